@@ -41,6 +41,16 @@ rm -rf build
 cmake -Bbuild -DFREERTOS_DIRECTORY=$TEST_FREERTOS_SRC -DCMAKE_BUILD_TYPE=Release ./tests/ut
 cmake --build build -- --jobs=$TEST_CORES
 
+for TEST_EMULATOR_HOST in emulator bulk_provisioning bench; do
+    echo -e "::group::Running $TEST_EMULATOR_HOST tests"
+    rm -rf build_$TEST_EMULATOR_HOST
+    cmake -Bbuild_$TEST_EMULATOR_HOST -DFREERTOS_DIRECTORY=$TEST_FREERTOS_SRC -DCMAKE_BUILD_TYPE=Release ./tests/$TEST_EMULATOR_HOST
+    cmake --build build_$TEST_EMULATOR_HOST -- --jobs=$TEST_CORES
+    pushd build_$TEST_EMULATOR_HOST
+    ctest -C "release" --output-on-failure --verbose
+    popd
+done
+
 if [ $TEST_RUN_E2E_TESTS -ne 0 ]; then
     ./tests/e2e/run.sh veth1 $TEST_FREERTOS_SRC
 else
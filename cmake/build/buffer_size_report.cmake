@@ -0,0 +1,83 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT License.
+
+# Print the buffer sizes of azure_iot_buffer_size.h for the configuration
+# _TARGET is built with. The values are read back from a compiled probe, as
+# CheckTypeSize does, so that it also works when cross compiling.
+function(az_iot_buffer_size_report _TARGET)
+  set(_SIZES
+    hub_working_buffer azureiothubWORKING_BUFFER_SIZE
+    hub_buffer_min azureiothubBUFFER_SIZE_MIN
+    hub_transient_buffer_min azureiothubTRANSIENT_BUFFER_SIZE_MIN
+    provisioning_scratch_buffer azureiotprovisioningSCRATCH_BUFFER_SIZE
+    provisioning_response_state azureiotprovisioningRESPONSE_STATE_MAX
+    provisioning_buffer_min azureiotprovisioningBUFFER_SIZE_MIN
+  )
+
+  set(_PROBE_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}/az_iot_buffer_size)
+  set(_PROBE_SOURCE "#include \"azure_iot_buffer_size.h\"\n\n")
+  string(APPEND _PROBE_SOURCE "#define azureiotPrvDigit( x, d )    ( char ) ( '0' + ( ( x ) / ( d ) ) % 10 )\n")
+  string(APPEND _PROBE_SOURCE "#define azureiotPrvDigits( x )      azureiotPrvDigit( x, 1000000 ), azureiotPrvDigit( x, 100000 ), \\\n")
+  string(APPEND _PROBE_SOURCE "    azureiotPrvDigit( x, 10000 ), azureiotPrvDigit( x, 1000 ), azureiotPrvDigit( x, 100 ), \\\n")
+  string(APPEND _PROBE_SOURCE "    azureiotPrvDigit( x, 10 ), azureiotPrvDigit( x, 1 )\n\n")
+
+  list(LENGTH _SIZES _SIZES_LENGTH)
+  math(EXPR _LAST "${_SIZES_LENGTH} - 1")
+
+  foreach(_INDEX RANGE 0 ${_LAST} 2)
+    math(EXPR _MACRO_INDEX "${_INDEX} + 1")
+    list(GET _SIZES ${_INDEX} _NAME)
+    list(GET _SIZES ${_MACRO_INDEX} _MACRO)
+    string(REGEX REPLACE "(.)" "'\\1', " _NAME_CHARACTERS "AZIOTSIZE:${_NAME}[")
+    string(APPEND _PROBE_SOURCE
+      "const char az_iot_buffer_size_${_NAME}[] = { ${_NAME_CHARACTERS}azureiotPrvDigits( ${_MACRO} ), ']', '\\0' };\n")
+  endforeach()
+
+  file(WRITE ${_PROBE_DIRECTORY}/probe.c "${_PROBE_SOURCE}")
+
+  get_target_property(_INCLUDES ${_TARGET} INCLUDE_DIRECTORIES)
+  get_target_property(_DEFINITIONS ${_TARGET} COMPILE_DEFINITIONS)
+  set(_DEFINITION_FLAGS "")
+
+  if(_DEFINITIONS)
+    list(FILTER _DEFINITIONS EXCLUDE REGEX "\\$<")
+
+    foreach(_DEFINITION ${_DEFINITIONS})
+      list(APPEND _DEFINITION_FLAGS "-D${_DEFINITION}")
+    endforeach()
+  endif()
+
+  if(_INCLUDES)
+    list(FILTER _INCLUDES EXCLUDE REGEX "\\$<")
+  else()
+    set(_INCLUDES "")
+  endif()
+
+  # A library, so that no startup code or linker script is needed for embedded toolchains.
+  set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+  try_compile(_COMPILED ${_PROBE_DIRECTORY}/build
+    SOURCES ${_PROBE_DIRECTORY}/probe.c
+    CMAKE_FLAGS "-DINCLUDE_DIRECTORIES=${_INCLUDES}"
+    COMPILE_DEFINITIONS ${_DEFINITION_FLAGS}
+    OUTPUT_VARIABLE _OUTPUT
+    COPY_FILE ${_PROBE_DIRECTORY}/probe.bin
+  )
+
+  if(NOT _COMPILED)
+    message(STATUS "Azure IoT buffer sizes: not available, the configuration could not be compiled on its own")
+    file(WRITE ${_PROBE_DIRECTORY}/probe.log "${_OUTPUT}")
+    return()
+  endif()
+
+  file(STRINGS ${_PROBE_DIRECTORY}/probe.bin _INFO REGEX "AZIOTSIZE:[a-z_]+\\[[0-9]+\\]")
+  message(STATUS "Azure IoT buffer sizes for this configuration, in bytes:")
+
+  foreach(_ENTRY ${_INFO})
+    string(REGEX MATCH "AZIOTSIZE:([a-z_]+)\\[0*([0-9]+)\\]" _MATCH "${_ENTRY}")
+
+    if(_MATCH)
+      message(STATUS "  ${CMAKE_MATCH_1}: ${CMAKE_MATCH_2}")
+    endif()
+  endforeach()
+endfunction()
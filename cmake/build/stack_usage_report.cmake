@@ -0,0 +1,69 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT License.
+
+# Collect the .su files written by -fstack-usage under STACK_USAGE_DIRECTORY
+# and write the frames, largest first, to STACK_USAGE_REPORT.
+#
+# Usage: cmake -DSTACK_USAGE_DIRECTORY=<dir> -DSTACK_USAGE_REPORT=<file> -P stack_usage_report.cmake
+
+if(NOT STACK_USAGE_DIRECTORY OR NOT STACK_USAGE_REPORT)
+  message(FATAL_ERROR "STACK_USAGE_DIRECTORY and STACK_USAGE_REPORT must be set")
+endif()
+
+file(GLOB_RECURSE _SU_FILES "${STACK_USAGE_DIRECTORY}/*.su")
+
+if(NOT _SU_FILES)
+  message(FATAL_ERROR "No .su files under ${STACK_USAGE_DIRECTORY}, build with AZURE_IOT_STACK_USAGE=ON first")
+endif()
+
+set(_ENTRIES "")
+
+foreach(_SU_FILE ${_SU_FILES})
+  file(STRINGS ${_SU_FILE} _LINES)
+
+  foreach(_LINE ${_LINES})
+    # <file>:<line>:<column>:<function>\t<bytes>\t<static|dynamic|dynamic,bounded>
+    string(REPLACE "\t" ";" _FIELDS "${_LINE}")
+    list(LENGTH _FIELDS _FIELD_COUNT)
+
+    if(_FIELD_COUNT EQUAL 3)
+      list(GET _FIELDS 0 _LOCATION)
+      list(GET _FIELDS 1 _BYTES)
+      list(GET _FIELDS 2 _QUALIFIER)
+      string(REGEX REPLACE "^.*:" "" _FUNCTION "${_LOCATION}")
+      get_filename_component(_SOURCE "${_SU_FILE}" NAME_WE)
+
+      # Zero padded so that a reverse string sort orders by size.
+      string(LENGTH "${_BYTES}" _DIGITS)
+      math(EXPR _PADDING "8 - ${_DIGITS}")
+      string(REPEAT "0" ${_PADDING} _ZEROES)
+      list(APPEND _ENTRIES "${_ZEROES}${_BYTES}|${_FUNCTION}|${_SOURCE}|${_QUALIFIER}")
+    endif()
+  endforeach()
+endforeach()
+
+list(SORT _ENTRIES ORDER DESCENDING)
+
+set(_REPORT "bytes     qualifier         function (source)\n")
+
+foreach(_ENTRY ${_ENTRIES})
+  string(REPLACE "|" ";" _FIELDS "${_ENTRY}")
+  list(GET _FIELDS 0 _BYTES)
+  list(GET _FIELDS 1 _FUNCTION)
+  list(GET _FIELDS 2 _SOURCE)
+  list(GET _FIELDS 3 _QUALIFIER)
+  string(REGEX REPLACE "^0+([0-9])" "\\1" _BYTES "${_BYTES}")
+
+  string(LENGTH "${_BYTES}" _LENGTH)
+  math(EXPR _PADDING "10 - ${_LENGTH}")
+  string(REPEAT " " ${_PADDING} _BYTES_PADDING)
+  string(LENGTH "${_QUALIFIER}" _LENGTH)
+  math(EXPR _PADDING "18 - ${_LENGTH}")
+  string(REPEAT " " ${_PADDING} _QUALIFIER_PADDING)
+
+  string(APPEND _REPORT "${_BYTES}${_BYTES_PADDING}${_QUALIFIER}${_QUALIFIER_PADDING}${_FUNCTION} (${_SOURCE})\n")
+endforeach()
+
+file(WRITE ${STACK_USAGE_REPORT} "${_REPORT}")
+message("${_REPORT}")
+message(STATUS "Stack usage report written to ${STACK_USAGE_REPORT}")
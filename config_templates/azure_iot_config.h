@@ -87,4 +87,82 @@
  */
 // #define azureiotconfigPROVISIONING_REQUEST_PAYLOAD_MAX    ( 512U )
 
+/**
+ * @brief Provisioning polling interval.
+ *
+ */
+// #define azureiotconfigPROVISIONING_POLLING_INTERVAL_S    ( 3U )
+
+/**
+ * @brief Max provisioning polling interval.
+ *
+ */
+// #define azureiotconfigPROVISIONING_BACKOFF_MAX_S    ( 60U )
+
+/**
+ * @brief Max random delay added to a provisioning polling interval, in percent of the interval.
+ *
+ */
+// #define azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT    ( 25U )
+
+/**
+ * @brief First delay before AzureIoTHubClient_Run() reconnects a lost connection, in milliseconds.
+ *
+ */
+// #define azureiotconfigRECONNECT_BACKOFF_BASE_MS    ( 1000U )
+
+/**
+ * @brief Max delay between two reconnect attempts of AzureIoTHubClient_Run(), in seconds.
+ *
+ */
+// #define azureiotconfigRECONNECT_BACKOFF_MAX_S    ( 120U )
+
+/**
+ * @brief Max random delay added to a reconnect delay, in percent of the delay.
+ *
+ */
+// #define azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT    ( 50U )
+
+/**
+ * @brief Time before the SAS token expires at which AzureIoTHubClient_Run() reconnects with a new one, in seconds.
+ *
+ */
+// #define azureiotconfigTOKEN_RENEWAL_MARGIN_S    ( 300U )
+
+/**
+ * @brief Max random time by which a SAS token renewal is brought forward, in percent of the token lifetime.
+ *
+ */
+// #define azureiotconfigTOKEN_RENEWAL_JITTER_PERCENT    ( 10U )
+
+/**
+ * @brief Max JSON value length of a property tracked by the reported properties cache.
+ *
+ */
+// #define azureiotconfigPROPERTIES_CACHE_VALUE_MAX    ( 32U )
+
+/**
+ * @brief Max properties requests sent with a callback which can wait for their response at once.
+ *
+ */
+// #define azureiotconfigPROPERTIES_REQUESTS_MAX    ( 4U )
+
+/**
+ * @brief Record the peak stack usage of the middleware entry points and callbacks.
+ *
+ */
+// #define azureiotconfigSTACK_PROFILING    ( 0 )
+
+/**
+ * @brief Thread local storage pointer used by stack profiling to track nested instrumented calls.
+ *
+ */
+// #define azureiotconfigSTACK_PROFILING_TLS_INDEX    ( 0 )
+
+/**
+ * @brief Max stack depth, in bytes, below an instrumented call that stack profiling can measure.
+ *
+ */
+// #define azureiotconfigSTACK_PROFILING_DEPTH_MAX    ( 4096U )
+
 #endif /* AZURE_IOT_CONFIG_H */
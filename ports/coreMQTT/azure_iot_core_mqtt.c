@@ -14,6 +14,8 @@
 
 #include "azure_iot_mqtt.h"
 
+#include "core_mqtt_state.h"
+
 /**
  * Maps CoreMQTT errors to AzureIoTMQTT errors.
  **/
@@ -143,6 +145,113 @@ AzureIoTMQTTResult_t AzureIoTMQTT_Publish( AzureIoTMQTTHandle_t xContext,
     return prvTranslateToAzureIoTMQTTResult( xResult );
 }
 
+/**
+ * Sends all the bytes through the transport, retrying partial sends as coreMQTT does.
+ **/
+static MQTTStatus_t prvSendAll( MQTTContext_t * pxContext,
+                                const uint8_t * pucData,
+                                size_t xDataLength )
+{
+    MQTTStatus_t xResult = MQTTSuccess;
+    size_t xBytesSent = 0;
+    int32_t lSendResult;
+    uint32_t ulLastSendTime = pxContext->getTime();
+
+    while( ( xResult == MQTTSuccess ) && ( xBytesSent < xDataLength ) )
+    {
+        lSendResult = pxContext->transportInterface.send( pxContext->transportInterface.pNetworkContext,
+                                                          pucData + xBytesSent, xDataLength - xBytesSent );
+
+        if( lSendResult < 0 )
+        {
+            xResult = MQTTSendFailed;
+        }
+        else if( lSendResult > 0 )
+        {
+            xBytesSent += ( size_t ) lSendResult;
+            ulLastSendTime = pxContext->getTime();
+        }
+        else if( ( pxContext->getTime() - ulLastSendTime ) >= MQTT_SEND_RETRY_TIMEOUT_MS )
+        {
+            xResult = MQTTSendFailed;
+        }
+    }
+
+    if( xResult == MQTTSuccess )
+    {
+        pxContext->lastPacketTime = pxContext->getTime();
+    }
+
+    return xResult;
+}
+
+/**
+ * Drops the outgoing publish record reserved for a PUBLISH which never made it to the wire,
+ * as coreMQTT does once a publish is acknowledged.
+ **/
+static void prvReleaseState( MQTTContext_t * pxContext,
+                             uint16_t usPacketId )
+{
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < MQTT_STATE_ARRAY_MAX_COUNT; xIndex++ )
+    {
+        if( pxContext->outgoingPublishRecords[ xIndex ].packetId == usPacketId )
+        {
+            pxContext->outgoingPublishRecords[ xIndex ].packetId = MQTT_PACKET_ID_INVALID;
+            pxContext->outgoingPublishRecords[ xIndex ].qos = MQTTQoS0;
+            pxContext->outgoingPublishRecords[ xIndex ].publishState = MQTTStateNull;
+            break;
+        }
+    }
+}
+
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamBegin( AzureIoTMQTTHandle_t xContext,
+                                                      const AzureIoTMQTTPublishInfo_t * pxPublishInfo,
+                                                      uint16_t usPacketId )
+{
+    const MQTTPublishInfo_t * pxInfo = ( const MQTTPublishInfo_t * ) pxPublishInfo;
+    MQTTPublishState_t xPublishState;
+    MQTTStatus_t xResult;
+    size_t xRemainingLength;
+    size_t xPacketSize;
+    size_t xHeaderSize;
+
+    /* The header goes through the network buffer, the payload is sent as it is produced. */
+    if( ( ( xResult = MQTT_GetPublishPacketSize( pxInfo, &xRemainingLength, &xPacketSize ) ) == MQTTSuccess ) &&
+        ( ( xResult = MQTT_SerializePublishHeader( pxInfo, usPacketId, xRemainingLength,
+                                                   &xContext->networkBuffer, &xHeaderSize ) ) == MQTTSuccess ) &&
+        ( ( pxInfo->qos == MQTTQoS0 ) ||
+          ( ( xResult = MQTT_ReserveState( xContext, usPacketId, pxInfo->qos ) ) == MQTTSuccess ) ) )
+    {
+        if( ( xResult = prvSendAll( xContext, xContext->networkBuffer.pBuffer, xHeaderSize ) ) != MQTTSuccess )
+        {
+            if( pxInfo->qos != MQTTQoS0 )
+            {
+                prvReleaseState( xContext, usPacketId );
+            }
+        }
+        else if( pxInfo->qos != MQTTQoS0 )
+        {
+            /* Nothing can be received before the payload is complete, so the PUBACK is expected from now on. */
+            xResult = MQTT_UpdateStatePublish( xContext, usPacketId, MQTT_SEND, pxInfo->qos, &xPublishState );
+        }
+    }
+
+    return prvTranslateToAzureIoTMQTTResult( xResult );
+}
+
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamSend( AzureIoTMQTTHandle_t xContext,
+                                                     const uint8_t * pucData,
+                                                     size_t xDataLength )
+{
+    MQTTStatus_t xResult;
+
+    xResult = prvSendAll( xContext, pucData, xDataLength );
+
+    return prvTranslateToAzureIoTMQTTResult( xResult );
+}
+
 AzureIoTMQTTResult_t AzureIoTMQTT_Ping( AzureIoTMQTTHandle_t xContext )
 {
     MQTTStatus_t xResult;
@@ -19,9 +19,6 @@
 #include "azure/az_iot.h"
 #include "azure/core/az_base64.h"
 
-/* Using SHA256 hash - needs 32 bytes */
-#define azureiotBASE64_HASH_BUFFER_SIZE    ( 33 )
-
 /*-----------------------------------------------------------*/
 
 /**
@@ -183,3 +180,32 @@ AzureIoTResult_t AzureIoT_Base64HMACCalculate( AzureIoTGetHMACFunc_t xAzureIoTHM
     return eAzureIoTSuccess;
 }
 /*-----------------------------------------------------------*/
+
+uint32_t AzureIoT_FNV1aHash( uint32_t ulHash,
+                             const uint8_t * pucData,
+                             uint32_t ulDataLength )
+{
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulDataLength; ulIndex++ )
+    {
+        ulHash = ( ulHash ^ pucData[ ulIndex ] ) * azureiotFNV_PRIME;
+    }
+
+    return ulHash;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AzureIoT_NextJitter( uint32_t * pulState )
+{
+    uint32_t ulState = *pulState;
+
+    /* xorshift32 */
+    ulState ^= ulState << 13;
+    ulState ^= ulState >> 17;
+    ulState ^= ulState << 5;
+    *pulState = ulState;
+
+    return ulState;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,668 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_cbor_writer.c
+ * @brief Implementation of the Azure IoT CBOR writer.
+ */
+
+#include "azure_iot_cbor_writer.h"
+
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "azure_iot.h"
+
+/* CBOR major types, already shifted into the initial byte. */
+#define azureiotcborMAJOR_UNSIGNED              ( 0x00 )
+#define azureiotcborMAJOR_NEGATIVE              ( 0x20 )
+#define azureiotcborMAJOR_BYTES                 ( 0x40 )
+#define azureiotcborMAJOR_TEXT                  ( 0x60 )
+
+/* Initial bytes of simple values and indefinite-length containers. */
+#define azureiotcborFALSE                       ( 0xF4 )
+#define azureiotcborTRUE                        ( 0xF5 )
+#define azureiotcborNULL                        ( 0xF6 )
+#define azureiotcborFLOAT32                     ( 0xFA )
+#define azureiotcborFLOAT64                     ( 0xFB )
+#define azureiotcborBEGIN_INDEFINITE_ARRAY      ( 0x9F )
+#define azureiotcborBEGIN_INDEFINITE_MAP        ( 0xBF )
+#define azureiotcborBREAK                       ( 0xFF )
+
+/* Additional information values selecting the size of the argument. */
+#define azureiotcborADDITIONAL_UINT8            ( 24 )
+#define azureiotcborADDITIONAL_UINT16           ( 25 )
+#define azureiotcborADDITIONAL_UINT32           ( 26 )
+
+/* Largest head: initial byte and a 32-bit argument. */
+#define azureiotcborHEAD_MAX                    ( 5 )
+
+static bool prvHasSpace( AzureIoTCBORWriter_t * pxWriter,
+                         uint32_t ulLength )
+{
+    return ( pxWriter->_internal.ulBufferLength - pxWriter->_internal.ulBytesWritten ) >= ulLength;
+}
+
+/**
+ *
+ * Write a data item head of the given major type using the shortest argument encoding.
+ *
+ * */
+static AzureIoTResult_t prvWriteHead( AzureIoTCBORWriter_t * pxWriter,
+                                      uint8_t ucMajorType,
+                                      uint32_t ulArgument )
+{
+    uint8_t ucHead[ azureiotcborHEAD_MAX ];
+    uint32_t ulHeadLength;
+    AzureIoTResult_t xResult;
+
+    if( ulArgument < azureiotcborADDITIONAL_UINT8 )
+    {
+        ucHead[ 0 ] = ( uint8_t ) ( ucMajorType | ulArgument );
+        ulHeadLength = 1;
+    }
+    else if( ulArgument <= UINT8_MAX )
+    {
+        ucHead[ 0 ] = ( uint8_t ) ( ucMajorType | azureiotcborADDITIONAL_UINT8 );
+        ucHead[ 1 ] = ( uint8_t ) ulArgument;
+        ulHeadLength = 2;
+    }
+    else if( ulArgument <= UINT16_MAX )
+    {
+        ucHead[ 0 ] = ( uint8_t ) ( ucMajorType | azureiotcborADDITIONAL_UINT16 );
+        ucHead[ 1 ] = ( uint8_t ) ( ulArgument >> 8 );
+        ucHead[ 2 ] = ( uint8_t ) ulArgument;
+        ulHeadLength = 3;
+    }
+    else
+    {
+        ucHead[ 0 ] = ( uint8_t ) ( ucMajorType | azureiotcborADDITIONAL_UINT32 );
+        ucHead[ 1 ] = ( uint8_t ) ( ulArgument >> 24 );
+        ucHead[ 2 ] = ( uint8_t ) ( ulArgument >> 16 );
+        ucHead[ 3 ] = ( uint8_t ) ( ulArgument >> 8 );
+        ucHead[ 4 ] = ( uint8_t ) ulArgument;
+        ulHeadLength = 5;
+    }
+
+    if( !prvHasSpace( pxWriter, ulHeadLength ) )
+    {
+        AZLogError( ( "CBOR writer out of space" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        memcpy( pxWriter->_internal.pucBuffer + pxWriter->_internal.ulBytesWritten, ucHead, ulHeadLength );
+        pxWriter->_internal.ulBytesWritten += ulHeadLength;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Write a text or byte string: the head followed by the content.
+ *
+ * */
+static AzureIoTResult_t prvWriteString( AzureIoTCBORWriter_t * pxWriter,
+                                        uint8_t ucMajorType,
+                                        const uint8_t * pucValue,
+                                        uint32_t ulValueLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulBytesWritten = pxWriter->_internal.ulBytesWritten;
+
+    if( ( xResult = prvWriteHead( pxWriter, ucMajorType, ulValueLength ) ) != eAzureIoTSuccess )
+    {
+        AZLogError( ( "Could not write CBOR string head: error=0x%08x", xResult ) );
+    }
+    else if( !prvHasSpace( pxWriter, ulValueLength ) )
+    {
+        AZLogError( ( "CBOR writer out of space" ) );
+        /* Do not leave a dangling head behind. */
+        pxWriter->_internal.ulBytesWritten = ulBytesWritten;
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        memcpy( pxWriter->_internal.pucBuffer + pxWriter->_internal.ulBytesWritten, pucValue, ulValueLength );
+        pxWriter->_internal.ulBytesWritten += ulValueLength;
+    }
+
+    return xResult;
+}
+
+static AzureIoTResult_t prvWriteByte( AzureIoTCBORWriter_t * pxWriter,
+                                      uint8_t ucValue )
+{
+    AzureIoTResult_t xResult;
+
+    if( !prvHasSpace( pxWriter, 1 ) )
+    {
+        AZLogError( ( "CBOR writer out of space" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        pxWriter->_internal.pucBuffer[ pxWriter->_internal.ulBytesWritten++ ] = ucValue;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+static AzureIoTResult_t prvWriteInt32( AzureIoTCBORWriter_t * pxWriter,
+                                       int32_t lValue )
+{
+    AzureIoTResult_t xResult;
+
+    if( lValue >= 0 )
+    {
+        xResult = prvWriteHead( pxWriter, azureiotcborMAJOR_UNSIGNED, ( uint32_t ) lValue );
+    }
+    else
+    {
+        /* Negative integers encode -1 - n, which cannot overflow for INT32_MIN. */
+        xResult = prvWriteHead( pxWriter, azureiotcborMAJOR_NEGATIVE, ( uint32_t ) ( -( lValue + 1 ) ) );
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Write a double in single precision if it round trips exactly, otherwise in double precision.
+ *
+ * */
+static AzureIoTResult_t prvWriteDouble( AzureIoTCBORWriter_t * pxWriter,
+                                        double xValue )
+{
+    float xSingle = 0.0F;
+    double xRoundTrip = 0.0;
+    uint64_t ullBits;
+    uint32_t ulBits;
+    uint32_t ulIndex;
+    AzureIoTResult_t xResult;
+
+    /* Converting a value outside the float range is undefined, so only narrow what fits. */
+    if( ( xValue >= -FLT_MAX ) && ( xValue <= FLT_MAX ) )
+    {
+        xSingle = ( float ) xValue;
+        xRoundTrip = ( double ) xSingle;
+    }
+
+    /* Compare bit patterns rather than values so signed zeros are kept. */
+    if( memcmp( &xRoundTrip, &xValue, sizeof( double ) ) == 0 )
+    {
+        memcpy( &ulBits, &xSingle, sizeof( ulBits ) );
+
+        if( !prvHasSpace( pxWriter, 1 + sizeof( ulBits ) ) )
+        {
+            AZLogError( ( "CBOR writer out of space" ) );
+            xResult = eAzureIoTErrorOutOfMemory;
+        }
+        else
+        {
+            pxWriter->_internal.pucBuffer[ pxWriter->_internal.ulBytesWritten++ ] = azureiotcborFLOAT32;
+
+            for( ulIndex = 0; ulIndex < sizeof( ulBits ); ulIndex++ )
+            {
+                pxWriter->_internal.pucBuffer[ pxWriter->_internal.ulBytesWritten++ ] =
+                    ( uint8_t ) ( ulBits >> ( 8U * ( sizeof( ulBits ) - 1U - ulIndex ) ) );
+            }
+
+            xResult = eAzureIoTSuccess;
+        }
+    }
+    else
+    {
+        memcpy( &ullBits, &xValue, sizeof( ullBits ) );
+
+        if( !prvHasSpace( pxWriter, 1 + sizeof( ullBits ) ) )
+        {
+            AZLogError( ( "CBOR writer out of space" ) );
+            xResult = eAzureIoTErrorOutOfMemory;
+        }
+        else
+        {
+            pxWriter->_internal.pucBuffer[ pxWriter->_internal.ulBytesWritten++ ] = azureiotcborFLOAT64;
+
+            for( ulIndex = 0; ulIndex < sizeof( ullBits ); ulIndex++ )
+            {
+                pxWriter->_internal.pucBuffer[ pxWriter->_internal.ulBytesWritten++ ] =
+                    ( uint8_t ) ( ullBits >> ( 8U * ( sizeof( ullBits ) - 1U - ulIndex ) ) );
+            }
+
+            xResult = eAzureIoTSuccess;
+        }
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Open a container, recording its kind (1 for map, 0 for array) in the nesting bit stack.
+ *
+ * */
+static AzureIoTResult_t prvBeginContainer( AzureIoTCBORWriter_t * pxWriter,
+                                           bool xIsMap )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter->_internal.ulDepth >= azureiotcborwriterMAX_DEPTH )
+    {
+        AZLogError( ( "CBOR writer nesting overflow" ) );
+        xResult = eAzureIoTErrorJSONNestingOverflow;
+    }
+    else if( ( xResult = prvWriteByte( pxWriter, xIsMap ? azureiotcborBEGIN_INDEFINITE_MAP :
+                                       azureiotcborBEGIN_INDEFINITE_ARRAY ) ) == eAzureIoTSuccess )
+    {
+        pxWriter->_internal.ulContainerStack = ( pxWriter->_internal.ulContainerStack << 1 ) | ( xIsMap ? 1U : 0U );
+        pxWriter->_internal.ulDepth++;
+    }
+
+    return xResult;
+}
+
+static AzureIoTResult_t prvEndContainer( AzureIoTCBORWriter_t * pxWriter,
+                                         bool xIsMap )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter->_internal.ulDepth == 0 ) ||
+        ( ( ( pxWriter->_internal.ulContainerStack & 1U ) == 1U ) != xIsMap ) )
+    {
+        AZLogError( ( "CBOR writer invalid state: no matching open container" ) );
+        xResult = eAzureIoTErrorJSONInvalidState;
+    }
+    else if( ( xResult = prvWriteByte( pxWriter, azureiotcborBREAK ) ) == eAzureIoTSuccess )
+    {
+        pxWriter->_internal.ulContainerStack >>= 1;
+        pxWriter->_internal.ulDepth--;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_Init( AzureIoTCBORWriter_t * pxWriter,
+                                          uint8_t * pucBuffer,
+                                          uint32_t ulBufferSize )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( pucBuffer == NULL ) || ( ulBufferSize == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_Init failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        pxWriter->_internal.pucBuffer = pucBuffer;
+        pxWriter->_internal.ulBufferLength = ulBufferSize;
+        pxWriter->_internal.ulBytesWritten = 0;
+        pxWriter->_internal.ulContainerStack = 0;
+        pxWriter->_internal.ulDepth = 0;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithInt32Value( AzureIoTCBORWriter_t * pxWriter,
+                                                                  const uint8_t * pucPropertyName,
+                                                                  uint32_t ulPropertyNameLength,
+                                                                  int32_t lValue )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulBytesWritten;
+
+    if( ( pxWriter == NULL ) || ( pucPropertyName == NULL ) || ( ulPropertyNameLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendPropertyWithInt32Value failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        ulBytesWritten = pxWriter->_internal.ulBytesWritten;
+
+        if( ( ( xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucPropertyName, ulPropertyNameLength ) ) != eAzureIoTSuccess ) ||
+            ( ( xResult = prvWriteInt32( pxWriter, lValue ) ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "Could not append property and int32: error=0x%08x", xResult ) );
+            pxWriter->_internal.ulBytesWritten = ulBytesWritten;
+        }
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithDoubleValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                   const uint8_t * pucPropertyName,
+                                                                   uint32_t ulPropertyNameLength,
+                                                                   double xValue )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulBytesWritten;
+
+    if( ( pxWriter == NULL ) || ( pucPropertyName == NULL ) || ( ulPropertyNameLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendPropertyWithDoubleValue failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        ulBytesWritten = pxWriter->_internal.ulBytesWritten;
+
+        if( ( ( xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucPropertyName, ulPropertyNameLength ) ) != eAzureIoTSuccess ) ||
+            ( ( xResult = prvWriteDouble( pxWriter, xValue ) ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "Could not append property and double: error=0x%08x", xResult ) );
+            pxWriter->_internal.ulBytesWritten = ulBytesWritten;
+        }
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithBoolValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                 const uint8_t * pucPropertyName,
+                                                                 uint32_t ulPropertyNameLength,
+                                                                 bool xValue )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulBytesWritten;
+
+    if( ( pxWriter == NULL ) || ( pucPropertyName == NULL ) || ( ulPropertyNameLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendPropertyWithBoolValue failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        ulBytesWritten = pxWriter->_internal.ulBytesWritten;
+
+        if( ( ( xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucPropertyName, ulPropertyNameLength ) ) != eAzureIoTSuccess ) ||
+            ( ( xResult = prvWriteByte( pxWriter, xValue ? azureiotcborTRUE : azureiotcborFALSE ) ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "Could not append property and bool: error=0x%08x", xResult ) );
+            pxWriter->_internal.ulBytesWritten = ulBytesWritten;
+        }
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithStringValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                   const uint8_t * pucPropertyName,
+                                                                   uint32_t ulPropertyNameLength,
+                                                                   const uint8_t * pucValue,
+                                                                   uint32_t ulValueLen )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulBytesWritten;
+
+    if( ( pxWriter == NULL ) || ( pucPropertyName == NULL ) || ( ulPropertyNameLength == 0 ) ||
+        ( pucValue == NULL ) || ( ulValueLen == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendPropertyWithStringValue failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        ulBytesWritten = pxWriter->_internal.ulBytesWritten;
+
+        if( ( ( xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucPropertyName, ulPropertyNameLength ) ) != eAzureIoTSuccess ) ||
+            ( ( xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucValue, ulValueLen ) ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "Could not append property and string: error=0x%08x", xResult ) );
+            pxWriter->_internal.ulBytesWritten = ulBytesWritten;
+        }
+    }
+
+    return xResult;
+}
+
+int32_t AzureIoTCBORWriter_GetBytesUsed( AzureIoTCBORWriter_t * pxWriter )
+{
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_GetBytesUsed failed: invalid argument" ) );
+        return -1;
+    }
+
+    return ( int32_t ) pxWriter->_internal.ulBytesWritten;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendString( AzureIoTCBORWriter_t * pxWriter,
+                                                  const uint8_t * pucValue,
+                                                  uint32_t ulValueLen )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( pucValue == NULL ) || ( ulValueLen == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendString failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pucValue, ulValueLen );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendBytes( AzureIoTCBORWriter_t * pxWriter,
+                                                 const uint8_t * pucValue,
+                                                 uint32_t ulValueLen )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( ( pucValue == NULL ) && ( ulValueLen != 0 ) ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendBytes failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteString( pxWriter, azureiotcborMAJOR_BYTES, pucValue, ulValueLen );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyName( AzureIoTCBORWriter_t * pxWriter,
+                                                        const uint8_t * pusValue,
+                                                        uint32_t ulValueLen )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( pusValue == NULL ) || ( ulValueLen == 0 ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendPropertyName failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteString( pxWriter, azureiotcborMAJOR_TEXT, pusValue, ulValueLen );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendBool( AzureIoTCBORWriter_t * pxWriter,
+                                                bool xValue )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendBool failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteByte( pxWriter, xValue ? azureiotcborTRUE : azureiotcborFALSE );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendInt32( AzureIoTCBORWriter_t * pxWriter,
+                                                 int32_t lValue )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendInt32 failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteInt32( pxWriter, lValue );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendDouble( AzureIoTCBORWriter_t * pxWriter,
+                                                  double xValue )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendDouble failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteDouble( pxWriter, xValue );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendNull( AzureIoTCBORWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendNull failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvWriteByte( pxWriter, azureiotcborNULL );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendBeginObject( AzureIoTCBORWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendBeginObject failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvBeginContainer( pxWriter, true );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendBeginArray( AzureIoTCBORWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendBeginArray failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvBeginContainer( pxWriter, false );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendEndObject( AzureIoTCBORWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendEndObject failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvEndContainer( pxWriter, true );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_AppendEndArray( AzureIoTCBORWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxWriter == NULL )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_AppendEndArray failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvEndContainer( pxWriter, false );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTCBORWriter_SetMessageProperties( AzureIoTMessageProperties_t * pxProperties,
+                                                          const uint8_t * pucContentEncoding,
+                                                          uint32_t ulContentEncodingLength )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxProperties == NULL ) ||
+        ( ( pucContentEncoding != NULL ) && ( ulContentEncodingLength == 0 ) ) )
+    {
+        AZLogError( ( "AzureIoTCBORWriter_SetMessageProperties failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( xResult = AzureIoTMessage_PropertiesAppend( pxProperties,
+                                                           ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_TYPE,
+                                                           sizeof( azureiotmessagePROPERTY_CONTENT_TYPE ) - 1,
+                                                           ( const uint8_t * ) azureiotcborwriterCONTENT_TYPE,
+                                                           sizeof( azureiotcborwriterCONTENT_TYPE ) - 1 ) ) != eAzureIoTSuccess )
+    {
+        AZLogError( ( "Could not append content type property: error=0x%08x", xResult ) );
+    }
+    else if( pucContentEncoding != NULL )
+    {
+        if( ( xResult = AzureIoTMessage_PropertiesAppend( pxProperties,
+                                                          ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_ENCODING,
+                                                          sizeof( azureiotmessagePROPERTY_CONTENT_ENCODING ) - 1,
+                                                          pucContentEncoding,
+                                                          ulContentEncodingLength ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Could not append content encoding property: error=0x%08x", xResult ) );
+        }
+    }
+
+    return xResult;
+}
@@ -0,0 +1,264 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_compression.c
+ *
+ * @brief Implementation of the LZSS codec.
+ *
+ */
+
+#include "azure_iot_compression.h"
+
+#include <string.h>
+
+#include "azure_iot.h"
+
+#define azureiotcompressionMAX_DISTANCE    ( 4096 )
+#define azureiotcompressionMIN_MATCH       ( 3 )
+#define azureiotcompressionMAX_MATCH       ( azureiotcompressionMIN_MATCH + 15 )
+#define azureiotcompressionGROUP_SIZE      ( 8 )
+
+/* Knuth multiplicative hashing constant. */
+#define azureiotcompressionHASH_MULTIPLIER    ( 2654435761U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Hash the three bytes starting at pucData into ulHashBits bits.
+ *
+ * */
+static uint32_t prvHash( const uint8_t * pucData,
+                         uint32_t ulHashBits )
+{
+    uint32_t ulValue = ( ( uint32_t ) pucData[ 0 ] << 16 ) |
+                       ( ( uint32_t ) pucData[ 1 ] << 8 ) |
+                       ( uint32_t ) pucData[ 2 ];
+
+    return ( ulValue * azureiotcompressionHASH_MULTIPLIER ) >> ( 32U - ulHashBits );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTCompression_Compress( const uint8_t * pucInput,
+                                               uint32_t ulInputLength,
+                                               uint8_t * pucOutput,
+                                               uint32_t ulOutputLength,
+                                               uint32_t * pulOutputLength,
+                                               uint8_t * pucWindowBuffer,
+                                               uint32_t ulWindowBufferLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t * pulHeads;
+    uint32_t ulAlignment;
+    uint32_t ulHashBits = 0;
+    uint32_t ulPosition = 0;
+    uint32_t ulOutputIndex = 0;
+    uint32_t ulFlagIndex = 0;
+    uint32_t ulItemCount = azureiotcompressionGROUP_SIZE;
+    uint32_t ulItemLength;
+    uint32_t ulCandidate;
+    uint32_t ulMatchLength;
+    uint32_t ulMaxMatch;
+    uint32_t ulDistance;
+    uint32_t ulHash;
+    uint32_t ulIndex;
+
+    if( ( ( pucInput == NULL ) && ( ulInputLength != 0 ) ) ||
+        ( pucOutput == NULL ) || ( pulOutputLength == NULL ) ||
+        ( pucWindowBuffer == NULL ) || ( ulWindowBufferLength < azureiotcompressionWINDOW_BUFFER_MIN ) )
+    {
+        AZLogError( ( "AzureIoTCompression_Compress failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        ulAlignment = ( uint32_t ) ( ( sizeof( uint32_t ) - ( ( uintptr_t ) pucWindowBuffer % sizeof( uint32_t ) ) ) % sizeof( uint32_t ) );
+        pulHeads = ( uint32_t * ) ( void * ) ( pucWindowBuffer + ulAlignment );
+        ulWindowBufferLength -= ulAlignment;
+
+        /* Use the largest power of two number of slots that fits in the window buffer. */
+        while( ( ( sizeof( uint32_t ) << ( ulHashBits + 1 ) ) <= ulWindowBufferLength ) && ( ulHashBits < 16 ) )
+        {
+            ulHashBits++;
+        }
+
+        /* Slots hold the position of a candidate plus one, so zero marks an empty slot. */
+        memset( pulHeads, 0, sizeof( uint32_t ) << ulHashBits );
+
+        xResult = eAzureIoTSuccess;
+
+        while( ( xResult == eAzureIoTSuccess ) && ( ulPosition < ulInputLength ) )
+        {
+            ulMatchLength = 0;
+            ulDistance = 0;
+
+            if( ( ulInputLength - ulPosition ) >= azureiotcompressionMIN_MATCH )
+            {
+                ulHash = prvHash( pucInput + ulPosition, ulHashBits );
+                ulCandidate = pulHeads[ ulHash ];
+                pulHeads[ ulHash ] = ulPosition + 1;
+
+                if( ( ulCandidate != 0 ) && ( ( ulPosition - ( ulCandidate - 1 ) ) <= azureiotcompressionMAX_DISTANCE ) )
+                {
+                    ulCandidate--;
+                    ulMaxMatch = ulInputLength - ulPosition;
+
+                    if( ulMaxMatch > azureiotcompressionMAX_MATCH )
+                    {
+                        ulMaxMatch = azureiotcompressionMAX_MATCH;
+                    }
+
+                    while( ( ulMatchLength < ulMaxMatch ) &&
+                           ( pucInput[ ulCandidate + ulMatchLength ] == pucInput[ ulPosition + ulMatchLength ] ) )
+                    {
+                        ulMatchLength++;
+                    }
+
+                    ulDistance = ulPosition - ulCandidate;
+                }
+            }
+
+            /* A back-reference takes two bytes, a literal one, and a new group its flags byte first. */
+            ulItemLength = ( ulMatchLength >= azureiotcompressionMIN_MATCH ) ? 2U : 1U;
+            ulItemLength += ( ulItemCount == azureiotcompressionGROUP_SIZE ) ? 1U : 0U;
+
+            if( ( ulOutputLength - ulOutputIndex ) < ulItemLength )
+            {
+                AZLogError( ( "AzureIoTCompression_Compress failed: output buffer too small" ) );
+                xResult = eAzureIoTErrorOutOfMemory;
+            }
+            else
+            {
+                if( ulItemCount == azureiotcompressionGROUP_SIZE )
+                {
+                    ulFlagIndex = ulOutputIndex++;
+                    pucOutput[ ulFlagIndex ] = 0;
+                    ulItemCount = 0;
+                }
+
+                if( ulMatchLength >= azureiotcompressionMIN_MATCH )
+                {
+                    pucOutput[ ulOutputIndex++ ] = ( uint8_t ) ( ulDistance - 1 );
+                    pucOutput[ ulOutputIndex++ ] = ( uint8_t ) ( ( ( ( ulDistance - 1 ) >> 8 ) << 4 ) |
+                                                                 ( ulMatchLength - azureiotcompressionMIN_MATCH ) );
+
+                    /* Index the positions covered by the match so later data can refer to them. */
+                    for( ulIndex = ulPosition + 1; ulIndex < ( ulPosition + ulMatchLength ); ulIndex++ )
+                    {
+                        if( ( ulInputLength - ulIndex ) >= azureiotcompressionMIN_MATCH )
+                        {
+                            pulHeads[ prvHash( pucInput + ulIndex, ulHashBits ) ] = ulIndex + 1;
+                        }
+                    }
+
+                    ulPosition += ulMatchLength;
+                }
+                else
+                {
+                    pucOutput[ ulFlagIndex ] |= ( uint8_t ) ( 1U << ulItemCount );
+                    pucOutput[ ulOutputIndex++ ] = pucInput[ ulPosition++ ];
+                }
+
+                ulItemCount++;
+            }
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            *pulOutputLength = ulOutputIndex;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTCompression_Decompress( const uint8_t * pucInput,
+                                                 uint32_t ulInputLength,
+                                                 uint8_t * pucOutput,
+                                                 uint32_t ulOutputLength,
+                                                 uint32_t * pulOutputLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulInputIndex = 0;
+    uint32_t ulOutputIndex = 0;
+    uint32_t ulItemCount;
+    uint32_t ulDistance;
+    uint32_t ulMatchLength;
+    uint8_t ucFlags;
+
+    if( ( ( pucInput == NULL ) && ( ulInputLength != 0 ) ) ||
+        ( pucOutput == NULL ) || ( pulOutputLength == NULL ) )
+    {
+        AZLogError( ( "AzureIoTCompression_Decompress failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = eAzureIoTSuccess;
+
+        while( ( xResult == eAzureIoTSuccess ) && ( ulInputIndex < ulInputLength ) )
+        {
+            ucFlags = pucInput[ ulInputIndex++ ];
+
+            for( ulItemCount = 0;
+                 ( xResult == eAzureIoTSuccess ) && ( ulItemCount < azureiotcompressionGROUP_SIZE ) && ( ulInputIndex < ulInputLength );
+                 ulItemCount++ )
+            {
+                if( ( ucFlags & ( 1U << ulItemCount ) ) != 0 )
+                {
+                    if( ulOutputIndex >= ulOutputLength )
+                    {
+                        AZLogError( ( "AzureIoTCompression_Decompress failed: output buffer too small" ) );
+                        xResult = eAzureIoTErrorOutOfMemory;
+                    }
+                    else
+                    {
+                        pucOutput[ ulOutputIndex++ ] = pucInput[ ulInputIndex++ ];
+                    }
+                }
+                else if( ( ulInputLength - ulInputIndex ) < 2 )
+                {
+                    AZLogError( ( "AzureIoTCompression_Decompress failed: truncated back-reference" ) );
+                    xResult = eAzureIoTErrorInvalidResponse;
+                }
+                else
+                {
+                    ulDistance = ( ( uint32_t ) pucInput[ ulInputIndex ] |
+                                   ( ( uint32_t ) ( pucInput[ ulInputIndex + 1 ] >> 4 ) << 8 ) ) + 1;
+                    ulMatchLength = ( uint32_t ) ( pucInput[ ulInputIndex + 1 ] & 0x0F ) + azureiotcompressionMIN_MATCH;
+                    ulInputIndex += 2;
+
+                    if( ulDistance > ulOutputIndex )
+                    {
+                        AZLogError( ( "AzureIoTCompression_Decompress failed: back-reference before start of output" ) );
+                        xResult = eAzureIoTErrorInvalidResponse;
+                    }
+                    else if( ( ulOutputLength - ulOutputIndex ) < ulMatchLength )
+                    {
+                        AZLogError( ( "AzureIoTCompression_Decompress failed: output buffer too small" ) );
+                        xResult = eAzureIoTErrorOutOfMemory;
+                    }
+                    else
+                    {
+                        /* Byte by byte, as the source may overlap the bytes being written. */
+                        while( ulMatchLength-- > 0 )
+                        {
+                            pucOutput[ ulOutputIndex ] = pucOutput[ ulOutputIndex - ulDistance ];
+                            ulOutputIndex++;
+                        }
+                    }
+                }
+            }
+        }
+
+        if( xResult == eAzureIoTSuccess )
+        {
+            *pulOutputLength = ulOutputIndex;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
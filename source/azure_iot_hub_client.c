@@ -33,6 +33,10 @@
     #define azureiothubSUBACK_WAIT_INTERVAL_MS    azureiotconfigSUBACK_WAIT_INTERVAL_MS
 #endif /* azureiothubSUBACK_WAIT_INTERVAL_MS */
 
+#ifndef azureiothubCONNACK_RECV_TIMEOUT_MS
+    #define azureiothubCONNACK_RECV_TIMEOUT_MS    azureiotconfigCONNACK_RECV_TIMEOUT_MS
+#endif /* azureiothubCONNACK_RECV_TIMEOUT_MS */
+
 #ifndef azureiothubUSER_AGENT
     #define azureiothubUSER_AGENT    "DeviceClientType=c%2F" azureiotVERSION_STRING "%28FreeRTOS%29"
 #endif /* azureiothubUSER_AGENT */
@@ -53,8 +57,17 @@
 
 #define azureiothubCOMMAND_EMPTY_RESPONSE              "{}"
 
+#define azureiothubCOMPRESSION_CONTENT_ENCODING        azureiotmessagePROPERTY_CONTENT_ENCODING "=" azureiotcompressionCONTENT_ENCODING
+
 #define azureiothubMAX_SIZE_FOR_UINT32                 ( 10 )
 #define azureiothubHMACBufferLength                    ( 48 )
+
+/* Longest expiry and base64 encoded HMAC-SHA256 signature a SAS token is sized for. */
+#define azureiothubSAS_EXPIRY_MAX                      ( 9999999999ULL )
+#define azureiothubSAS_SIGNATURE_MAX                   "+++++++++++++++++++++++++++++++++++++++++++="
+
+/* Topics are built in the working buffer and published with a 16 bit length. */
+azureiotSTATIC_ASSERT( azureiothubWORKING_BUFFER_SIZE <= UINT16_MAX, "azureiotconfigTOPIC_MAX and the MQTT credentials must fit a 16 bit length" );
 /*-----------------------------------------------------------*/
 
 /**
@@ -203,15 +216,15 @@ static uint32_t prvAzureIoTHubClientC2DProcess( AzureIoTHubClientReceiveContext_
                                                 void * pvPublishInfo )
 {
     AzureIoTResult_t xResult;
-    AzureIoTHubClientCloudToDeviceMessageRequest_t xCloudToDeviceMessage = { 0 };
+    AzureIoTHubClientCloudToDeviceMessageRequest_t * pxCloudToDeviceMessage = &pxAzureIoTHubClient->_internal.xReceiveScratch.xCloudToDevice.xMessage;
     AzureIoTMQTTPublishInfo_t * xMQTTPublishInfo = ( AzureIoTMQTTPublishInfo_t * ) pvPublishInfo;
     az_result xCoreResult;
-    az_iot_hub_client_c2d_request xOutEmbeddedRequest;
+    az_iot_hub_client_c2d_request * pxOutEmbeddedRequest = &pxAzureIoTHubClient->_internal.xReceiveScratch.xCloudToDevice.xCoreRequest;
     az_span xTopicSpan = az_span_create( ( uint8_t * ) xMQTTPublishInfo->pcTopicName, xMQTTPublishInfo->usTopicNameLength );
 
     /* Failed means no topic match. This means the message is not for cloud to device messaging. */
     xCoreResult = az_iot_hub_client_c2d_parse_received_topic( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
-                                                              xTopicSpan, &xOutEmbeddedRequest );
+                                                              xTopicSpan, pxOutEmbeddedRequest );
 
     if( az_result_failed( xCoreResult ) )
     {
@@ -227,13 +240,18 @@ static uint32_t prvAzureIoTHubClientC2DProcess( AzureIoTHubClientReceiveContext_
 
         if( pxContext->_internal.callbacks.xCloudToDeviceMessageCallback )
         {
-            xCloudToDeviceMessage.pvMessagePayload = xMQTTPublishInfo->pvPayload;
-            xCloudToDeviceMessage.ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
-            xCloudToDeviceMessage.xProperties._internal.xProperties = xOutEmbeddedRequest.properties;
+            memset( pxCloudToDeviceMessage, 0, sizeof( AzureIoTHubClientCloudToDeviceMessageRequest_t ) );
+            pxCloudToDeviceMessage->pvMessagePayload = xMQTTPublishInfo->pvPayload;
+            pxCloudToDeviceMessage->ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
+            pxCloudToDeviceMessage->xProperties._internal.xProperties = pxOutEmbeddedRequest->properties;
 
             AZLogDebug( ( "Invoking Cloud to Device callback" ) );
-            pxContext->_internal.callbacks.xCloudToDeviceMessageCallback( &xCloudToDeviceMessage,
-                                                                          pxContext->_internal.pvCallbackContext );
+            {
+                azureiotSTACK_PROFILE_BEGIN();
+                pxContext->_internal.callbacks.xCloudToDeviceMessageCallback( pxCloudToDeviceMessage,
+                                                                              pxContext->_internal.pvCallbackContext );
+                azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubCloudToDeviceCallback );
+            }
             AZLogDebug( ( "Returned from Cloud to Device callback" ) );
         }
 
@@ -254,15 +272,15 @@ static uint32_t prvAzureIoTHubClientCommandProcess( AzureIoTHubClientReceiveCont
                                                     void * pvPublishInfo )
 {
     AzureIoTResult_t xResult;
-    AzureIoTHubClientCommandRequest_t xCommandRequest = { 0 };
+    AzureIoTHubClientCommandRequest_t * pxCommandRequest = &pxAzureIoTHubClient->_internal.xReceiveScratch.xCommand.xMessage;
     AzureIoTMQTTPublishInfo_t * xMQTTPublishInfo = ( AzureIoTMQTTPublishInfo_t * ) pvPublishInfo;
     az_result xCoreResult;
-    az_iot_hub_client_command_request xOutEmbeddedRequest;
+    az_iot_hub_client_command_request * pxOutEmbeddedRequest = &pxAzureIoTHubClient->_internal.xReceiveScratch.xCommand.xCoreRequest;
     az_span xTopicSpan = az_span_create( ( uint8_t * ) xMQTTPublishInfo->pcTopicName, xMQTTPublishInfo->usTopicNameLength );
 
     /* Failed means no topic match. This means the message is not for command. */
     xCoreResult = az_iot_hub_client_commands_parse_received_topic( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
-                                                                   xTopicSpan, &xOutEmbeddedRequest );
+                                                                   xTopicSpan, pxOutEmbeddedRequest );
 
     if( az_result_failed( xCoreResult ) )
     {
@@ -278,17 +296,22 @@ static uint32_t prvAzureIoTHubClientCommandProcess( AzureIoTHubClientReceiveCont
 
         if( pxContext->_internal.callbacks.xCommandCallback )
         {
-            xCommandRequest.pvMessagePayload = xMQTTPublishInfo->pvPayload;
-            xCommandRequest.ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
-            xCommandRequest.pucCommandName = az_span_ptr( xOutEmbeddedRequest.command_name );
-            xCommandRequest.usCommandNameLength = ( uint16_t ) az_span_size( xOutEmbeddedRequest.command_name );
-            xCommandRequest.pucComponentName = az_span_ptr( xOutEmbeddedRequest.component_name );
-            xCommandRequest.usComponentNameLength = ( uint16_t ) az_span_size( xOutEmbeddedRequest.component_name );
-            xCommandRequest.pucRequestID = az_span_ptr( xOutEmbeddedRequest.request_id );
-            xCommandRequest.usRequestIDLength = ( uint16_t ) az_span_size( xOutEmbeddedRequest.request_id );
+            memset( pxCommandRequest, 0, sizeof( AzureIoTHubClientCommandRequest_t ) );
+            pxCommandRequest->pvMessagePayload = xMQTTPublishInfo->pvPayload;
+            pxCommandRequest->ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
+            pxCommandRequest->pucCommandName = az_span_ptr( pxOutEmbeddedRequest->command_name );
+            pxCommandRequest->usCommandNameLength = ( uint16_t ) az_span_size( pxOutEmbeddedRequest->command_name );
+            pxCommandRequest->pucComponentName = az_span_ptr( pxOutEmbeddedRequest->component_name );
+            pxCommandRequest->usComponentNameLength = ( uint16_t ) az_span_size( pxOutEmbeddedRequest->component_name );
+            pxCommandRequest->pucRequestID = az_span_ptr( pxOutEmbeddedRequest->request_id );
+            pxCommandRequest->usRequestIDLength = ( uint16_t ) az_span_size( pxOutEmbeddedRequest->request_id );
 
             AZLogDebug( ( "Invoking command callback" ) );
-            pxContext->_internal.callbacks.xCommandCallback( &xCommandRequest, pxContext->_internal.pvCallbackContext );
+            {
+                azureiotSTACK_PROFILE_BEGIN();
+                pxContext->_internal.callbacks.xCommandCallback( pxCommandRequest, pxContext->_internal.pvCallbackContext );
+                azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubCommandCallback );
+            }
             AZLogDebug( ( "Returned from command callback" ) );
         }
 
@@ -299,6 +322,140 @@ static uint32_t prvAzureIoTHubClientCommandProcess( AzureIoTHubClientReceiveCont
 }
 /*-----------------------------------------------------------*/
 
+/**
+ *
+ * Time callback for MQTT initialization.
+ *
+ * */
+static uint32_t prvGetTimeMs( void )
+{
+    TickType_t xTickCount;
+    uint32_t ulTimeMs;
+
+    /* Get the current tick count. */
+    xTickCount = xTaskGetTickCount();
+
+    /* Convert the ticks to milliseconds. */
+    ulTimeMs = ( uint32_t ) xTickCount * azureiotMILLISECONDS_PER_TICK;
+
+    return ulTimeMs;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Find the properties request waiting for the response with the given request ID.
+ *
+ * */
+static AzureIoTHubClientPropertiesRequest_t * prvPropertiesRequestFind( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                        uint32_t ulRequestID )
+{
+    AzureIoTHubClientPropertiesRequest_t * pxRequest = NULL;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < azureiotconfigPROPERTIES_REQUESTS_MAX; ulIndex++ )
+    {
+        if( pxAzureIoTHubClient->_internal.xPropertiesRequests[ ulIndex ]._internal.ulRequestID == ulRequestID )
+        {
+            pxRequest = &pxAzureIoTHubClient->_internal.xPropertiesRequests[ ulIndex ];
+            break;
+        }
+    }
+
+    return pxRequest;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Hand the response of a properties request to its callback and free the request.
+ *
+ * */
+static void prvPropertiesRequestComplete( AzureIoTHubClientPropertiesRequest_t * pxRequest,
+                                          AzureIoTHubClientPropertiesResponse_t * pxResponse )
+{
+    AzureIoTHubClientPropertiesRequestCallback_t xCallback = pxRequest->_internal.xCallback;
+    void * pvCallbackContext = pxRequest->_internal.pvCallbackContext;
+    uint32_t ulLatencyMs = prvGetTimeMs() - pxRequest->_internal.ulSentTimeMilliseconds;
+
+    /* Free the request first so the callback can send a new one. */
+    memset( pxRequest, 0, sizeof( AzureIoTHubClientPropertiesRequest_t ) );
+
+    AZLogDebug( ( "Invoking properties request callback: request id=%u, latency=%ums",
+                  pxResponse->ulRequestID, ulLatencyMs ) );
+    xCallback( pxResponse, ulLatencyMs, pvCallbackContext );
+    AZLogDebug( ( "Returning from properties request callback" ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Complete a properties request which will get no response with a timeout status.
+ *
+ * */
+static void prvPropertiesRequestExpire( AzureIoTHubClientPropertiesRequest_t * pxRequest )
+{
+    AzureIoTHubClientPropertiesResponse_t xPropertiesResponse;
+
+    memset( &xPropertiesResponse, 0, sizeof( xPropertiesResponse ) );
+    xPropertiesResponse.xMessageType = ( pxRequest->_internal.ulRequestID & 0x01 ) ?
+                                       eAzureIoTHubPropertiesReportedResponseMessage : eAzureIoTHubPropertiesRequestedMessage;
+    xPropertiesResponse.xMessageStatus = eAzureIoTStatusTimeout;
+    xPropertiesResponse.ulRequestID = pxRequest->_internal.ulRequestID;
+
+    prvPropertiesRequestComplete( pxRequest, &xPropertiesResponse );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Time out properties requests which waited for their response for too long.
+ *
+ * */
+static void prvPropertiesRequestsCheckTimeout( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    AzureIoTHubClientPropertiesRequest_t * pxRequest;
+    uint32_t ulNowMs = prvGetTimeMs();
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < azureiotconfigPROPERTIES_REQUESTS_MAX; ulIndex++ )
+    {
+        pxRequest = &pxAzureIoTHubClient->_internal.xPropertiesRequests[ ulIndex ];
+
+        if( ( pxRequest->_internal.ulRequestID != 0 ) &&
+            ( pxRequest->_internal.ulTimeoutMilliseconds != 0 ) &&
+            ( ( ulNowMs - pxRequest->_internal.ulSentTimeMilliseconds ) >= pxRequest->_internal.ulTimeoutMilliseconds ) )
+        {
+            AZLogWarn( ( "Properties request timed out: request id=%u", pxRequest->_internal.ulRequestID ) );
+            prvPropertiesRequestExpire( pxRequest );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Time out all pending properties requests. Their responses were lost with the connection.
+ *
+ * */
+static void prvPropertiesRequestsCancel( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    AzureIoTHubClientPropertiesRequest_t * pxRequest;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < azureiotconfigPROPERTIES_REQUESTS_MAX; ulIndex++ )
+    {
+        pxRequest = &pxAzureIoTHubClient->_internal.xPropertiesRequests[ ulIndex ];
+
+        if( pxRequest->_internal.ulRequestID != 0 )
+        {
+            AZLogWarn( ( "Properties request lost on reconnect: request id=%u", pxRequest->_internal.ulRequestID ) );
+            prvPropertiesRequestExpire( pxRequest );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
 /**
  *
  * Check/Process messages for incoming property messages.
@@ -309,16 +466,17 @@ static uint32_t prvAzureIoTHubClientPropertiesProcess( AzureIoTHubClientReceiveC
                                                        void * pvPublishInfo )
 {
     AzureIoTResult_t xResult;
-    AzureIoTHubClientPropertiesResponse_t xPropertiesResponse = { 0 };
+    AzureIoTHubClientPropertiesResponse_t * pxPropertiesResponse = &pxAzureIoTHubClient->_internal.xReceiveScratch.xProperties.xMessage;
+    AzureIoTHubClientPropertiesRequest_t * pxRequest;
     AzureIoTMQTTPublishInfo_t * xMQTTPublishInfo = ( AzureIoTMQTTPublishInfo_t * ) pvPublishInfo;
     az_result xCoreResult;
-    az_iot_hub_client_properties_message xOutMessage;
+    az_iot_hub_client_properties_message * pxOutMessage = &pxAzureIoTHubClient->_internal.xReceiveScratch.xProperties.xCoreMessage;
     az_span xTopicSpan = az_span_create( ( uint8_t * ) xMQTTPublishInfo->pcTopicName, xMQTTPublishInfo->usTopicNameLength );
     uint32_t ulRequestID = 0;
 
     /* Failed means no topic match. This means the message is not for properties messaging. */
     xCoreResult = az_iot_hub_client_properties_parse_received_topic( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
-                                                                     xTopicSpan, &xOutMessage );
+                                                                     xTopicSpan, pxOutMessage );
 
     if( az_result_failed( xCoreResult ) )
     {
@@ -333,44 +491,55 @@ static uint32_t prvAzureIoTHubClientPropertiesProcess( AzureIoTHubClientReceiveC
                       ( const char * ) xMQTTPublishInfo->pvPayload ) );
 
         xResult = eAzureIoTSuccess;
+        memset( pxPropertiesResponse, 0, sizeof( AzureIoTHubClientPropertiesResponse_t ) );
 
-        if( pxContext->_internal.callbacks.xPropertiesCallback )
+        if( az_span_size( pxOutMessage->request_id ) == 0 )
         {
-            if( az_span_size( xOutMessage.request_id ) == 0 )
-            {
-                xPropertiesResponse.xMessageType = eAzureIoTHubPropertiesWritablePropertyMessage;
-            }
-            else
+            pxPropertiesResponse->xMessageType = eAzureIoTHubPropertiesWritablePropertyMessage;
+        }
+        else
+        {
+            if( az_result_succeeded( xCoreResult = az_span_atou32( pxOutMessage->request_id, &ulRequestID ) ) )
             {
-                if( az_result_succeeded( xCoreResult = az_span_atou32( xOutMessage.request_id, &ulRequestID ) ) )
+                if( ulRequestID & 0x01 )
                 {
-                    if( ulRequestID & 0x01 )
-                    {
-                        xPropertiesResponse.xMessageType = eAzureIoTHubPropertiesReportedResponseMessage;
-                    }
-                    else
-                    {
-                        xPropertiesResponse.xMessageType = eAzureIoTHubPropertiesRequestedMessage;
-                    }
+                    pxPropertiesResponse->xMessageType = eAzureIoTHubPropertiesReportedResponseMessage;
                 }
                 else
                 {
-                    /* Failed to parse the message */
-                    AZLogError( ( "Request ID parsing failed: core error=0x%08x", xCoreResult ) );
-                    xResult = AzureIoT_TranslateCoreError( xCoreResult );
+                    pxPropertiesResponse->xMessageType = eAzureIoTHubPropertiesRequestedMessage;
                 }
             }
-
-            if( xResult == eAzureIoTSuccess )
+            else
             {
-                xPropertiesResponse.pvMessagePayload = xMQTTPublishInfo->pvPayload;
-                xPropertiesResponse.ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
-                xPropertiesResponse.xMessageStatus = ( AzureIoTHubMessageStatus_t ) xOutMessage.status;
-                xPropertiesResponse.ulRequestID = ulRequestID;
+                /* Failed to parse the message */
+                AZLogError( ( "Request ID parsing failed: core error=0x%08x", xCoreResult ) );
+                xResult = AzureIoT_TranslateCoreError( xCoreResult );
+            }
+        }
 
+        if( xResult == eAzureIoTSuccess )
+        {
+            pxPropertiesResponse->pvMessagePayload = xMQTTPublishInfo->pvPayload;
+            pxPropertiesResponse->ulPayloadLength = ( uint32_t ) xMQTTPublishInfo->xPayloadLength;
+            pxPropertiesResponse->xMessageStatus = ( AzureIoTHubMessageStatus_t ) pxOutMessage->status;
+            pxPropertiesResponse->ulRequestID = ulRequestID;
+
+            /* Responses to requests sent with a callback go to that callback only. */
+            if( ( ulRequestID != 0 ) &&
+                ( ( pxRequest = prvPropertiesRequestFind( pxAzureIoTHubClient, ulRequestID ) ) != NULL ) )
+            {
+                prvPropertiesRequestComplete( pxRequest, pxPropertiesResponse );
+            }
+            else if( pxContext->_internal.callbacks.xPropertiesCallback )
+            {
                 AZLogDebug( ( "Invoking property callback" ) );
-                pxContext->_internal.callbacks.xPropertiesCallback( &xPropertiesResponse,
-                                                                    pxContext->_internal.pvCallbackContext );
+                {
+                    azureiotSTACK_PROFILE_BEGIN();
+                    pxContext->_internal.callbacks.xPropertiesCallback( pxPropertiesResponse,
+                                                                        pxContext->_internal.pvCallbackContext );
+                    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubPropertiesCallback );
+                }
                 AZLogDebug( ( "Returning from property callback" ) );
             }
         }
@@ -380,26 +549,6 @@ static uint32_t prvAzureIoTHubClientPropertiesProcess( AzureIoTHubClientReceiveC
 }
 /*-----------------------------------------------------------*/
 
-/**
- *
- * Time callback for MQTT initialization.
- *
- * */
-static uint32_t prvGetTimeMs( void )
-{
-    TickType_t xTickCount;
-    uint32_t ulTimeMs;
-
-    /* Get the current tick count. */
-    xTickCount = xTaskGetTickCount();
-
-    /* Convert the ticks to milliseconds. */
-    ulTimeMs = ( uint32_t ) xTickCount * azureiotMILLISECONDS_PER_TICK;
-
-    return ulTimeMs;
-}
-/*-----------------------------------------------------------*/
-
 /**
  * Get the next request Id available. Currently we are using
  * odd for PropertiesReported property and even for PropertiesGet.
@@ -504,6 +653,21 @@ static AzureIoTResult_t prvWaitForSubAck( AzureIoTHubClient_t * pxAzureIoTHubCli
 }
 /*-----------------------------------------------------------*/
 
+/**
+ *
+ * Reset and return the publish description of the client, kept out of the caller's stack.
+ *
+ * */
+static AzureIoTMQTTPublishInfo_t * prvGetPublishInfo( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    AzureIoTMQTTPublishInfo_t * pxPublishInfo = &pxAzureIoTHubClient->_internal.xSendScratch.xPublishInfo;
+
+    memset( pxPublishInfo, 0, sizeof( AzureIoTMQTTPublishInfo_t ) );
+
+    return pxPublishInfo;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * Generate the SAS token based on :
  *   https://docs.microsoft.com/en-us/azure/iot-hub/iot-hub-devguide-security#use-a-shared-access-policy
@@ -580,119 +744,947 @@ static uint32_t prvIoTHubClientGetToken( AzureIoTHubClient_t * pxAzureIoTHubClie
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_OptionsInit( AzureIoTHubClientOptions_t * pxHubClientOptions )
+/**
+ *
+ * Compress the telemetry payload when compression is enabled and it makes the payload smaller.
+ * On success, the content encoding property is appended to the telemetry topic and the payload
+ * is swapped for the compressed one. Otherwise, including when the caller already set a content
+ * encoding, the payload is left untouched.
+ *
+ * */
+static void prvCompressTelemetry( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                  AzureIoTMessageProperties_t * pxProperties,
+                                  size_t * pxTopicLength,
+                                  const uint8_t ** ppucPayload,
+                                  uint32_t * pulPayloadLength )
 {
+    uint8_t * pucTopic = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+    size_t xTopicLength = *pxTopicLength;
+    uint32_t ulCompressedLength;
     AzureIoTResult_t xResult;
+    /* Without properties the topic ends with '/', otherwise a separator is needed. */
+    bool xNeedsSeparator = ( xTopicLength > 0 ) && ( pucTopic[ xTopicLength - 1 ] != '/' );
+    size_t xSuffixLength = ( xNeedsSeparator ? 1 : 0 ) + sizeof( azureiothubCOMPRESSION_CONTENT_ENCODING ) - 1;
+    const uint8_t * pucContentEncoding;
+    uint32_t ulContentEncodingLength;
 
-    if( pxHubClientOptions == NULL )
+    if( ( pxProperties != NULL ) &&
+        ( AzureIoTMessage_PropertiesFind( pxProperties,
+                                          ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_ENCODING,
+                                          sizeof( azureiotmessagePROPERTY_CONTENT_ENCODING ) - 1,
+                                          &pucContentEncoding, &ulContentEncodingLength ) == eAzureIoTSuccess ) )
     {
-        AZLogError( ( "AzureIoTHubClient_OptionsInit failed: invalid argument" ) );
-        xResult = eAzureIoTErrorInvalidArgument;
+        AZLogWarn( ( "Sending telemetry uncompressed: content encoding already set" ) );
+    }
+    else if( ( xTopicLength + xSuffixLength ) > pxAzureIoTHubClient->_internal.ulWorkingBufferLength )
+    {
+        AZLogWarn( ( "Sending telemetry uncompressed: no room for content encoding property" ) );
+    }
+    else if( ( xResult = AzureIoTCompression_Compress( *ppucPayload, *pulPayloadLength,
+                                                       pxAzureIoTHubClient->_internal.pucCompressionBuffer,
+                                                       pxAzureIoTHubClient->_internal.ulCompressionBufferLength,
+                                                       &ulCompressedLength,
+                                                       pxAzureIoTHubClient->_internal.pucCompressionWindow,
+                                                       pxAzureIoTHubClient->_internal.ulCompressionWindowLength ) ) != eAzureIoTSuccess )
+    {
+        AZLogInfo( ( "Sending telemetry uncompressed: compression result=0x%08x", xResult ) );
+    }
+    else if( ulCompressedLength >= *pulPayloadLength )
+    {
+        AZLogInfo( ( "Sending telemetry uncompressed: payload does not compress" ) );
     }
     else
     {
-        memset( pxHubClientOptions, 0, sizeof( AzureIoTHubClientOptions_t ) );
+        if( xNeedsSeparator )
+        {
+            pucTopic[ xTopicLength++ ] = '&';
+        }
 
-        pxHubClientOptions->pucUserAgent = ( const uint8_t * ) azureiothubUSER_AGENT;
-        pxHubClientOptions->ulUserAgentLength = sizeof( azureiothubUSER_AGENT ) - 1;
+        memcpy( pucTopic + xTopicLength, azureiothubCOMPRESSION_CONTENT_ENCODING,
+                sizeof( azureiothubCOMPRESSION_CONTENT_ENCODING ) - 1 );
+        xTopicLength += sizeof( azureiothubCOMPRESSION_CONTENT_ENCODING ) - 1;
 
-        xResult = eAzureIoTSuccess;
+        *pxTopicLength = xTopicLength;
+        *ppucPayload = pxAzureIoTHubClient->_internal.pucCompressionBuffer;
+        *pulPayloadLength = ulCompressedLength;
     }
+}
+/*-----------------------------------------------------------*/
 
-    return xResult;
+/**
+ *
+ * Map a core error met while sizing the working buffer. Running out of scratch
+ * means the scratch buffer passed in was too small.
+ *
+ * */
+static AzureIoTResult_t prvTranslateSizingError( az_result xCoreResult )
+{
+    return ( xCoreResult == AZ_ERROR_NOT_ENOUGH_SPACE ) ? eAzureIoTErrorOutOfMemory :
+           AzureIoT_TranslateCoreError( xCoreResult );
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_Init( AzureIoTHubClient_t * pxAzureIoTHubClient,
-                                         const uint8_t * pucHostname,
-                                         uint16_t ulHostnameLength,
-                                         const uint8_t * pucDeviceId,
-                                         uint16_t ulDeviceIdLength,
-                                         AzureIoTHubClientOptions_t * pxHubClientOptions,
-                                         uint8_t * pucBuffer,
-                                         uint32_t ulBufferLength,
-                                         AzureIoTGetCurrentTimeFunc_t xGetTimeFunction,
-                                         const AzureIoTTransportInterface_t * pxTransportInterface )
+/**
+ *
+ * Compute the working buffer needed for the username and SAS token of this client, using
+ * pucBuffer as scratch. Topics are still bounded by azureiotconfigTOPIC_MAX.
+ *
+ * */
+static AzureIoTResult_t prvExactWorkingBufferLength( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                     uint32_t ulSymmetricKeyLengthMax,
+                                                     uint8_t * pucBuffer,
+                                                     uint32_t ulBufferLength )
 {
+    az_iot_hub_client * pxHubClientCore = &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore;
+    az_span xSpan = az_span_create( pucBuffer, ( int32_t ) ulBufferLength );
+    az_span xSignatureSpan = AZ_SPAN_FROM_STR( azureiothubSAS_SIGNATURE_MAX );
     AzureIoTResult_t xResult;
-    AzureIoTMQTTResult_t xMQTTResult;
     az_result xCoreResult;
-    az_iot_hub_client_options xHubOptions;
-    uint8_t * pucNetworkBuffer;
-    uint32_t ulNetworkBufferLength;
-    az_span xHostnameSpan;
-    az_span xDeviceIDSpan;
+    size_t xUserNameLength;
+    size_t xPasswordLength;
+    uint32_t ulUserNameLength;
+    uint32_t ulPasswordLength = 0;
+    uint32_t ulHMACScratchLength;
 
-    if( ( pxAzureIoTHubClient == NULL ) ||
-        ( pucHostname == NULL ) || ( ulHostnameLength == 0 ) ||
-        ( pucDeviceId == NULL ) || ( ulDeviceIdLength == 0 ) ||
-        ( pucBuffer == NULL ) || ( ulBufferLength == 0 ) ||
-        ( xGetTimeFunction == NULL ) || ( pxTransportInterface == NULL ) )
+    /* The token is built in place: the signature, the decoded key and the hash, then the
+     * encoded HMAC at the end of the buffer. The password is then written over the signature. */
+    if( az_result_failed( xCoreResult = az_iot_hub_client_get_user_name( pxHubClientCore, ( char * ) pucBuffer,
+                                                                         ulBufferLength, &xUserNameLength ) ) )
     {
-        AZLogError( ( "AzureIoTHubClient_Init failed: invalid argument" ) );
-        xResult = eAzureIoTErrorInvalidArgument;
+        AZLogError( ( "Failed to size username: core error=0x%08x", xCoreResult ) );
+        xResult = prvTranslateSizingError( xCoreResult );
     }
-    else if( ( ulBufferLength < azureiotconfigTOPIC_MAX ) ||
-             ( ulBufferLength < ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ) ) )
+    else if( ( ulSymmetricKeyLengthMax > 0 ) &&
+             az_result_failed( xCoreResult = az_iot_hub_client_sas_get_signature( pxHubClientCore, azureiothubSAS_EXPIRY_MAX,
+                                                                                  xSpan, &xSpan ) ) )
     {
-        AZLogError( ( "AzureIoTHubClient_Init failed: not enough memory passed" ) );
-        xResult = eAzureIoTErrorOutOfMemory;
+        AZLogError( ( "Failed to size signature: core error=0x%08x", xCoreResult ) );
+        xResult = prvTranslateSizingError( xCoreResult );
+    }
+    else if( ( ulSymmetricKeyLengthMax > 0 ) &&
+             az_result_failed( xCoreResult = az_iot_hub_client_sas_get_password( pxHubClientCore, azureiothubSAS_EXPIRY_MAX,
+                                                                                 xSignatureSpan, AZ_SPAN_EMPTY,
+                                                                                 ( char * ) pucBuffer, ulBufferLength,
+                                                                                 &xPasswordLength ) ) )
+    {
+        AZLogError( ( "Failed to size password: core error=0x%08x", xCoreResult ) );
+        xResult = prvTranslateSizingError( xCoreResult );
     }
     else
     {
-        memset( ( void * ) pxAzureIoTHubClient, 0, sizeof( AzureIoTHubClient_t ) );
+        ulUserNameLength = ( uint32_t ) xUserNameLength + 1;
 
-        /* Setup working buffer to be used by middleware */
+        if( ulSymmetricKeyLengthMax > 0 )
+        {
+            ulHMACScratchLength = ( uint32_t ) az_span_size( xSpan ) +
+                                  ( ( ulSymmetricKeyLengthMax + 3 ) / 4 ) * 3 + azureiotBASE64_HASH_BUFFER_SIZE;
+            ulPasswordLength = azureiothubHMACBufferLength +
+                               azureiotPrvBufferSizeMax( ( uint32_t ) xPasswordLength + 1, ulHMACScratchLength );
+        }
+
+        pxAzureIoTHubClient->_internal.ulUserNameBufferLength = ulUserNameLength;
+        pxAzureIoTHubClient->_internal.ulPasswordBufferLength = ulPasswordLength;
         pxAzureIoTHubClient->_internal.ulWorkingBufferLength =
-            ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ) > azureiotconfigTOPIC_MAX ?
-            ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ) : azureiotconfigTOPIC_MAX;
-        pxAzureIoTHubClient->_internal.pucWorkingBuffer = pucBuffer;
-        pucNetworkBuffer = pucBuffer + pxAzureIoTHubClient->_internal.ulWorkingBufferLength;
-        ulNetworkBufferLength = ulBufferLength - pxAzureIoTHubClient->_internal.ulWorkingBufferLength;
+            azureiotPrvBufferSizeMax( ulUserNameLength + ulPasswordLength, ( uint32_t ) azureiotconfigTOPIC_MAX );
+        xResult = eAzureIoTSuccess;
+    }
 
-        /* Initialize Azure IoT Hub Client */
-        xHostnameSpan = az_span_create( ( uint8_t * ) pucHostname, ( int32_t ) ulHostnameLength );
-        xDeviceIDSpan = az_span_create( ( uint8_t * ) pucDeviceId, ( int32_t ) ulDeviceIdLength );
+    return xResult;
+}
+/*-----------------------------------------------------------*/
 
-        xHubOptions = az_iot_hub_client_options_default();
+/**
+ *
+ * Size the working buffer from the options, and check the buffer passed at init is large enough.
+ *
+ * */
+static AzureIoTResult_t prvSetupWorkingBuffer( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                               const AzureIoTHubClientOptions_t * pxHubClientOptions,
+                                               uint8_t * pucBuffer,
+                                               uint32_t ulBufferLength )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint32_t ulRequiredLength;
 
-        if( pxHubClientOptions )
+    if( pxHubClientOptions->xExactWorkingBuffer )
+    {
+        xResult = prvExactWorkingBufferLength( pxAzureIoTHubClient, pxHubClientOptions->ulSymmetricKeyLengthMax,
+                                               pucBuffer, ulBufferLength );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        ulRequiredLength = pxAzureIoTHubClient->_internal.ulWorkingBufferLength;
+
+        if( pxHubClientOptions->xTransientConnectBuffer )
         {
-            xHubOptions.module_id = az_span_create( ( uint8_t * ) pxHubClientOptions->pucModuleID, ( int32_t ) pxHubClientOptions->ulModuleIDLength );
-            xHubOptions.model_id = az_span_create( ( uint8_t * ) pxHubClientOptions->pucModelID, ( int32_t ) pxHubClientOptions->ulModelIDLength );
-            xHubOptions.user_agent = az_span_create( ( uint8_t * ) pxHubClientOptions->pucUserAgent, ( int32_t ) pxHubClientOptions->ulUserAgentLength );
-            xHubOptions.component_names = ( az_span * ) pxHubClientOptions->pxComponentList;
-            xHubOptions.component_names_length = ( int32_t ) pxHubClientOptions->ulComponentListLength;
+            /* Username and password are borrowed during connect, topics still need their space. */
+            pxAzureIoTHubClient->_internal.ulWorkingBufferLength = azureiotconfigTOPIC_MAX;
+            ulRequiredLength = azureiotconfigTOPIC_MAX;
+
+            if( pxHubClientOptions->xConnectBufferAcquire == NULL )
+            {
+                ulRequiredLength += pxAzureIoTHubClient->_internal.ulUserNameBufferLength +
+                                    pxAzureIoTHubClient->_internal.ulPasswordBufferLength;
+            }
         }
-        else
+
+        if( ulBufferLength < ulRequiredLength )
         {
-            xHubOptions.user_agent = az_span_create( ( uint8_t * ) azureiothubUSER_AGENT, sizeof( azureiothubUSER_AGENT ) - 1 );
+            xResult = eAzureIoTErrorOutOfMemory;
         }
+    }
 
-        if( az_result_failed( xCoreResult = az_iot_hub_client_init( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
-                                                                    xHostnameSpan, xDeviceIDSpan, &xHubOptions ) ) )
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Get the buffer for the username and password of a CONNECT: the working buffer, or with the
+ * transient connect buffer, the user's buffer or the end of the network buffer.
+ *
+ * */
+static AzureIoTResult_t prvConnectBufferAcquire( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                 uint8_t ** ppucBuffer )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint32_t ulLength = pxAzureIoTHubClient->_internal.ulUserNameBufferLength +
+                        pxAzureIoTHubClient->_internal.ulPasswordBufferLength;
+
+    if( !pxAzureIoTHubClient->_internal.xTransientConnectBuffer )
+    {
+        *ppucBuffer = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+    }
+    else if( pxAzureIoTHubClient->_internal.xConnectBufferAcquire != NULL )
+    {
+        *ppucBuffer = pxAzureIoTHubClient->_internal.xConnectBufferAcquire( pxAzureIoTHubClient->_internal.pvConnectBufferContext,
+                                                                            ulLength );
+
+        if( *ppucBuffer == NULL )
+        {
+            AZLogError( ( "AzureIoTHubClient connect buffer acquire callback failed: length=%u", ulLength ) );
+            xResult = eAzureIoTErrorOutOfMemory;
+        }
+    }
+    else
+    {
+        *ppucBuffer = pxAzureIoTHubClient->_internal.pucNetworkBuffer +
+                      pxAzureIoTHubClient->_internal.ulNetworkBufferLength - ulLength;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvConnectBufferRelease( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                     uint8_t * pucConnectBuffer )
+{
+    if( pxAzureIoTHubClient->_internal.xTransientConnectBuffer &&
+        ( pxAzureIoTHubClient->_internal.xConnectBufferAcquire != NULL ) &&
+        ( pxAzureIoTHubClient->_internal.xConnectBufferRelease != NULL ) )
+    {
+        pxAzureIoTHubClient->_internal.xConnectBufferRelease( pxAzureIoTHubClient->_internal.pvConnectBufferContext,
+                                                              pucConnectBuffer );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * When the username and password are at the end of the network buffer, the CONNECT packet
+ * serialized at its start must end before them.
+ *
+ * */
+static AzureIoTResult_t prvConnectPacketFits( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                              const AzureIoTMQTTConnectInfo_t * pxConnectInfo )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint32_t ulPacketLength;
+    uint32_t ulAvailableLength;
+
+    if( pxAzureIoTHubClient->_internal.xTransientConnectBuffer &&
+        ( pxAzureIoTHubClient->_internal.xConnectBufferAcquire == NULL ) )
+    {
+        /* Fixed header, variable header, then the client ID, username and password with their lengths. */
+        ulPacketLength = 5U + 10U + ( 2U + pxConnectInfo->usClientIdentifierLength ) +
+                         ( 2U + pxConnectInfo->usUserNameLength ) + ( 2U + pxConnectInfo->usPasswordLength );
+        ulAvailableLength = ( uint32_t ) ( pxConnectInfo->pcUserName - pxAzureIoTHubClient->_internal.pucNetworkBuffer );
+
+        if( ulAvailableLength < ulPacketLength )
+        {
+            AZLogError( ( "AzureIoTHubClient CONNECT packet of %u bytes overlaps its credentials at %u bytes",
+                          ulPacketLength, ulAvailableLength ) );
+            xResult = eAzureIoTErrorOutOfMemory;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_OptionsInit( AzureIoTHubClientOptions_t * pxHubClientOptions )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxHubClientOptions == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_OptionsInit failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( pxHubClientOptions, 0, sizeof( AzureIoTHubClientOptions_t ) );
+
+        pxHubClientOptions->pucUserAgent = ( const uint8_t * ) azureiothubUSER_AGENT;
+        pxHubClientOptions->ulUserAgentLength = sizeof( azureiothubUSER_AGENT ) - 1;
+
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_Init( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                         const uint8_t * pucHostname,
+                                         uint16_t ulHostnameLength,
+                                         const uint8_t * pucDeviceId,
+                                         uint16_t ulDeviceIdLength,
+                                         AzureIoTHubClientOptions_t * pxHubClientOptions,
+                                         uint8_t * pucBuffer,
+                                         uint32_t ulBufferLength,
+                                         AzureIoTGetCurrentTimeFunc_t xGetTimeFunction,
+                                         const AzureIoTTransportInterface_t * pxTransportInterface )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTMQTTResult_t xMQTTResult;
+    az_result xCoreResult;
+    az_iot_hub_client_options xHubOptions;
+    az_span xHostnameSpan;
+    az_span xDeviceIDSpan;
+
+    if( ( pxAzureIoTHubClient == NULL ) ||
+        ( pucHostname == NULL ) || ( ulHostnameLength == 0 ) ||
+        ( pucDeviceId == NULL ) || ( ulDeviceIdLength == 0 ) ||
+        ( pucBuffer == NULL ) || ( ulBufferLength == 0 ) ||
+        ( xGetTimeFunction == NULL ) || ( pxTransportInterface == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_Init failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( ( pxHubClientOptions == NULL ) ||
+               ( !pxHubClientOptions->xExactWorkingBuffer && !pxHubClientOptions->xTransientConnectBuffer ) ) &&
+             ( ulBufferLength < azureiothubWORKING_BUFFER_SIZE ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_Init failed: not enough memory passed" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else if( ( pxHubClientOptions != NULL ) && pxHubClientOptions->xTransientConnectBuffer &&
+             ( pxHubClientOptions->xConnectBufferRelease != NULL ) && ( pxHubClientOptions->xConnectBufferAcquire == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_Init failed: connect buffer release callback without acquire callback" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( ( void * ) pxAzureIoTHubClient, 0, sizeof( AzureIoTHubClient_t ) );
+
+        /* Setup working buffer to be used by middleware */
+        pxAzureIoTHubClient->_internal.ulWorkingBufferLength = azureiothubWORKING_BUFFER_SIZE;
+        pxAzureIoTHubClient->_internal.ulUserNameBufferLength = azureiotconfigUSERNAME_MAX;
+        pxAzureIoTHubClient->_internal.ulPasswordBufferLength = azureiotconfigPASSWORD_MAX;
+        pxAzureIoTHubClient->_internal.pucWorkingBuffer = pucBuffer;
+
+        /* Initialize Azure IoT Hub Client */
+        xHostnameSpan = az_span_create( ( uint8_t * ) pucHostname, ( int32_t ) ulHostnameLength );
+        xDeviceIDSpan = az_span_create( ( uint8_t * ) pucDeviceId, ( int32_t ) ulDeviceIdLength );
+
+        xHubOptions = az_iot_hub_client_options_default();
+
+        if( pxHubClientOptions )
+        {
+            xHubOptions.module_id = az_span_create( ( uint8_t * ) pxHubClientOptions->pucModuleID, ( int32_t ) pxHubClientOptions->ulModuleIDLength );
+            xHubOptions.model_id = az_span_create( ( uint8_t * ) pxHubClientOptions->pucModelID, ( int32_t ) pxHubClientOptions->ulModelIDLength );
+            xHubOptions.user_agent = az_span_create( ( uint8_t * ) pxHubClientOptions->pucUserAgent, ( int32_t ) pxHubClientOptions->ulUserAgentLength );
+            xHubOptions.component_names = ( az_span * ) pxHubClientOptions->pxComponentList;
+            xHubOptions.component_names_length = ( int32_t ) pxHubClientOptions->ulComponentListLength;
+        }
+        else
+        {
+            xHubOptions.user_agent = az_span_create( ( uint8_t * ) azureiothubUSER_AGENT, sizeof( azureiothubUSER_AGENT ) - 1 );
+        }
+
+        if( az_result_failed( xCoreResult = az_iot_hub_client_init( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
+                                                                    xHostnameSpan, xDeviceIDSpan, &xHubOptions ) ) )
+        {
+            AZLogError( ( "Failed to initialize az_iot_hub_client_init: core error=0x%08x", xCoreResult ) );
+            xResult = AzureIoT_TranslateCoreError( xCoreResult );
+        }
+        else if( ( pxHubClientOptions != NULL ) &&
+                 ( ( xResult = prvSetupWorkingBuffer( pxAzureIoTHubClient, pxHubClientOptions,
+                                                      pucBuffer, ulBufferLength ) ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "AzureIoTHubClient_Init failed: cannot setup working buffer, result=0x%08x", xResult ) );
+        }
+        /* Initialize AzureIoTMQTT library with the rest of the buffer. */
+        else if( ( xMQTTResult = AzureIoTMQTT_Init( &( pxAzureIoTHubClient->_internal.xMQTTContext ), pxTransportInterface,
+                                                    prvGetTimeMs, prvEventCallback,
+                                                    pucBuffer + pxAzureIoTHubClient->_internal.ulWorkingBufferLength,
+                                                    ulBufferLength - pxAzureIoTHubClient->_internal.ulWorkingBufferLength ) ) != eAzureIoTMQTTSuccess )
+        {
+            AZLogError( ( "Failed to initialize AzureIoTMQTT_Init: MQTT error=0x%08x", xMQTTResult ) );
+            xResult = eAzureIoTErrorInitFailed;
+        }
+        else
+        {
+            pxAzureIoTHubClient->_internal.pucDeviceID = pucDeviceId;
+            pxAzureIoTHubClient->_internal.ulDeviceIDLength = ulDeviceIdLength;
+            pxAzureIoTHubClient->_internal.pucHostname = pucHostname;
+            pxAzureIoTHubClient->_internal.ulHostnameLength = ulHostnameLength;
+            pxAzureIoTHubClient->_internal.xTimeFunction = xGetTimeFunction;
+            pxAzureIoTHubClient->_internal.xTelemetryCallback =
+                pxHubClientOptions == NULL ? NULL : pxHubClientOptions->xTelemetryCallback;
+
+            pxAzureIoTHubClient->_internal.pucNetworkBuffer = pucBuffer + pxAzureIoTHubClient->_internal.ulWorkingBufferLength;
+            pxAzureIoTHubClient->_internal.ulNetworkBufferLength = ulBufferLength - pxAzureIoTHubClient->_internal.ulWorkingBufferLength;
+
+            if( ( pxHubClientOptions != NULL ) && pxHubClientOptions->xExactWorkingBuffer )
+            {
+                pxAzureIoTHubClient->_internal.xExactWorkingBuffer = true;
+                pxAzureIoTHubClient->_internal.ulSymmetricKeyLengthMax = pxHubClientOptions->ulSymmetricKeyLengthMax;
+            }
+
+            if( ( pxHubClientOptions != NULL ) && pxHubClientOptions->xTransientConnectBuffer )
+            {
+                pxAzureIoTHubClient->_internal.xTransientConnectBuffer = true;
+                pxAzureIoTHubClient->_internal.xConnectBufferAcquire = pxHubClientOptions->xConnectBufferAcquire;
+                pxAzureIoTHubClient->_internal.xConnectBufferRelease = pxHubClientOptions->xConnectBufferRelease;
+                pxAzureIoTHubClient->_internal.pvConnectBufferContext = pxHubClientOptions->pvConnectBufferContext;
+            }
+
+            xResult = eAzureIoTSuccess;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTHubClient_Deinit( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    ( void ) pxAzureIoTHubClient;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_SetSymmetricKey( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                    const uint8_t * pucSymmetricKey,
+                                                    uint32_t ulSymmetricKeyLength,
+                                                    AzureIoTGetHMACFunc_t xHMACFunction )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxAzureIoTHubClient == NULL ) ||
+        ( pucSymmetricKey == NULL ) || ( ulSymmetricKeyLength == 0 ) ||
+        ( xHMACFunction == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_SetSymmetricKey failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( pxAzureIoTHubClient->_internal.xExactWorkingBuffer &&
+             ( ulSymmetricKeyLength > pxAzureIoTHubClient->_internal.ulSymmetricKeyLengthMax ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_SetSymmetricKey failed: key longer than the working buffer was sized for" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        pxAzureIoTHubClient->_internal.pucSymmetricKey = pucSymmetricKey;
+        pxAzureIoTHubClient->_internal.ulSymmetricKeyLength = ulSymmetricKeyLength;
+        pxAzureIoTHubClient->_internal.pxTokenRefresh = prvIoTHubClientGetToken;
+        pxAzureIoTHubClient->_internal.xHMACFunction = xHMACFunction;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_Connect( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                            bool xCleanSession,
+                                            bool * pxOutSessionPresent,
+                                            uint32_t ulTimeoutMilliseconds )
+{
+    AzureIoTMQTTConnectInfo_t * pxConnectInfo;
+    AzureIoTResult_t xResult;
+    AzureIoTMQTTResult_t xMQTTResult;
+    uint8_t * pucConnectBuffer;
+    uint32_t ulPasswordLength = 0;
+    size_t xMQTTUserNameLength;
+    uint64_t ullTokenExpiryTime = 0;
+    az_result xCoreResult;
+
+    azureiotSTACK_PROFILE_BEGIN();
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( pxOutSessionPresent == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_Connect failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        pxConnectInfo = &pxAzureIoTHubClient->_internal.xSendScratch.xConnectInfo;
+        memset( pxConnectInfo, 0, sizeof( AzureIoTMQTTConnectInfo_t ) );
+
+        if( pxAzureIoTHubClient->_internal.pxTokenRefresh )
+        {
+            ullTokenExpiryTime = pxAzureIoTHubClient->_internal.xTimeFunction() + azureiothubDEFAULT_TOKEN_TIMEOUT_IN_SEC;
+        }
+
+        /* Username and password only live until CONNACK, in the working buffer or a borrowed one. */
+        xResult = prvConnectBufferAcquire( pxAzureIoTHubClient, &pucConnectBuffer );
+        pxConnectInfo->pcUserName = pucConnectBuffer;
+        pxConnectInfo->pcPassword = ( pucConnectBuffer == NULL ) ? NULL :
+                                    pucConnectBuffer + pxAzureIoTHubClient->_internal.ulUserNameBufferLength;
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            AZLogError( ( "AzureIoTHubClient_Connect failed: no buffer for username and password" ) );
+        }
+        else if( az_result_failed( xCoreResult = az_iot_hub_client_get_user_name( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
+                                                                                  ( char * ) pxConnectInfo->pcUserName,
+                                                                                  pxAzureIoTHubClient->_internal.ulUserNameBufferLength,
+                                                                                  &xMQTTUserNameLength ) ) )
+        {
+            AZLogError( ( "Failed to get username: core error=0x%08x", xCoreResult ) );
+            xResult = AzureIoT_TranslateCoreError( xCoreResult );
+        }
+        /* Check if token refresh is set, then generate password */
+        else if( ( pxAzureIoTHubClient->_internal.pxTokenRefresh ) &&
+                 ( pxAzureIoTHubClient->_internal.pxTokenRefresh( pxAzureIoTHubClient,
+                                                                  ullTokenExpiryTime,
+                                                                  pxAzureIoTHubClient->_internal.pucSymmetricKey,
+                                                                  pxAzureIoTHubClient->_internal.ulSymmetricKeyLength,
+                                                                  ( uint8_t * ) pxConnectInfo->pcPassword,
+                                                                  pxAzureIoTHubClient->_internal.ulPasswordBufferLength,
+                                                                  &ulPasswordLength ) ) )
+        {
+            AZLogError( ( "Failed to generate SAS token" ) );
+            xResult = eAzureIoTErrorFailed;
+        }
+        else
+        {
+            pxConnectInfo->xCleanSession = xCleanSession;
+            pxConnectInfo->pcClientIdentifier = pxAzureIoTHubClient->_internal.pucDeviceID;
+            pxConnectInfo->usClientIdentifierLength = ( uint16_t ) pxAzureIoTHubClient->_internal.ulDeviceIDLength;
+            pxConnectInfo->usUserNameLength = ( uint16_t ) xMQTTUserNameLength;
+            pxConnectInfo->usKeepAliveSeconds = azureiothubKEEP_ALIVE_TIMEOUT_SECONDS;
+            pxConnectInfo->usPasswordLength = ( uint16_t ) ulPasswordLength;
+
+            if( ( xResult = prvConnectPacketFits( pxAzureIoTHubClient, pxConnectInfo ) ) != eAzureIoTSuccess )
+            {
+                AZLogError( ( "AzureIoTHubClient_Connect failed: network buffer too small for CONNECT and its credentials" ) );
+            }
+            /* Send MQTT CONNECT packet to broker. Last Will and Testament is not used. */
+            else if( ( xMQTTResult = AzureIoTMQTT_Connect( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                           pxConnectInfo,
+                                                           NULL,
+                                                           ulTimeoutMilliseconds,
+                                                           pxOutSessionPresent ) ) != eAzureIoTMQTTSuccess )
+            {
+                AZLogError( ( "Failed to establish MQTT connection: Server=%.*s, MQTT error=0x%08x",
+                              pxAzureIoTHubClient->_internal.ulHostnameLength, ( const char * ) pxAzureIoTHubClient->_internal.pucHostname,
+                              xMQTTResult ) );
+                xResult = eAzureIoTErrorFailed;
+            }
+            else
+            {
+                /* Successfully established a MQTT connection with the broker. */
+                AZLogInfo( ( "An MQTT connection is established with %.*s", pxAzureIoTHubClient->_internal.ulHostnameLength,
+                             ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
+
+                /* AzureIoTHubClient_Run() schedules the renewal of the new token. */
+                pxAzureIoTHubClient->_internal.ullTokenExpiryTime = ullTokenExpiryTime;
+                pxAzureIoTHubClient->_internal.ullTokenRenewalTime = 0;
+                pxAzureIoTHubClient->_internal.xStreamOutOfSync = false;
+                xResult = eAzureIoTSuccess;
+            }
+        }
+
+        if( pucConnectBuffer != NULL )
+        {
+            prvConnectBufferRelease( pxAzureIoTHubClient, pucConnectBuffer );
+        }
+    }
+
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubConnect );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_Disconnect( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    AzureIoTMQTTResult_t xMQTTResult;
+    AzureIoTResult_t xResult;
+
+    if( pxAzureIoTHubClient == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_Disconnect failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( xMQTTResult = AzureIoTMQTT_Disconnect( &( pxAzureIoTHubClient->_internal.xMQTTContext ) ) ) != eAzureIoTMQTTSuccess )
+    {
+        AZLogError( ( "AzureIoTHubClient_Disconnect failed to disconnect: MQTT error=0x%08x", xMQTTResult ) );
+        xResult = eAzureIoTErrorFailed;
+    }
+    else
+    {
+        AZLogInfo( ( "Disconnecting the MQTT connection with %.*s", pxAzureIoTHubClient->_internal.ulHostnameLength,
+                     ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                  const uint8_t * pucTelemetryData,
+                                                  uint32_t ulTelemetryDataLength,
+                                                  AzureIoTMessageProperties_t * pxProperties,
+                                                  AzureIoTHubMessageQoS_t xQOS,
+                                                  uint16_t * pusTelemetryPacketID )
+{
+    AzureIoTMQTTResult_t xMQTTResult;
+    AzureIoTResult_t xResult;
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo;
+    uint16_t usPublishPacketIdentifier = 0;
+    size_t xTelemetryTopicLength;
+    az_result xCoreResult;
+
+    azureiotSTACK_PROFILE_BEGIN();
+
+    if( pxAzureIoTHubClient == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendTelemetry failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( pxAzureIoTHubClient->_internal.xReconnectPending )
+    {
+        /* Paced until AzureIoTHubClient_Run() reconnects, the caller keeps the message. */
+        AZLogWarn( ( "AzureIoTHubClient_SendTelemetry deferred: reconnecting" ) );
+        xResult = eAzureIoTErrorPending;
+    }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendTelemetry failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorPublishFailed;
+    }
+    else if( az_result_failed(
+                 xCoreResult = az_iot_hub_client_telemetry_get_publish_topic( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
+                                                                              ( pxProperties != NULL ) ? &pxProperties->_internal.xProperties : NULL,
+                                                                              ( char * ) pxAzureIoTHubClient->_internal.pucWorkingBuffer,
+                                                                              pxAzureIoTHubClient->_internal.ulWorkingBufferLength,
+                                                                              &xTelemetryTopicLength ) ) )
+    {
+        AZLogError( ( "Failed to get telemetry topic: core error=0x%08x", xCoreResult ) );
+        xResult = AzureIoT_TranslateCoreError( xCoreResult );
+    }
+    else
+    {
+        if( ( pxAzureIoTHubClient->_internal.pucCompressionBuffer != NULL ) && ( ulTelemetryDataLength > 0 ) )
+        {
+            prvCompressTelemetry( pxAzureIoTHubClient, pxProperties, &xTelemetryTopicLength,
+                                  &pucTelemetryData, &ulTelemetryDataLength );
+        }
+
+        pxMQTTPublishInfo = prvGetPublishInfo( pxAzureIoTHubClient );
+        pxMQTTPublishInfo->xQOS = xQOS == eAzureIoTHubMessageQoS1 ? eAzureIoTMQTTQoS1 : eAzureIoTMQTTQoS0;
+        pxMQTTPublishInfo->pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+        pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xTelemetryTopicLength;
+        pxMQTTPublishInfo->pvPayload = ( const void * ) pucTelemetryData;
+        pxMQTTPublishInfo->xPayloadLength = ulTelemetryDataLength;
+
+        /* Get a unique packet id. Not used if QOS is 0 */
+        if( xQOS == eAzureIoTHubMessageQoS1 )
+        {
+            usPublishPacketIdentifier = AzureIoTMQTT_GetPacketId( &( pxAzureIoTHubClient->_internal.xMQTTContext ) );
+        }
+
+        /* Send PUBLISH packet. */
+        if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                  pxMQTTPublishInfo, usPublishPacketIdentifier ) ) != eAzureIoTMQTTSuccess )
+        {
+            AZLogError( ( "Failed to publish telemetry: MQTT error=0x%08x", xMQTTResult ) );
+            xResult = eAzureIoTErrorPublishFailed;
+        }
+        else
+        {
+            if( ( xQOS == eAzureIoTHubMessageQoS1 ) && ( pusTelemetryPacketID != NULL ) )
+            {
+                *pusTelemetryPacketID = usPublishPacketIdentifier;
+            }
+
+            AZLogInfo( ( "Successfully sent telemetry message" ) );
+            xResult = eAzureIoTSuccess;
+        }
+    }
+
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubSendTelemetry );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_SetTelemetryCompression( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                            uint8_t * pucCompressionBuffer,
+                                                            uint32_t ulCompressionBufferLength,
+                                                            uint8_t * pucWindowBuffer,
+                                                            uint32_t ulWindowBufferLength )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxAzureIoTHubClient == NULL ) ||
+        ( ( pucCompressionBuffer != NULL ) &&
+          ( ( ulCompressionBufferLength == 0 ) || ( pucWindowBuffer == NULL ) ||
+            ( ulWindowBufferLength < azureiotcompressionWINDOW_BUFFER_MIN ) ) ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_SetTelemetryCompression failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        pxAzureIoTHubClient->_internal.pucCompressionBuffer = pucCompressionBuffer;
+        pxAzureIoTHubClient->_internal.ulCompressionBufferLength = ( pucCompressionBuffer != NULL ) ? ulCompressionBufferLength : 0;
+        pxAzureIoTHubClient->_internal.pucCompressionWindow = ( pucCompressionBuffer != NULL ) ? pucWindowBuffer : NULL;
+        pxAzureIoTHubClient->_internal.ulCompressionWindowLength = ( pucCompressionBuffer != NULL ) ? ulWindowBufferLength : 0;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_ProcessLoop( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                uint32_t ulTimeoutMilliseconds )
+{
+    AzureIoTMQTTResult_t xMQTTResult;
+    AzureIoTResult_t xResult;
+
+    azureiotSTACK_PROFILE_BEGIN();
+
+    if( pxAzureIoTHubClient == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_ProcessLoop failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_ProcessLoop failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorFailed;
+    }
+    else if( ( xMQTTResult = AzureIoTMQTT_ProcessLoop( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                       ulTimeoutMilliseconds ) ) != eAzureIoTMQTTSuccess )
+    {
+        AZLogError( ( "AzureIoTMQTT_ProcessLoop failed: ProcessLoopDuration=%u, MQTT error=0x%08x",
+                      ulTimeoutMilliseconds, xMQTTResult ) );
+        xResult = eAzureIoTErrorFailed;
+    }
+    else
+    {
+        prvPropertiesRequestsCheckTimeout( pxAzureIoTHubClient );
+        xResult = eAzureIoTSuccess;
+    }
+
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubProcessLoop );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Schedule the next reconnect attempt, with exponential backoff and a random delay on top,
+ * so devices which lost their connection at the same time do not reconnect in lockstep.
+ *
+ * */
+static void prvReconnectSchedule( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    uint32_t ulDelayMilliseconds = azureiotconfigRECONNECT_BACKOFF_BASE_MS;
+    uint32_t ulMaxMilliseconds = azureiotconfigRECONNECT_BACKOFF_MAX_S * 1000U;
+    uint32_t ulJitterMilliseconds;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ( ulIndex < pxAzureIoTHubClient->_internal.ulReconnectAttempts ) &&
+         ( ulDelayMilliseconds < ulMaxMilliseconds ); ulIndex++ )
+    {
+        ulDelayMilliseconds *= 2;
+    }
+
+    if( ulDelayMilliseconds > ulMaxMilliseconds )
+    {
+        ulDelayMilliseconds = ulMaxMilliseconds;
+    }
+
+    ulJitterMilliseconds = ( ulDelayMilliseconds / 100U ) * azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT;
+    ulDelayMilliseconds += AzureIoT_NextJitter( &pxAzureIoTHubClient->_internal.ulReconnectJitterState ) %
+                           ( ulJitterMilliseconds + 1U );
+
+    AZLogInfo( ( "AzureIoTHubClient reconnect attempt %u in %u ms",
+                 pxAzureIoTHubClient->_internal.ulReconnectAttempts + 1, ulDelayMilliseconds ) );
+
+    pxAzureIoTHubClient->_internal.xReconnectPending = true;
+    pxAzureIoTHubClient->_internal.ulReconnectAttempts++;
+    pxAzureIoTHubClient->_internal.ulReconnectTimeMilliseconds = prvGetTimeMs() + ulDelayMilliseconds;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Check whether the SAS token of the connection is due for renewal. The renewal time is picked
+ * at random in a window before the expiry, so devices which connected at the same time renew
+ * at different times.
+ *
+ * */
+static bool prvTokenRenewalDue( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    uint64_t ullNow;
+    uint64_t ullLifetime;
+    uint64_t ullWindow;
+    uint32_t ulJitter;
+
+    if( ( pxAzureIoTHubClient->_internal.pxTokenRefresh == NULL ) ||
+        ( pxAzureIoTHubClient->_internal.ullTokenExpiryTime == 0 ) )
+    {
+        return false;
+    }
+
+    ullNow = pxAzureIoTHubClient->_internal.xTimeFunction();
+
+    if( pxAzureIoTHubClient->_internal.ullTokenRenewalTime == 0 )
+    {
+        ullLifetime = ( pxAzureIoTHubClient->_internal.ullTokenExpiryTime > ullNow ) ?
+                      ( pxAzureIoTHubClient->_internal.ullTokenExpiryTime - ullNow ) : 0;
+        ullWindow = ( ullLifetime / 100U ) * azureiotconfigTOKEN_RENEWAL_JITTER_PERCENT;
+
+        ulJitter = AzureIoT_NextJitter( &pxAzureIoTHubClient->_internal.ulReconnectJitterState );
+
+        if( ( azureiotconfigTOKEN_RENEWAL_MARGIN_S + ullWindow ) < ullLifetime )
+        {
+            pxAzureIoTHubClient->_internal.ullTokenRenewalTime = pxAzureIoTHubClient->_internal.ullTokenExpiryTime -
+                                                                 azureiotconfigTOKEN_RENEWAL_MARGIN_S -
+                                                                 ( ulJitter % ( ullWindow + 1U ) );
+        }
+        else
+        {
+            /* Token too short lived for the margin, renew half way. */
+            pxAzureIoTHubClient->_internal.ullTokenRenewalTime = ullNow + ullLifetime / 2U;
+        }
+
+        AZLogInfo( ( "AzureIoTHubClient SAS token renewal in %u s",
+                     ( uint32_t ) ( pxAzureIoTHubClient->_internal.ullTokenRenewalTime - ullNow ) ) );
+    }
+
+    return ullNow >= pxAzureIoTHubClient->_internal.ullTokenRenewalTime;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Fill the topic filters of a receive context, returning how many there are.
+ *
+ * */
+static uint32_t prvReceiveContextTopics( uint32_t ulIndex,
+                                         AzureIoTMQTTSubscribeInfo_t * pxSubscriptions )
+{
+    uint32_t ulCount = 0;
+
+    switch( ulIndex )
+    {
+        case azureiothubRECEIVE_CONTEXT_INDEX_C2D:
+            pxSubscriptions[ 0 ].xQoS = eAzureIoTMQTTQoS1;
+            pxSubscriptions[ 0 ].pcTopicFilter = ( const uint8_t * ) AZ_IOT_HUB_CLIENT_C2D_SUBSCRIBE_TOPIC;
+            pxSubscriptions[ 0 ].usTopicFilterLength = ( uint16_t ) sizeof( AZ_IOT_HUB_CLIENT_C2D_SUBSCRIBE_TOPIC ) - 1;
+            ulCount = 1;
+            break;
+
+        case azureiothubRECEIVE_CONTEXT_INDEX_COMMANDS:
+            pxSubscriptions[ 0 ].xQoS = eAzureIoTMQTTQoS0;
+            pxSubscriptions[ 0 ].pcTopicFilter = ( const uint8_t * ) AZ_IOT_HUB_CLIENT_COMMANDS_SUBSCRIBE_TOPIC;
+            pxSubscriptions[ 0 ].usTopicFilterLength = ( uint16_t ) sizeof( AZ_IOT_HUB_CLIENT_COMMANDS_SUBSCRIBE_TOPIC ) - 1;
+            ulCount = 1;
+            break;
+
+        case azureiothubRECEIVE_CONTEXT_INDEX_PROPERTIES:
+            pxSubscriptions[ 0 ].xQoS = eAzureIoTMQTTQoS0;
+            pxSubscriptions[ 0 ].pcTopicFilter = ( const uint8_t * ) AZ_IOT_HUB_CLIENT_PROPERTIES_MESSAGE_SUBSCRIBE_TOPIC;
+            pxSubscriptions[ 0 ].usTopicFilterLength = ( uint16_t ) sizeof( AZ_IOT_HUB_CLIENT_PROPERTIES_MESSAGE_SUBSCRIBE_TOPIC ) - 1;
+            pxSubscriptions[ 1 ].xQoS = eAzureIoTMQTTQoS0;
+            pxSubscriptions[ 1 ].pcTopicFilter = ( const uint8_t * ) AZ_IOT_HUB_CLIENT_PROPERTIES_WRITABLE_UPDATES_SUBSCRIBE_TOPIC;
+            pxSubscriptions[ 1 ].usTopicFilterLength = ( uint16_t ) sizeof( AZ_IOT_HUB_CLIENT_PROPERTIES_WRITABLE_UPDATES_SUBSCRIBE_TOPIC ) - 1;
+            ulCount = 2;
+            break;
+
+        default:
+            break;
+    }
+
+    return ulCount;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Subscribe again to the topics of the receive contexts in use, keeping their callbacks.
+ * All the SUBSCRIBE packets are sent before waiting for the SUBACKs.
+ *
+ * */
+static AzureIoTResult_t prvResubscribe( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    AzureIoTMQTTSubscribeInfo_t xMqttSubscription[ 2 ];
+    AzureIoTMQTTResult_t xMQTTResult;
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    AzureIoTHubClientReceiveContext_t * pxContext;
+    uint16_t usSubscribePacketIdentifier;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ( ulIndex < azureiothubSUBSCRIBE_FEATURE_COUNT ) && ( xResult == eAzureIoTSuccess ); ulIndex++ )
+    {
+        pxContext = &pxAzureIoTHubClient->_internal.xReceiveContext[ ulIndex ];
+
+        if( pxContext->_internal.usState == azureiothubTOPIC_SUBSCRIBE_STATE_NONE )
+        {
+            continue;
+        }
+
+        memset( xMqttSubscription, 0, sizeof( xMqttSubscription ) );
+        usSubscribePacketIdentifier = AzureIoTMQTT_GetPacketId( &( pxAzureIoTHubClient->_internal.xMQTTContext ) );
+
+        if( ( xMQTTResult = AzureIoTMQTT_Subscribe( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                    xMqttSubscription,
+                                                    prvReceiveContextTopics( ulIndex, xMqttSubscription ),
+                                                    usSubscribePacketIdentifier ) ) != eAzureIoTMQTTSuccess )
         {
-            AZLogError( ( "Failed to initialize az_iot_hub_client_init: core error=0x%08x", xCoreResult ) );
-            xResult = AzureIoT_TranslateCoreError( xCoreResult );
+            AZLogError( ( "Resubscribe failed: receive context=%u, MQTT error=0x%08x", ulIndex, xMQTTResult ) );
+            xResult = eAzureIoTErrorSubscribeFailed;
         }
-        /* Initialize AzureIoTMQTT library. */
-        else if( ( xMQTTResult = AzureIoTMQTT_Init( &( pxAzureIoTHubClient->_internal.xMQTTContext ), pxTransportInterface,
-                                                    prvGetTimeMs, prvEventCallback,
-                                                    pucNetworkBuffer, ulNetworkBufferLength ) ) != eAzureIoTMQTTSuccess )
+        else
         {
-            AZLogError( ( "Failed to initialize AzureIoTMQTT_Init: MQTT error=0x%08x", xMQTTResult ) );
-            xResult = eAzureIoTErrorInitFailed;
+            pxContext->_internal.usState = azureiothubTOPIC_SUBSCRIBE_STATE_SUB;
+            pxContext->_internal.usMqttSubPacketID = usSubscribePacketIdentifier;
         }
-        else
+    }
+
+    for( ulIndex = 0; ( ulIndex < azureiothubSUBSCRIBE_FEATURE_COUNT ) && ( xResult == eAzureIoTSuccess ); ulIndex++ )
+    {
+        pxContext = &pxAzureIoTHubClient->_internal.xReceiveContext[ ulIndex ];
+
+        if( ( pxContext->_internal.usState == azureiothubTOPIC_SUBSCRIBE_STATE_SUB ) &&
+            ( ( xResult = prvWaitForSubAck( pxAzureIoTHubClient, pxContext,
+                                            azureiothubCONNACK_RECV_TIMEOUT_MS ) ) != eAzureIoTSuccess ) )
         {
-            pxAzureIoTHubClient->_internal.pucDeviceID = pucDeviceId;
-            pxAzureIoTHubClient->_internal.ulDeviceIDLength = ulDeviceIdLength;
-            pxAzureIoTHubClient->_internal.pucHostname = pucHostname;
-            pxAzureIoTHubClient->_internal.ulHostnameLength = ulHostnameLength;
-            pxAzureIoTHubClient->_internal.xTimeFunction = xGetTimeFunction;
-            pxAzureIoTHubClient->_internal.xTelemetryCallback =
-                pxHubClientOptions == NULL ? NULL : pxHubClientOptions->xTelemetryCallback;
-            xResult = eAzureIoTSuccess;
+            AZLogError( ( "Wait for resubscribe sub ack failed: receive context=%u, error=0x%08x", ulIndex, xResult ) );
         }
     }
 
@@ -700,32 +1692,75 @@ AzureIoTResult_t AzureIoTHubClient_Init( AzureIoTHubClient_t * pxAzureIoTHubClie
 }
 /*-----------------------------------------------------------*/
 
-void AzureIoTHubClient_Deinit( AzureIoTHubClient_t * pxAzureIoTHubClient )
+/**
+ *
+ * Reconnect the transport, then the MQTT session, then restore the subscriptions the service
+ * did not keep. On success, the pending properties requests are timed out. On failure, the
+ * next attempt is scheduled.
+ *
+ * */
+static AzureIoTResult_t prvReconnect( AzureIoTHubClient_t * pxAzureIoTHubClient )
 {
-    ( void ) pxAzureIoTHubClient;
+    AzureIoTResult_t xResult;
+    bool xSessionPresent = false;
+
+    if( ( xResult = pxAzureIoTHubClient->_internal.xTransportReconnect(
+              pxAzureIoTHubClient->_internal.pvTransportReconnectContext ) ) != eAzureIoTSuccess )
+    {
+        AZLogWarn( ( "AzureIoTHubClient transport reconnect failed: error=0x%08x", xResult ) );
+    }
+    else if( ( xResult = AzureIoTHubClient_Connect( pxAzureIoTHubClient, false, &xSessionPresent,
+                                                    azureiothubCONNACK_RECV_TIMEOUT_MS ) ) != eAzureIoTSuccess )
+    {
+        AZLogWarn( ( "AzureIoTHubClient MQTT reconnect failed: error=0x%08x", xResult ) );
+    }
+    else if( !xSessionPresent &&
+             ( ( xResult = prvResubscribe( pxAzureIoTHubClient ) ) != eAzureIoTSuccess ) )
+    {
+        AZLogWarn( ( "AzureIoTHubClient resubscribe failed: error=0x%08x", xResult ) );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        AZLogInfo( ( "AzureIoTHubClient reconnected after %u attempts, session present=%u",
+                     pxAzureIoTHubClient->_internal.ulReconnectAttempts, ( uint32_t ) xSessionPresent ) );
+        pxAzureIoTHubClient->_internal.xReconnectPending = false;
+        pxAzureIoTHubClient->_internal.ulReconnectAttempts = 0;
+
+        /* Once connected again, so the callbacks can send their requests anew. */
+        prvPropertiesRequestsCancel( pxAzureIoTHubClient );
+    }
+    else
+    {
+        prvReconnectSchedule( pxAzureIoTHubClient );
+        xResult = eAzureIoTErrorPending;
+    }
+
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_SetSymmetricKey( AzureIoTHubClient_t * pxAzureIoTHubClient,
-                                                    const uint8_t * pucSymmetricKey,
-                                                    uint32_t ulSymmetricKeyLength,
-                                                    AzureIoTGetHMACFunc_t xHMACFunction )
+AzureIoTResult_t AzureIoTHubClient_SetReconnect( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                 AzureIoTHubClientTransportReconnect_t xTransportReconnect,
+                                                 void * pvContext )
 {
     AzureIoTResult_t xResult;
+    uint32_t ulHash;
 
-    if( ( pxAzureIoTHubClient == NULL ) ||
-        ( pucSymmetricKey == NULL ) || ( ulSymmetricKeyLength == 0 ) ||
-        ( xHMACFunction == NULL ) )
+    if( ( pxAzureIoTHubClient == NULL ) || ( xTransportReconnect == NULL ) )
     {
-        AZLogError( ( "AzureIoTHubClient_SetSymmetricKey failed: invalid argument" ) );
+        AZLogError( ( "AzureIoTHubClient_SetReconnect failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
     else
     {
-        pxAzureIoTHubClient->_internal.pucSymmetricKey = pucSymmetricKey;
-        pxAzureIoTHubClient->_internal.ulSymmetricKeyLength = ulSymmetricKeyLength;
-        pxAzureIoTHubClient->_internal.pxTokenRefresh = prvIoTHubClientGetToken;
-        pxAzureIoTHubClient->_internal.xHMACFunction = xHMACFunction;
+        /* Seed the reconnect jitter per device and boot. xorshift32 must not start from zero. */
+        ulHash = AzureIoT_FNV1aHash( azureiotFNV_OFFSET_BASIS, pxAzureIoTHubClient->_internal.pucDeviceID,
+                                     pxAzureIoTHubClient->_internal.ulDeviceIDLength ) ^ prvGetTimeMs();
+
+        pxAzureIoTHubClient->_internal.xTransportReconnect = xTransportReconnect;
+        pxAzureIoTHubClient->_internal.pvTransportReconnectContext = pvContext;
+        pxAzureIoTHubClient->_internal.ulReconnectJitterState = ( ulHash == 0 ) ? 1 : ulHash;
         xResult = eAzureIoTSuccess;
     }
 
@@ -733,77 +1768,54 @@ AzureIoTResult_t AzureIoTHubClient_SetSymmetricKey( AzureIoTHubClient_t * pxAzur
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_Connect( AzureIoTHubClient_t * pxAzureIoTHubClient,
-                                            bool xCleanSession,
-                                            bool * pxOutSessionPresent,
-                                            uint32_t ulTimeoutMilliseconds )
+AzureIoTResult_t AzureIoTHubClient_Run( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                        uint32_t ulTimeoutMilliseconds )
 {
-    AzureIoTMQTTConnectInfo_t xConnectInfo = { 0 };
     AzureIoTResult_t xResult;
-    AzureIoTMQTTResult_t xMQTTResult;
-    uint32_t ulPasswordLength = 0;
-    size_t xMQTTUserNameLength;
-    az_result xCoreResult;
+    int32_t lRemainingMilliseconds;
 
-    if( ( pxAzureIoTHubClient == NULL ) || ( pxOutSessionPresent == NULL ) )
+    if( ( pxAzureIoTHubClient == NULL ) || ( pxAzureIoTHubClient->_internal.xTransportReconnect == NULL ) )
     {
-        AZLogError( ( "AzureIoTHubClient_Connect failed: invalid argument" ) );
+        AZLogError( ( "AzureIoTHubClient_Run failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
-    else
+    else if( !pxAzureIoTHubClient->_internal.xReconnectPending && prvTokenRenewalDue( pxAzureIoTHubClient ) )
     {
-        /* Use working buffer for username/password */
-        xConnectInfo.pcUserName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
-        xConnectInfo.pcPassword = xConnectInfo.pcUserName + azureiotconfigUSERNAME_MAX;
-
-        if( az_result_failed( xCoreResult = az_iot_hub_client_get_user_name( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
-                                                                             ( char * ) xConnectInfo.pcUserName, azureiotconfigUSERNAME_MAX,
-                                                                             &xMQTTUserNameLength ) ) )
+        /* Reconnect right away with a new token, before the hub drops the connection. */
+        AZLogInfo( ( "AzureIoTHubClient renewing SAS token" ) );
+        ( void ) AzureIoTMQTT_Disconnect( &( pxAzureIoTHubClient->_internal.xMQTTContext ) );
+        pxAzureIoTHubClient->_internal.xReconnectPending = true;
+        pxAzureIoTHubClient->_internal.ulReconnectAttempts = 0;
+        xResult = prvReconnect( pxAzureIoTHubClient );
+    }
+    else if( !pxAzureIoTHubClient->_internal.xReconnectPending )
+    {
+        if( ( xResult = AzureIoTHubClient_ProcessLoop( pxAzureIoTHubClient, ulTimeoutMilliseconds ) ) != eAzureIoTSuccess )
         {
-            AZLogError( ( "Failed to get username: core error=0x%08x", xCoreResult ) );
-            xResult = AzureIoT_TranslateCoreError( xCoreResult );
+            AZLogWarn( ( "AzureIoTHubClient connection to %.*s lost", pxAzureIoTHubClient->_internal.ulHostnameLength,
+                         ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
+            prvReconnectSchedule( pxAzureIoTHubClient );
+            xResult = eAzureIoTErrorPending;
         }
-        /* Check if token refresh is set, then generate password */
-        else if( ( pxAzureIoTHubClient->_internal.pxTokenRefresh ) &&
-                 ( pxAzureIoTHubClient->_internal.pxTokenRefresh( pxAzureIoTHubClient,
-                                                                  pxAzureIoTHubClient->_internal.xTimeFunction() +
-                                                                  azureiothubDEFAULT_TOKEN_TIMEOUT_IN_SEC,
-                                                                  pxAzureIoTHubClient->_internal.pucSymmetricKey,
-                                                                  pxAzureIoTHubClient->_internal.ulSymmetricKeyLength,
-                                                                  ( uint8_t * ) xConnectInfo.pcPassword, azureiotconfigPASSWORD_MAX,
-                                                                  &ulPasswordLength ) ) )
+    }
+    else
+    {
+        /* Compare the difference, which stays correct when the tick count wraps. */
+        lRemainingMilliseconds = ( int32_t ) ( pxAzureIoTHubClient->_internal.ulReconnectTimeMilliseconds - prvGetTimeMs() );
+
+        if( lRemainingMilliseconds <= 0 )
         {
-            AZLogError( ( "Failed to generate SAS token" ) );
-            xResult = eAzureIoTErrorFailed;
+            xResult = prvReconnect( pxAzureIoTHubClient );
         }
         else
         {
-            xConnectInfo.xCleanSession = xCleanSession;
-            xConnectInfo.pcClientIdentifier = pxAzureIoTHubClient->_internal.pucDeviceID;
-            xConnectInfo.usClientIdentifierLength = ( uint16_t ) pxAzureIoTHubClient->_internal.ulDeviceIDLength;
-            xConnectInfo.usUserNameLength = ( uint16_t ) xMQTTUserNameLength;
-            xConnectInfo.usKeepAliveSeconds = azureiothubKEEP_ALIVE_TIMEOUT_SECONDS;
-            xConnectInfo.usPasswordLength = ( uint16_t ) ulPasswordLength;
-
-            /* Send MQTT CONNECT packet to broker. Last Will and Testament is not used. */
-            if( ( xMQTTResult = AzureIoTMQTT_Connect( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                      &xConnectInfo,
-                                                      NULL,
-                                                      ulTimeoutMilliseconds,
-                                                      pxOutSessionPresent ) ) != eAzureIoTMQTTSuccess )
-            {
-                AZLogError( ( "Failed to establish MQTT connection: Server=%.*s, MQTT error=0x%08x",
-                              pxAzureIoTHubClient->_internal.ulHostnameLength, ( const char * ) pxAzureIoTHubClient->_internal.pucHostname,
-                              xMQTTResult ) );
-                xResult = eAzureIoTErrorFailed;
-            }
-            else
+            if( ulTimeoutMilliseconds > 0 )
             {
-                /* Successfully established a MQTT connection with the broker. */
-                AZLogInfo( ( "An MQTT connection is established with %.*s", pxAzureIoTHubClient->_internal.ulHostnameLength,
-                             ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
-                xResult = eAzureIoTSuccess;
+                vTaskDelay( pdMS_TO_TICKS( ( ( uint32_t ) lRemainingMilliseconds < ulTimeoutMilliseconds ) ?
+                                           ( uint32_t ) lRemainingMilliseconds : ulTimeoutMilliseconds ) );
             }
+
+            xResult = eAzureIoTErrorPending;
         }
     }
 
@@ -811,25 +1823,35 @@ AzureIoTResult_t AzureIoTHubClient_Connect( AzureIoTHubClient_t * pxAzureIoTHubC
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_Disconnect( AzureIoTHubClient_t * pxAzureIoTHubClient )
+/**
+ *
+ * Send the JSON text of a streamed telemetry payload each time the chunk of the writer fills.
+ *
+ * */
+static AzureIoTResult_t prvTelemetryStreamFlush( void * pvContext,
+                                                 const uint8_t * pucData,
+                                                 uint32_t ulDataLength )
 {
+    AzureIoTHubClient_t * pxAzureIoTHubClient = ( AzureIoTHubClient_t * ) pvContext;
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
 
-    if( pxAzureIoTHubClient == NULL )
+    if( ulDataLength > pxAzureIoTHubClient->_internal.ulStreamBytesRemaining )
     {
-        AZLogError( ( "AzureIoTHubClient_Disconnect failed: invalid argument" ) );
-        xResult = eAzureIoTErrorInvalidArgument;
+        /* Sending would run past the length announced in the PUBLISH header. */
+        AZLogError( ( "Telemetry payload longer than announced: %u bytes left, %u to send",
+                      pxAzureIoTHubClient->_internal.ulStreamBytesRemaining, ulDataLength ) );
+        xResult = eAzureIoTErrorPublishFailed;
     }
-    else if( ( xMQTTResult = AzureIoTMQTT_Disconnect( &( pxAzureIoTHubClient->_internal.xMQTTContext ) ) ) != eAzureIoTMQTTSuccess )
+    else if( ( xMQTTResult = AzureIoTMQTT_PublishStreamSend( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                             pucData, ulDataLength ) ) != eAzureIoTMQTTSuccess )
     {
-        AZLogError( ( "AzureIoTHubClient_Disconnect failed to disconnect: MQTT error=0x%08x", xMQTTResult ) );
-        xResult = eAzureIoTErrorFailed;
+        AZLogError( ( "Failed to send telemetry payload: MQTT error=0x%08x", xMQTTResult ) );
+        xResult = eAzureIoTErrorPublishFailed;
     }
     else
     {
-        AZLogInfo( ( "Disconnecting the MQTT connection with %.*s", pxAzureIoTHubClient->_internal.ulHostnameLength,
-                     ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
+        pxAzureIoTHubClient->_internal.ulStreamBytesRemaining -= ulDataLength;
         xResult = eAzureIoTSuccess;
     }
 
@@ -837,25 +1859,74 @@ AzureIoTResult_t AzureIoTHubClient_Disconnect( AzureIoTHubClient_t * pxAzureIoTH
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureIoTHubClient,
-                                                  const uint8_t * pucTelemetryData,
-                                                  uint32_t ulTelemetryDataLength,
-                                                  AzureIoTMessageProperties_t * pxProperties,
-                                                  AzureIoTHubMessageQoS_t xQOS,
-                                                  uint16_t * pusTelemetryPacketID )
+/**
+ *
+ * A streamed PUBLISH was cut short, so the connection is out of sync with the broker. Reconnect when
+ * a transport reconnect is set, otherwise fail the sends until the application connects again.
+ *
+ * */
+static void prvTelemetryStreamAbort( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    if( pxAzureIoTHubClient->_internal.xTransportReconnect != NULL )
+    {
+        prvReconnectSchedule( pxAzureIoTHubClient );
+    }
+    else
+    {
+        AZLogError( ( "AzureIoTHubClient connection to %.*s out of sync, connect again",
+                      pxAzureIoTHubClient->_internal.ulHostnameLength,
+                      ( const char * ) pxAzureIoTHubClient->_internal.pucHostname ) );
+        pxAzureIoTHubClient->_internal.xStreamOutOfSync = true;
+    }
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_SendTelemetryStream( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                        AzureIoTHubClientTelemetryWriter_t xTelemetryWriter,
+                                                        void * pvContext,
+                                                        uint8_t * pucChunk,
+                                                        uint32_t ulChunkLength,
+                                                        AzureIoTMessageProperties_t * pxProperties,
+                                                        AzureIoTHubMessageQoS_t xQOS,
+                                                        uint16_t * pusTelemetryPacketID )
 {
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
-    AzureIoTMQTTPublishInfo_t xMQTTPublishInfo = { 0 };
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo;
+    AzureIoTJSONWriter_t xJSONWriter;
     uint16_t usPublishPacketIdentifier = 0;
     size_t xTelemetryTopicLength;
+    int32_t lTelemetryDataLength;
     az_result xCoreResult;
 
-    if( pxAzureIoTHubClient == NULL )
+    azureiotSTACK_PROFILE_BEGIN();
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( xTelemetryWriter == NULL ) ||
+        ( pucChunk == NULL ) || ( ulChunkLength < azureiotjsonwriterCHUNK_SIZE_MIN ) )
     {
-        AZLogError( ( "AzureIoTHubClient_SendTelemetry failed: invalid argument" ) );
+        AZLogError( ( "AzureIoTHubClient_SendTelemetryStream failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
+    else if( pxAzureIoTHubClient->_internal.xReconnectPending )
+    {
+        AZLogWarn( ( "AzureIoTHubClient_SendTelemetryStream deferred: reconnecting" ) );
+        xResult = eAzureIoTErrorPending;
+    }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendTelemetryStream failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorPublishFailed;
+    }
+    else if( ( ( xResult = AzureIoTJSONWriter_Init( &xJSONWriter, NULL, 0 ) ) != eAzureIoTSuccess ) ||
+             ( ( xResult = xTelemetryWriter( &xJSONWriter, pvContext ) ) != eAzureIoTSuccess ) )
+    {
+        AZLogError( ( "Failed to measure telemetry payload: error=0x%08x", xResult ) );
+    }
+    else if( ( lTelemetryDataLength = AzureIoTJSONWriter_GetBytesUsed( &xJSONWriter ) ) < 0 )
+    {
+        AZLogError( ( "Failed to get telemetry payload length" ) );
+        xResult = eAzureIoTErrorFailed;
+    }
     else if( az_result_failed(
                  xCoreResult = az_iot_hub_client_telemetry_get_publish_topic( &pxAzureIoTHubClient->_internal.xAzureIoTHubClientCore,
                                                                               ( pxProperties != NULL ) ? &pxProperties->_internal.xProperties : NULL,
@@ -868,11 +1939,11 @@ AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureI
     }
     else
     {
-        xMQTTPublishInfo.xQOS = xQOS == eAzureIoTHubMessageQoS1 ? eAzureIoTMQTTQoS1 : eAzureIoTMQTTQoS0;
-        xMQTTPublishInfo.pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
-        xMQTTPublishInfo.usTopicNameLength = ( uint16_t ) xTelemetryTopicLength;
-        xMQTTPublishInfo.pvPayload = ( const void * ) pucTelemetryData;
-        xMQTTPublishInfo.xPayloadLength = ulTelemetryDataLength;
+        pxMQTTPublishInfo = prvGetPublishInfo( pxAzureIoTHubClient );
+        pxMQTTPublishInfo->xQOS = xQOS == eAzureIoTHubMessageQoS1 ? eAzureIoTMQTTQoS1 : eAzureIoTMQTTQoS0;
+        pxMQTTPublishInfo->pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+        pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xTelemetryTopicLength;
+        pxMQTTPublishInfo->xPayloadLength = ( size_t ) lTelemetryDataLength;
 
         /* Get a unique packet id. Not used if QOS is 0 */
         if( xQOS == eAzureIoTHubMessageQoS1 )
@@ -880,12 +1951,31 @@ AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureI
             usPublishPacketIdentifier = AzureIoTMQTT_GetPacketId( &( pxAzureIoTHubClient->_internal.xMQTTContext ) );
         }
 
-        /* Send PUBLISH packet. */
-        if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                  &xMQTTPublishInfo, usPublishPacketIdentifier ) ) != eAzureIoTMQTTSuccess )
+        pxAzureIoTHubClient->_internal.ulStreamBytesRemaining = ( uint32_t ) lTelemetryDataLength;
+
+        if( ( xMQTTResult = AzureIoTMQTT_PublishStreamBegin( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
+                                                             pxMQTTPublishInfo, usPublishPacketIdentifier ) ) != eAzureIoTMQTTSuccess )
         {
             AZLogError( ( "Failed to publish telemetry: MQTT error=0x%08x", xMQTTResult ) );
             xResult = eAzureIoTErrorPublishFailed;
+
+            /* Part of the PUBLISH header may have been sent. */
+            if( xMQTTResult == eAzureIoTMQTTSendFailed )
+            {
+                prvTelemetryStreamAbort( pxAzureIoTHubClient );
+            }
+        }
+        else if( ( ( xResult = AzureIoTJSONWriter_InitChunked( &xJSONWriter, pucChunk, ulChunkLength,
+                                                               prvTelemetryStreamFlush, pxAzureIoTHubClient ) ) != eAzureIoTSuccess ) ||
+                 ( ( xResult = xTelemetryWriter( &xJSONWriter, pvContext ) ) != eAzureIoTSuccess ) ||
+                 ( ( xResult = AzureIoTJSONWriter_Flush( &xJSONWriter ) ) != eAzureIoTSuccess ) ||
+                 ( pxAzureIoTHubClient->_internal.ulStreamBytesRemaining != 0 ) )
+        {
+            /* The PUBLISH was announced with a length which was not sent, the connection is out of sync. */
+            AZLogError( ( "Failed to stream telemetry payload of %d bytes: error=0x%08x",
+                          ( int ) lTelemetryDataLength, xResult ) );
+            xResult = eAzureIoTErrorPublishFailed;
+            prvTelemetryStreamAbort( pxAzureIoTHubClient );
         }
         else
         {
@@ -895,36 +1985,10 @@ AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureI
             }
 
             AZLogInfo( ( "Successfully sent telemetry message" ) );
-            xResult = eAzureIoTSuccess;
         }
     }
 
-    return xResult;
-}
-/*-----------------------------------------------------------*/
-
-AzureIoTResult_t AzureIoTHubClient_ProcessLoop( AzureIoTHubClient_t * pxAzureIoTHubClient,
-                                                uint32_t ulTimeoutMilliseconds )
-{
-    AzureIoTMQTTResult_t xMQTTResult;
-    AzureIoTResult_t xResult;
-
-    if( pxAzureIoTHubClient == NULL )
-    {
-        AZLogError( ( "AzureIoTHubClient_ProcessLoop failed: invalid argument" ) );
-        xResult = eAzureIoTErrorInvalidArgument;
-    }
-    else if( ( xMQTTResult = AzureIoTMQTT_ProcessLoop( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                       ulTimeoutMilliseconds ) ) != eAzureIoTMQTTSuccess )
-    {
-        AZLogError( ( "AzureIoTMQTT_ProcessLoop failed: ProcessLoopDuration=%u, MQTT error=0x%08x",
-                      ulTimeoutMilliseconds, xMQTTResult ) );
-        xResult = eAzureIoTErrorFailed;
-    }
-    else
-    {
-        xResult = eAzureIoTSuccess;
-    }
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubSendTelemetryStream );
 
     return xResult;
 }
@@ -1129,17 +2193,24 @@ AzureIoTResult_t AzureIoTHubClient_SendCommandResponse( AzureIoTHubClient_t * px
 {
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
-    AzureIoTMQTTPublishInfo_t xMQTTPublishInfo = { 0 };
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo;
     az_span xRequestID;
     size_t xTopicLength;
     az_result xCoreResult;
 
+    azureiotSTACK_PROFILE_BEGIN();
+
     if( ( pxAzureIoTHubClient == NULL ) ||
         ( pxMessage == NULL ) )
     {
         AZLogError( ( "AzureIoTHubClient_SendCommandResponse failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendCommandResponse failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorPublishFailed;
+    }
     else if( ( pxMessage->pucRequestID == NULL ) || ( pxMessage->usRequestIDLength == 0 ) )
     {
         AZLogError( ( "AzureIoTHubClient_SendCommandResponse failed: invalid request id " ) );
@@ -1162,23 +2233,24 @@ AzureIoTResult_t AzureIoTHubClient_SendCommandResponse( AzureIoTHubClient_t * px
         }
         else
         {
-            xMQTTPublishInfo.xQOS = eAzureIoTMQTTQoS0;
-            xMQTTPublishInfo.pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
-            xMQTTPublishInfo.usTopicNameLength = ( uint16_t ) xTopicLength;
+            pxMQTTPublishInfo = prvGetPublishInfo( pxAzureIoTHubClient );
+            pxMQTTPublishInfo->xQOS = eAzureIoTMQTTQoS0;
+            pxMQTTPublishInfo->pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+            pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xTopicLength;
 
             if( ( pucCommandPayload == NULL ) || ( ulCommandPayloadLength == 0 ) )
             {
-                xMQTTPublishInfo.pvPayload = ( const void * ) azureiothubCOMMAND_EMPTY_RESPONSE;
-                xMQTTPublishInfo.xPayloadLength = sizeof( azureiothubCOMMAND_EMPTY_RESPONSE ) - 1;
+                pxMQTTPublishInfo->pvPayload = ( const void * ) azureiothubCOMMAND_EMPTY_RESPONSE;
+                pxMQTTPublishInfo->xPayloadLength = sizeof( azureiothubCOMMAND_EMPTY_RESPONSE ) - 1;
             }
             else
             {
-                xMQTTPublishInfo.pvPayload = ( const void * ) pucCommandPayload;
-                xMQTTPublishInfo.xPayloadLength = ulCommandPayloadLength;
+                pxMQTTPublishInfo->pvPayload = ( const void * ) pucCommandPayload;
+                pxMQTTPublishInfo->xPayloadLength = ulCommandPayloadLength;
             }
 
             if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                      &xMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
+                                                      pxMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
             {
                 AZLogError( ( "Failed to publish response: MQTT error=0x%08x", xMQTTResult ) );
                 xResult = eAzureIoTErrorPublishFailed;
@@ -1190,6 +2262,8 @@ AzureIoTResult_t AzureIoTHubClient_SendCommandResponse( AzureIoTHubClient_t * px
         }
     }
 
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubSendCommandResponse );
+
     return xResult;
 }
 /*-----------------------------------------------------------*/
@@ -1305,18 +2379,25 @@ AzureIoTResult_t AzureIoTHubClient_SendPropertiesReported( AzureIoTHubClient_t *
 {
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
-    AzureIoTMQTTPublishInfo_t xMQTTPublishInfo = { 0 };
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo;
     uint8_t ucRequestID[ azureiothubMAX_SIZE_FOR_UINT32 ];
     size_t xTopicLength;
     az_result xCoreResult;
     az_span xRequestID = az_span_create( ucRequestID, sizeof( ucRequestID ) );
 
+    azureiotSTACK_PROFILE_BEGIN();
+
     if( ( pxAzureIoTHubClient == NULL ) ||
         ( pucReportedPayload == NULL ) || ( ulReportedPayloadLength == 0 ) )
     {
         AZLogError( ( "AzureIoTHubClient_SendPropertiesReported failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendPropertiesReported failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorPublishFailed;
+    }
     else if( pxAzureIoTHubClient->_internal.xReceiveContext[ azureiothubRECEIVE_CONTEXT_INDEX_PROPERTIES ]._internal.usState !=
              azureiothubTOPIC_SUBSCRIBE_STATE_SUBACK )
     {
@@ -1343,14 +2424,15 @@ AzureIoTResult_t AzureIoTHubClient_SendPropertiesReported( AzureIoTHubClient_t *
         }
         else
         {
-            xMQTTPublishInfo.xQOS = eAzureIoTMQTTQoS0;
-            xMQTTPublishInfo.pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
-            xMQTTPublishInfo.usTopicNameLength = ( uint16_t ) xTopicLength;
-            xMQTTPublishInfo.pvPayload = ( const void * ) pucReportedPayload;
-            xMQTTPublishInfo.xPayloadLength = ulReportedPayloadLength;
+            pxMQTTPublishInfo = prvGetPublishInfo( pxAzureIoTHubClient );
+            pxMQTTPublishInfo->xQOS = eAzureIoTMQTTQoS0;
+            pxMQTTPublishInfo->pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+            pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xTopicLength;
+            pxMQTTPublishInfo->pvPayload = ( const void * ) pucReportedPayload;
+            pxMQTTPublishInfo->xPayloadLength = ulReportedPayloadLength;
 
             if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                      &xMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
+                                                      pxMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
             {
                 AZLogError( ( "Failed to Publish properties reported message: MQTT error=0x%08x", xMQTTResult ) );
                 xResult = eAzureIoTErrorPublishFailed;
@@ -1362,15 +2444,23 @@ AzureIoTResult_t AzureIoTHubClient_SendPropertiesReported( AzureIoTHubClient_t *
         }
     }
 
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileHubSendPropertiesReported );
+
     return xResult;
 }
 /*-----------------------------------------------------------*/
 
-AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t * pxAzureIoTHubClient )
+/**
+ *
+ * Publish a request for the properties document, optionally returning the request ID used.
+ *
+ * */
+static AzureIoTResult_t prvRequestProperties( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                              uint32_t * pulRequestId )
 {
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
-    AzureIoTMQTTPublishInfo_t xMQTTPublishInfo = { 0 };
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo;
     uint8_t ucRequestID[ 10 ];
     az_span xRequestID = az_span_create( ( uint8_t * ) ucRequestID, sizeof( ucRequestID ) );
     size_t xTopicLength;
@@ -1381,6 +2471,11 @@ AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t *
         AZLogError( ( "AzureIoTHubClient_RequestPropertiesAsync failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
+    else if( pxAzureIoTHubClient->_internal.xStreamOutOfSync )
+    {
+        AZLogError( ( "AzureIoTHubClient_RequestPropertiesAsync failed: connection out of sync, connect again" ) );
+        xResult = eAzureIoTErrorPublishFailed;
+    }
     else if( pxAzureIoTHubClient->_internal.xReceiveContext[ azureiothubRECEIVE_CONTEXT_INDEX_PROPERTIES ]._internal.usState !=
              azureiothubTOPIC_SUBSCRIBE_STATE_SUBACK )
     {
@@ -1390,7 +2485,7 @@ AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t *
     else
     {
         if( ( xResult = prvGetPropertiesRequestId( pxAzureIoTHubClient, xRequestID,
-                                                   false, NULL, &xRequestID ) ) != eAzureIoTSuccess )
+                                                   false, pulRequestId, &xRequestID ) ) != eAzureIoTSuccess )
         {
             AZLogError( ( "Failed to get request id: error=0x%08x", xResult ) );
         }
@@ -1407,12 +2502,13 @@ AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t *
         }
         else
         {
-            xMQTTPublishInfo.pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
-            xMQTTPublishInfo.xQOS = eAzureIoTMQTTQoS0;
-            xMQTTPublishInfo.usTopicNameLength = ( uint16_t ) xTopicLength;
+            pxMQTTPublishInfo = prvGetPublishInfo( pxAzureIoTHubClient );
+            pxMQTTPublishInfo->pcTopicName = pxAzureIoTHubClient->_internal.pucWorkingBuffer;
+            pxMQTTPublishInfo->xQOS = eAzureIoTMQTTQoS0;
+            pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xTopicLength;
 
             if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureIoTHubClient->_internal.xMQTTContext ),
-                                                      &xMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
+                                                      pxMQTTPublishInfo, 0 ) ) != eAzureIoTMQTTSuccess )
             {
                 AZLogError( ( "Failed to Publish get properties message: MQTT error=0x%08x", xMQTTResult ) );
                 xResult = eAzureIoTErrorPublishFailed;
@@ -1427,3 +2523,112 @@ AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t *
     return xResult;
 }
 /*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    return prvRequestProperties( pxAzureIoTHubClient, NULL );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Find a free slot to track a properties request sent with a callback.
+ *
+ * */
+static AzureIoTHubClientPropertiesRequest_t * prvPropertiesRequestAllocate( AzureIoTHubClient_t * pxAzureIoTHubClient )
+{
+    return prvPropertiesRequestFind( pxAzureIoTHubClient, 0 );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Start tracking a properties request which was just sent.
+ *
+ * */
+static void prvPropertiesRequestStart( AzureIoTHubClientPropertiesRequest_t * pxRequest,
+                                       uint32_t ulRequestID,
+                                       AzureIoTHubClientPropertiesRequestCallback_t xCallback,
+                                       void * pvCallbackContext,
+                                       uint32_t ulTimeoutMilliseconds )
+{
+    pxRequest->_internal.ulRequestID = ulRequestID;
+    pxRequest->_internal.ulSentTimeMilliseconds = prvGetTimeMs();
+    pxRequest->_internal.ulTimeoutMilliseconds = ulTimeoutMilliseconds;
+    pxRequest->_internal.xCallback = xCallback;
+    pxRequest->_internal.pvCallbackContext = pvCallbackContext;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_SendPropertiesReportedWithCallback( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                       const uint8_t * pucReportedPayload,
+                                                                       uint32_t ulReportedPayloadLength,
+                                                                       AzureIoTHubClientPropertiesRequestCallback_t xCallback,
+                                                                       void * pvCallbackContext,
+                                                                       uint32_t ulTimeoutMilliseconds,
+                                                                       uint32_t * pulRequestID )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesRequest_t * pxRequest;
+    uint32_t ulRequestID;
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( xCallback == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendPropertiesReportedWithCallback failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( pxRequest = prvPropertiesRequestAllocate( pxAzureIoTHubClient ) ) == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_SendPropertiesReportedWithCallback failed: too many requests in flight" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else if( ( xResult = AzureIoTHubClient_SendPropertiesReported( pxAzureIoTHubClient,
+                                                                   pucReportedPayload,
+                                                                   ulReportedPayloadLength,
+                                                                   &ulRequestID ) ) == eAzureIoTSuccess )
+    {
+        prvPropertiesRequestStart( pxRequest, ulRequestID, xCallback, pvCallbackContext, ulTimeoutMilliseconds );
+
+        if( pulRequestID != NULL )
+        {
+            *pulRequestID = ulRequestID;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTHubClient_RequestPropertiesWithCallback( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                  AzureIoTHubClientPropertiesRequestCallback_t xCallback,
+                                                                  void * pvCallbackContext,
+                                                                  uint32_t ulTimeoutMilliseconds,
+                                                                  uint32_t * pulRequestID )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesRequest_t * pxRequest;
+    uint32_t ulRequestID;
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( xCallback == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClient_RequestPropertiesWithCallback failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( pxRequest = prvPropertiesRequestAllocate( pxAzureIoTHubClient ) ) == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClient_RequestPropertiesWithCallback failed: too many requests in flight" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else if( ( xResult = prvRequestProperties( pxAzureIoTHubClient, &ulRequestID ) ) == eAzureIoTSuccess )
+    {
+        prvPropertiesRequestStart( pxRequest, ulRequestID, xCallback, pvCallbackContext, ulTimeoutMilliseconds );
+
+        if( pulRequestID != NULL )
+        {
+            *pulRequestID = ulRequestID;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
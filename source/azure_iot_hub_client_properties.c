@@ -7,8 +7,19 @@
  */
 
 #include "azure_iot_hub_client_properties.h"
+
+#include <string.h>
+
 #include "azure_iot_private.h"
 
+/* The value was set and differs from the acknowledged one. */
+#define azureiothubclientpropertiesCACHE_FLAG_DIRTY        ( 0x01 )
+/* The pending value was sent and is waiting for its acknowledgement. */
+#define azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT    ( 0x02 )
+
+/* Bytes a batch writes around the names and values it is given. */
+#define azureiothubclientpropertiesBATCH_LENGTH( pcText )    ( ( uint32_t ) sizeof( pcText ) - 1U )
+
 AzureIoTResult_t AzureIoTHubClientProperties_BuilderBeginComponent( AzureIoTHubClient_t * pxAzureIoTHubClient,
                                                                     AzureIoTJSONWriter_t * pxJSONWriter,
                                                                     const uint8_t * pucComponentName,
@@ -243,3 +254,705 @@ AzureIoTResult_t AzureIoTHubClientProperties_GetNextComponentProperty( AzureIoTH
 
     return xResult;
 }
+
+/**
+ *
+ * Find the cache entry of a property, or take a free one.
+ *
+ * */
+static AzureIoTHubClientPropertiesCacheEntry_t * prvCacheGetEntry( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                                   const uint8_t * pucName,
+                                                                   uint16_t usNameLength )
+{
+    AzureIoTHubClientPropertiesCacheEntry_t * pxEntry = NULL;
+    AzureIoTHubClientPropertiesCacheEntry_t * pxCandidate;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ( pxEntry == NULL ) && ( ulIndex < pxCache->_internal.ulEntriesUsed ); ulIndex++ )
+    {
+        pxCandidate = &pxCache->_internal.pxEntries[ ulIndex ];
+
+        if( ( pxCandidate->_internal.usNameLength == usNameLength ) &&
+            ( memcmp( pxCandidate->_internal.pucName, pucName, usNameLength ) == 0 ) )
+        {
+            pxEntry = pxCandidate;
+        }
+    }
+
+    if( ( pxEntry == NULL ) && ( pxCache->_internal.ulEntriesUsed < pxCache->_internal.ulEntryCount ) )
+    {
+        pxEntry = &pxCache->_internal.pxEntries[ pxCache->_internal.ulEntriesUsed++ ];
+        memset( pxEntry, 0, sizeof( AzureIoTHubClientPropertiesCacheEntry_t ) );
+        pxEntry->_internal.pucName = pucName;
+        pxEntry->_internal.usNameLength = usNameLength;
+    }
+
+    return pxEntry;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_CacheInit( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                        AzureIoTHubClientPropertiesCacheEntry_t * pxEntries,
+                                                        uint32_t ulEntryCount )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxCache == NULL ) || ( pxEntries == NULL ) || ( ulEntryCount == 0 ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_CacheInit failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( pxCache, 0, sizeof( AzureIoTHubClientPropertiesCache_t ) );
+        pxCache->_internal.pxEntries = pxEntries;
+        pxCache->_internal.ulEntryCount = ulEntryCount;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_CacheSet( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                       const uint8_t * pucName,
+                                                       uint16_t usNameLength,
+                                                       const uint8_t * pucValue,
+                                                       uint32_t ulValueLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesCacheEntry_t * pxEntry;
+
+    if( ( pxCache == NULL ) ||
+        ( pucName == NULL ) || ( usNameLength == 0 ) ||
+        ( pucValue == NULL ) || ( ulValueLength == 0 ) ||
+        ( ulValueLength > azureiotconfigPROPERTIES_CACHE_VALUE_MAX ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_CacheSet failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( pxEntry = prvCacheGetEntry( pxCache, pucName, usNameLength ) ) == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_CacheSet failed: no free cache entry" ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        if( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT )
+        {
+            /* The acknowledged value is about to change, compare with the value sent instead. */
+            if( ( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_DIRTY ) ||
+                ( pxEntry->_internal.usPendingValueLength != ulValueLength ) ||
+                ( memcmp( pxEntry->_internal.ucPendingValue, pucValue, ulValueLength ) != 0 ) )
+            {
+                memcpy( pxEntry->_internal.ucPendingValue, pucValue, ulValueLength );
+                pxEntry->_internal.usPendingValueLength = ( uint16_t ) ulValueLength;
+                pxEntry->_internal.usFlags |= azureiothubclientpropertiesCACHE_FLAG_DIRTY;
+            }
+        }
+        else if( ( pxEntry->_internal.usAckedValueLength == ulValueLength ) &&
+                 ( memcmp( pxEntry->_internal.ucAckedValue, pucValue, ulValueLength ) == 0 ) )
+        {
+            pxEntry->_internal.usFlags &= ( uint16_t ) ~azureiothubclientpropertiesCACHE_FLAG_DIRTY;
+        }
+        else
+        {
+            memcpy( pxEntry->_internal.ucPendingValue, pucValue, ulValueLength );
+            pxEntry->_internal.usPendingValueLength = ( uint16_t ) ulValueLength;
+            pxEntry->_internal.usFlags |= azureiothubclientpropertiesCACHE_FLAG_DIRTY;
+        }
+
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_SendReportedDelta( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                                uint8_t * pucPayloadBuffer,
+                                                                uint32_t ulPayloadBufferLength,
+                                                                uint32_t * pulRequestId )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTJSONWriter_t xJSONWriter;
+    AzureIoTHubClientPropertiesCacheEntry_t * pxEntry;
+    uint32_t ulRequestId = 0;
+    uint32_t ulDirtyCount = 0;
+    uint32_t ulIndex;
+    int32_t lPayloadLength;
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( pxCache == NULL ) ||
+        ( pucPayloadBuffer == NULL ) || ( ulPayloadBufferLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_SendReportedDelta failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( pxCache->_internal.ulInFlightRequestID != 0 )
+    {
+        AZLogWarn( ( "AzureIoTHubClientProperties_SendReportedDelta: request %u not acknowledged yet",
+                     ( unsigned int ) pxCache->_internal.ulInFlightRequestID ) );
+        xResult = eAzureIoTErrorPending;
+    }
+    else if( ( xResult = AzureIoTJSONWriter_Init( &xJSONWriter, pucPayloadBuffer, ulPayloadBufferLength ) ) != eAzureIoTSuccess )
+    {
+        AZLogError( ( "Failed to initialize JSON writer: error=0x%08x", xResult ) );
+    }
+    else if( ( xResult = AzureIoTJSONWriter_AppendBeginObject( &xJSONWriter ) ) != eAzureIoTSuccess )
+    {
+        AZLogError( ( "Failed to begin reported properties: error=0x%08x", xResult ) );
+    }
+    else
+    {
+        for( ulIndex = 0; ( ulIndex < pxCache->_internal.ulEntriesUsed ) && ( xResult == eAzureIoTSuccess ); ulIndex++ )
+        {
+            pxEntry = &pxCache->_internal.pxEntries[ ulIndex ];
+
+            if( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_DIRTY )
+            {
+                if( ( ( xResult = AzureIoTJSONWriter_AppendPropertyName( &xJSONWriter,
+                                                                         pxEntry->_internal.pucName,
+                                                                         pxEntry->_internal.usNameLength ) ) == eAzureIoTSuccess ) &&
+                    ( ( xResult = AzureIoTJSONWriter_AppendJSONText( &xJSONWriter,
+                                                                     pxEntry->_internal.ucPendingValue,
+                                                                     pxEntry->_internal.usPendingValueLength ) ) == eAzureIoTSuccess ) )
+                {
+                    ulDirtyCount++;
+                }
+            }
+        }
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Failed to append reported property: error=0x%08x", xResult ) );
+        }
+        else if( ulDirtyCount == 0 )
+        {
+            AZLogDebug( ( "No reported property changed" ) );
+        }
+        else if( ( xResult = AzureIoTJSONWriter_AppendEndObject( &xJSONWriter ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Failed to end reported properties: error=0x%08x", xResult ) );
+        }
+        else if( ( lPayloadLength = AzureIoTJSONWriter_GetBytesUsed( &xJSONWriter ) ) < 0 )
+        {
+            AZLogError( ( "Failed to get reported properties length" ) );
+            xResult = eAzureIoTErrorFailed;
+        }
+        else if( ( xResult = AzureIoTHubClient_SendPropertiesReported( pxAzureIoTHubClient,
+                                                                       pucPayloadBuffer,
+                                                                       ( uint32_t ) lPayloadLength,
+                                                                       &ulRequestId ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Failed to send reported properties delta: error=0x%08x", xResult ) );
+            ulRequestId = 0;
+        }
+        else
+        {
+            for( ulIndex = 0; ulIndex < pxCache->_internal.ulEntriesUsed; ulIndex++ )
+            {
+                pxEntry = &pxCache->_internal.pxEntries[ ulIndex ];
+
+                if( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_DIRTY )
+                {
+                    pxEntry->_internal.usFlags = azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT;
+                }
+            }
+
+            pxCache->_internal.ulInFlightRequestID = ulRequestId;
+        }
+    }
+
+    if( pulRequestId != NULL )
+    {
+        *pulRequestId = ulRequestId;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_CacheProcessResponse( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                                   const AzureIoTHubClientPropertiesResponse_t * pxResponse )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesCacheEntry_t * pxEntry;
+    bool xAccepted;
+    uint32_t ulIndex;
+
+    if( ( pxCache == NULL ) || ( pxResponse == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_CacheProcessResponse failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( pxResponse->xMessageType != eAzureIoTHubPropertiesReportedResponseMessage ) ||
+             ( pxCache->_internal.ulInFlightRequestID == 0 ) ||
+             ( pxResponse->ulRequestID != pxCache->_internal.ulInFlightRequestID ) )
+    {
+        xResult = eAzureIoTErrorItemNotFound;
+    }
+    else
+    {
+        xAccepted = ( pxResponse->xMessageStatus >= eAzureIoTStatusOk ) && ( pxResponse->xMessageStatus < eAzureIoTStatusBadRequest );
+
+        if( !xAccepted )
+        {
+            AZLogWarn( ( "Reported properties delta rejected: status=%d", ( int ) pxResponse->xMessageStatus ) );
+        }
+
+        for( ulIndex = 0; ulIndex < pxCache->_internal.ulEntriesUsed; ulIndex++ )
+        {
+            pxEntry = &pxCache->_internal.pxEntries[ ulIndex ];
+
+            if( ( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT ) == 0 )
+            {
+                continue;
+            }
+
+            if( !xAccepted )
+            {
+                pxEntry->_internal.usFlags |= azureiothubclientpropertiesCACHE_FLAG_DIRTY;
+            }
+            else if( pxEntry->_internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_DIRTY )
+            {
+                /* The value sent was overwritten meanwhile, so the acknowledged value is unknown. */
+                pxEntry->_internal.usAckedValueLength = 0;
+            }
+            else
+            {
+                memcpy( pxEntry->_internal.ucAckedValue, pxEntry->_internal.ucPendingValue,
+                        pxEntry->_internal.usPendingValueLength );
+                pxEntry->_internal.usAckedValueLength = pxEntry->_internal.usPendingValueLength;
+            }
+
+            pxEntry->_internal.usFlags &= ( uint16_t ) ~azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT;
+        }
+
+        pxCache->_internal.ulInFlightRequestID = 0;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_CacheCancelInFlight( AzureIoTHubClientPropertiesCache_t * pxCache )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulIndex;
+
+    if( pxCache == NULL )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_CacheCancelInFlight failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        for( ulIndex = 0; ulIndex < pxCache->_internal.ulEntriesUsed; ulIndex++ )
+        {
+            if( pxCache->_internal.pxEntries[ ulIndex ]._internal.usFlags & azureiothubclientpropertiesCACHE_FLAG_IN_FLIGHT )
+            {
+                pxCache->_internal.pxEntries[ ulIndex ]._internal.usFlags = azureiothubclientpropertiesCACHE_FLAG_DIRTY;
+            }
+        }
+
+        pxCache->_internal.ulInFlightRequestID = 0;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Length of a name or string once written by the JSON writer: quoted, with the characters
+ * JSON requires escaped.
+ *
+ * */
+static uint32_t prvJSONStringLength( const uint8_t * pucString,
+                                     uint32_t ulStringLength )
+{
+    uint32_t ulLength = 2;
+    uint32_t ulIndex;
+
+    for( ulIndex = 0; ulIndex < ulStringLength; ulIndex++ )
+    {
+        switch( pucString[ ulIndex ] )
+        {
+            case '"':
+            case '\\':
+            case '\b':
+            case '\f':
+            case '\n':
+            case '\r':
+            case '\t':
+                ulLength += 2;
+                break;
+
+            default:
+                /* Other control characters are written as \u00XX. */
+                ulLength += ( pucString[ ulIndex ] < 0x20 ) ? 6 : 1;
+                break;
+        }
+    }
+
+    return ulLength;
+}
+
+/**
+ *
+ * Length of an integer once written by the JSON writer.
+ *
+ * */
+static uint32_t prvJSONInt32Length( int32_t lValue )
+{
+    int64_t llValue = lValue;
+    uint32_t ulLength = 1;
+
+    if( llValue < 0 )
+    {
+        llValue = -llValue;
+        ulLength++;
+    }
+
+    while( llValue >= 10 )
+    {
+        llValue /= 10;
+        ulLength++;
+    }
+
+    return ulLength;
+}
+
+/**
+ *
+ * Longest length of a property written in a batch, with its name but without a separating comma.
+ * The value is counted as passed, the JSON writer may drop its insignificant whitespace.
+ *
+ * */
+static uint32_t prvBatchPropertyLength( const AzureIoTHubClientPropertiesBatchEntry_t * pxEntry )
+{
+    uint32_t ulLength = prvJSONStringLength( pxEntry->_internal.pucPropertyName,
+                                             pxEntry->_internal.usPropertyNameLength ) +
+                        1 + pxEntry->_internal.ulValueLength;
+
+    if( pxEntry->_internal.xIsResponseStatus )
+    {
+        ulLength += azureiothubclientpropertiesBATCH_LENGTH( "{\"ac\":,\"av\":,\"value\":}" ) +
+                    prvJSONInt32Length( pxEntry->_internal.lAckCode ) +
+                    prvJSONInt32Length( pxEntry->_internal.lAckVersion );
+
+        if( pxEntry->_internal.usAckDescriptionLength > 0 )
+        {
+            ulLength += azureiothubclientpropertiesBATCH_LENGTH( ",\"ad\":" ) +
+                        prvJSONStringLength( pxEntry->_internal.pucAckDescription,
+                                             pxEntry->_internal.usAckDescriptionLength );
+        }
+    }
+
+    return ulLength;
+}
+
+/**
+ *
+ * Whether two batch entries belong to the same component.
+ *
+ * */
+static bool prvBatchSameComponent( const AzureIoTHubClientPropertiesBatchEntry_t * pxEntry,
+                                   const AzureIoTHubClientPropertiesBatchEntry_t * pxOther )
+{
+    return ( pxEntry->_internal.usComponentNameLength == pxOther->_internal.usComponentNameLength ) &&
+           ( memcmp( pxEntry->_internal.pucComponentName, pxOther->_internal.pucComponentName,
+                     pxEntry->_internal.usComponentNameLength ) == 0 );
+}
+
+/**
+ *
+ * Add an entry to a batch and account for the bytes it adds to the payload.
+ *
+ * */
+static AzureIoTResult_t prvBatchAdd( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                     const AzureIoTHubClientPropertiesBatchEntry_t * pxNewEntry )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulLength = prvBatchPropertyLength( pxNewEntry );
+    bool xNewComponent = ( pxNewEntry->_internal.usComponentNameLength > 0 );
+    uint32_t ulIndex;
+
+    if( pxBatch->_internal.ulEntriesUsed == pxBatch->_internal.ulEntryCount )
+    {
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        for( ulIndex = 0; xNewComponent && ( ulIndex < pxBatch->_internal.ulEntriesUsed ); ulIndex++ )
+        {
+            xNewComponent = !prvBatchSameComponent( &pxBatch->_internal.pxEntries[ ulIndex ], pxNewEntry );
+        }
+
+        if( xNewComponent )
+        {
+            /* The property follows the "__t" marker of its component. */
+            ulLength += prvJSONStringLength( pxNewEntry->_internal.pucComponentName,
+                                             pxNewEntry->_internal.usComponentNameLength ) +
+                        azureiothubclientpropertiesBATCH_LENGTH( ":{\"__t\":\"c\",}" );
+        }
+
+        if( pxBatch->_internal.ulEntriesUsed > 0 )
+        {
+            /* Separated by a comma from the previous root property or component, or from the
+             * previous property of its component. */
+            ulLength++;
+        }
+
+        pxBatch->_internal.pxEntries[ pxBatch->_internal.ulEntriesUsed++ ] = *pxNewEntry;
+        pxBatch->_internal.ulPayloadLengthMax += ulLength;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Write one property of a batch, either as a plain value or as a response status.
+ *
+ * */
+static AzureIoTResult_t prvBatchWriteProperty( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                               AzureIoTJSONWriter_t * pxJSONWriter,
+                                               const AzureIoTHubClientPropertiesBatchEntry_t * pxEntry )
+{
+    AzureIoTResult_t xResult;
+
+    if( !pxEntry->_internal.xIsResponseStatus )
+    {
+        if( ( xResult = AzureIoTJSONWriter_AppendPropertyName( pxJSONWriter,
+                                                               pxEntry->_internal.pucPropertyName,
+                                                               pxEntry->_internal.usPropertyNameLength ) ) == eAzureIoTSuccess )
+        {
+            xResult = AzureIoTJSONWriter_AppendJSONText( pxJSONWriter,
+                                                         pxEntry->_internal.pucValue,
+                                                         pxEntry->_internal.ulValueLength );
+        }
+    }
+    else if( ( ( xResult = AzureIoTHubClientProperties_BuilderBeginResponseStatus( pxAzureIoTHubClient, pxJSONWriter,
+                                                                                   pxEntry->_internal.pucPropertyName,
+                                                                                   pxEntry->_internal.usPropertyNameLength,
+                                                                                   pxEntry->_internal.lAckCode,
+                                                                                   pxEntry->_internal.lAckVersion,
+                                                                                   pxEntry->_internal.pucAckDescription,
+                                                                                   pxEntry->_internal.usAckDescriptionLength ) ) == eAzureIoTSuccess ) &&
+             ( ( xResult = AzureIoTJSONWriter_AppendJSONText( pxJSONWriter,
+                                                              pxEntry->_internal.pucValue,
+                                                              pxEntry->_internal.ulValueLength ) ) == eAzureIoTSuccess ) )
+    {
+        xResult = AzureIoTHubClientProperties_BuilderEndResponseStatus( pxAzureIoTHubClient, pxJSONWriter );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_BatchInit( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                        AzureIoTHubClientPropertiesBatchEntry_t * pxEntries,
+                                                        uint32_t ulEntryCount )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxBatch == NULL ) || ( pxEntries == NULL ) || ( ulEntryCount == 0 ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_BatchInit failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( pxBatch, 0, sizeof( AzureIoTHubClientPropertiesBatch_t ) );
+        pxBatch->_internal.pxEntries = pxEntries;
+        pxBatch->_internal.ulEntryCount = ulEntryCount;
+        /* The enclosing object. */
+        pxBatch->_internal.ulPayloadLengthMax = azureiothubclientpropertiesBATCH_LENGTH( "{}" );
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_BatchAddProperty( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                               const uint8_t * pucComponentName,
+                                                               uint16_t usComponentNameLength,
+                                                               const uint8_t * pucPropertyName,
+                                                               uint16_t usPropertyNameLength,
+                                                               const uint8_t * pucValue,
+                                                               uint32_t ulValueLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesBatchEntry_t xEntry;
+
+    if( ( pxBatch == NULL ) ||
+        ( ( pucComponentName == NULL ) && ( usComponentNameLength != 0 ) ) ||
+        ( pucPropertyName == NULL ) || ( usPropertyNameLength == 0 ) ||
+        ( pucValue == NULL ) || ( ulValueLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_BatchAddProperty failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( &xEntry, 0, sizeof( xEntry ) );
+        xEntry._internal.pucComponentName = pucComponentName;
+        xEntry._internal.usComponentNameLength = usComponentNameLength;
+        xEntry._internal.pucPropertyName = pucPropertyName;
+        xEntry._internal.usPropertyNameLength = usPropertyNameLength;
+        xEntry._internal.pucValue = pucValue;
+        xEntry._internal.ulValueLength = ulValueLength;
+
+        if( ( xResult = prvBatchAdd( pxBatch, &xEntry ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "AzureIoTHubClientProperties_BatchAddProperty failed: no free batch entry" ) );
+        }
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_BatchAddResponseStatus( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                                     const uint8_t * pucComponentName,
+                                                                     uint16_t usComponentNameLength,
+                                                                     const uint8_t * pucPropertyName,
+                                                                     uint16_t usPropertyNameLength,
+                                                                     const uint8_t * pucValue,
+                                                                     uint32_t ulValueLength,
+                                                                     int32_t lAckCode,
+                                                                     int32_t lAckVersion,
+                                                                     const uint8_t * pucAckDescription,
+                                                                     uint16_t usAckDescriptionLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTHubClientPropertiesBatchEntry_t xEntry;
+
+    if( ( pxBatch == NULL ) ||
+        ( ( pucComponentName == NULL ) && ( usComponentNameLength != 0 ) ) ||
+        ( pucPropertyName == NULL ) || ( usPropertyNameLength == 0 ) ||
+        ( pucValue == NULL ) || ( ulValueLength == 0 ) ||
+        ( ( pucAckDescription == NULL ) && ( usAckDescriptionLength != 0 ) ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_BatchAddResponseStatus failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( &xEntry, 0, sizeof( xEntry ) );
+        xEntry._internal.pucComponentName = pucComponentName;
+        xEntry._internal.usComponentNameLength = usComponentNameLength;
+        xEntry._internal.pucPropertyName = pucPropertyName;
+        xEntry._internal.usPropertyNameLength = usPropertyNameLength;
+        xEntry._internal.pucValue = pucValue;
+        xEntry._internal.ulValueLength = ulValueLength;
+        xEntry._internal.xIsResponseStatus = true;
+        xEntry._internal.lAckCode = lAckCode;
+        xEntry._internal.lAckVersion = lAckVersion;
+        xEntry._internal.pucAckDescription = pucAckDescription;
+        xEntry._internal.usAckDescriptionLength = usAckDescriptionLength;
+
+        if( ( xResult = prvBatchAdd( pxBatch, &xEntry ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "AzureIoTHubClientProperties_BatchAddResponseStatus failed: no free batch entry" ) );
+        }
+    }
+
+    return xResult;
+}
+
+uint32_t AzureIoTHubClientProperties_BatchGetPayloadLengthMax( const AzureIoTHubClientPropertiesBatch_t * pxBatch )
+{
+    return ( pxBatch == NULL ) ? 0 : pxBatch->_internal.ulPayloadLengthMax;
+}
+
+AzureIoTResult_t AzureIoTHubClientProperties_BatchWrite( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                         const AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                         uint8_t * pucPayloadBuffer,
+                                                         uint32_t ulPayloadBufferLength,
+                                                         uint32_t * pulPayloadLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTJSONWriter_t xJSONWriter;
+    const AzureIoTHubClientPropertiesBatchEntry_t * pxEntry;
+    bool xWritten;
+    uint32_t ulIndex;
+    uint32_t ulOther;
+    int32_t lPayloadLength;
+
+    if( ( pxAzureIoTHubClient == NULL ) || ( pxBatch == NULL ) ||
+        ( pucPayloadBuffer == NULL ) || ( pulPayloadLength == NULL ) )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_BatchWrite failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ulPayloadBufferLength < pxBatch->_internal.ulPayloadLengthMax )
+    {
+        AZLogError( ( "AzureIoTHubClientProperties_BatchWrite failed: payload needs up to %u bytes, buffer has %u",
+                      ( unsigned int ) pxBatch->_internal.ulPayloadLengthMax, ( unsigned int ) ulPayloadBufferLength ) );
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else if( ( ( xResult = AzureIoTJSONWriter_Init( &xJSONWriter, pucPayloadBuffer, ulPayloadBufferLength ) ) != eAzureIoTSuccess ) ||
+             ( ( xResult = AzureIoTJSONWriter_AppendBeginObject( &xJSONWriter ) ) != eAzureIoTSuccess ) )
+    {
+        AZLogError( ( "Failed to begin reported properties: error=0x%08x", xResult ) );
+    }
+    else
+    {
+        for( ulIndex = 0; ( ulIndex < pxBatch->_internal.ulEntriesUsed ) && ( xResult == eAzureIoTSuccess ); ulIndex++ )
+        {
+            pxEntry = &pxBatch->_internal.pxEntries[ ulIndex ];
+
+            if( pxEntry->_internal.usComponentNameLength == 0 )
+            {
+                xResult = prvBatchWriteProperty( pxAzureIoTHubClient, &xJSONWriter, pxEntry );
+            }
+            else
+            {
+                /* A component is written in full where its first property was added. */
+                for( xWritten = false, ulOther = 0; ( ulOther < ulIndex ) && !xWritten; ulOther++ )
+                {
+                    xWritten = prvBatchSameComponent( &pxBatch->_internal.pxEntries[ ulOther ], pxEntry );
+                }
+
+                if( !xWritten )
+                {
+                    xResult = AzureIoTHubClientProperties_BuilderBeginComponent( pxAzureIoTHubClient, &xJSONWriter,
+                                                                                 pxEntry->_internal.pucComponentName,
+                                                                                 pxEntry->_internal.usComponentNameLength );
+
+                    for( ulOther = ulIndex; ( ulOther < pxBatch->_internal.ulEntriesUsed ) && ( xResult == eAzureIoTSuccess ); ulOther++ )
+                    {
+                        if( prvBatchSameComponent( &pxBatch->_internal.pxEntries[ ulOther ], pxEntry ) )
+                        {
+                            xResult = prvBatchWriteProperty( pxAzureIoTHubClient, &xJSONWriter,
+                                                             &pxBatch->_internal.pxEntries[ ulOther ] );
+                        }
+                    }
+
+                    if( xResult == eAzureIoTSuccess )
+                    {
+                        xResult = AzureIoTHubClientProperties_BuilderEndComponent( pxAzureIoTHubClient, &xJSONWriter );
+                    }
+                }
+            }
+        }
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Failed to write reported properties batch: error=0x%08x", xResult ) );
+        }
+        else if( ( xResult = AzureIoTJSONWriter_AppendEndObject( &xJSONWriter ) ) != eAzureIoTSuccess )
+        {
+            AZLogError( ( "Failed to end reported properties: error=0x%08x", xResult ) );
+        }
+        else if( ( lPayloadLength = AzureIoTJSONWriter_GetBytesUsed( &xJSONWriter ) ) < 0 )
+        {
+            AZLogError( ( "Failed to get reported properties length" ) );
+            xResult = eAzureIoTErrorFailed;
+        }
+        else
+        {
+            *pulPayloadLength = ( uint32_t ) lPayloadLength;
+        }
+    }
+
+    return xResult;
+}
@@ -10,10 +10,213 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "azure_iot.h"
 #include "azure_iot_private.h"
 
+/* Maximum number of fractional digits honored, matching the embedded SDK. */
+#define azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS    ( 15 )
+
+/* Largest magnitude (2^53) for which the whole part of a double is exact as an integer. */
+#define azureiotjsonwriterDOUBLE_MAX_EXACT_INTEGER        ( 9007199254740992.0 )
+
+/* Sign, 16 whole digits, decimal point and 15 fractional digits. */
+#define azureiotjsonwriterDOUBLE_TEXT_MAX                 ( 1 + 16 + 1 + azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS )
+
+/* Output of counting writers. It is never read, so all of them share it. */
+static uint8_t ucCountingChunk[ azureiotjsonwriterCOUNTING_CHUNK_SIZE ];
+
+static const uint64_t ullPowersOf10[ azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS + 1 ] =
+{
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL
+};
+
+/**
+ *
+ * Format a double with a fixed number of fractional digits using only integer arithmetic
+ * after a single scaling multiply, and append it as a JSON number.
+ *
+ * The output matches az_json_writer_append_double(): the fractional part is truncated and
+ * non-significant trailing zeros are dropped. Values that are not finite or whose whole
+ * part cannot be represented exactly fall back to the embedded SDK routine.
+ *
+ * */
+static az_result prvAppendDouble( az_json_writer * pxCoreWriter,
+                                  double xValue,
+                                  uint16_t usFractionalDigits )
+{
+    uint8_t ucText[ azureiotjsonwriterDOUBLE_TEXT_MAX ];
+    uint8_t ucDigits[ azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS + 1 ];
+    double xMagnitude = ( xValue < 0.0 ) ? -xValue : xValue;
+    uint64_t ullWhole;
+    uint64_t ullFraction;
+    uint32_t ulDigitCount;
+    uint32_t ulTextLength = 0;
+    az_result xCoreResult;
+
+    if( usFractionalDigits > azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS )
+    {
+        usFractionalDigits = azureiotjsonwriterDOUBLE_MAX_FRACTIONAL_DIGITS;
+    }
+
+    /* Also rejects NaN, for which every comparison is false. */
+    if( !( xMagnitude < azureiotjsonwriterDOUBLE_MAX_EXACT_INTEGER ) )
+    {
+        xCoreResult = az_json_writer_append_double( pxCoreWriter, xValue, ( int32_t ) usFractionalDigits );
+    }
+    else
+    {
+        ullWhole = ( uint64_t ) xMagnitude;
+        ullFraction = ( uint64_t ) ( ( xMagnitude - ( double ) ullWhole ) *
+                                     ( double ) ullPowersOf10[ usFractionalDigits ] );
+
+        /* Drop non-significant trailing zeros of the fraction. */
+        while( ( usFractionalDigits > 0 ) && ( ( ullFraction % 10U ) == 0U ) )
+        {
+            ullFraction /= 10U;
+            usFractionalDigits--;
+        }
+
+        if( ( xValue < 0.0 ) && ( ( ullWhole != 0U ) || ( usFractionalDigits > 0 ) ) )
+        {
+            ucText[ ulTextLength++ ] = '-';
+        }
+
+        ulDigitCount = 0;
+
+        do
+        {
+            ucDigits[ ulDigitCount++ ] = ( uint8_t ) ( '0' + ( ullWhole % 10U ) );
+            ullWhole /= 10U;
+        } while( ullWhole != 0U );
+
+        while( ulDigitCount > 0 )
+        {
+            ucText[ ulTextLength++ ] = ucDigits[ --ulDigitCount ];
+        }
+
+        if( usFractionalDigits > 0 )
+        {
+            ucText[ ulTextLength++ ] = '.';
+
+            /* Fill right to left so leading zeros of the fraction are kept. */
+            for( ulDigitCount = usFractionalDigits; ulDigitCount > 0; ulDigitCount-- )
+            {
+                ucText[ ulTextLength + ulDigitCount - 1 ] = ( uint8_t ) ( '0' + ( ullFraction % 10U ) );
+                ullFraction /= 10U;
+            }
+
+            ulTextLength += usFractionalDigits;
+        }
+
+        xCoreResult = az_json_writer_append_json_text( pxCoreWriter, az_span_create( ucText, ( int32_t ) ulTextLength ) );
+    }
+
+    return xCoreResult;
+}
+
+/**
+ *
+ * Pass the bytes of the chunk not flushed yet to the flush callback. Counting writers only count them.
+ *
+ * */
+static AzureIoTResult_t prvFlushChunk( AzureIoTJSONWriter_t * pxWriter,
+                                       uint32_t ulChunkBytesUsed )
+{
+    AzureIoTResult_t xResult = eAzureIoTSuccess;
+    uint32_t ulLength = ulChunkBytesUsed - pxWriter->_internal.ulChunkBytesFlushed;
+
+    if( ( pxWriter->_internal.xFlush != NULL ) && ( ulLength > 0 ) )
+    {
+        xResult = pxWriter->_internal.xFlush( pxWriter->_internal.pvFlushContext,
+                                              pxWriter->_internal.pucChunk + pxWriter->_internal.ulChunkBytesFlushed,
+                                              ulLength );
+    }
+
+    if( xResult == eAzureIoTSuccess )
+    {
+        pxWriter->_internal.ulBytesFlushed += ulLength;
+        pxWriter->_internal.ulChunkBytesFlushed = ulChunkBytesUsed;
+    }
+
+    return xResult;
+}
+
+/**
+ *
+ * Hand the chunk back to the core writer once its content was flushed.
+ *
+ * */
+static az_result prvChunkAllocator( az_span_allocator_context * pxAllocatorContext,
+                                    az_span * pxNextDestination )
+{
+    AzureIoTJSONWriter_t * pxWriter = ( AzureIoTJSONWriter_t * ) pxAllocatorContext->user_context;
+
+    if( ( pxAllocatorContext->minimum_required_size > ( int32_t ) pxWriter->_internal.ulChunkLength ) ||
+        ( prvFlushChunk( pxWriter, ( uint32_t ) pxAllocatorContext->bytes_used ) != eAzureIoTSuccess ) )
+    {
+        return AZ_ERROR_NOT_ENOUGH_SPACE;
+    }
+
+    pxWriter->_internal.ulChunkBytesFlushed = 0;
+    *pxNextDestination = az_span_create( pxWriter->_internal.pucChunk, ( int32_t ) pxWriter->_internal.ulChunkLength );
+
+    return AZ_OK;
+}
+
+/**
+ *
+ * Set up the core writer to write through a chunk.
+ *
+ * */
+static AzureIoTResult_t prvInitChunked( AzureIoTJSONWriter_t * pxWriter,
+                                        uint8_t * pucChunk,
+                                        uint32_t ulChunkSize,
+                                        AzureIoTJSONWriterFlush_t xFlush,
+                                        void * pvFlushContext )
+{
+    AzureIoTResult_t xResult;
+    az_result xCoreResult;
+
+    pxWriter->_internal.ulBytesFlushed = 0;
+    pxWriter->_internal.pucChunk = pucChunk;
+    pxWriter->_internal.ulChunkLength = ulChunkSize;
+    pxWriter->_internal.ulChunkBytesFlushed = 0;
+    pxWriter->_internal.xFlush = xFlush;
+    pxWriter->_internal.pvFlushContext = pvFlushContext;
+
+    if( az_result_failed(
+            xCoreResult = az_json_writer_chunked_init( &pxWriter->_internal.xCoreWriter,
+                                                       az_span_create( pucChunk, ( int32_t ) ulChunkSize ),
+                                                       prvChunkAllocator, pxWriter, NULL ) ) )
+    {
+        AZLogError( ( "Could not initialize the JSON writer: core error=0x%08x", xCoreResult ) );
+        xResult = AzureIoT_TranslateCoreError( xCoreResult );
+    }
+    else
+    {
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+
 AzureIoTResult_t AzureIoTJSONWriter_Init( AzureIoTJSONWriter_t * pxWriter,
                                           uint8_t * pucBuffer,
                                           uint32_t ulBufferSize )
@@ -22,13 +225,18 @@ AzureIoTResult_t AzureIoTJSONWriter_Init( AzureIoTJSONWriter_t * pxWriter,
     az_result xCoreResult;
     az_span xJSONSpan;
 
-    if( ( pxWriter == NULL ) || ( pucBuffer == NULL ) || ( ulBufferSize == 0 ) )
+    if( ( pxWriter == NULL ) || ( ( pucBuffer == NULL ) != ( ulBufferSize == 0 ) ) )
     {
         AZLogError( ( "AzureIoTJSONWriter_Init failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
+    else if( pucBuffer == NULL )
+    {
+        xResult = prvInitChunked( pxWriter, ucCountingChunk, ( uint32_t ) sizeof( ucCountingChunk ), NULL, NULL );
+    }
     else
     {
+        memset( &pxWriter->_internal, 0, sizeof( pxWriter->_internal ) );
         xJSONSpan = az_span_create( ( uint8_t * ) pucBuffer, ( int32_t ) ulBufferSize );
 
         if( az_result_failed( xCoreResult = az_json_writer_init( &pxWriter->_internal.xCoreWriter, xJSONSpan, NULL ) ) )
@@ -45,6 +253,46 @@ AzureIoTResult_t AzureIoTJSONWriter_Init( AzureIoTJSONWriter_t * pxWriter,
     return xResult;
 }
 
+AzureIoTResult_t AzureIoTJSONWriter_InitChunked( AzureIoTJSONWriter_t * pxWriter,
+                                                 uint8_t * pucChunk,
+                                                 uint32_t ulChunkSize,
+                                                 AzureIoTJSONWriterFlush_t xFlush,
+                                                 void * pvFlushContext )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( pucChunk == NULL ) ||
+        ( ulChunkSize < azureiotjsonwriterCHUNK_SIZE_MIN ) || ( xFlush == NULL ) )
+    {
+        AZLogError( ( "AzureIoTJSONWriter_InitChunked failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        xResult = prvInitChunked( pxWriter, pucChunk, ulChunkSize, xFlush, pvFlushContext );
+    }
+
+    return xResult;
+}
+
+AzureIoTResult_t AzureIoTJSONWriter_Flush( AzureIoTJSONWriter_t * pxWriter )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxWriter == NULL ) || ( pxWriter->_internal.xFlush == NULL ) )
+    {
+        AZLogError( ( "AzureIoTJSONWriter_Flush failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( xResult = prvFlushChunk( pxWriter,
+                                        ( uint32_t ) az_span_size( az_json_writer_get_bytes_used_in_destination( &pxWriter->_internal.xCoreWriter ) ) ) ) != eAzureIoTSuccess )
+    {
+        AZLogError( ( "Failed to flush JSON text: error=0x%08x", xResult ) );
+    }
+
+    return xResult;
+}
+
 AzureIoTResult_t AzureIoTJSONWriter_AppendPropertyWithInt32Value( AzureIoTJSONWriter_t * pxWriter,
                                                                   const uint8_t * pucPropertyName,
                                                                   uint32_t ulPropertyNameLength,
@@ -98,7 +346,7 @@ AzureIoTResult_t AzureIoTJSONWriter_AppendPropertyWithDoubleValue( AzureIoTJSONW
         xPropertyNameSpan = az_span_create( ( uint8_t * ) pucPropertyName, ( int32_t ) ulPropertyNameLength );
 
         if( az_result_failed( xCoreResult = az_json_writer_append_property_name( &pxWriter->_internal.xCoreWriter, xPropertyNameSpan ) ) ||
-            az_result_failed( xCoreResult = az_json_writer_append_double( &pxWriter->_internal.xCoreWriter, xValue, ( int32_t ) usFractionalDigits ) ) )
+            az_result_failed( xCoreResult = prvAppendDouble( &pxWriter->_internal.xCoreWriter, xValue, usFractionalDigits ) ) )
         {
             AZLogError( ( "Could not append property and double: core error=0x%08x", xCoreResult ) );
             xResult = AzureIoT_TranslateCoreError( xCoreResult );
@@ -190,7 +438,8 @@ int32_t AzureIoTJSONWriter_GetBytesUsed( AzureIoTJSONWriter_t * pxWriter )
         return -1;
     }
 
-    return az_span_size( az_json_writer_get_bytes_used_in_destination( &pxWriter->_internal.xCoreWriter ) );
+    return ( int32_t ) ( pxWriter->_internal.ulBytesFlushed - pxWriter->_internal.ulChunkBytesFlushed ) +
+           az_span_size( az_json_writer_get_bytes_used_in_destination( &pxWriter->_internal.xCoreWriter ) );
 }
 
 AzureIoTResult_t AzureIoTJSONWriter_AppendString( AzureIoTJSONWriter_t * pxWriter,
@@ -354,7 +603,7 @@ AzureIoTResult_t AzureIoTJSONWriter_AppendDouble( AzureIoTJSONWriter_t * pxWrite
     }
     else
     {
-        if( az_result_failed( xCoreResult = az_json_writer_append_double( &pxWriter->_internal.xCoreWriter, xValue, usFractionalDigits ) ) )
+        if( az_result_failed( xCoreResult = prvAppendDouble( &pxWriter->_internal.xCoreWriter, xValue, usFractionalDigits ) ) )
         {
             AZLogError( ( "Could not append double: core error=0x%08x", xCoreResult ) );
             xResult = AzureIoT_TranslateCoreError( xCoreResult );
@@ -10,6 +10,59 @@
 
 #include "azure_iot_message.h"
 
+#include <string.h>
+
+#include "azure_iot_private.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Hash a property name. Zero is reserved to mark an empty slot.
+ *
+ * */
+static uint32_t prvPropertyNameHash( const uint8_t * pucName,
+                                     uint32_t ulNameLength )
+{
+    uint32_t ulHash = AzureIoT_FNV1aHash( azureiotFNV_OFFSET_BASIS, pucName, ulNameLength );
+
+    return ( ulHash == 0 ) ? 1 : ulHash;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Find the slot holding the name, or the empty slot where it would go. Returns NULL
+ * if every slot is taken by another name.
+ *
+ * */
+static AzureIoTMessagePropertiesIndexEntry_t * prvPropertiesIndexSlot( const AzureIoTMessagePropertiesIndex_t * pxIndex,
+                                                                        const uint8_t * pucName,
+                                                                        uint32_t ulNameLength,
+                                                                        uint32_t ulHash )
+{
+    AzureIoTMessagePropertiesIndexEntry_t * pxEntry;
+    AzureIoTMessagePropertiesIndexEntry_t * pxSlot = NULL;
+    uint32_t ulSlot = ulHash % pxIndex->_internal.ulEntryCount;
+    uint32_t ulProbes;
+
+    for( ulProbes = 0; ( pxSlot == NULL ) && ( ulProbes < pxIndex->_internal.ulEntryCount ); ulProbes++ )
+    {
+        pxEntry = &pxIndex->_internal.pxEntries[ ulSlot ];
+
+        if( ( pxEntry->_internal.ulHash == 0 ) ||
+            ( ( pxEntry->_internal.ulHash == ulHash ) &&
+              ( pxEntry->_internal.ulNameLength == ulNameLength ) &&
+              ( memcmp( pxEntry->_internal.pucName, pucName, ulNameLength ) == 0 ) ) )
+        {
+            pxSlot = pxEntry;
+        }
+
+        ulSlot = ( ulSlot + 1 ) % pxIndex->_internal.ulEntryCount;
+    }
+
+    return pxSlot;
+}
 /*-----------------------------------------------------------*/
 
 AzureIoTResult_t AzureIoTMessage_PropertiesInit( AzureIoTMessageProperties_t * pxMessageProperties,
@@ -101,3 +154,107 @@ AzureIoTResult_t AzureIoTMessage_PropertiesFind( AzureIoTMessageProperties_t * p
     return eAzureIoTSuccess;
 }
 /*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTMessage_PropertiesIndexBuild( AzureIoTMessageProperties_t * pxMessageProperties,
+                                                       AzureIoTMessagePropertiesIndex_t * pxIndex,
+                                                       AzureIoTMessagePropertiesIndexEntry_t * pxEntries,
+                                                       uint32_t ulEntryCount )
+{
+    az_iot_message_properties xCursor;
+    AzureIoTMessagePropertiesIndexEntry_t * pxEntry;
+    az_span xNameSpan;
+    az_span xValueSpan;
+    AzureIoTResult_t xResult;
+    az_result xCoreResult;
+    uint32_t ulHash;
+
+    if( ( pxMessageProperties == NULL ) || ( pxIndex == NULL ) ||
+        ( pxEntries == NULL ) || ( ulEntryCount == 0 ) )
+    {
+        AZLogError( ( "AzureIoTMessage_PropertiesIndexBuild failed: Invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        memset( pxEntries, 0, sizeof( AzureIoTMessagePropertiesIndexEntry_t ) * ulEntryCount );
+        pxIndex->_internal.pxEntries = pxEntries;
+        pxIndex->_internal.ulEntryCount = ulEntryCount;
+        xResult = eAzureIoTSuccess;
+
+        /* Walk a private cursor so the iteration state of the caller's bag is left alone. */
+        xCoreResult = az_iot_message_properties_init( &xCursor,
+                                                      pxMessageProperties->_internal.xProperties._internal.properties_buffer,
+                                                      pxMessageProperties->_internal.xProperties._internal.properties_written );
+
+        while( ( xResult == eAzureIoTSuccess ) && !az_result_failed( xCoreResult ) &&
+               !az_result_failed( xCoreResult = az_iot_message_properties_next( &xCursor, &xNameSpan, &xValueSpan ) ) )
+        {
+            ulHash = prvPropertyNameHash( az_span_ptr( xNameSpan ), ( uint32_t ) az_span_size( xNameSpan ) );
+
+            if( ( pxEntry = prvPropertiesIndexSlot( pxIndex, az_span_ptr( xNameSpan ),
+                                                    ( uint32_t ) az_span_size( xNameSpan ), ulHash ) ) == NULL )
+            {
+                AZLogError( ( "AzureIoTMessage_PropertiesIndexBuild failed: more properties than index entries" ) );
+                xResult = eAzureIoTErrorOutOfMemory;
+            }
+            /* Keep the first occurrence, matching AzureIoTMessage_PropertiesFind. */
+            else if( pxEntry->_internal.ulHash == 0 )
+            {
+                pxEntry->_internal.pucName = az_span_ptr( xNameSpan );
+                pxEntry->_internal.ulNameLength = ( uint32_t ) az_span_size( xNameSpan );
+                pxEntry->_internal.pucValue = az_span_ptr( xValueSpan );
+                pxEntry->_internal.ulValueLength = ( uint32_t ) az_span_size( xValueSpan );
+                pxEntry->_internal.ulHash = ulHash;
+            }
+        }
+
+        if( ( xResult == eAzureIoTSuccess ) && ( xCoreResult != AZ_ERROR_IOT_END_OF_PROPERTIES ) )
+        {
+            AZLogError( ( "AzureIoTMessage_PropertiesIndexBuild failed: core error=0x%08x", xCoreResult ) );
+            xResult = AzureIoT_TranslateCoreError( xCoreResult );
+        }
+
+        if( xResult != eAzureIoTSuccess )
+        {
+            /* A partial index would silently miss properties, leave it unusable instead. */
+            pxIndex->_internal.pxEntries = NULL;
+            pxIndex->_internal.ulEntryCount = 0;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTMessage_PropertiesIndexFind( const AzureIoTMessagePropertiesIndex_t * pxIndex,
+                                                      const uint8_t * pucName,
+                                                      uint32_t ulNameLength,
+                                                      const uint8_t ** ppucOutValue,
+                                                      uint32_t * pulOutValueLength )
+{
+    AzureIoTMessagePropertiesIndexEntry_t * pxEntry;
+    AzureIoTResult_t xResult;
+
+    if( ( pxIndex == NULL ) || ( pxIndex->_internal.pxEntries == NULL ) ||
+        ( pucName == NULL ) || ( ulNameLength == 0 ) ||
+        ( ppucOutValue == NULL ) || ( pulOutValueLength == NULL ) )
+    {
+        AZLogError( ( "AzureIoTMessage_PropertiesIndexFind failed: Invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( ( ( pxEntry = prvPropertiesIndexSlot( pxIndex, pucName, ulNameLength,
+                                                   prvPropertyNameHash( pucName, ulNameLength ) ) ) == NULL ) ||
+             ( pxEntry->_internal.ulHash == 0 ) )
+    {
+        xResult = eAzureIoTErrorItemNotFound;
+    }
+    else
+    {
+        *ppucOutValue = pxEntry->_internal.pucValue;
+        *pulOutValueLength = pxEntry->_internal.ulValueLength;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
@@ -5,11 +5,34 @@
 #define AZURE_IOT_PRIVATE_H
 
 #include "azure_iot_result.h"
+#include "azure_iot_stack_profile.h"
 
 /* Azure SDK for Embedded C includes */
 #include "azure/az_core.h"
 #include "azure/core/_az_cfg_prefix.h"
 
+/* Using SHA256 hash - needs 32 bytes */
+#define azureiotBASE64_HASH_BUFFER_SIZE    ( 33 )
+
+/* 32-bit FNV-1a hashing constants, see AzureIoT_FNV1aHash(). */
+#define azureiotFNV_OFFSET_BASIS           ( 2166136261U )
+#define azureiotFNV_PRIME                  ( 16777619U )
+
+/*
+ * Stack profiling of the instrumented calls, see azure_iot_stack_profile.h.
+ * azureiotSTACK_PROFILE_BEGIN() must follow the declarations of the function
+ * and azureiotSTACK_PROFILE_END() precede its single return.
+ */
+#if azureiotconfigSTACK_PROFILING
+    #define azureiotSTACK_PROFILE_BEGIN()               \
+    AzureIoTStackProfileFrame_t xStackProfileFrame;     \
+    AzureIoTStackProfile_Begin( &xStackProfileFrame )
+    #define azureiotSTACK_PROFILE_END( xEntry )    AzureIoTStackProfile_End( &xStackProfileFrame, ( xEntry ) )
+#else
+    #define azureiotSTACK_PROFILE_BEGIN()
+    #define azureiotSTACK_PROFILE_END( xEntry )
+#endif /* azureiotconfigSTACK_PROFILING */
+
 /**
  * @brief Translate embedded errors to middleware errors
  *
@@ -48,6 +71,28 @@ AzureIoTResult_t AzureIoT_Base64HMACCalculate( AzureIoTGetHMACFunc_t xAzureIoTHM
                                                uint32_t ulOutputSize,
                                                uint32_t * pulOutputLength );
 
+/**
+ * @brief Continue a 32-bit FNV-1a hash over a buffer.
+ *
+ * @param[in] ulHash The hash so far, #azureiotFNV_OFFSET_BASIS to start a new one.
+ * @param[in] pucData The bytes to hash.
+ * @param[in] ulDataLength The length of \p pucData.
+ *
+ * @result The hash including \p pucData.
+ */
+uint32_t AzureIoT_FNV1aHash( uint32_t ulHash,
+                             const uint8_t * pucData,
+                             uint32_t ulDataLength );
+
+/**
+ * @brief Advance a xorshift32 state and return it, to spread retries and renewals of devices apart.
+ *
+ * @param[in,out] pulState The state to advance, which must not be zero.
+ *
+ * @result The next pseudo random value.
+ */
+uint32_t AzureIoT_NextJitter( uint32_t * pulState );
+
 #include "azure/core/_az_cfg_suffix.h"
 
 #endif /* AZURE_IOT_PRIVATE_H */
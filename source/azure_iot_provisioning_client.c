@@ -53,12 +53,40 @@
 #define azureiotprovisioningWF_STATE_WAITING        ( 0x7 )
 #define azureiotprovisioningWF_STATE_COMPLETE       ( 0x8 )
 
-#define azureiotPrvGetMaxInt( a, b )    ( ( a ) > ( b ) ? ( a ) : ( b ) )
-
 #define azureiotprovisioningREQUEST_PAYLOAD_LABEL            "payload"
 #define azureiotprovisioningREQUEST_REGISTRATION_ID_LABEL    "registrationId"
 
 #define azureiotprovisioningHMACBufferLength                 ( 48 )
+
+/* Layout of a saved result, all integers little endian:
+ * magic (4) | version (1) | reserved (1) | hostname length (2) | device ID length (2) |
+ * configuration hash (4) | hostname | device ID | checksum (4) */
+#define azureiotprovisioningSAVED_RESULT_MAGIC               ( 0x52505A41U ) /* "AZPR" */
+#define azureiotprovisioningSAVED_RESULT_VERSION             ( 1U )
+#define azureiotprovisioningSAVED_RESULT_HEADER_SIZE         ( 14U )
+#define azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE       ( 4U )
+
+/* Largest retry-after hint honored, so that it converts to milliseconds without overflow. */
+#define azureiotprovisioningRETRY_AFTER_MAX_S                ( 24U * 60U * 60U )
+/*-----------------------------------------------------------*/
+
+/**
+ * Get number of millseconds passed to MQTT stack
+ *
+ */
+static uint32_t prvProvClientGetTimeMillseconds( void )
+{
+    TickType_t xTickCount = 0;
+    uint32_t ulTimeMs = 0UL;
+
+    /* Get the current tick count. */
+    xTickCount = xTaskGetTickCount();
+
+    /* Convert the ticks to milliseconds. */
+    ulTimeMs = ( uint32_t ) xTickCount * azureiotMILLISECONDS_PER_TICK;
+
+    return ulTimeMs;
+}
 /*-----------------------------------------------------------*/
 
 /**
@@ -144,7 +172,7 @@ static void prvProvClientUpdateState( AzureIoTProvisioningClient_t * pxAzureProv
  * */
 static void prvProvClientConnect( AzureIoTProvisioningClient_t * pxAzureProvClient )
 {
-    AzureIoTMQTTConnectInfo_t xConnectInfo = { 0 };
+    AzureIoTMQTTConnectInfo_t * pxConnectInfo = &pxAzureProvClient->_internal.xSendScratch.xConnectInfo;
     AzureIoTResult_t xResult;
     AzureIoTMQTTResult_t xMQTTResult;
     bool xSessionPresent;
@@ -159,12 +187,13 @@ static void prvProvClientConnect( AzureIoTProvisioningClient_t * pxAzureProvClie
         return;
     }
 
-    xConnectInfo.pcUserName = pxAzureProvClient->_internal.pucScratchBuffer;
-    xConnectInfo.pcPassword = xConnectInfo.pcUserName + azureiotconfigUSERNAME_MAX;
+    memset( pxConnectInfo, 0, sizeof( AzureIoTMQTTConnectInfo_t ) );
+    pxConnectInfo->pcUserName = pxAzureProvClient->_internal.pucScratchBuffer;
+    pxConnectInfo->pcPassword = pxConnectInfo->pcUserName + azureiotconfigUSERNAME_MAX;
 
     if( az_result_failed(
             xCoreResult = az_iot_provisioning_client_get_user_name( &pxAzureProvClient->_internal.xProvisioningClientCore,
-                                                                    ( char * ) xConnectInfo.pcUserName,
+                                                                    ( char * ) pxConnectInfo->pcUserName,
                                                                     azureiotconfigUSERNAME_MAX, &xMQTTUsernameLength ) ) )
     {
         AZLogError( ( "AzureIoTProvisioning failed to get username: core error=0x%08x", xCoreResult ) );
@@ -177,7 +206,7 @@ static void prvProvClientConnect( AzureIoTProvisioningClient_t * pxAzureProvClie
                                                             azureiotprovisioningDEFAULT_TOKEN_TIMEOUT_IN_SEC,
                                                             pxAzureProvClient->_internal.pucSymmetricKey,
                                                             pxAzureProvClient->_internal.ulSymmetricKeyLength,
-                                                            ( uint8_t * ) xConnectInfo.pcPassword,
+                                                            ( uint8_t * ) pxConnectInfo->pcPassword,
                                                             azureiotconfigPASSWORD_MAX,
                                                             &ulPasswordLength ) ) )
     {
@@ -186,15 +215,15 @@ static void prvProvClientConnect( AzureIoTProvisioningClient_t * pxAzureProvClie
     }
     else
     {
-        xConnectInfo.xCleanSession = true;
-        xConnectInfo.pcClientIdentifier = pxAzureProvClient->_internal.pucRegistrationID;
-        xConnectInfo.usClientIdentifierLength = ( uint16_t ) pxAzureProvClient->_internal.ulRegistrationIDLength;
-        xConnectInfo.usUserNameLength = ( uint16_t ) xMQTTUsernameLength;
-        xConnectInfo.usKeepAliveSeconds = azureiotprovisioningKEEP_ALIVE_TIMEOUT_SECONDS;
-        xConnectInfo.usPasswordLength = ( uint16_t ) ulPasswordLength;
+        pxConnectInfo->xCleanSession = true;
+        pxConnectInfo->pcClientIdentifier = pxAzureProvClient->_internal.pucRegistrationID;
+        pxConnectInfo->usClientIdentifierLength = ( uint16_t ) pxAzureProvClient->_internal.ulRegistrationIDLength;
+        pxConnectInfo->usUserNameLength = ( uint16_t ) xMQTTUsernameLength;
+        pxConnectInfo->usKeepAliveSeconds = azureiotprovisioningKEEP_ALIVE_TIMEOUT_SECONDS;
+        pxConnectInfo->usPasswordLength = ( uint16_t ) ulPasswordLength;
 
         if( ( xMQTTResult = AzureIoTMQTT_Connect( &( pxAzureProvClient->_internal.xMQTTContext ),
-                                                  &xConnectInfo, NULL, azureiotprovisioningCONNACK_RECV_TIMEOUT_MS,
+                                                  pxConnectInfo, NULL, azureiotprovisioningCONNACK_RECV_TIMEOUT_MS,
                                                   &xSessionPresent ) ) != eAzureIoTMQTTSuccess )
         {
             AZLogError( ( "AzureIoTProvisioning failed to establish MQTT connection: Server=%.*s, MQTT error=0x%08x",
@@ -209,6 +238,7 @@ static void prvProvClientConnect( AzureIoTProvisioningClient_t * pxAzureProvClie
             AZLogInfo( ( "AzureIoTProvisioning established an MQTT connection with %.*s",
                          pxAzureProvClient->_internal.ulEndpointLength,
                          pxAzureProvClient->_internal.pucEndpoint ) );
+            pxAzureProvClient->_internal.ulMQTTConnected = 1;
             xResult = eAzureIoTSuccess;
         }
     }
@@ -269,7 +299,7 @@ static void prvProvClientRequest( AzureIoTProvisioningClient_t * pxAzureProvClie
 {
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
-    AzureIoTMQTTPublishInfo_t xMQTTPublishInfo = { 0 };
+    AzureIoTMQTTPublishInfo_t * pxMQTTPublishInfo = &pxAzureProvClient->_internal.xSendScratch.xPublishInfo;
     size_t xMQTTTopicLength;
     uint32_t xMQTTPayloadLength = 0;
     uint16_t usPublishPacketIdentifier;
@@ -286,7 +316,7 @@ static void prvProvClientRequest( AzureIoTProvisioningClient_t * pxAzureProvClie
     else
     {
         /* Check if previous this is the 1st request or subsequent query request */
-        if( pxAzureProvClient->_internal.xLastResponsePayloadLength == 0 )
+        if( pxAzureProvClient->_internal.ulLastResponseLength == 0 )
         {
             xCoreResult =
                 az_iot_provisioning_client_register_get_publish_topic( &pxAzureProvClient->_internal.xProvisioningClientCore,
@@ -322,17 +352,19 @@ static void prvProvClientRequest( AzureIoTProvisioningClient_t * pxAzureProvClie
             return;
         }
 
-        xMQTTPublishInfo.xQOS = eAzureIoTMQTTQoS0;
-        xMQTTPublishInfo.pcTopicName = pxAzureProvClient->_internal.pucScratchBuffer;
-        xMQTTPublishInfo.usTopicNameLength = ( uint16_t ) xMQTTTopicLength;
-        xMQTTPublishInfo.pvPayload = pxAzureProvClient->_internal.pucScratchBuffer + xMQTTTopicLength;
-        xMQTTPublishInfo.xPayloadLength = xMQTTPayloadLength;
+        memset( pxMQTTPublishInfo, 0, sizeof( AzureIoTMQTTPublishInfo_t ) );
+        pxMQTTPublishInfo->xQOS = eAzureIoTMQTTQoS0;
+        pxMQTTPublishInfo->pcTopicName = pxAzureProvClient->_internal.pucScratchBuffer;
+        pxMQTTPublishInfo->usTopicNameLength = ( uint16_t ) xMQTTTopicLength;
+        pxMQTTPublishInfo->pvPayload = pxAzureProvClient->_internal.pucScratchBuffer + xMQTTTopicLength;
+        pxMQTTPublishInfo->xPayloadLength = xMQTTPayloadLength;
         usPublishPacketIdentifier = AzureIoTMQTT_GetPacketId( &( pxAzureProvClient->_internal.xMQTTContext ) );
 
         if( ( xMQTTResult = AzureIoTMQTT_Publish( &( pxAzureProvClient->_internal.xMQTTContext ),
-                                                  &xMQTTPublishInfo, usPublishPacketIdentifier ) ) != eAzureIoTMQTTSuccess )
+                                                  pxMQTTPublishInfo, usPublishPacketIdentifier ) ) != eAzureIoTMQTTSuccess )
         {
             AZLogError( ( "AzureIoTProvisioning failed to publish prov request: MQTT error=0x%08x", xMQTTResult ) );
+            pxAzureProvClient->_internal.ulMQTTSubscribed = 0;
             xResult = eAzureIoTErrorPublishFailed;
         }
         else
@@ -347,48 +379,78 @@ static void prvProvClientRequest( AzureIoTProvisioningClient_t * pxAzureProvClie
 
 /**
  *
- * Implementation of parsing response action, this action is only allowed in azureiotprovisioningWF_STATE_RESPONSE
+ * Schedule the next status query of a pending registration.
+ *
+ * The interval starts at the retry-after hint of the service, or the polling interval without one,
+ * and doubles with each query up to the backoff limit. A random delay is added on top, so devices
+ * that started registering at the same time do not query in lockstep.
  *
  * */
-static void prvProvClientParseResponse( AzureIoTProvisioningClient_t * pxAzureProvClient )
+static void prvProvClientScheduleRetry( AzureIoTProvisioningClient_t * pxAzureProvClient )
 {
-    az_result xCoreResult;
-    az_span xTopic = az_span_create( pxAzureProvClient->_internal.ucProvisioningLastResponse,
-                                     ( int32_t ) pxAzureProvClient->_internal.usLastResponseTopicLength );
-    az_span xPayload = az_span_create( pxAzureProvClient->_internal.ucProvisioningLastResponse +
-                                       pxAzureProvClient->_internal.usLastResponseTopicLength,
-                                       ( int32_t ) pxAzureProvClient->_internal.xLastResponsePayloadLength );
+    uint32_t ulRetryAfterSeconds = pxAzureProvClient->_internal.xRegisterResponse.retry_after_seconds;
+    uint32_t ulDelayMilliseconds;
+    uint32_t ulMaxMilliseconds = azureiotconfigPROVISIONING_BACKOFF_MAX_S * 1000U;
+    uint32_t ulJitterMilliseconds;
+    uint32_t ulIndex;
 
-    /* Check the state.  */
-    if( pxAzureProvClient->_internal.ulWorkflowState != azureiotprovisioningWF_STATE_RESPONSE )
+    if( ulRetryAfterSeconds == 0 )
     {
-        AZLogWarn( ( "AzureIoTProvisioning parse response action called in wrong state: [%u]",
-                     pxAzureProvClient->_internal.ulWorkflowState ) );
-        return;
+        ulRetryAfterSeconds = azureiotconfigPROVISIONING_POLLING_INTERVAL_S;
     }
+    else if( ulRetryAfterSeconds > azureiotprovisioningRETRY_AFTER_MAX_S )
+    {
+        ulRetryAfterSeconds = azureiotprovisioningRETRY_AFTER_MAX_S;
+    }
+
+    ulDelayMilliseconds = ulRetryAfterSeconds * 1000U;
 
-    if( ( pxAzureProvClient->_internal.usLastResponseTopicLength == 0 ) ||
-        ( pxAzureProvClient->_internal.xLastResponsePayloadLength == 0 ) )
+    if( ulMaxMilliseconds < ulDelayMilliseconds )
     {
-        AZLogError( ( "AzureIoTProvisioning client failed with invalid server response" ) );
-        prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorInvalidResponse );
-        return;
+        ulMaxMilliseconds = ulDelayMilliseconds;
     }
 
-    xCoreResult =
-        az_iot_provisioning_client_parse_received_topic_and_payload( &pxAzureProvClient->_internal.xProvisioningClientCore,
-                                                                     xTopic, xPayload, &pxAzureProvClient->_internal.xRegisterResponse );
+    for( ulIndex = 0; ( ulIndex < pxAzureProvClient->_internal.ulRetryCount ) &&
+         ( ulDelayMilliseconds < ulMaxMilliseconds ); ulIndex++ )
+    {
+        ulDelayMilliseconds *= 2;
+    }
 
-    if( xCoreResult == AZ_ERROR_IOT_TOPIC_NO_MATCH )
+    if( ulDelayMilliseconds > ulMaxMilliseconds )
     {
-        AZLogInfo( ( "AzureIoTProvisioning ignoring unknown topic." ) );
-        /* Maintaining the same state. */
+        ulDelayMilliseconds = ulMaxMilliseconds;
+    }
+
+    ulJitterMilliseconds = ( ulDelayMilliseconds / 100U ) * azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT;
+    ulDelayMilliseconds += AzureIoT_NextJitter( &pxAzureProvClient->_internal.ulJitterState ) %
+                           ( ulJitterMilliseconds + 1U );
+
+    AZLogDebug( ( "AzureIoTProvisioning next query in %u ms", ulDelayMilliseconds ) );
+
+    pxAzureProvClient->_internal.ulRetryCount++;
+    pxAzureProvClient->_internal.ulRetryTimeMilliseconds = prvProvClientGetTimeMillseconds() + ulDelayMilliseconds;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Implementation of parsing response action, this action is only allowed in azureiotprovisioningWF_STATE_RESPONSE
+ *
+ * */
+static void prvProvClientParseResponse( AzureIoTProvisioningClient_t * pxAzureProvClient )
+{
+    /* Check the state.  */
+    if( pxAzureProvClient->_internal.ulWorkflowState != azureiotprovisioningWF_STATE_RESPONSE )
+    {
+        AZLogWarn( ( "AzureIoTProvisioning parse response action called in wrong state: [%u]",
+                     pxAzureProvClient->_internal.ulWorkflowState ) );
         return;
     }
-    else if( az_result_failed( xCoreResult ) )
+
+    if( pxAzureProvClient->_internal.ulLastOperationResult != eAzureIoTSuccess )
     {
-        AZLogError( ( "AzureIoTProvisioning client failed to parse packet: core error=0x%08x", xCoreResult ) );
-        prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorFailed );
+        /* Processing the received response failed. */
+        prvProvClientUpdateState( pxAzureProvClient, pxAzureProvClient->_internal.ulLastOperationResult );
         return;
     }
 
@@ -401,12 +463,8 @@ static void prvProvClientParseResponse( AzureIoTProvisioningClient_t * pxAzurePr
                 break;
 
             case AZ_IOT_PROVISIONING_STATUS_FAILED:
-                AZLogError( ( "AzureIoTProvisioning client registration failed with error %u: TrackingID: [%.*s] \"%.*s\"",
-                              pxAzureProvClient->_internal.xRegisterResponse.registration_state.extended_error_code,
-                              az_span_size( pxAzureProvClient->_internal.xRegisterResponse.registration_state.error_tracking_id ),
-                              az_span_ptr( pxAzureProvClient->_internal.xRegisterResponse.registration_state.error_tracking_id ),
-                              az_span_size( pxAzureProvClient->_internal.xRegisterResponse.registration_state.error_message ),
-                              az_span_ptr( pxAzureProvClient->_internal.xRegisterResponse.registration_state.error_message ) ) );
+                AZLogError( ( "AzureIoTProvisioning client registration failed with error %u",
+                              pxAzureProvClient->_internal.xRegisterResponse.registration_state.extended_error_code ) );
                 prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorServerError );
                 break;
 
@@ -419,16 +477,16 @@ static void prvProvClientParseResponse( AzureIoTProvisioningClient_t * pxAzurePr
                 AZLogError( ( "AzureIoTProvisioning unexpected operation status %d", pxAzureProvClient->_internal.xRegisterResponse.operation_status ) );
         }
     }
+    else if( ( pxAzureProvClient->_internal.ulRetryBudget != 0 ) &&
+             ( pxAzureProvClient->_internal.ulRetryCount >= pxAzureProvClient->_internal.ulRetryBudget ) )
+    {
+        AZLogError( ( "AzureIoTProvisioning registration still pending after %u queries",
+                      pxAzureProvClient->_internal.ulRetryCount ) );
+        prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorFailed );
+    }
     else /* Operation is not complete. */
     {
-        if( pxAzureProvClient->_internal.xRegisterResponse.retry_after_seconds == 0 )
-        {
-            pxAzureProvClient->_internal.xRegisterResponse.retry_after_seconds = azureiotconfigPROVISIONING_POLLING_INTERVAL_S;
-        }
-
-        pxAzureProvClient->_internal.ullRetryAfter =
-            pxAzureProvClient->_internal.xGetTimeFunction() +
-            pxAzureProvClient->_internal.xRegisterResponse.retry_after_seconds;
+        prvProvClientScheduleRetry( pxAzureProvClient );
         prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorPending );
     }
 }
@@ -443,16 +501,65 @@ static void prvProvClientCheckTimeout( AzureIoTProvisioningClient_t * pxAzurePro
 {
     if( pxAzureProvClient->_internal.ulWorkflowState == azureiotprovisioningWF_STATE_WAITING )
     {
-        if( pxAzureProvClient->_internal.xGetTimeFunction() >
-            pxAzureProvClient->_internal.ullRetryAfter )
+        /* Compare the difference, which stays correct when the tick count wraps. */
+        if( ( int32_t ) ( prvProvClientGetTimeMillseconds() -
+                          pxAzureProvClient->_internal.ulRetryTimeMilliseconds ) >= 0 )
         {
-            pxAzureProvClient->_internal.ullRetryAfter = 0;
             prvProvClientUpdateState( pxAzureProvClient, eAzureIoTSuccess );
         }
     }
 }
 /*-----------------------------------------------------------*/
 
+/**
+ *
+ * Get how long the workflow can wait before its next action is due.
+ *
+ * */
+static uint32_t prvProvClientGetSleepTime( AzureIoTProvisioningClient_t * pxAzureProvClient )
+{
+    int32_t lRemainingMilliseconds;
+    uint32_t ulSleepMilliseconds;
+
+    switch( pxAzureProvClient->_internal.ulWorkflowState )
+    {
+        case azureiotprovisioningWF_STATE_SUBSCRIBING:
+        case azureiotprovisioningWF_STATE_REQUESTING:
+            /* Waiting for the receive path, which can complete at any time. */
+            ulSleepMilliseconds = azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS;
+            break;
+
+        case azureiotprovisioningWF_STATE_WAITING:
+            lRemainingMilliseconds = ( int32_t ) ( pxAzureProvClient->_internal.ulRetryTimeMilliseconds -
+                                                   prvProvClientGetTimeMillseconds() );
+
+            if( lRemainingMilliseconds <= 0 )
+            {
+                ulSleepMilliseconds = 0;
+            }
+            else
+            {
+                /* Wake in time to keep the MQTT connection alive. */
+                ulSleepMilliseconds = ( uint32_t ) lRemainingMilliseconds;
+
+                if( ulSleepMilliseconds > ( azureiotprovisioningKEEP_ALIVE_TIMEOUT_SECONDS * 1000U / 2U ) )
+                {
+                    ulSleepMilliseconds = azureiotprovisioningKEEP_ALIVE_TIMEOUT_SECONDS * 1000U / 2U;
+                }
+            }
+
+            break;
+
+        default:
+            /* The next action can run right away. */
+            ulSleepMilliseconds = 0;
+            break;
+    }
+
+    return ulSleepMilliseconds;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * Trigger state machine action base on the state.
  *
@@ -505,6 +612,7 @@ static AzureIoTResult_t prvProvClientRunWorkflow( AzureIoTProvisioningClient_t *
     AzureIoTMQTTResult_t xMQTTResult;
     AzureIoTResult_t xResult;
     uint32_t ulWaitTime;
+    uint32_t ulPreviousState;
 
     do
     {
@@ -514,17 +622,7 @@ static AzureIoTResult_t prvProvClientRunWorkflow( AzureIoTProvisioningClient_t *
             break;
         }
 
-        if( ulTimeoutMilliseconds > azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS )
-        {
-            ulTimeoutMilliseconds -= azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS;
-            ulWaitTime = azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS;
-        }
-        else
-        {
-            ulWaitTime = ulTimeoutMilliseconds;
-            ulTimeoutMilliseconds = 0;
-        }
-
+        ulPreviousState = pxAzureProvClient->_internal.ulWorkflowState;
         prvProvClientTriggerAction( pxAzureProvClient );
 
         if( pxAzureProvClient->_internal.ulWorkflowState == azureiotprovisioningWF_STATE_COMPLETE )
@@ -533,12 +631,37 @@ static AzureIoTResult_t prvProvClientRunWorkflow( AzureIoTProvisioningClient_t *
                           pxAzureProvClient->_internal.ulLastOperationResult ) );
             break;
         }
-        else if( ( xMQTTResult =
-                       AzureIoTMQTT_ProcessLoop( &( pxAzureProvClient->_internal.xMQTTContext ),
-                                                 ulWaitTime ) ) != eAzureIoTMQTTSuccess )
+
+        /* Only block in the process loop until the next action is due, so that
+         * consecutive actions do not each wait out a full process loop slice. */
+        ulWaitTime = prvProvClientGetSleepTime( pxAzureProvClient );
+
+        if( ( ulWaitTime == 0 ) && ( ulPreviousState == pxAzureProvClient->_internal.ulWorkflowState ) )
+        {
+            /* The action made no progress, avoid spinning. */
+            ulWaitTime = azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS;
+        }
+
+        if( ulWaitTime > azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS )
+        {
+            ulWaitTime = azureiotprovisioningPROCESS_LOOP_TIMEOUT_MS;
+        }
+
+        if( ulWaitTime > ulTimeoutMilliseconds )
+        {
+            ulWaitTime = ulTimeoutMilliseconds;
+        }
+
+        ulTimeoutMilliseconds -= ulWaitTime;
+
+        if( ( xMQTTResult = AzureIoTMQTT_ProcessLoop( &( pxAzureProvClient->_internal.xMQTTContext ),
+                                                      ulWaitTime ) ) != eAzureIoTMQTTSuccess )
         {
             AZLogError( ( "AzureIoTProvisioning failed to process loop: ProcessLoopDuration=%u, MQTT error=0x%08x",
                           ulTimeoutMilliseconds, xMQTTResult ) );
+            /* The connection can not be relied on anymore. */
+            pxAzureProvClient->_internal.ulMQTTConnected = 0;
+            pxAzureProvClient->_internal.ulMQTTSubscribed = 0;
             prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorFailed );
             break;
         }
@@ -568,44 +691,115 @@ static void prvProvClientMQTTProcessSubAck( AzureIoTProvisioningClient_t * pxAzu
     ( void ) pxPacketInfo;
 
     /* We assume success since IoT Provisioning would disconnect if there was a problem subscribing. */
+    pxAzureProvClient->_internal.ulMQTTSubscribed = 1;
     prvProvClientUpdateState( pxAzureProvClient, eAzureIoTSuccess );
 }
 /*-----------------------------------------------------------*/
 
+/**
+ *
+ * Copy a span of the parsed response into the response buffer and point it there.
+ *
+ * */
+static AzureIoTResult_t prvProvClientKeepSpan( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                               az_span * pxSpan )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulSpanLength = ( uint32_t ) az_span_size( *pxSpan );
+    uint8_t * pucDestination = pxAzureProvClient->_internal.pucLastResponse +
+                               pxAzureProvClient->_internal.ulLastResponseLength;
+
+    if( ulSpanLength > ( azureiotprovisioningRESPONSE_STATE_MAX - pxAzureProvClient->_internal.ulLastResponseLength ) )
+    {
+        xResult = eAzureIoTErrorOutOfMemory;
+    }
+    else
+    {
+        memcpy( pucDestination, az_span_ptr( *pxSpan ), ulSpanLength );
+        *pxSpan = az_span_create( pucDestination, ( int32_t ) ulSpanLength );
+        pxAzureProvClient->_internal.ulLastResponseLength += ulSpanLength;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
 /**
  * Process MQTT Response from Provisioning Service
  *
+ * The response is parsed in place from the network buffer, which is reused by later
+ * packets. Only the spans still needed afterwards are copied out.
+ *
  */
 static void prvProvClientMQTTProcessResponse( AzureIoTProvisioningClient_t * pxAzureProvClient,
                                               AzureIoTMQTTPublishInfo_t * pxPublishInfo )
 {
-    if( pxAzureProvClient->_internal.ulWorkflowState == azureiotprovisioningWF_STATE_REQUESTING )
+    AzureIoTResult_t xResult;
+    az_result xCoreResult;
+    az_iot_provisioning_client_register_response * pxResponse = &pxAzureProvClient->_internal.xRegisterResponse;
+    az_span xTopic = az_span_create( ( uint8_t * ) pxPublishInfo->pcTopicName, ( int32_t ) pxPublishInfo->usTopicNameLength );
+    az_span xPayload = az_span_create( ( uint8_t * ) pxPublishInfo->pvPayload, ( int32_t ) pxPublishInfo->xPayloadLength );
+
+    if( pxAzureProvClient->_internal.ulWorkflowState != azureiotprovisioningWF_STATE_REQUESTING )
+    {
+        return;
+    }
+
+    if( ( pxPublishInfo->usTopicNameLength == 0 ) || ( pxPublishInfo->xPayloadLength == 0 ) )
+    {
+        AZLogError( ( "AzureIoTProvisioning client failed with invalid server response" ) );
+        xResult = eAzureIoTErrorInvalidResponse;
+    }
+    else if( ( xCoreResult =
+                   az_iot_provisioning_client_parse_received_topic_and_payload( &pxAzureProvClient->_internal.xProvisioningClientCore,
+                                                                                xTopic, xPayload, pxResponse ) ) == AZ_ERROR_IOT_TOPIC_NO_MATCH )
+    {
+        AZLogInfo( ( "AzureIoTProvisioning ignoring unknown topic." ) );
+        /* Maintaining the same state. */
+        return;
+    }
+    else if( az_result_failed( xCoreResult ) )
+    {
+        AZLogError( ( "AzureIoTProvisioning client failed to parse packet: core error=0x%08x", xCoreResult ) );
+        xResult = eAzureIoTErrorFailed;
+    }
+    else
     {
-        if( ( pxPublishInfo->xPayloadLength + pxPublishInfo->usTopicNameLength ) <=
-            sizeof( pxAzureProvClient->_internal.ucProvisioningLastResponse ) )
+        if( pxResponse->operation_status == AZ_IOT_PROVISIONING_STATUS_FAILED )
         {
-            /* Copy topic + payload into the response buffer.
-             * ucProvisioningLastResponse = [ topic payload ] */
-            pxAzureProvClient->_internal.usLastResponseTopicLength =
-                pxPublishInfo->usTopicNameLength;
-            memcpy( pxAzureProvClient->_internal.ucProvisioningLastResponse,
-                    pxPublishInfo->pcTopicName, pxPublishInfo->usTopicNameLength );
+            AZLogError( ( "AzureIoTProvisioning client registration failed with error %u: TrackingID: [%.*s] \"%.*s\"",
+                          pxResponse->registration_state.extended_error_code,
+                          az_span_size( pxResponse->registration_state.error_tracking_id ),
+                          az_span_ptr( pxResponse->registration_state.error_tracking_id ),
+                          az_span_size( pxResponse->registration_state.error_message ),
+                          az_span_ptr( pxResponse->registration_state.error_message ) ) );
+        }
 
-            pxAzureProvClient->_internal.xLastResponsePayloadLength =
-                pxPublishInfo->xPayloadLength;
-            memcpy( pxAzureProvClient->_internal.ucProvisioningLastResponse +
-                    pxAzureProvClient->_internal.usLastResponseTopicLength,
-                    pxPublishInfo->pvPayload, pxPublishInfo->xPayloadLength );
+        /* Nothing else may point into the network buffer. */
+        pxResponse->registration_state.error_message = AZ_SPAN_EMPTY;
+        pxResponse->registration_state.error_tracking_id = AZ_SPAN_EMPTY;
+        pxResponse->registration_state.error_timestamp = AZ_SPAN_EMPTY;
 
-            prvProvClientUpdateState( pxAzureProvClient, eAzureIoTSuccess );
+        pxAzureProvClient->_internal.ulLastResponseLength = 0;
+
+        if( ( prvProvClientKeepSpan( pxAzureProvClient, &pxResponse->operation_id ) != eAzureIoTSuccess ) ||
+            ( prvProvClientKeepSpan( pxAzureProvClient, &pxResponse->registration_state.assigned_hub_hostname ) != eAzureIoTSuccess ) ||
+            ( prvProvClientKeepSpan( pxAzureProvClient, &pxResponse->registration_state.device_id ) != eAzureIoTSuccess ) )
+        {
+            AZLogError( ( "AzureIoTProvisioning process response failed: response does not fit in %u bytes",
+                          azureiotprovisioningRESPONSE_STATE_MAX ) );
+            xResult = eAzureIoTErrorOutOfMemory;
         }
         else
         {
-            AZLogError( ( "AzureIoTProvisioning process response failed with buffer too small required size is %d bytes",
-                          pxPublishInfo->xPayloadLength + pxPublishInfo->usTopicNameLength ) );
-            prvProvClientUpdateState( pxAzureProvClient, eAzureIoTErrorOutOfMemory );
+            xResult = eAzureIoTSuccess;
         }
     }
+
+    /* Move on to the response action either way, which reports the result. */
+    prvProvClientUpdateState( pxAzureProvClient, eAzureIoTSuccess );
+    pxAzureProvClient->_internal.ulLastOperationResult = xResult;
 }
 /*-----------------------------------------------------------*/
 
@@ -712,25 +906,6 @@ static uint32_t prvProvClientGetToken( AzureIoTProvisioningClient_t * pxAzurePro
 }
 /*-----------------------------------------------------------*/
 
-/**
- * Get number of millseconds passed to MQTT stack
- *
- */
-static uint32_t prvProvClientGetTimeMillseconds( void )
-{
-    TickType_t xTickCount = 0;
-    uint32_t ulTimeMs = 0UL;
-
-    /* Get the current tick count. */
-    xTickCount = xTaskGetTickCount();
-
-    /* Convert the ticks to milliseconds. */
-    ulTimeMs = ( uint32_t ) xTickCount * azureiotMILLISECONDS_PER_TICK;
-
-    return ulTimeMs;
-}
-/*-----------------------------------------------------------*/
-
 AzureIoTResult_t AzureIoTProvisioningClient_OptionsInit( AzureIoTProvisioningClientOptions_t * pxProvisioningClientOptions )
 {
     AzureIoTResult_t xResult;
@@ -744,6 +919,7 @@ AzureIoTResult_t AzureIoTProvisioningClient_OptionsInit( AzureIoTProvisioningCli
     {
         pxProvisioningClientOptions->pucUserAgent = ( const uint8_t * ) azureiotprovisioningUSER_AGENT;
         pxProvisioningClientOptions->ulUserAgentLength = sizeof( azureiotprovisioningUSER_AGENT ) - 1;
+        pxProvisioningClientOptions->ulRetryBudget = 0;
         xResult = eAzureIoTSuccess;
     }
 
@@ -784,8 +960,7 @@ AzureIoTResult_t AzureIoTProvisioningClient_Init( AzureIoTProvisioningClient_t *
         AZLogError( ( "AzureIoTProvisioningClient_Init failed: invalid argument" ) );
         xResult = eAzureIoTErrorInvalidArgument;
     }
-    else if( ( ulBufferLength < ( azureiotconfigTOPIC_MAX + azureiotconfigPROVISIONING_REQUEST_PAYLOAD_MAX ) ) ||
-             ( ulBufferLength < ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ) ) )
+    else if( ulBufferLength < ( azureiotprovisioningSCRATCH_BUFFER_SIZE + azureiotprovisioningRESPONSE_STATE_MAX ) )
     {
         AZLogError( ( "AzureIoTProvisioningClient_Init failed: insufficient buffer size" ) );
         xResult = eAzureIoTErrorOutOfMemory;
@@ -794,12 +969,12 @@ AzureIoTResult_t AzureIoTProvisioningClient_Init( AzureIoTProvisioningClient_t *
     {
         memset( pxAzureProvClient, 0, sizeof( AzureIoTProvisioningClient_t ) );
         /* Setup scratch buffer to be used by middleware */
-        pxAzureProvClient->_internal.ulScratchBufferLength =
-            azureiotPrvGetMaxInt( ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ),
-                                  ( azureiotconfigTOPIC_MAX + azureiotconfigPROVISIONING_REQUEST_PAYLOAD_MAX ) );
+        pxAzureProvClient->_internal.ulScratchBufferLength = azureiotprovisioningSCRATCH_BUFFER_SIZE;
         pxAzureProvClient->_internal.pucScratchBuffer = pucBuffer;
-        pucNetworkBuffer = pucBuffer + pxAzureProvClient->_internal.ulScratchBufferLength;
-        ulNetworkBufferLength = ulBufferLength - pxAzureProvClient->_internal.ulScratchBufferLength;
+        pxAzureProvClient->_internal.ulBufferLength = ulBufferLength;
+        pxAzureProvClient->_internal.pucLastResponse = pucBuffer + azureiotprovisioningSCRATCH_BUFFER_SIZE;
+        pucNetworkBuffer = pxAzureProvClient->_internal.pucLastResponse + azureiotprovisioningRESPONSE_STATE_MAX;
+        ulNetworkBufferLength = ulBufferLength - ( azureiotprovisioningSCRATCH_BUFFER_SIZE + azureiotprovisioningRESPONSE_STATE_MAX );
 
         pxAzureProvClient->_internal.pucEndpoint = pucEndpoint;
         pxAzureProvClient->_internal.ulEndpointLength = ulEndpointLength;
@@ -809,10 +984,21 @@ AzureIoTResult_t AzureIoTProvisioningClient_Init( AzureIoTProvisioningClient_t *
         pxAzureProvClient->_internal.ulRegistrationIDLength = ulRegistrationIDLength;
         pxAzureProvClient->_internal.xGetTimeFunction = xGetTimeFunction;
 
+        /* Seed the retry jitter per device and boot. xorshift32 must not start from zero. */
+        pxAzureProvClient->_internal.ulJitterState =
+            AzureIoT_FNV1aHash( azureiotFNV_OFFSET_BASIS, pucRegistrationID, ulRegistrationIDLength ) ^
+            prvProvClientGetTimeMillseconds();
+
+        if( pxAzureProvClient->_internal.ulJitterState == 0 )
+        {
+            pxAzureProvClient->_internal.ulJitterState = 1;
+        }
+
         if( pxProvisioningClientOptions )
         {
             xOptions.user_agent = az_span_create( ( uint8_t * ) pxProvisioningClientOptions->pucUserAgent,
                                                   ( int32_t ) pxProvisioningClientOptions->ulUserAgentLength );
+            pxAzureProvClient->_internal.ulRetryBudget = pxProvisioningClientOptions->ulRetryBudget;
         }
         else
         {
@@ -855,6 +1041,39 @@ void AzureIoTProvisioningClient_Deinit( AzureIoTProvisioningClient_t * pxAzurePr
 }
 /*-----------------------------------------------------------*/
 
+AzureIoTResult_t AzureIoTProvisioningClient_ReleaseBuffer( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                           uint8_t ** ppucBuffer,
+                                                           uint32_t * pulBufferLength )
+{
+    AzureIoTResult_t xResult;
+    AzureIoTMQTTResult_t xMQTTResult;
+
+    if( ( pxAzureProvClient == NULL ) || ( ppucBuffer == NULL ) || ( pulBufferLength == NULL ) )
+    {
+        AZLogError( ( "AzureIoTProvisioningClient_ReleaseBuffer failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        if( pxAzureProvClient->_internal.ulMQTTConnected &&
+            ( ( xMQTTResult = AzureIoTMQTT_Disconnect( &( pxAzureProvClient->_internal.xMQTTContext ) ) ) != eAzureIoTMQTTSuccess ) )
+        {
+            /* The buffer is released anyway, as the connection is of no use without it. */
+            AZLogWarn( ( "AzureIoTProvisioning failed to disconnect: MQTT error=0x%08x", xMQTTResult ) );
+        }
+
+        *ppucBuffer = pxAzureProvClient->_internal.pucScratchBuffer;
+        *pulBufferLength = pxAzureProvClient->_internal.ulBufferLength;
+
+        /* Nothing may point into the buffer anymore. */
+        memset( pxAzureProvClient, 0, sizeof( AzureIoTProvisioningClient_t ) );
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
 AzureIoTResult_t AzureIoTProvisioningClient_SetSymmetricKey( AzureIoTProvisioningClient_t * pxAzureProvClient,
                                                              const uint8_t * pucSymmetricKey,
                                                              uint32_t ulSymmetricKeyLength,
@@ -887,6 +1106,8 @@ AzureIoTResult_t AzureIoTProvisioningClient_Register( AzureIoTProvisioningClient
 {
     AzureIoTResult_t xResult;
 
+    azureiotSTACK_PROFILE_BEGIN();
+
     if( pxAzureProvClient == NULL )
     {
         AZLogError( ( "AzureIoTProvisioningClient_Register failed: invalid argument" ) );
@@ -902,6 +1123,62 @@ AzureIoTResult_t AzureIoTProvisioningClient_Register( AzureIoTProvisioningClient
         xResult = prvProvClientRunWorkflow( pxAzureProvClient, ulTimeoutMilliseconds );
     }
 
+    azureiotSTACK_PROFILE_END( eAzureIoTStackProfileProvisioningRegister );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTProvisioningClient_ResetRegistration( AzureIoTProvisioningClient_t * pxAzureProvClient )
+{
+    AzureIoTResult_t xResult;
+
+    if( pxAzureProvClient == NULL )
+    {
+        AZLogError( ( "AzureIoTProvisioningClient_ResetRegistration failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        if( pxAzureProvClient->_internal.ulMQTTConnected && pxAzureProvClient->_internal.ulMQTTSubscribed )
+        {
+            AZLogInfo( ( "AzureIoTProvisioning registering again on the current connection" ) );
+            pxAzureProvClient->_internal.ulWorkflowState = azureiotprovisioningWF_STATE_REQUEST;
+        }
+        else
+        {
+            pxAzureProvClient->_internal.ulMQTTConnected = 0;
+            pxAzureProvClient->_internal.ulMQTTSubscribed = 0;
+            pxAzureProvClient->_internal.ulWorkflowState = azureiotprovisioningWF_STATE_INIT;
+        }
+
+        /* An empty last response makes the next request a registration rather than a status query. */
+        pxAzureProvClient->_internal.ulLastOperationResult = eAzureIoTSuccess;
+        pxAzureProvClient->_internal.ulRetryCount = 0;
+        pxAzureProvClient->_internal.ulLastResponseLength = 0;
+        xResult = eAzureIoTSuccess;
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTProvisioningClient_GetSleepTime( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                          uint32_t * pulSleepMilliseconds )
+{
+    AzureIoTResult_t xResult;
+
+    if( ( pxAzureProvClient == NULL ) || ( pulSleepMilliseconds == NULL ) )
+    {
+        AZLogError( ( "AzureIoTProvisioningClient_GetSleepTime failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        *pulSleepMilliseconds = prvProvClientGetSleepTime( pxAzureProvClient );
+        xResult = eAzureIoTSuccess;
+    }
+
     return xResult;
 }
 /*-----------------------------------------------------------*/
@@ -959,6 +1236,213 @@ AzureIoTResult_t AzureIoTProvisioningClient_GetDeviceAndHub( AzureIoTProvisionin
 }
 /*-----------------------------------------------------------*/
 
+/**
+ *
+ * Continue a 32-bit FNV-1a hash over a length prefixed field, so that
+ * moving bytes between adjacent fields changes the hash.
+ *
+ * */
+static uint32_t prvFNV1aHashField( uint32_t ulHash,
+                                   const uint8_t * pucData,
+                                   uint32_t ulDataLength )
+{
+    uint8_t ucLength[ 4 ];
+
+    ucLength[ 0 ] = ( uint8_t ) ulDataLength;
+    ucLength[ 1 ] = ( uint8_t ) ( ulDataLength >> 8 );
+    ucLength[ 2 ] = ( uint8_t ) ( ulDataLength >> 16 );
+    ucLength[ 3 ] = ( uint8_t ) ( ulDataLength >> 24 );
+
+    ulHash = AzureIoT_FNV1aHash( ulHash, ucLength, sizeof( ucLength ) );
+
+    return ( ulDataLength > 0 ) ? AzureIoT_FNV1aHash( ulHash, pucData, ulDataLength ) : ulHash;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Hash the parts of the client configuration which decide the registration result.
+ *
+ * */
+static uint32_t prvProvClientConfigurationHash( AzureIoTProvisioningClient_t * pxAzureProvClient )
+{
+    uint32_t ulHash = azureiotFNV_OFFSET_BASIS;
+
+    ulHash = prvFNV1aHashField( ulHash, pxAzureProvClient->_internal.pucEndpoint,
+                                pxAzureProvClient->_internal.ulEndpointLength );
+    ulHash = prvFNV1aHashField( ulHash, pxAzureProvClient->_internal.pucIDScope,
+                                pxAzureProvClient->_internal.ulIDScopeLength );
+    ulHash = prvFNV1aHashField( ulHash, pxAzureProvClient->_internal.pucRegistrationID,
+                                pxAzureProvClient->_internal.ulRegistrationIDLength );
+    ulHash = prvFNV1aHashField( ulHash, pxAzureProvClient->_internal.pucRegistrationPayload,
+                                pxAzureProvClient->_internal.ulRegistrationPayloadLength );
+
+    return ulHash;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteUint16( uint8_t * pucBuffer,
+                            uint32_t ulValue )
+{
+    pucBuffer[ 0 ] = ( uint8_t ) ulValue;
+    pucBuffer[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteUint32( uint8_t * pucBuffer,
+                            uint32_t ulValue )
+{
+    prvWriteUint16( pucBuffer, ulValue );
+    prvWriteUint16( pucBuffer + 2, ulValue >> 16 );
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadUint16( const uint8_t * pucBuffer )
+{
+    return ( uint32_t ) pucBuffer[ 0 ] | ( ( uint32_t ) pucBuffer[ 1 ] << 8 );
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadUint32( const uint8_t * pucBuffer )
+{
+    return prvReadUint16( pucBuffer ) | ( prvReadUint16( pucBuffer + 2 ) << 16 );
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTProvisioningClient_SaveResult( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                        uint8_t * pucSavedResult,
+                                                        uint32_t ulSavedResultLength,
+                                                        uint32_t * pulBytesWritten )
+{
+    AzureIoTResult_t xResult;
+    az_span * pxHostname;
+    az_span * pxDeviceID;
+    uint32_t ulHostnameLength;
+    uint32_t ulDeviceIDLength;
+    uint32_t ulLength;
+
+    if( ( pxAzureProvClient == NULL ) || ( pucSavedResult == NULL ) || ( pulBytesWritten == NULL ) )
+    {
+        AZLogError( ( "AzureIoTProvisioningClient_SaveResult failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else if( pxAzureProvClient->_internal.ulWorkflowState != azureiotprovisioningWF_STATE_COMPLETE )
+    {
+        AZLogError( ( "AzureIoTProvisioning client state is not in complete state" ) );
+        xResult = eAzureIoTErrorFailed;
+    }
+    else if( pxAzureProvClient->_internal.ulLastOperationResult )
+    {
+        xResult = pxAzureProvClient->_internal.ulLastOperationResult;
+    }
+    else
+    {
+        pxHostname = &pxAzureProvClient->_internal.xRegisterResponse.registration_state.assigned_hub_hostname;
+        pxDeviceID = &pxAzureProvClient->_internal.xRegisterResponse.registration_state.device_id;
+        ulHostnameLength = ( uint32_t ) az_span_size( *pxHostname );
+        ulDeviceIDLength = ( uint32_t ) az_span_size( *pxDeviceID );
+        ulLength = azureiotprovisioningSAVED_RESULT_HEADER_SIZE + ulHostnameLength +
+                   ulDeviceIDLength + azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE;
+
+        if( ( ulHostnameLength > UINT16_MAX ) || ( ulDeviceIDLength > UINT16_MAX ) )
+        {
+            AZLogError( ( "AzureIoTProvisioningClient_SaveResult failed: hub info too long" ) );
+            xResult = eAzureIoTErrorFailed;
+        }
+        else if( ulSavedResultLength < ulLength )
+        {
+            AZLogError( ( "AzureIoTProvisioningClient_SaveResult failed: buffer too small, needs %u bytes", ulLength ) );
+            xResult = eAzureIoTErrorOutOfMemory;
+        }
+        else
+        {
+            prvWriteUint32( pucSavedResult, azureiotprovisioningSAVED_RESULT_MAGIC );
+            pucSavedResult[ 4 ] = azureiotprovisioningSAVED_RESULT_VERSION;
+            pucSavedResult[ 5 ] = 0;
+            prvWriteUint16( pucSavedResult + 6, ulHostnameLength );
+            prvWriteUint16( pucSavedResult + 8, ulDeviceIDLength );
+            prvWriteUint32( pucSavedResult + 10, prvProvClientConfigurationHash( pxAzureProvClient ) );
+            memcpy( pucSavedResult + azureiotprovisioningSAVED_RESULT_HEADER_SIZE,
+                    az_span_ptr( *pxHostname ), ulHostnameLength );
+            memcpy( pucSavedResult + azureiotprovisioningSAVED_RESULT_HEADER_SIZE + ulHostnameLength,
+                    az_span_ptr( *pxDeviceID ), ulDeviceIDLength );
+            prvWriteUint32( pucSavedResult + ulLength - azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE,
+                            AzureIoT_FNV1aHash( azureiotFNV_OFFSET_BASIS, pucSavedResult,
+                                                ulLength - azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE ) );
+            *pulBytesWritten = ulLength;
+            xResult = eAzureIoTSuccess;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTResult_t AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                                            const uint8_t * pucSavedResult,
+                                                                            uint32_t ulSavedResultLength,
+                                                                            uint8_t * pucHubHostname,
+                                                                            uint32_t * pulHostnameLength,
+                                                                            uint8_t * pucDeviceID,
+                                                                            uint32_t * pulDeviceIDLength )
+{
+    AzureIoTResult_t xResult;
+    uint32_t ulHostnameLength = 0;
+    uint32_t ulDeviceIDLength = 0;
+    uint32_t ulLength = 0;
+
+    if( ( pxAzureProvClient == NULL ) || ( pucSavedResult == NULL ) ||
+        ( pucHubHostname == NULL ) || ( pulHostnameLength == NULL ) ||
+        ( pucDeviceID == NULL ) || ( pulDeviceIDLength == NULL ) )
+    {
+        AZLogError( ( "AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult failed: invalid argument" ) );
+        xResult = eAzureIoTErrorInvalidArgument;
+    }
+    else
+    {
+        if( ulSavedResultLength >= ( azureiotprovisioningSAVED_RESULT_HEADER_SIZE + azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE ) )
+        {
+            ulHostnameLength = prvReadUint16( pucSavedResult + 6 );
+            ulDeviceIDLength = prvReadUint16( pucSavedResult + 8 );
+            ulLength = azureiotprovisioningSAVED_RESULT_HEADER_SIZE + ulHostnameLength +
+                       ulDeviceIDLength + azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE;
+        }
+
+        if( ( ulLength == 0 ) || ( ulSavedResultLength < ulLength ) ||
+            ( prvReadUint32( pucSavedResult ) != azureiotprovisioningSAVED_RESULT_MAGIC ) ||
+            ( pucSavedResult[ 4 ] != azureiotprovisioningSAVED_RESULT_VERSION ) ||
+            ( prvReadUint32( pucSavedResult + ulLength - azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE ) !=
+              AzureIoT_FNV1aHash( azureiotFNV_OFFSET_BASIS, pucSavedResult,
+                                  ulLength - azureiotprovisioningSAVED_RESULT_CHECKSUM_SIZE ) ) )
+        {
+            AZLogWarn( ( "AzureIoTProvisioning saved result is corrupted" ) );
+            xResult = eAzureIoTErrorItemNotFound;
+        }
+        else if( prvReadUint32( pucSavedResult + 10 ) != prvProvClientConfigurationHash( pxAzureProvClient ) )
+        {
+            AZLogInfo( ( "AzureIoTProvisioning saved result is for another configuration" ) );
+            xResult = eAzureIoTErrorItemNotFound;
+        }
+        else if( ( *pulHostnameLength < ulHostnameLength ) || ( *pulDeviceIDLength < ulDeviceIDLength ) )
+        {
+            AZLogWarn( ( "AzureIoTProvisioning memory buffer passed is not enough to store hub info" ) );
+            xResult = eAzureIoTErrorFailed;
+        }
+        else
+        {
+            memcpy( pucHubHostname, pucSavedResult + azureiotprovisioningSAVED_RESULT_HEADER_SIZE, ulHostnameLength );
+            memcpy( pucDeviceID, pucSavedResult + azureiotprovisioningSAVED_RESULT_HEADER_SIZE + ulHostnameLength,
+                    ulDeviceIDLength );
+            *pulHostnameLength = ulHostnameLength;
+            *pulDeviceIDLength = ulDeviceIDLength;
+            xResult = eAzureIoTSuccess;
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
 AzureIoTResult_t AzureIoTProvisioningClient_GetExtendedCode( AzureIoTProvisioningClient_t * pxAzureProvClient,
                                                              uint32_t * pulExtendedErrorCode )
 {
@@ -0,0 +1,205 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_stack_profile.c
+ * @brief Implementation of the stack usage profiling of the middleware entry points.
+ */
+
+#include "azure_iot_stack_profile.h"
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if azureiotconfigSTACK_PROFILING
+
+    #if ( INCLUDE_uxTaskGetStackHighWaterMark != 1 )
+        #error "azureiotconfigSTACK_PROFILING requires INCLUDE_uxTaskGetStackHighWaterMark"
+    #endif
+
+    #if ( configNUM_THREAD_LOCAL_STORAGE_POINTERS <= azureiotconfigSTACK_PROFILING_TLS_INDEX )
+        #error "azureiotconfigSTACK_PROFILING requires a thread local storage pointer at azureiotconfigSTACK_PROFILING_TLS_INDEX"
+    #endif
+
+/* The kernel fill byte, so that painted stack still reads as free to uxTaskGetStackHighWaterMark(). */
+    #define azureiotstackprofileFILL_BYTE      ( 0xa5U )
+
+/* Stack left alone below the painting code, for its own frame and any red zone. */
+    #define azureiotstackprofileGUARD_BYTES    ( 512U )
+/*-----------------------------------------------------------*/
+
+static uint32_t ulStackProfilePeaks[ eAzureIoTStackProfileEntryCount ];
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Find the deepest byte written below pucTop since it was painted.
+ *
+ * */
+static uint8_t * prvStackProfileScan( uint8_t * pucPaintedEnd,
+                                      uint8_t * pucTop )
+{
+    volatile uint8_t * pucByte = pucPaintedEnd;
+
+    while( ( pucByte < pucTop ) && ( *pucByte == azureiotstackprofileFILL_BYTE ) )
+    {
+        pucByte++;
+    }
+
+    return ( uint8_t * ) pucByte;
+}
+/*-----------------------------------------------------------*/
+
+static void prvStackProfilePaint( uint8_t * pucPaintedEnd,
+                                  uint8_t * pucTop )
+{
+    volatile uint8_t * pucByte = pucPaintedEnd;
+
+    while( pucByte < pucTop )
+    {
+        *pucByte++ = azureiotstackprofileFILL_BYTE;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTStackProfile_Begin( AzureIoTStackProfileFrame_t * pxFrame )
+{
+    volatile uint8_t ucMarker = 0;
+    uint8_t * pucTop = ( uint8_t * ) &ucMarker - azureiotstackprofileGUARD_BYTES;
+    AzureIoTStackProfileFrame_t * pxOuter =
+        ( AzureIoTStackProfileFrame_t * ) pvTaskGetThreadLocalStoragePointer( NULL, azureiotconfigSTACK_PROFILING_TLS_INDEX );
+    uint8_t * pucDeepest;
+    uint32_t ulFreeBytes;
+    uint32_t ulPaintLength;
+
+    /* The frame lives in the stack frame of the instrumented function. */
+    pxFrame->_internal.pucEntry = ( uint8_t * ) pxFrame;
+    pxFrame->_internal.pucDeepest = ( uint8_t * ) &ucMarker;
+    pxFrame->_internal.pucPaintedTop = pucTop;
+    pxFrame->_internal.pucPaintedEnd = NULL;
+    pxFrame->_internal.pxOuter = pxOuter;
+
+    if( pxOuter != NULL )
+    {
+        /* Nested call: record what the outer call used so far, then repaint its area below this frame. */
+        if( ( pxOuter->_internal.pucPaintedEnd != NULL ) && ( pucTop <= pxOuter->_internal.pucPaintedTop ) )
+        {
+            pucDeepest = prvStackProfileScan( pxOuter->_internal.pucPaintedEnd, pucTop );
+
+            if( pucDeepest == pucTop )
+            {
+                pucDeepest = ( uint8_t * ) &ucMarker;
+            }
+
+            if( pucDeepest < pxOuter->_internal.pucDeepest )
+            {
+                pxOuter->_internal.pucDeepest = pucDeepest;
+            }
+
+            pxFrame->_internal.pucPaintedEnd = pxOuter->_internal.pucPaintedEnd;
+            prvStackProfilePaint( pxFrame->_internal.pucPaintedEnd, pucTop );
+        }
+    }
+    else
+    {
+        /* The high-water mark is taken below this frame, so at least this much stack is free under pucTop. */
+        ulFreeBytes = ( uint32_t ) ( uxTaskGetStackHighWaterMark( NULL ) * sizeof( StackType_t ) );
+
+        if( ulFreeBytes > azureiotstackprofileGUARD_BYTES )
+        {
+            ulPaintLength = ulFreeBytes - azureiotstackprofileGUARD_BYTES;
+
+            if( ulPaintLength > azureiotconfigSTACK_PROFILING_DEPTH_MAX )
+            {
+                ulPaintLength = azureiotconfigSTACK_PROFILING_DEPTH_MAX;
+            }
+
+            pxFrame->_internal.pucPaintedEnd = pucTop - ulPaintLength;
+            prvStackProfilePaint( pxFrame->_internal.pucPaintedEnd, pucTop );
+        }
+    }
+
+    vTaskSetThreadLocalStoragePointer( NULL, azureiotconfigSTACK_PROFILING_TLS_INDEX, pxFrame );
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTStackProfile_End( AzureIoTStackProfileFrame_t * pxFrame,
+                               AzureIoTStackProfileEntry_t xEntry )
+{
+    volatile uint8_t ucMarker = 0;
+    AzureIoTStackProfileFrame_t * pxOuter = pxFrame->_internal.pxOuter;
+    uint8_t * pucDeepest;
+    uint32_t ulPeak;
+
+    vTaskSetThreadLocalStoragePointer( NULL, azureiotconfigSTACK_PROFILING_TLS_INDEX, pxOuter );
+
+    /* Without enough free stack to paint, there is nothing to measure. */
+    if( pxFrame->_internal.pucPaintedEnd != NULL )
+    {
+        pucDeepest = prvStackProfileScan( pxFrame->_internal.pucPaintedEnd, pxFrame->_internal.pucPaintedTop );
+
+        /* Nothing reached the painted area, the call went no deeper than this frame. */
+        if( pucDeepest == pxFrame->_internal.pucPaintedTop )
+        {
+            pucDeepest = ( uint8_t * ) &ucMarker;
+        }
+
+        if( pucDeepest > pxFrame->_internal.pucDeepest )
+        {
+            pucDeepest = pxFrame->_internal.pucDeepest;
+        }
+
+        if( ( pxOuter != NULL ) && ( pucDeepest < pxOuter->_internal.pucDeepest ) )
+        {
+            pxOuter->_internal.pucDeepest = pucDeepest;
+        }
+
+        if( ( uint32_t ) xEntry < eAzureIoTStackProfileEntryCount )
+        {
+            ulPeak = ( uint32_t ) ( pxFrame->_internal.pucEntry - pucDeepest );
+
+            taskENTER_CRITICAL();
+
+            if( ulPeak > ulStackProfilePeaks[ xEntry ] )
+            {
+                ulStackProfilePeaks[ xEntry ] = ulPeak;
+            }
+
+            taskEXIT_CRITICAL();
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t AzureIoTStackProfile_GetPeak( AzureIoTStackProfileEntry_t xEntry )
+{
+    uint32_t ulPeak = 0;
+
+    if( ( uint32_t ) xEntry < eAzureIoTStackProfileEntryCount )
+    {
+        taskENTER_CRITICAL();
+        ulPeak = ulStackProfilePeaks[ xEntry ];
+        taskEXIT_CRITICAL();
+    }
+
+    return ulPeak;
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTStackProfile_Reset( void )
+{
+    uint32_t ulIndex;
+
+    taskENTER_CRITICAL();
+
+    for( ulIndex = 0; ulIndex < eAzureIoTStackProfileEntryCount; ulIndex++ )
+    {
+        ulStackProfilePeaks[ ulIndex ] = 0;
+    }
+
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#endif /* azureiotconfigSTACK_PROFILING */
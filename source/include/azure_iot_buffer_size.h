@@ -0,0 +1,148 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_buffer_size.h
+ *
+ * @brief Compile time sizes of the buffers passed to AzureIoTHubClient_Init() and
+ * AzureIoTProvisioningClient_Init(), computed from the configuration in azure_iot_config.h.
+ *
+ * @details The buffer passed at init is split between the space the client keeps for itself
+ * (MQTT username and password, topics, and for provisioning the last service response) and the
+ * MQTT network buffer. The `_MIN` sizes are the smallest buffers with which a client can connect:
+ * the network buffer holds the MQTT CONNECT packet with the longest identities IoT Hub and the
+ * Device Provisioning Service accept. Add the largest message the application expects to receive
+ * with azureiothubBUFFER_SIZE() or azureiotprovisioningBUFFER_SIZE().
+ *
+ * This header only depends on the configuration, so that it can be used in static asserts and
+ * build scripts:
+ *
+ * @code
+ * static uint8_t ucSharedBuffer[ azureiothubBUFFER_SIZE( 1024 ) ];
+ * azureiothubASSERT_BUFFER_SIZE( sizeof( ucSharedBuffer ) );
+ * @endcode
+ *
+ * @note You MUST NOT use any symbols (macros, functions, structures, enums, etc.)
+ * prefixed with an underscore ('_') directly in your application code. These symbols
+ * are part of Azure SDK's internal implementation; we do not document these symbols
+ * and they are subject to change in future versions of the SDK which would break your code.
+ *
+ */
+
+#ifndef AZURE_IOT_BUFFER_SIZE_H
+#define AZURE_IOT_BUFFER_SIZE_H
+
+/* Same configuration as azure_iot.h, without the FreeRTOS dependency. */
+#ifndef AZURE_IOT_NO_CUSTOM_CONFIG
+    #include "azure_iot_config.h"
+#endif
+
+#include "azure_iot_config_defaults.h"
+
+#define azureiotPrvBufferSizeMax( a, b )         ( ( a ) > ( b ) ? ( a ) : ( b ) )
+#define azureiotPrvConcat( a, b )                a ## b
+#define azureiotPrvConcatExpanded( a, b )        azureiotPrvConcat( a, b )
+
+/**
+ * @brief Largest device ID, module ID and registration ID accepted by the service.
+ */
+#define azureiotIDENTITY_LENGTH_MAX              ( 128U )
+
+/**
+ * @brief Largest MQTT CONNECT packet for a client ID of \p ulClientIDLength bytes.
+ *
+ * Fixed header (5), variable header (10), then the client ID, username and password,
+ * each with a 2 byte length.
+ */
+#define azureiotMQTT_CONNECT_PACKET_SIZE( ulClientIDLength ) \
+    ( 5U + 10U + ( 2U + ( ulClientIDLength ) ) +             \
+      ( 2U + azureiotconfigUSERNAME_MAX ) + ( 2U + azureiotconfigPASSWORD_MAX ) )
+
+/**
+ * @brief Part of the AzureIoTHubClient_Init() buffer kept for the username, password and topics.
+ */
+#define azureiothubWORKING_BUFFER_SIZE                                                   \
+    azureiotPrvBufferSizeMax( ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ), \
+                              azureiotconfigTOPIC_MAX )
+
+/**
+ * @brief Smallest AzureIoTHubClient_Init() buffer with which the client can connect.
+ *
+ * The client ID is the device ID, followed by '/' and the module ID for modules.
+ */
+#define azureiothubBUFFER_SIZE_MIN \
+    ( azureiothubWORKING_BUFFER_SIZE + azureiotMQTT_CONNECT_PACKET_SIZE( 2U * azureiotIDENTITY_LENGTH_MAX + 1U ) )
+
+/**
+ * @brief Smallest AzureIoTHubClient_Init() buffer with which the client can connect when
+ * #AzureIoTHubClientOptions_t.xTransientConnectBuffer borrows the username and password
+ * space from the network buffer.
+ *
+ * Once connected, all but #azureiotconfigTOPIC_MAX bytes are left to receive messages.
+ */
+#define azureiothubTRANSIENT_BUFFER_SIZE_MIN                                                      \
+    ( azureiotconfigTOPIC_MAX + azureiotMQTT_CONNECT_PACKET_SIZE( 2U * azureiotIDENTITY_LENGTH_MAX + 1U ) + \
+      azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX )
+
+/**
+ * @brief AzureIoTHubClient_Init() buffer size for a network buffer of \p ulNetworkBufferSize bytes.
+ *
+ * The network buffer holds any packet sent or received in full, except for the payload of
+ * outgoing messages.
+ */
+#define azureiothubBUFFER_SIZE( ulNetworkBufferSize )    ( azureiothubWORKING_BUFFER_SIZE + ( ulNetworkBufferSize ) )
+
+/**
+ * @brief The space kept in the buffer passed to AzureIoTProvisioningClient_Init() for the parts of the last
+ * service response still needed: the operation ID, the IoT Hub hostname and the device ID.
+ */
+#define azureiotprovisioningRESPONSE_STATE_MAX    ( 128 + 255 + 128 )
+
+/**
+ * @brief Part of the AzureIoTProvisioningClient_Init() buffer kept for the username, password and requests.
+ */
+#define azureiotprovisioningSCRATCH_BUFFER_SIZE                                          \
+    azureiotPrvBufferSizeMax( ( azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ), \
+                              ( azureiotconfigTOPIC_MAX + azureiotconfigPROVISIONING_REQUEST_PAYLOAD_MAX ) )
+
+/**
+ * @brief Smallest AzureIoTProvisioningClient_Init() buffer with which the client can connect.
+ *
+ * The client ID is the registration ID.
+ */
+#define azureiotprovisioningBUFFER_SIZE_MIN                                              \
+    ( azureiotprovisioningSCRATCH_BUFFER_SIZE + azureiotprovisioningRESPONSE_STATE_MAX + \
+      azureiotMQTT_CONNECT_PACKET_SIZE( azureiotIDENTITY_LENGTH_MAX ) )
+
+/**
+ * @brief AzureIoTProvisioningClient_Init() buffer size for a network buffer of \p ulNetworkBufferSize bytes.
+ */
+#define azureiotprovisioningBUFFER_SIZE( ulNetworkBufferSize ) \
+    ( azureiotprovisioningSCRATCH_BUFFER_SIZE + azureiotprovisioningRESPONSE_STATE_MAX + ( ulNetworkBufferSize ) )
+
+/**
+ * @brief Fail the build when \p xCondition, a constant expression, is false.
+ *
+ * Can be used at file or block scope. Before C11, a failure shows as an array with a negative size.
+ */
+#if defined( __STDC_VERSION__ ) && ( __STDC_VERSION__ >= 201112L )
+    #define azureiotSTATIC_ASSERT( xCondition, pcMessage )    _Static_assert( xCondition, pcMessage )
+#else
+    #define azureiotSTATIC_ASSERT( xCondition, pcMessage ) \
+    typedef char azureiotPrvConcatExpanded( azureiotStaticAssert, __LINE__ )[ ( xCondition ) ? 1 : -1 ]
+#endif
+
+/**
+ * @brief Fail the build when a buffer of \p ulBufferSize bytes is too small for AzureIoTHubClient_Init().
+ */
+#define azureiothubASSERT_BUFFER_SIZE( ulBufferSize ) \
+    azureiotSTATIC_ASSERT( ( ulBufferSize ) >= azureiothubBUFFER_SIZE_MIN, "Buffer too small for AzureIoTHubClient_Init()" )
+
+/**
+ * @brief Fail the build when a buffer of \p ulBufferSize bytes is too small for AzureIoTProvisioningClient_Init().
+ */
+#define azureiotprovisioningASSERT_BUFFER_SIZE( ulBufferSize )                     \
+    azureiotSTATIC_ASSERT( ( ulBufferSize ) >= azureiotprovisioningBUFFER_SIZE_MIN, \
+                           "Buffer too small for AzureIoTProvisioningClient_Init()" )
+
+#endif /* AZURE_IOT_BUFFER_SIZE_H */
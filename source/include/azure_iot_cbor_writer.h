@@ -0,0 +1,299 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_cbor_writer.h
+ *
+ * @brief The CBOR (RFC 8949) writer used by the middleware for binary telemetry payloads.
+ *
+ * @note The writer mirrors the #AzureIoTJSONWriter_t append functions. Objects and arrays are
+ * written as indefinite-length maps and arrays so that no element count is needed up front.
+ *
+ * @note You MUST NOT use any symbols (macros, functions, structures, enums, etc.)
+ * prefixed with an underscore ('_') directly in your application code. These symbols
+ * are part of Azure SDK's internal implementation; we do not document these symbols
+ * and they are subject to change in future versions of the SDK which would break your code.
+ *
+ */
+
+#ifndef AZURE_IOT_CBOR_WRITER_H
+#define AZURE_IOT_CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+#include "azure_iot_message.h"
+
+/* Azure SDK for Embedded C includes */
+#include "azure/core/_az_cfg_prefix.h"
+
+/**
+ * @brief The content type to set on messages carrying a CBOR payload.
+ *
+ * @note Percent-encoded, as message property values must be (see AzureIoTMessage_PropertiesAppend()).
+ */
+#define azureiotcborwriterCONTENT_TYPE    "application%2Fcbor"
+
+/**
+ * @brief The maximum nesting depth of maps and arrays.
+ */
+#define azureiotcborwriterMAX_DEPTH       ( 32 )
+
+/**
+ * @brief The struct to use for Azure IoT CBOR writer functionality.
+ */
+typedef struct AzureIoTCBORWriter
+{
+    struct
+    {
+        uint8_t * pucBuffer;
+        uint32_t ulBufferLength;
+        uint32_t ulBytesWritten;
+        uint32_t ulContainerStack;
+        uint32_t ulDepth;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTCBORWriter_t;
+
+/**
+ * @brief Initializes an #AzureIoTCBORWriter_t which writes CBOR into a buffer passed.
+ *
+ * @param[out] pxWriter A pointer to an #AzureIoTCBORWriter_t the instance to initialize.
+ * @param[in] pucBuffer A buffer pointer to which CBOR will be written.
+ * @param[in] ulBufferSize Length of buffer.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Successfully initialized CBOR writer.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_Init( AzureIoTCBORWriter_t * pxWriter,
+                                          uint8_t * pucBuffer,
+                                          uint32_t ulBufferSize );
+
+/**
+ * @brief Appends the UTF-8 property name and value where value is int32
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucPropertyName The UTF-8 encoded property name written as a CBOR text string.
+ * @param[in] ulPropertyNameLength Length of pucPropertyName.
+ * @param[in] lValue The value to be written as a CBOR integer.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property name and int32 value was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithInt32Value( AzureIoTCBORWriter_t * pxWriter,
+                                                                  const uint8_t * pucPropertyName,
+                                                                  uint32_t ulPropertyNameLength,
+                                                                  int32_t lValue );
+
+/**
+ * @brief Appends the UTF-8 property name and value where value is double
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucPropertyName The UTF-8 encoded property name written as a CBOR text string.
+ * @param[in] ulPropertyNameLength Length of pucPropertyName.
+ * @param[in] xValue The value to be written as a CBOR floating-point number.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property name and double value was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithDoubleValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                   const uint8_t * pucPropertyName,
+                                                                   uint32_t ulPropertyNameLength,
+                                                                   double xValue );
+
+/**
+ * @brief Appends the UTF-8 property name and value where value is boolean
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucPropertyName The UTF-8 encoded property name written as a CBOR text string.
+ * @param[in] ulPropertyNameLength Length of pucPropertyName.
+ * @param[in] xValue The value to be written as a CBOR `true` or `false`.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property name and bool value was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithBoolValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                 const uint8_t * pucPropertyName,
+                                                                 uint32_t ulPropertyNameLength,
+                                                                 bool xValue );
+
+/**
+ * @brief Appends the UTF-8 property name and value where value is string
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucPropertyName The UTF-8 encoded property name written as a CBOR text string.
+ * @param[in] ulPropertyNameLength Length of pucPropertyName.
+ * @param[in] pucValue The UTF-8 encoded value written as a CBOR text string.
+ * @param[in] ulValueLen Length of value.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property name and string value was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyWithStringValue( AzureIoTCBORWriter_t * pxWriter,
+                                                                   const uint8_t * pucPropertyName,
+                                                                   uint32_t ulPropertyNameLength,
+                                                                   const uint8_t * pucValue,
+                                                                   uint32_t ulValueLen );
+
+/**
+ * @brief Returns the length of the CBOR written to the underlying buffer.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An int32_t containing the length of CBOR built so far. Will return -1 if there was an error.
+ */
+int32_t AzureIoTCBORWriter_GetBytesUsed( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Appends the UTF-8 text value (as a CBOR text string) into the buffer.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucValue Pointer to the UTF-8 encoded value to be written.
+ * @param[in] ulValueLen Length of value.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The string value was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendString( AzureIoTCBORWriter_t * pxWriter,
+                                                  const uint8_t * pucValue,
+                                                  uint32_t ulValueLen );
+
+/**
+ * @brief Appends raw bytes (as a CBOR byte string) into the buffer.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pucValue Pointer to the bytes to be written.
+ * @param[in] ulValueLen Length of value.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The byte string was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendBytes( AzureIoTCBORWriter_t * pxWriter,
+                                                 const uint8_t * pucValue,
+                                                 uint32_t ulValueLen );
+
+/**
+ * @brief Appends the UTF-8 property name (as a CBOR text string) which is the key of a key/value
+ * pair of a CBOR map.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] pusValue The UTF-8 encoded property name to be written.
+ * @param[in] ulValueLen Length of name.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property name was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendPropertyName( AzureIoTCBORWriter_t * pxWriter,
+                                                        const uint8_t * pusValue,
+                                                        uint32_t ulValueLen );
+
+/**
+ * @brief Appends a boolean value (as a CBOR `true` or `false`).
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] xValue The value to be written.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The bool was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendBool( AzureIoTCBORWriter_t * pxWriter,
+                                                bool xValue );
+
+/**
+ * @brief Appends an `int32_t` number value in its shortest CBOR integer encoding.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] lValue The value to be written.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The number was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendInt32( AzureIoTCBORWriter_t * pxWriter,
+                                                 int32_t lValue );
+
+/**
+ * @brief Appends a `double` number value.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ * @param[in] xValue The value to be written.
+ *
+ * @remark The value is written in single precision when that is lossless, otherwise in double
+ * precision.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The number was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendDouble( AzureIoTCBORWriter_t * pxWriter,
+                                                  double xValue );
+
+/**
+ * @brief Appends the CBOR simple value `null`.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess `null` was appended successfully.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendNull( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Appends the beginning of an indefinite-length CBOR map.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Object start was appended successfully.
+ * @retval eAzureIoTErrorJSONNestingOverflow More than #azureiotcborwriterMAX_DEPTH levels are open.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendBeginObject( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Appends the beginning of an indefinite-length CBOR array.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Array start was appended successfully.
+ * @retval eAzureIoTErrorJSONNestingOverflow More than #azureiotcborwriterMAX_DEPTH levels are open.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendBeginArray( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Appends the end of the CBOR map opened by AzureIoTCBORWriter_AppendBeginObject().
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Object end was appended successfully.
+ * @retval eAzureIoTErrorJSONInvalidState The innermost open container is not a map.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendEndObject( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Appends the end of the CBOR array opened by AzureIoTCBORWriter_AppendBeginArray().
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTCBORWriter_t.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Array end was appended successfully.
+ * @retval eAzureIoTErrorJSONInvalidState The innermost open container is not an array.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_AppendEndArray( AzureIoTCBORWriter_t * pxWriter );
+
+/**
+ * @brief Set the content type (`$.ct`) and, optionally, the content encoding (`$.ce`) system
+ * properties of a message carrying a CBOR payload.
+ *
+ * @param[in] pxProperties The #AzureIoTMessageProperties_t* to append the properties to.
+ * @param[in] pucContentEncoding The content encoding to set, or `NULL` to only set the content type.
+ * @param[in] ulContentEncodingLength Length of \p pucContentEncoding.
+ *
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTCBORWriter_SetMessageProperties( AzureIoTMessageProperties_t * pxProperties,
+                                                          const uint8_t * pucContentEncoding,
+                                                          uint32_t ulContentEncodingLength );
+
+#include "azure/core/_az_cfg_suffix.h"
+
+#endif /* AZURE_IOT_CBOR_WRITER_H */
@@ -0,0 +1,95 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_compression.h
+ *
+ * @brief Small-footprint LZSS codec used by the middleware to compress telemetry payloads.
+ *
+ * @details The encoded stream is a sequence of groups. Each group starts with a flag byte whose
+ * bits, least significant first, describe up to eight items. A set bit is a literal byte. A clear
+ * bit is a two byte back-reference: the first byte holds the low eight bits of the distance minus
+ * one, the second holds the high four bits of the distance minus one in its upper nibble and the
+ * match length minus three in its lower nibble. Distances go up to 4096 bytes and lengths from 3 to
+ * 18 bytes. No memory is allocated; the compressor indexes match candidates in a caller-provided,
+ * statically sized window buffer.
+ *
+ * @note You MUST NOT use any symbols (macros, functions, structures, enums, etc.)
+ * prefixed with an underscore ('_') directly in your application code. These symbols
+ * are part of Azure SDK's internal implementation; we do not document these symbols
+ * and they are subject to change in future versions of the SDK which would break your code.
+ *
+ */
+
+#ifndef AZURE_IOT_COMPRESSION_H
+#define AZURE_IOT_COMPRESSION_H
+
+#include <stdint.h>
+
+#include "azure_iot_result.h"
+
+/* Azure SDK for Embedded C includes */
+#include "azure/core/_az_cfg_prefix.h"
+
+/**
+ * @brief The content encoding set on messages carrying a payload produced by AzureIoTCompression_Compress().
+ */
+#define azureiotcompressionCONTENT_ENCODING       "lzss"
+
+/**
+ * @brief The minimum size of the window buffer passed to AzureIoTCompression_Compress().
+ *
+ * @note Larger buffers index more match candidates and usually compress better, up to the 4096 byte
+ * distance limit of the format.
+ */
+#define azureiotcompressionWINDOW_BUFFER_MIN      ( 64 )
+
+/**
+ * @brief The largest encoded size of \p x input bytes, reached when no match is found.
+ */
+#define azureiotcompressionMAX_ENCODED_SIZE( x )    ( ( x ) + ( ( ( x ) + 7 ) / 8 ) )
+
+/**
+ * @brief Compress a buffer.
+ *
+ * @param[in] pucInput The bytes to compress.
+ * @param[in] ulInputLength The length of \p pucInput.
+ * @param[out] pucOutput The buffer the compressed bytes are written to.
+ * @param[in] ulOutputLength The length of \p pucOutput.
+ * @param[out] pulOutputLength The number of bytes written to \p pucOutput.
+ * @param[in] pucWindowBuffer Scratch space indexing match candidates. It is overwritten.
+ * @param[in] ulWindowBufferLength The length of \p pucWindowBuffer, at least #azureiotcompressionWINDOW_BUFFER_MIN.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTSuccess The input was compressed.
+ * @retval eAzureIoTErrorOutOfMemory \p pucOutput is too small for the compressed bytes.
+ */
+AzureIoTResult_t AzureIoTCompression_Compress( const uint8_t * pucInput,
+                                               uint32_t ulInputLength,
+                                               uint8_t * pucOutput,
+                                               uint32_t ulOutputLength,
+                                               uint32_t * pulOutputLength,
+                                               uint8_t * pucWindowBuffer,
+                                               uint32_t ulWindowBufferLength );
+
+/**
+ * @brief Decompress a buffer produced by AzureIoTCompression_Compress().
+ *
+ * @param[in] pucInput The compressed bytes.
+ * @param[in] ulInputLength The length of \p pucInput.
+ * @param[out] pucOutput The buffer the decompressed bytes are written to.
+ * @param[in] ulOutputLength The length of \p pucOutput.
+ * @param[out] pulOutputLength The number of bytes written to \p pucOutput.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTSuccess The input was decompressed.
+ * @retval eAzureIoTErrorOutOfMemory \p pucOutput is too small for the decompressed bytes.
+ * @retval eAzureIoTErrorInvalidResponse \p pucInput is not a valid compressed stream.
+ */
+AzureIoTResult_t AzureIoTCompression_Decompress( const uint8_t * pucInput,
+                                                 uint32_t ulInputLength,
+                                                 uint8_t * pucOutput,
+                                                 uint32_t ulOutputLength,
+                                                 uint32_t * pulOutputLength );
+
+#include "azure/core/_az_cfg_suffix.h"
+
+#endif /* AZURE_IOT_COMPRESSION_H */
@@ -74,6 +74,112 @@
     #define azureiotconfigPROVISIONING_POLLING_INTERVAL_S    ( 3U )
 #endif
 
+/**
+ * @brief Max provisioning polling interval.
+ *
+ * @details The polling interval doubles with each status query of a registration, up to this value
+ *          or the retry-after hint of the service, whichever is larger.
+ */
+#ifndef azureiotconfigPROVISIONING_BACKOFF_MAX_S
+    #define azureiotconfigPROVISIONING_BACKOFF_MAX_S    ( 60U )
+#endif
+
+/**
+ * @brief Max random delay added to a provisioning polling interval, in percent of the interval.
+ *
+ * @details Spreads out the queries of devices which started registering at the same time.
+ */
+#ifndef azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT
+    #define azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT    ( 25U )
+#endif
+
+/**
+ * @brief First delay before AzureIoTHubClient_Run() reconnects a lost connection, in milliseconds.
+ *
+ * @details The delay doubles with each failed attempt, up to azureiotconfigRECONNECT_BACKOFF_MAX_S.
+ */
+#ifndef azureiotconfigRECONNECT_BACKOFF_BASE_MS
+    #define azureiotconfigRECONNECT_BACKOFF_BASE_MS    ( 1000U )
+#endif
+
+/**
+ * @brief Max delay between two reconnect attempts of AzureIoTHubClient_Run(), in seconds.
+ */
+#ifndef azureiotconfigRECONNECT_BACKOFF_MAX_S
+    #define azureiotconfigRECONNECT_BACKOFF_MAX_S    ( 120U )
+#endif
+
+/**
+ * @brief Max random delay added to a reconnect delay, in percent of the delay.
+ *
+ * @details Spreads out the reconnects of devices which lost their connection at the same time.
+ */
+#ifndef azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT
+    #define azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT    ( 50U )
+#endif
+
+/**
+ * @brief Time before the SAS token expires at which AzureIoTHubClient_Run() reconnects with a new one, in seconds.
+ */
+#ifndef azureiotconfigTOKEN_RENEWAL_MARGIN_S
+    #define azureiotconfigTOKEN_RENEWAL_MARGIN_S    ( 300U )
+#endif
+
+/**
+ * @brief Max random time by which a SAS token renewal is brought forward, in percent of the token lifetime.
+ *
+ * @details Spreads out the renewals of devices which connected at the same time.
+ */
+#ifndef azureiotconfigTOKEN_RENEWAL_JITTER_PERCENT
+    #define azureiotconfigTOKEN_RENEWAL_JITTER_PERCENT    ( 10U )
+#endif
+
+/**
+ * @brief Max JSON value length of a property tracked by the reported properties cache.
+ *
+ * @details Each cache entry stores the last acknowledged and the pending value of a property,
+ *          so an entry takes twice this size.
+ */
+#ifndef azureiotconfigPROPERTIES_CACHE_VALUE_MAX
+    #define azureiotconfigPROPERTIES_CACHE_VALUE_MAX    ( 32U )
+#endif
+
+/**
+ * @brief Max properties requests sent with a callback which can wait for their response at once.
+ *
+ */
+#ifndef azureiotconfigPROPERTIES_REQUESTS_MAX
+    #define azureiotconfigPROPERTIES_REQUESTS_MAX    ( 4U )
+#endif
+
+/**
+ * @brief Record the peak stack usage of the middleware entry points and callbacks.
+ *
+ * @details Set to 1 in development builds to read the peaks with AzureIoTStackProfile_GetPeak().
+ *          Profiling scans the stack of the calling task on every instrumented call. It requires
+ *          `INCLUDE_uxTaskGetStackHighWaterMark` and one thread local storage pointer, see
+ *          #azureiotconfigSTACK_PROFILING_TLS_INDEX.
+ */
+#ifndef azureiotconfigSTACK_PROFILING
+    #define azureiotconfigSTACK_PROFILING    ( 0 )
+#endif
+
+/**
+ * @brief Thread local storage pointer used by stack profiling to track nested instrumented calls.
+ *
+ */
+#ifndef azureiotconfigSTACK_PROFILING_TLS_INDEX
+    #define azureiotconfigSTACK_PROFILING_TLS_INDEX    ( 0 )
+#endif
+
+/**
+ * @brief Max stack depth, in bytes, below an instrumented call that stack profiling can measure.
+ *
+ */
+#ifndef azureiotconfigSTACK_PROFILING_DEPTH_MAX
+    #define azureiotconfigSTACK_PROFILING_DEPTH_MAX    ( 4096U )
+#endif
+
 /**
  * @brief Macro that is called in the Azure IoT middleware library for logging "Error" level
  * messages.
@@ -17,9 +17,13 @@
 #define AZURE_IOT_HUB_CLIENT_H
 
 #include "azure_iot.h"
+#include "azure_iot_buffer_size.h"
 #include "azure_iot_message.h"
+#include "azure_iot_compression.h"
+#include "azure_iot_json_writer.h"
 #include "azure_iot_result.h"
 
+#include "azure_iot_mqtt.h"
 #include "azure_iot_mqtt_port.h"
 #include "azure_iot_transport_interface.h"
 
@@ -172,6 +176,22 @@ typedef void ( * AzureIoTHubClientCommandCallback_t ) ( AzureIoTHubClientCommand
 typedef void ( * AzureIoTHubClientPropertiesCallback_t ) ( AzureIoTHubClientPropertiesResponse_t * pxMessage,
                                                            void * pvContext );
 
+/**
+ * @brief Callback to be invoked when the response to a properties request sent with
+ * AzureIoTHubClient_SendPropertiesReportedWithCallback() or AzureIoTHubClient_RequestPropertiesWithCallback()
+ * is received, or when the request timed out.
+ *
+ * @note If the request timed out, or the client reconnected before its response arrived, the message
+ * status is #eAzureIoTStatusTimeout and the message has no payload.
+ *
+ * @param[in] pxMessage The #AzureIoTHubClientPropertiesResponse_t associated with the request.
+ * @param[in] ulLatencyMilliseconds The time elapsed between sending the request and receiving its response.
+ * @param[in] pvContext The context passed back to the caller.
+ */
+typedef void ( * AzureIoTHubClientPropertiesRequestCallback_t ) ( AzureIoTHubClientPropertiesResponse_t * pxMessage,
+                                                                  uint32_t ulLatencyMilliseconds,
+                                                                  void * pvContext );
+
 /**
  * @brief Receive context to be used internally for the processing of messages.
  *
@@ -197,6 +217,23 @@ typedef struct AzureIoTHubClientReceiveContext
     } _internal; /**< @brief Internal to the SDK */
 } AzureIoTHubClientReceiveContext_t;
 
+/**
+ * @brief Properties request waiting for its response.
+ *
+ * @warning Used internally.
+ */
+typedef struct AzureIoTHubClientPropertiesRequest
+{
+    struct
+    {
+        uint32_t ulRequestID;
+        uint32_t ulSentTimeMilliseconds;
+        uint32_t ulTimeoutMilliseconds;
+        AzureIoTHubClientPropertiesRequestCallback_t xCallback;
+        void * pvCallbackContext;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTHubClientPropertiesRequest_t;
+
 /**
  * @brief Callback to send notification that puback was received for specific packet ID.
  *
@@ -205,6 +242,51 @@ typedef struct AzureIoTHubClientReceiveContext
  */
 typedef void (* AzureIoTTelemetryAckCallback_t)( uint16_t ulTelemetryPacketID );
 
+/**
+ * @brief Callback to lend the hub client a buffer for the MQTT username and password, for the
+ * duration of AzureIoTHubClient_Connect().
+ *
+ * @param[in] pvContext The context passed in the #AzureIoTHubClientOptions_t.
+ * @param[in] ulLength The number of bytes needed.
+ * @return A buffer of at least \p ulLength bytes, or NULL if none is available.
+ */
+typedef uint8_t * (* AzureIoTHubClientConnectBufferAcquire_t)( void * pvContext,
+                                                               uint32_t ulLength );
+
+/**
+ * @brief Callback to give back the buffer lent by #AzureIoTHubClientConnectBufferAcquire_t.
+ *
+ * @param[in] pvContext The context passed in the #AzureIoTHubClientOptions_t.
+ * @param[in] pucBuffer The buffer returned by the acquire callback.
+ */
+typedef void (* AzureIoTHubClientConnectBufferRelease_t)( void * pvContext,
+                                                          uint8_t * pucBuffer );
+
+/**
+ * @brief Callback to bring back the transport of the hub client, such as the TCP and TLS session,
+ * after the connection was lost.
+ *
+ * @note The callback should close the previous session, if needed, and open a new one on the
+ * #AzureIoTTransportInterface_t passed to AzureIoTHubClient_Init().
+ *
+ * @param[in] pvContext The context passed to AzureIoTHubClient_SetReconnect().
+ * @return #eAzureIoTSuccess once the transport is connected.
+ */
+typedef AzureIoTResult_t (* AzureIoTHubClientTransportReconnect_t)( void * pvContext );
+
+/**
+ * @brief Callback writing the JSON payload of AzureIoTHubClient_SendTelemetryStream().
+ *
+ * @note The callback is called twice, first to measure the payload and then to send it, and must
+ * write the same JSON text both times.
+ *
+ * @param[in] pxJSONWriter The #AzureIoTJSONWriter_t to write the payload with.
+ * @param[in] pvContext The context passed to AzureIoTHubClient_SendTelemetryStream().
+ * @return #eAzureIoTSuccess once the payload is written.
+ */
+typedef AzureIoTResult_t (* AzureIoTHubClientTelemetryWriter_t)( AzureIoTJSONWriter_t * pxJSONWriter,
+                                                                 void * pvContext );
+
 /**
  * @brief Options list for the hub client.
  */
@@ -225,6 +307,19 @@ typedef struct AzureIoTHubClientOptions
 
     AzureIoTTelemetryAckCallback_t xTelemetryCallback; /**< The callback to invoke to notify user a puback was received for QOS 1.
                                                         *   Can be NULL if user does not want to be notified.*/
+
+    bool xExactWorkingBuffer;                          /**< Size the working buffer from the hostname, device ID, module ID and model ID
+                                                        *   rather than from #azureiotconfigUSERNAME_MAX and #azureiotconfigPASSWORD_MAX.
+                                                        *   The rest of the buffer passed to AzureIoTHubClient_Init() goes to MQTT. */
+    uint32_t ulSymmetricKeyLengthMax;                  /**< With xExactWorkingBuffer, the largest key length AzureIoTHubClient_SetSymmetricKey()
+                                                        *   will be called with, or 0 to authenticate with X.509 certificates only. */
+
+    bool xTransientConnectBuffer;                      /**< Keep only #azureiotconfigTOPIC_MAX bytes of working buffer and borrow the space
+                                                        *   for the username and password during AzureIoTHubClient_Connect(): from
+                                                        *   xConnectBufferAcquire if set, otherwise from the end of the MQTT network buffer. */
+    AzureIoTHubClientConnectBufferAcquire_t xConnectBufferAcquire; /**< The optional callback lending the username and password buffer. */
+    AzureIoTHubClientConnectBufferRelease_t xConnectBufferRelease; /**< The optional callback to give the buffer back after CONNACK. */
+    void * pvConnectBufferContext;                                 /**< The context passed to the connect buffer callbacks. */
 } AzureIoTHubClientOptions_t;
 
 /**
@@ -239,6 +334,16 @@ struct AzureIoTHubClient
 
         uint8_t * pucWorkingBuffer;
         uint32_t ulWorkingBufferLength;
+        uint32_t ulUserNameBufferLength;
+        uint32_t ulPasswordBufferLength;
+        bool xExactWorkingBuffer;
+        uint32_t ulSymmetricKeyLengthMax;
+        uint8_t * pucNetworkBuffer;
+        uint32_t ulNetworkBufferLength;
+        bool xTransientConnectBuffer;
+        AzureIoTHubClientConnectBufferAcquire_t xConnectBufferAcquire;
+        AzureIoTHubClientConnectBufferRelease_t xConnectBufferRelease;
+        void * pvConnectBufferContext;
         az_iot_hub_client xAzureIoTHubClientCore;
 
         const uint8_t * pucHostname;
@@ -259,9 +364,56 @@ struct AzureIoTHubClient
         AzureIoTGetCurrentTimeFunc_t xTimeFunction;
         AzureIoTTelemetryAckCallback_t xTelemetryCallback;
 
+        uint8_t * pucCompressionBuffer;
+        uint32_t ulCompressionBufferLength;
+        uint8_t * pucCompressionWindow;
+        uint32_t ulCompressionWindowLength;
+
+        AzureIoTHubClientTransportReconnect_t xTransportReconnect;
+        void * pvTransportReconnectContext;
+        bool xReconnectPending;
+        uint32_t ulReconnectAttempts;
+        uint32_t ulReconnectTimeMilliseconds;
+        uint32_t ulReconnectJitterState;
+        uint64_t ullTokenExpiryTime;
+        uint64_t ullTokenRenewalTime;
+
         uint32_t ulCurrentPropertyRequestID;
+        AzureIoTHubClientPropertiesRequest_t xPropertiesRequests[ azureiotconfigPROPERTIES_REQUESTS_MAX ];
 
         AzureIoTHubClientReceiveContext_t xReceiveContext[ azureiothubSUBSCRIBE_FEATURE_COUNT ];
+
+        /* Payload bytes announced by a streamed telemetry PUBLISH and not sent yet. */
+        uint32_t ulStreamBytesRemaining;
+        /* A streamed PUBLISH stopped part way and nothing reconnects, sending waits for a new connection. */
+        bool xStreamOutOfSync;
+
+        /* Packet descriptions, kept here rather than on the caller's stack. Like the topic
+         * in the working buffer, they are only used by one call at a time. */
+        union
+        {
+            AzureIoTMQTTConnectInfo_t xConnectInfo;
+            AzureIoTMQTTPublishInfo_t xPublishInfo;
+        } xSendScratch;
+
+        union
+        {
+            struct
+            {
+                AzureIoTHubClientCloudToDeviceMessageRequest_t xMessage;
+                az_iot_hub_client_c2d_request xCoreRequest;
+            } xCloudToDevice;
+            struct
+            {
+                AzureIoTHubClientCommandRequest_t xMessage;
+                az_iot_hub_client_command_request xCoreRequest;
+            } xCommand;
+            struct
+            {
+                AzureIoTHubClientPropertiesResponse_t xMessage;
+                az_iot_hub_client_properties_message xCoreMessage;
+            } xProperties;
+        } xReceiveScratch;
     }
     _internal; /**< @brief Internal to the SDK */
 };
@@ -289,7 +441,11 @@ AzureIoTResult_t AzureIoTHubClient_OptionsInit( AzureIoTHubClientOptions_t * pxH
  * @param[in] ulDeviceIDLength The length of the device ID.
  * @param[in] pxHubClientOptions The #AzureIoTHubClientOptions_t for the IoT Hub client instance.
  * @param[in] pucBuffer The static buffer to use for middleware operations and MQTT messages until AzureIoTHubClient_Deinit is called.
- * @param[in] ulBufferLength The length of the \p pucBuffer.
+ * @param[in] ulBufferLength The length of the \p pucBuffer. The middleware keeps #azureiothubWORKING_BUFFER_SIZE bytes
+ * of it, or with #AzureIoTHubClientOptions_t.xExactWorkingBuffer, what the identity of the device needs (at least
+ * #azureiotconfigTOPIC_MAX bytes); the rest is the MQTT network buffer. With
+ * #AzureIoTHubClientOptions_t.xTransientConnectBuffer, only #azureiotconfigTOPIC_MAX bytes are kept and, unless
+ * a callback lends it, the network buffer must also fit the username and password next to the CONNECT packet.
  * @param[in] xGetTimeFunction A function pointer to a function which gives the current epoch time.
  * @param[in] pxTransportInterface The #AzureIoTTransportInterface_t to use for the MQTT library.
  * @return An #AzureIoTResult_t with the result of the operation.
@@ -321,7 +477,9 @@ void AzureIoTHubClient_Deinit( AzureIoTHubClient_t * pxAzureIoTHubClient );
  * @param[in] pucSymmetricKey The symmetric key to use for the connection.
  * @param[in] ulSymmetricKeyLength The length of the \p pucSymmetricKey.
  * @param[in] xHMACFunction The #AzureIoTGetHMACFunc_t function pointer to a function which computes the HMAC256 over a set of bytes.
- * @return An #AzureIoTResult_t with the result of the operation.
+ * @return An #AzureIoTResult_t with the result of the operation. #eAzureIoTErrorOutOfMemory if the client was
+ * initialized with #AzureIoTHubClientOptions_t.xExactWorkingBuffer and \p ulSymmetricKeyLength is larger than
+ * #AzureIoTHubClientOptions_t.ulSymmetricKeyLengthMax.
  */
 AzureIoTResult_t AzureIoTHubClient_SetSymmetricKey( AzureIoTHubClient_t * pxAzureIoTHubClient,
                                                     const uint8_t * pucSymmetricKey,
@@ -372,6 +530,62 @@ AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureI
                                                   AzureIoTHubMessageQoS_t xQOS,
                                                   uint16_t * pusTelemetryPacketID );
 
+/**
+ * @brief Send telemetry data to IoT Hub, streaming the JSON payload to the transport as it is written.
+ *
+ * The payload is never held in memory as a whole: \p xTelemetryWriter first writes it to a counting
+ * #AzureIoTJSONWriter_t to get its length for the MQTT PUBLISH header, then writes it again through
+ * \p pucChunk, which is sent each time it fills. Payloads sent this way are not compressed.
+ *
+ * @note If the payload cannot be sent in full, or \p xTelemetryWriter writes a different length the
+ * second time, the connection is left in the middle of a packet and cannot be used anymore. With
+ * AzureIoTHubClient_SetReconnect(), the next AzureIoTHubClient_Run() reconnects; otherwise sending
+ * and AzureIoTHubClient_ProcessLoop() fail until the application calls AzureIoTHubClient_Connect() again.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] xTelemetryWriter The #AzureIoTHubClientTelemetryWriter_t writing the payload.
+ * @param[in] pvContext The context passed to \p xTelemetryWriter.
+ * @param[in] pucChunk The buffer the payload is written to before being sent.
+ * @param[in] ulChunkLength The length of \p pucChunk, at least #azureiotjsonwriterCHUNK_SIZE_MIN.
+ * @param[in] pxProperties The property bag to send with the message.
+ * @param[in] xQOS The QOS to use for the telemetry. Only QOS `0` and `1` are supported.
+ * @param[out] pusTelemetryPacketID The packet id for the sent telemetry, as for AzureIoTHubClient_SendTelemetry().
+ *                                  Can be `NULL`.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTHubClient_SendTelemetryStream( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                        AzureIoTHubClientTelemetryWriter_t xTelemetryWriter,
+                                                        void * pvContext,
+                                                        uint8_t * pucChunk,
+                                                        uint32_t ulChunkLength,
+                                                        AzureIoTMessageProperties_t * pxProperties,
+                                                        AzureIoTHubMessageQoS_t xQOS,
+                                                        uint16_t * pusTelemetryPacketID );
+
+/**
+ * @brief Enable or disable compression of telemetry payloads sent with AzureIoTHubClient_SendTelemetry().
+ *
+ * When enabled, each telemetry payload is compressed with AzureIoTCompression_Compress() into
+ * \p pucCompressionBuffer. If the result is smaller than the original payload, the compressed
+ * payload is sent instead and the `$.ce` content encoding property of the message is set to
+ * #azureiotcompressionCONTENT_ENCODING. Otherwise the payload is sent unchanged.
+ *
+ * @note The compressed payload lives in \p pucCompressionBuffer until the next call to
+ * AzureIoTHubClient_SendTelemetry(), so the buffer must not be shared with other operations.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] pucCompressionBuffer The buffer compressed payloads are written to, or `NULL` to disable compression.
+ * @param[in] ulCompressionBufferLength The length of \p pucCompressionBuffer.
+ * @param[in] pucWindowBuffer The window buffer used by the compressor to index match candidates.
+ * @param[in] ulWindowBufferLength The length of \p pucWindowBuffer, at least #azureiotcompressionWINDOW_BUFFER_MIN.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTHubClient_SetTelemetryCompression( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                            uint8_t * pucCompressionBuffer,
+                                                            uint32_t ulCompressionBufferLength,
+                                                            uint8_t * pucWindowBuffer,
+                                                            uint32_t ulWindowBufferLength );
+
 /**
  * @brief Receive any incoming MQTT messages from and manage the MQTT connection to IoT Hub.
  *
@@ -385,6 +599,45 @@ AzureIoTResult_t AzureIoTHubClient_SendTelemetry( AzureIoTHubClient_t * pxAzureI
 AzureIoTResult_t AzureIoTHubClient_ProcessLoop( AzureIoTHubClient_t * pxAzureIoTHubClient,
                                                 uint32_t ulTimeoutMilliseconds );
 
+/**
+ * @brief Set how AzureIoTHubClient_Run() brings the transport back after the connection is lost.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] xTransportReconnect The #AzureIoTHubClientTransportReconnect_t reconnecting the transport.
+ * @param[in] pvContext The context passed to \p xTransportReconnect.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTHubClient_SetReconnect( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                 AzureIoTHubClientTransportReconnect_t xTransportReconnect,
+                                                 void * pvContext );
+
+/**
+ * @brief Run the connection to IoT Hub: AzureIoTHubClient_ProcessLoop() while connected, and reconnect
+ * when the connection is lost.
+ *
+ * When AzureIoTHubClient_ProcessLoop() fails, the client waits an exponentially growing, randomized
+ * delay (see #azureiotconfigRECONNECT_BACKOFF_BASE_MS), reconnects the transport with the callback set
+ * by AzureIoTHubClient_SetReconnect(), then the MQTT session with `xCleanSession` set to false. When the
+ * service did not keep the session, the cloud to device, command and properties subscriptions made
+ * before are restored, with the same callbacks.
+ *
+ * With a symmetric key, the client also reconnects with a new SAS token shortly before the current one
+ * expires (see #azureiotconfigTOKEN_RENEWAL_MARGIN_S), at a time picked at random per device. Until the
+ * client is reconnected, AzureIoTHubClient_SendTelemetry() returns #eAzureIoTErrorPending.
+ *
+ * @note AzureIoTHubClient_Connect() must have succeeded once before. While waiting to reconnect, the calling
+ * task is delayed for up to \p ulTimeoutMilliseconds.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] ulTimeoutMilliseconds Minimum time (in milliseconds) for the loop to run while connected, and the
+ * longest the call blocks while waiting to reconnect.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ *      - eAzureIoTSuccess the client is connected.
+ *      - eAzureIoTErrorPending the connection was lost and the client is reconnecting; call again.
+ */
+AzureIoTResult_t AzureIoTHubClient_Run( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                        uint32_t ulTimeoutMilliseconds );
+
 /**
  * @brief Subscribe to cloud to device messages.
  *
@@ -497,6 +750,56 @@ AzureIoTResult_t AzureIoTHubClient_SendPropertiesReported( AzureIoTHubClient_t *
  */
 AzureIoTResult_t AzureIoTHubClient_RequestPropertiesAsync( AzureIoTHubClient_t * pxAzureIoTHubClient );
 
+/**
+ * @brief Send reported device properties to Azure IoT Hub and get their response through a dedicated callback.
+ *
+ * @note AzureIoTHubClient_SubscribeProperties() must be called before calling this function.
+ *
+ * Unlike AzureIoTHubClient_SendPropertiesReported(), the response is not passed to the #AzureIoTHubClientPropertiesCallback_t
+ * but to \p xCallback, so several requests can be in flight at once. Up to #azureiotconfigPROPERTIES_REQUESTS_MAX
+ * requests can wait for their response. Timeouts are checked by AzureIoTHubClient_ProcessLoop().
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] pucReportedPayload The payload of properly formatted, reported properties.
+ * @param[in] ulReportedPayloadLength The length of the reported property payload.
+ * @param[in] xCallback The #AzureIoTHubClientPropertiesRequestCallback_t to invoke with the response.
+ * @param[in] pvCallbackContext Context passed to \p xCallback.
+ * @param[in] ulTimeoutMilliseconds Time to wait for the response before invoking \p xCallback with a timeout status.
+ * Zero waits until the response is received.
+ * @param[out] pulRequestID Pointer to request ID used to send the reported property. This can be `NULL`.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTErrorOutOfMemory Too many requests are waiting for their response.
+ */
+AzureIoTResult_t AzureIoTHubClient_SendPropertiesReportedWithCallback( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                       const uint8_t * pucReportedPayload,
+                                                                       uint32_t ulReportedPayloadLength,
+                                                                       AzureIoTHubClientPropertiesRequestCallback_t xCallback,
+                                                                       void * pvCallbackContext,
+                                                                       uint32_t ulTimeoutMilliseconds,
+                                                                       uint32_t * pulRequestID );
+
+/**
+ * @brief Request to get the device property document and get the response through a dedicated callback.
+ *
+ * @note AzureIoTHubClient_SubscribeProperties() must be called before calling this function.
+ *
+ * See AzureIoTHubClient_SendPropertiesReportedWithCallback() for how the response is delivered.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t * to use for this call.
+ * @param[in] xCallback The #AzureIoTHubClientPropertiesRequestCallback_t to invoke with the response.
+ * @param[in] pvCallbackContext Context passed to \p xCallback.
+ * @param[in] ulTimeoutMilliseconds Time to wait for the response before invoking \p xCallback with a timeout status.
+ * Zero waits until the response is received.
+ * @param[out] pulRequestID Pointer to request ID used to request the document. This can be `NULL`.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTErrorOutOfMemory Too many requests are waiting for their response.
+ */
+AzureIoTResult_t AzureIoTHubClient_RequestPropertiesWithCallback( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                  AzureIoTHubClientPropertiesRequestCallback_t xCallback,
+                                                                  void * pvCallbackContext,
+                                                                  uint32_t ulTimeoutMilliseconds,
+                                                                  uint32_t * pulRequestID );
+
 #include "azure/core/_az_cfg_suffix.h"
 
 #endif /* AZURE_IOT_HUB_CLIENT_H */
@@ -313,6 +313,290 @@ AzureIoTResult_t AzureIoTHubClientProperties_GetNextComponentProperty( AzureIoTH
                                                                        const uint8_t ** ppucComponentName,
                                                                        uint32_t * pulComponentNameLength );
 
+/**
+ * @brief A property tracked by an #AzureIoTHubClientPropertiesCache_t.
+ *
+ */
+typedef struct AzureIoTHubClientPropertiesCacheEntry
+{
+    struct
+    {
+        const uint8_t * pucName;
+        uint16_t usNameLength;
+        uint16_t usFlags;
+        uint16_t usAckedValueLength;
+        uint16_t usPendingValueLength;
+        uint8_t ucAckedValue[ azureiotconfigPROPERTIES_CACHE_VALUE_MAX ];
+        uint8_t ucPendingValue[ azureiotconfigPROPERTIES_CACHE_VALUE_MAX ];
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTHubClientPropertiesCacheEntry_t;
+
+/**
+ * @brief Cache of reported properties used to only send the properties whose value changed.
+ *
+ * The cache keeps the last value of each property acknowledged by IoT Hub. Values set through
+ * AzureIoTHubClientProperties_CacheSet() which differ from it are coalesced into one reported
+ * properties PATCH by AzureIoTHubClientProperties_SendReportedDelta().
+ *
+ */
+typedef struct AzureIoTHubClientPropertiesCache
+{
+    struct
+    {
+        AzureIoTHubClientPropertiesCacheEntry_t * pxEntries;
+        uint32_t ulEntryCount;
+        uint32_t ulEntriesUsed;
+        uint32_t ulInFlightRequestID;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTHubClientPropertiesCache_t;
+
+/**
+ * @brief Initialize a reported properties cache.
+ *
+ * @param[out] pxCache The #AzureIoTHubClientPropertiesCache_t to initialize.
+ * @param[in] pxEntries The storage for the tracked properties, one entry per property. It must stay
+ * valid for the lifetime of \p pxCache.
+ * @param[in] ulEntryCount The number of entries in \p pxEntries.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The cache was initialized.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_CacheInit( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                        AzureIoTHubClientPropertiesCacheEntry_t * pxEntries,
+                                                        uint32_t ulEntryCount );
+
+/**
+ * @brief Set the value of a reported property.
+ *
+ * The property is marked for sending only if \p pucValue differs from the value last acknowledged
+ * by IoT Hub. Setting the same property several times before sending only sends the last value.
+ *
+ * @param[in] pxCache The #AzureIoTHubClientPropertiesCache_t to use for this call.
+ * @param[in] pucName The name of the property. It is not copied and must stay valid for the lifetime
+ * of \p pxCache.
+ * @param[in] usNameLength The length of \p pucName.
+ * @param[in] pucValue The value of the property as JSON text, for example `23`, `true` or `"on"`.
+ * @param[in] ulValueLength The length of \p pucValue, at most #azureiotconfigPROPERTIES_CACHE_VALUE_MAX.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The value was set.
+ * @retval eAzureIoTErrorOutOfMemory All the cache entries are used by other properties.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_CacheSet( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                       const uint8_t * pucName,
+                                                       uint16_t usNameLength,
+                                                       const uint8_t * pucValue,
+                                                       uint32_t ulValueLength );
+
+/**
+ * @brief Send the properties which changed since their last acknowledged value in one reported
+ * properties message.
+ *
+ * The payload is of the form `{"<name>":<value>,...}`. The properties sent are in flight until
+ * the response is passed to AzureIoTHubClientProperties_CacheProcessResponse(). Only one message
+ * can be in flight at a time; properties set meanwhile are sent by the next call.
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t to use for this call.
+ * @param[in] pxCache The #AzureIoTHubClientPropertiesCache_t to use for this call.
+ * @param[out] pucPayloadBuffer The buffer the JSON payload is written to.
+ * @param[in] ulPayloadBufferLength The length of \p pucPayloadBuffer.
+ * @param[out] pulRequestId Pointer to request ID used to send the reported property. Set to zero
+ * when nothing was sent. This can be `NULL`.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The changed properties were sent, or no property changed.
+ * @retval eAzureIoTErrorPending The response to the previous message was not processed yet.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_SendReportedDelta( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                                AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                                uint8_t * pucPayloadBuffer,
+                                                                uint32_t ulPayloadBufferLength,
+                                                                uint32_t * pulRequestId );
+
+/**
+ * @brief Update the cache with the response to a message sent by
+ * AzureIoTHubClientProperties_SendReportedDelta().
+ *
+ * Call this from the #AzureIoTHubClientPropertiesCallback_t. On a success status the values sent
+ * become the acknowledged ones, otherwise they are sent again by the next
+ * AzureIoTHubClientProperties_SendReportedDelta().
+ *
+ * @param[in] pxCache The #AzureIoTHubClientPropertiesCache_t to use for this call.
+ * @param[in] pxResponse The #AzureIoTHubClientPropertiesResponse_t received.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The response was for the message in flight and the cache was updated.
+ * @retval eAzureIoTErrorItemNotFound The response is not for the message in flight.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_CacheProcessResponse( AzureIoTHubClientPropertiesCache_t * pxCache,
+                                                                   const AzureIoTHubClientPropertiesResponse_t * pxResponse );
+
+/**
+ * @brief Give up on the message in flight, for example after reconnecting, and send its properties
+ * again on the next AzureIoTHubClientProperties_SendReportedDelta().
+ *
+ * @param[in] pxCache The #AzureIoTHubClientPropertiesCache_t to use for this call.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The message in flight was dropped.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_CacheCancelInFlight( AzureIoTHubClientPropertiesCache_t * pxCache );
+
+/**
+ * @brief A property or writable property acknowledgement added to an #AzureIoTHubClientPropertiesBatch_t.
+ *
+ */
+typedef struct AzureIoTHubClientPropertiesBatchEntry
+{
+    struct
+    {
+        const uint8_t * pucComponentName;
+        uint16_t usComponentNameLength;
+        uint16_t usPropertyNameLength;
+        const uint8_t * pucPropertyName;
+        const uint8_t * pucValue;
+        uint32_t ulValueLength;
+        const uint8_t * pucAckDescription;
+        uint16_t usAckDescriptionLength;
+        bool xIsResponseStatus;
+        int32_t lAckCode;
+        int32_t lAckVersion;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTHubClientPropertiesBatchEntry_t;
+
+/**
+ * @brief Reported properties of several components, and acknowledgements of writable properties,
+ * written in one reported properties message.
+ *
+ * An upper bound of the payload length is known as entries are added, so the payload buffer can be
+ * sized before anything is written and the payload is written in a single pass. This replaces
+ * sequencing AzureIoTHubClientProperties_BuilderBeginComponent(),
+ * AzureIoTHubClientProperties_BuilderBeginResponseStatus() and their end counterparts by hand.
+ *
+ */
+typedef struct AzureIoTHubClientPropertiesBatch
+{
+    struct
+    {
+        AzureIoTHubClientPropertiesBatchEntry_t * pxEntries;
+        uint32_t ulEntryCount;
+        uint32_t ulEntriesUsed;
+        uint32_t ulPayloadLengthMax;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTHubClientPropertiesBatch_t;
+
+/**
+ * @brief Initialize an empty reported properties batch.
+ *
+ * @param[out] pxBatch The #AzureIoTHubClientPropertiesBatch_t to initialize.
+ * @param[in] pxEntries The storage for the properties, one entry per property. It must stay valid
+ * for the lifetime of \p pxBatch.
+ * @param[in] ulEntryCount The number of entries in \p pxEntries.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The batch was initialized.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_BatchInit( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                        AzureIoTHubClientPropertiesBatchEntry_t * pxEntries,
+                                                        uint32_t ulEntryCount );
+
+/**
+ * @brief Add a reported property to a batch.
+ *
+ * Properties of the same component are written in the same component object, in the order they
+ * were added. The names and value are not copied and must stay valid until the batch is written.
+ *
+ * @param[in] pxBatch The #AzureIoTHubClientPropertiesBatch_t to use for this call.
+ * @param[in] pucComponentName The name of the component, or `NULL` for a property of the root component.
+ * @param[in] usComponentNameLength The length of \p pucComponentName.
+ * @param[in] pucPropertyName The name of the property.
+ * @param[in] usPropertyNameLength The length of \p pucPropertyName.
+ * @param[in] pucValue The value of the property as JSON text, for example `23`, `true` or `"on"`.
+ * @param[in] ulValueLength The length of \p pucValue.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The property was added.
+ * @retval eAzureIoTErrorOutOfMemory All the batch entries are used.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_BatchAddProperty( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                               const uint8_t * pucComponentName,
+                                                               uint16_t usComponentNameLength,
+                                                               const uint8_t * pucPropertyName,
+                                                               uint16_t usPropertyNameLength,
+                                                               const uint8_t * pucValue,
+                                                               uint32_t ulValueLength );
+
+/**
+ * @brief Add the acknowledgement of a writable property to a batch.
+ *
+ * Written as AzureIoTHubClientProperties_BuilderBeginResponseStatus() does, with \p pucValue as
+ * the value. The names, value and description are not copied and must stay valid until the batch
+ * is written.
+ *
+ * @param[in] pxBatch The #AzureIoTHubClientPropertiesBatch_t to use for this call.
+ * @param[in] pucComponentName The name of the component, or `NULL` for a property of the root component.
+ * @param[in] usComponentNameLength The length of \p pucComponentName.
+ * @param[in] pucPropertyName The name of the property.
+ * @param[in] usPropertyNameLength The length of \p pucPropertyName.
+ * @param[in] pucValue The value of the property as JSON text.
+ * @param[in] ulValueLength The length of \p pucValue.
+ * @param[in] lAckCode The HTTP-like status code to respond with. See #AzureIoTHubMessageStatus_t for
+ * possible supported values.
+ * @param[in] lAckVersion The version of the property the application is acknowledging.
+ * @param[in] pucAckDescription An optional description detailing the context or any details about
+ * the acknowledgement. This can be `NULL`.
+ * @param[in] usAckDescriptionLength The length of \p pucAckDescription.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The acknowledgement was added.
+ * @retval eAzureIoTErrorOutOfMemory All the batch entries are used.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_BatchAddResponseStatus( AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                                     const uint8_t * pucComponentName,
+                                                                     uint16_t usComponentNameLength,
+                                                                     const uint8_t * pucPropertyName,
+                                                                     uint16_t usPropertyNameLength,
+                                                                     const uint8_t * pucValue,
+                                                                     uint32_t ulValueLength,
+                                                                     int32_t lAckCode,
+                                                                     int32_t lAckVersion,
+                                                                     const uint8_t * pucAckDescription,
+                                                                     uint16_t usAckDescriptionLength );
+
+/**
+ * @brief Get the largest length of the payload AzureIoTHubClientProperties_BatchWrite() writes.
+ *
+ * Values are counted as they were added. The payload is shorter when they hold whitespace
+ * outside strings, which is not written.
+ *
+ * @param[in] pxBatch The #AzureIoTHubClientPropertiesBatch_t to use for this call.
+ *
+ * @return The largest length of the payload in bytes, 0 if \p pxBatch is `NULL`.
+ */
+uint32_t AzureIoTHubClientProperties_BatchGetPayloadLengthMax( const AzureIoTHubClientPropertiesBatch_t * pxBatch );
+
+/**
+ * @brief Write the properties of a batch as one reported properties payload.
+ *
+ * The payload can then be sent with AzureIoTHubClient_SendPropertiesReported(). Nothing is written
+ * unless \p ulPayloadBufferLength is at least AzureIoTHubClientProperties_BatchGetPayloadLengthMax().
+ *
+ * @param[in] pxAzureIoTHubClient The #AzureIoTHubClient_t to use for this call.
+ * @param[in] pxBatch The #AzureIoTHubClientPropertiesBatch_t to use for this call.
+ * @param[out] pucPayloadBuffer The buffer the JSON payload is written to.
+ * @param[in] ulPayloadBufferLength The length of \p pucPayloadBuffer.
+ * @param[out] pulPayloadLength The length of the payload written.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The payload was written.
+ * @retval eAzureIoTErrorOutOfMemory \p pucPayloadBuffer is too small for the payload.
+ */
+AzureIoTResult_t AzureIoTHubClientProperties_BatchWrite( AzureIoTHubClient_t * pxAzureIoTHubClient,
+                                                         const AzureIoTHubClientPropertiesBatch_t * pxBatch,
+                                                         uint8_t * pucPayloadBuffer,
+                                                         uint32_t ulPayloadBufferLength,
+                                                         uint32_t * pulPayloadLength );
+
 #include "azure/core/_az_cfg_suffix.h"
 
 #endif /*AZURE_IOT_HUB_CLIENT_PROPERTIES_H */
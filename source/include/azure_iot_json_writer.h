@@ -25,6 +25,34 @@
 #include "azure/core/az_json.h"
 #include "azure/core/_az_cfg_prefix.h"
 
+/**
+ * @brief The smallest chunk accepted by AzureIoTJSONWriter_InitChunked().
+ *
+ * In chunked mode the core writer asks for 64 contiguous bytes (`_az_MINIMUM_STRING_CHUNK_SIZE`)
+ * to write any string longer than a few bytes, so a smaller chunk cannot hold it.
+ */
+#define azureiotjsonwriterCHUNK_SIZE_MIN         ( 64 )
+
+/**
+ * @brief The largest single write a counting #AzureIoTJSONWriter_t can account for.
+ *
+ * A counting writer produces its output into a scratch chunk of this size which is then discarded.
+ */
+#define azureiotjsonwriterCOUNTING_CHUNK_SIZE    ( 128 )
+
+/**
+ * @brief Callback which takes the JSON text of a chunked #AzureIoTJSONWriter_t as its chunk fills.
+ *
+ * @param[in] pvContext The context passed to AzureIoTJSONWriter_InitChunked().
+ * @param[in] pucData The JSON text written since the last call.
+ * @param[in] ulDataLength The length of \p pucData.
+ *
+ * @return #eAzureIoTSuccess if the text was consumed, otherwise the append being written fails.
+ */
+typedef AzureIoTResult_t ( * AzureIoTJSONWriterFlush_t )( void * pvContext,
+                                                          const uint8_t * pucData,
+                                                          uint32_t ulDataLength );
+
 /**
  * @brief The struct to use for Azure IoT JSON writer functionality.
  */
@@ -33,23 +61,71 @@ typedef struct AzureIoTJSONWriter
     struct
     {
         az_json_writer xCoreWriter;
+        uint32_t ulBytesFlushed;
+        uint8_t * pucChunk;
+        uint32_t ulChunkLength;
+        uint32_t ulChunkBytesFlushed;
+        AzureIoTJSONWriterFlush_t xFlush;
+        void * pvFlushContext;
     } _internal; /**< @brief Internal to the SDK */
 } AzureIoTJSONWriter_t;
 
 /**
  * @brief Initializes an #AzureIoTJSONWriter_t which writes JSON text into a buffer passed.
  *
+ * When \p pucBuffer is `NULL` and \p ulBufferSize is 0, the writer only counts: the append
+ * functions write nothing and AzureIoTJSONWriter_GetBytesUsed() returns the length the JSON
+ * text would have. Running the same appends through a counting writer first gives the exact
+ * size of the buffer to allocate.
+ *
  * @param[out] pxWriter A pointer to an #AzureIoTJSONWriter_t the instance to initialize.
- * @param[in] pucBuffer A buffer pointer to which JSON text will be written.
- * @param[in] ulBufferSize Length of buffer.
+ * @param[in] pucBuffer A buffer pointer to which JSON text will be written, or `NULL` to count.
+ * @param[in] ulBufferSize Length of buffer, or 0 to count.
  *
  * @return An #AzureIoTResult_t value indicating the result of the operation.
  * @retval eAzureIoTSuccess Successfully initialized JSON writer.
+ *
+ * @note In counting mode, an append which needs more than #azureiotjsonwriterCOUNTING_CHUNK_SIZE
+ * contiguous bytes fails, as it would with a buffer too small.
  */
 AzureIoTResult_t AzureIoTJSONWriter_Init( AzureIoTJSONWriter_t * pxWriter,
                                           uint8_t * pucBuffer,
                                           uint32_t ulBufferSize );
 
+/**
+ * @brief Initializes an #AzureIoTJSONWriter_t which writes JSON text through a small chunk,
+ * passed to \p xFlush each time it fills.
+ *
+ * The whole JSON text is never held in memory, so it can be larger than any buffer the application
+ * has. Call AzureIoTJSONWriter_Flush() once done to pass the end of the text to \p xFlush.
+ * AzureIoTJSONWriter_GetBytesUsed() returns the length of the text written so far, flushed or not.
+ *
+ * @param[out] pxWriter A pointer to an #AzureIoTJSONWriter_t the instance to initialize.
+ * @param[in] pucChunk The buffer the JSON text is written to before being flushed.
+ * @param[in] ulChunkSize Length of \p pucChunk, at least #azureiotjsonwriterCHUNK_SIZE_MIN. An append
+ * which needs more contiguous bytes fails.
+ * @param[in] xFlush The #AzureIoTJSONWriterFlush_t taking the JSON text.
+ * @param[in] pvFlushContext The context passed to \p xFlush.
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess Successfully initialized JSON writer.
+ */
+AzureIoTResult_t AzureIoTJSONWriter_InitChunked( AzureIoTJSONWriter_t * pxWriter,
+                                                 uint8_t * pucChunk,
+                                                 uint32_t ulChunkSize,
+                                                 AzureIoTJSONWriterFlush_t xFlush,
+                                                 void * pvFlushContext );
+
+/**
+ * @brief Pass the JSON text not flushed yet to the #AzureIoTJSONWriterFlush_t of a chunked writer.
+ *
+ * @param[in] pxWriter A pointer to an #AzureIoTJSONWriter_t initialized with AzureIoTJSONWriter_InitChunked().
+ *
+ * @return An #AzureIoTResult_t value indicating the result of the operation.
+ * @retval eAzureIoTSuccess The JSON text written so far was flushed.
+ */
+AzureIoTResult_t AzureIoTJSONWriter_Flush( AzureIoTJSONWriter_t * pxWriter );
+
 /**
  * @brief Appends the UTF-8 property name and value where value is int32
  *
@@ -128,7 +204,8 @@ AzureIoTResult_t AzureIoTJSONWriter_AppendPropertyWithStringValue( AzureIoTJSONW
  *
  * @param[in] pxWriter A pointer to an #AzureIoTJSONWriter_t.
  *
- * @return An int32_t containing the length of JSON text built so far. Will return -1 if there was an error.
+ * @return An int32_t containing the length of JSON text built so far, or counted so far for a
+ * counting writer. Will return -1 if there was an error.
  */
 int32_t AzureIoTJSONWriter_GetBytesUsed( AzureIoTJSONWriter_t * pxWriter );
 
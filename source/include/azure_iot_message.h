@@ -23,6 +23,9 @@
 #include "azure/iot/az_iot_hub_client_properties.h"
 #include "azure/core/_az_cfg_prefix.h"
 
+#define azureiotmessagePROPERTY_CONTENT_TYPE        "$.ct" /**< @brief System property name for the content type of the payload. */
+#define azureiotmessagePROPERTY_CONTENT_ENCODING    "$.ce" /**< @brief System property name for the content encoding of the payload. */
+
 /**
  * @brief The bag of properties associated with a message.
  *
@@ -35,6 +38,35 @@ typedef struct AzureIoTMessageProperties
     } _internal; /**< @brief Internal to the SDK */
 } AzureIoTMessageProperties_t;
 
+/**
+ * @brief A slot of an #AzureIoTMessagePropertiesIndex_t.
+ *
+ */
+typedef struct AzureIoTMessagePropertiesIndexEntry
+{
+    struct
+    {
+        const uint8_t * pucName;
+        uint32_t ulNameLength;
+        const uint8_t * pucValue;
+        uint32_t ulValueLength;
+        uint32_t ulHash;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTMessagePropertiesIndexEntry_t;
+
+/**
+ * @brief A hash index over the names of an #AzureIoTMessageProperties_t.
+ *
+ */
+typedef struct AzureIoTMessagePropertiesIndex
+{
+    struct
+    {
+        AzureIoTMessagePropertiesIndexEntry_t * pxEntries;
+        uint32_t ulEntryCount;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTMessagePropertiesIndex_t;
+
 /**
  * @brief Initialize the message properties.
  *
@@ -99,6 +131,51 @@ AzureIoTResult_t AzureIoTMessage_PropertiesFind( AzureIoTMessageProperties_t * p
                                                  const uint8_t ** ppucOutValue,
                                                  uint32_t * pulOutValueLength );
 
+/**
+ * @brief Index the names of a message property bag in a single pass.
+ *
+ * Later lookups through AzureIoTMessage_PropertiesIndexFind() hash the name and
+ * return the value span found while indexing, instead of scanning the property
+ * string again as AzureIoTMessage_PropertiesFind() does.
+ *
+ * @note The index points into the buffer of \p pxMessageProperties, which must stay
+ *       valid and unchanged for as long as the index is used. Values are returned as
+ *       they appear in the bag, exactly as AzureIoTMessage_PropertiesFind() returns them.
+ *
+ * @note \p ulEntryCount must be at least the number of properties in the bag. Around
+ *       twice that number keeps probe sequences short.
+ *
+ * @param[in] pxMessageProperties The #AzureIoTMessageProperties_t* to index.
+ * @param[out] pxIndex The #AzureIoTMessagePropertiesIndex_t* to initialize.
+ * @param[in] pxEntries The caller provided array of index slots.
+ * @param[in] ulEntryCount The number of slots in \p pxEntries.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTErrorOutOfMemory If the bag has more properties than \p ulEntryCount. The index
+ * is then left unusable, and AzureIoTMessage_PropertiesIndexFind() fails with #eAzureIoTErrorInvalidArgument.
+ */
+AzureIoTResult_t AzureIoTMessage_PropertiesIndexBuild( AzureIoTMessageProperties_t * pxMessageProperties,
+                                                       AzureIoTMessagePropertiesIndex_t * pxIndex,
+                                                       AzureIoTMessagePropertiesIndexEntry_t * pxEntries,
+                                                       uint32_t ulEntryCount );
+
+/**
+ * @brief Find a property through an index built by AzureIoTMessage_PropertiesIndexBuild().
+ *
+ * @note If a name appears more than once in the bag, the first value is returned.
+ *
+ * @param[in] pxIndex The #AzureIoTMessagePropertiesIndex_t* to use for the operation.
+ * @param[in] pucName The name of the property to find.
+ * @param[in] ulNameLength Length of the property name.
+ * @param[out] ppucOutValue The output pointer to the property value.
+ * @param[out] pulOutValueLength The length of \p ppucOutValue.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTMessage_PropertiesIndexFind( const AzureIoTMessagePropertiesIndex_t * pxIndex,
+                                                      const uint8_t * pucName,
+                                                      uint32_t ulNameLength,
+                                                      const uint8_t ** ppucOutValue,
+                                                      uint32_t * pulOutValueLength );
+
 #include "azure/core/_az_cfg_suffix.h"
 
 #endif /* AZURE_IOT_MESSAGE_H */
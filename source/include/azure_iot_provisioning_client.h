@@ -18,8 +18,10 @@
 #include "FreeRTOS.h"
 
 #include "azure_iot.h"
+#include "azure_iot_buffer_size.h"
 
 #include "azure_iot_result.h"
+#include "azure_iot_mqtt.h"
 #include "azure_iot_mqtt_port.h"
 #include "azure_iot_transport_interface.h"
 
@@ -28,11 +30,6 @@
 #include "azure/iot/az_iot_provisioning_client.h"
 #include "azure/core/_az_cfg_prefix.h"
 
-/**
- * @brief The maximum size of the response buffer.
- */
-#define azureiotprovisioningRESPONSE_MAX    ( azureiotconfigTOPIC_MAX + azureiotconfigPROVISIONING_REQUEST_PAYLOAD_MAX )
-
 #define azureiotprovisioningNO_WAIT         ( 0 )                       /**< @brief Do not wait on the function call */
 #define azureiotprovisioningWAIT_FOREVER    ( ( uint32_t ) 0xFFFFFFFF ) /**< @brief Wait as long as it takes to complete the operation (success or failure) */
 
@@ -43,6 +40,7 @@ typedef struct AzureIoTProvisioningClientOptions
 {
     const uint8_t * pucUserAgent; /**< The user agent to use for this device. */
     uint32_t ulUserAgentLength;   /**< The length of the user agent. */
+    uint32_t ulRetryBudget;       /**< The max number of status queries for a registration, 0 for no limit. */
 } AzureIoTProvisioningClientOptions_t;
 
 /**
@@ -79,14 +77,27 @@ typedef struct AzureIoTProvisioningClient
 
         uint32_t ulWorkflowState;
         uint32_t ulLastOperationResult;
-        uint64_t ullRetryAfter;
+        uint32_t ulRetryTimeMilliseconds;
+        uint32_t ulRetryCount;
+        uint32_t ulRetryBudget;
+        uint32_t ulJitterState;
+
+        uint32_t ulMQTTConnected;
+        uint32_t ulMQTTSubscribed;
 
         uint8_t * pucScratchBuffer;
         uint32_t ulScratchBufferLength;
-        uint8_t ucProvisioningLastResponse[ azureiotprovisioningRESPONSE_MAX ];
-        size_t xLastResponsePayloadLength;
-        uint16_t usLastResponseTopicLength;
+        uint32_t ulBufferLength;
+        uint8_t * pucLastResponse;
+        uint32_t ulLastResponseLength;
         az_iot_provisioning_client_register_response xRegisterResponse;
+
+        /* Packet descriptions, kept here rather than on the stack of the workflow. */
+        union
+        {
+            AzureIoTMQTTConnectInfo_t xConnectInfo;
+            AzureIoTMQTTPublishInfo_t xPublishInfo;
+        } xSendScratch;
     } _internal; /**< @brief Internal to the SDK */
 } AzureIoTProvisioningClient_t;
 
@@ -109,8 +120,10 @@ AzureIoTResult_t AzureIoTProvisioningClient_OptionsInit( AzureIoTProvisioningCli
  * @param[in] pucRegistrationID The registration ID to use for provisioning.
  * @param[in] ulRegistrationIDLength The length of the registration ID.
  * @param[in] pxProvisioningClientOptions The #AzureIoTProvisioningClientOptions_t for the IoT Provisioning client instance.
- * @param[in] pucBuffer The buffer to use for MQTT messages.
- * @param[in] ulBufferLength bufferLength The length of the \p pucBuffer.
+ * @param[in] pucBuffer The buffer to use for MQTT messages and the last service response. The hub info returned
+ * by AzureIoTProvisioningClient_GetDeviceAndHub() is read from it, so it can only be reused once that is done.
+ * @param[in] ulBufferLength bufferLength The length of the \p pucBuffer. Besides room for MQTT messages, it must
+ * hold #azureiotprovisioningRESPONSE_STATE_MAX bytes for the response. See #azureiotprovisioningBUFFER_SIZE_MIN.
  * @param[in] xGetTimeFunction A function pointer to a function which gives the current epoch time.
  * @param[in] pxTransportInterface The transport interface to use for the MQTT library.
  * @return AzureIoTResult_t
@@ -135,6 +148,25 @@ AzureIoTResult_t AzureIoTProvisioningClient_Init( AzureIoTProvisioningClient_t *
  */
 void AzureIoTProvisioningClient_Deinit( AzureIoTProvisioningClient_t * pxAzureProvClient );
 
+/**
+ * @brief Hand the buffer passed to AzureIoTProvisioningClient_Init() back to the application, for example to
+ * pass it to AzureIoTHubClient_Init().
+ *
+ * The MQTT connection with the provisioning service is disconnected and the client is deinitialized, so it
+ * can not be used anymore. Closing the transport connection is left to the application.
+ *
+ * @note The hub info is kept in the buffer. Copy it out with AzureIoTProvisioningClient_GetDeviceAndHub(),
+ * into memory outside the buffer, or save it with AzureIoTProvisioningClient_SaveResult() before calling this function.
+ *
+ * @param[in] pxAzureProvClient The #AzureIoTProvisioningClient_t * to use for this call.
+ * @param[out] ppucBuffer The buffer passed to AzureIoTProvisioningClient_Init().
+ * @param[out] pulBufferLength The length of \p ppucBuffer.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTProvisioningClient_ReleaseBuffer( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                           uint8_t ** ppucBuffer,
+                                                           uint32_t * pulBufferLength );
+
 /**
  * @brief Set the symmetric key to use for authentication.
  *
@@ -166,12 +198,45 @@ AzureIoTResult_t AzureIoTProvisioningClient_SetSymmetricKey( AzureIoTProvisionin
  *      - eAzureIoTErrorPending registration is still in progess.
  *      - eAzureIoTErrorOutOfMemory registration failed because the device is out of memory.
  *      - eAzureIoTErrorServerError registration failed because of a server error.
- *      - eAzureIoTErrorFailed registration failed because of an internal error.
+ *      - eAzureIoTErrorFailed registration failed because of an internal error, or the retry budget
+ *        set in #AzureIoTProvisioningClientOptions_t ran out.
  *      - eAzureIoTSuccess registration is completed.
  */
 AzureIoTResult_t AzureIoTProvisioningClient_Register( AzureIoTProvisioningClient_t * pxAzureProvClient,
                                                       uint32_t ulTimeoutMilliseconds );
 
+/**
+ * @brief Get how long the application can sleep before calling AzureIoTProvisioningClient_Register() again.
+ *
+ * Lets the application drive registration with AzureIoTProvisioningClient_Register() and #azureiotprovisioningNO_WAIT,
+ * blocking or entering low power between calls instead of polling:
+ *      - 0 when the next step can run right away, or the registration is complete.
+ *      - The time left until the service asked to be polled again, while waiting on a pending registration.
+ *      - An upper bound while waiting for a response from the service. Call AzureIoTProvisioningClient_Register()
+ *        earlier if the network connection becomes readable.
+ *
+ * @param[in] pxAzureProvClient The #AzureIoTProvisioningClient_t * to use for this call.
+ * @param[out] pulSleepMilliseconds The time in milliseconds until the next step is due.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTProvisioningClient_GetSleepTime( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                          uint32_t * pulSleepMilliseconds );
+
+/**
+ * @brief Prepare the client to register again, for example after a firmware update or to move to another IoT Hub.
+ *
+ * If the MQTT connection with the provisioning service is still up and subscribed, the next call to
+ * AzureIoTProvisioningClient_Register() sends the registration request on it right away, without a new
+ * connect and subscribe. Otherwise it connects again, as on the first registration.
+ *
+ * @note The connection is only known to be down once an MQTT operation on it failed. If
+ * AzureIoTProvisioningClient_Register() then fails, reconnect the transport and call this function again.
+ *
+ * @param[in] pxAzureProvClient The #AzureIoTProvisioningClient_t * to use for this call.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ */
+AzureIoTResult_t AzureIoTProvisioningClient_ResetRegistration( AzureIoTProvisioningClient_t * pxAzureProvClient );
+
 /**
  * @brief After a registration has been completed, get the IoT Hub hostname and device ID.
  *
@@ -188,6 +253,62 @@ AzureIoTResult_t AzureIoTProvisioningClient_GetDeviceAndHub( AzureIoTProvisionin
                                                              uint8_t * pucDeviceID,
                                                              uint32_t * pulDeviceIDLength );
 
+/**
+ * @brief The largest size of a result saved by AzureIoTProvisioningClient_SaveResult().
+ *
+ * @details Covers an IoT Hub hostname of up to 255 bytes and a device ID of up to 128 bytes.
+ */
+#define azureiotprovisioningSAVED_RESULT_MAX    ( 18 + 255 + 128 )
+
+/**
+ * @brief After a successful registration, save its result so later boots can connect to the assigned
+ * IoT Hub without registering again.
+ *
+ * The saved result is a compact binary blob holding the IoT Hub hostname and device ID, a hash of the
+ * client configuration (endpoint, ID scope, registration ID and registration payload) and a checksum.
+ * The application persists it as is, for example in flash.
+ *
+ * @param[in] pxAzureProvClient The #AzureIoTProvisioningClient_t * to use for this call.
+ * @param[out] pucSavedResult The buffer the result is written to.
+ * @param[in] ulSavedResultLength The length of \p pucSavedResult. #azureiotprovisioningSAVED_RESULT_MAX is always enough.
+ * @param[out] pulBytesWritten The number of bytes written to \p pucSavedResult.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTErrorOutOfMemory \p pucSavedResult is too small.
+ */
+AzureIoTResult_t AzureIoTProvisioningClient_SaveResult( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                        uint8_t * pucSavedResult,
+                                                        uint32_t ulSavedResultLength,
+                                                        uint32_t * pulBytesWritten );
+
+/**
+ * @brief Get the IoT Hub hostname and device ID from a result saved by AzureIoTProvisioningClient_SaveResult(),
+ * instead of calling AzureIoTProvisioningClient_Register().
+ *
+ * The saved result is only used if it is intact and was saved with the same endpoint, ID scope,
+ * registration ID and registration payload as \p pxAzureProvClient. Call AzureIoTProvisioningClient_SetRegistrationPayload()
+ * before this function if a payload is used.
+ *
+ * @note The device may have been reassigned to another IoT Hub since the result was saved. If connecting to the
+ * IoT Hub fails, register again with AzureIoTProvisioningClient_Register().
+ *
+ * @param[in] pxAzureProvClient The #AzureIoTProvisioningClient_t * to use for this call.
+ * @param[in] pucSavedResult The saved result.
+ * @param[in] ulSavedResultLength The length of \p pucSavedResult.
+ * @param[out] pucHubHostname The pointer to a buffer which will be populated with the IoT Hub hostname.
+ * @param[in,out] pulHostnameLength The length of \p pucHubHostname, updated with the length of the hostname.
+ * @param[out] pucDeviceID The pointer to a buffer which will be populated with the device ID.
+ * @param[in,out] pulDeviceIDLength The length of \p pucDeviceID, updated with the length of the device ID.
+ * @return An #AzureIoTResult_t with the result of the operation.
+ * @retval eAzureIoTErrorItemNotFound The saved result is corrupted or does not match the client configuration.
+ */
+AzureIoTResult_t AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( AzureIoTProvisioningClient_t * pxAzureProvClient,
+                                                                            const uint8_t * pucSavedResult,
+                                                                            uint32_t ulSavedResultLength,
+                                                                            uint8_t * pucHubHostname,
+                                                                            uint32_t * pulHostnameLength,
+                                                                            uint8_t * pucDeviceID,
+                                                                            uint32_t * pulDeviceIDLength );
+
 /**
  * @brief Get extended code for Provisioning failure.
  *
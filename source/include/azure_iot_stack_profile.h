@@ -0,0 +1,108 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_stack_profile.h
+ *
+ * @brief Peak stack usage of the middleware entry points and of the user callbacks they invoke.
+ *
+ * @details Only available when `azureiotconfigSTACK_PROFILING` is set to 1. On entry, an
+ * instrumented function fills the unused stack below it with the FreeRTOS stack fill byte; on
+ * exit, it finds the deepest byte which was overwritten and records the distance from its own
+ * frame. The peaks include the Azure SDK for Embedded C, coreMQTT, the transport and, for the
+ * entry points, the callbacks they invoke. Use them with the `-fstack-usage` report of the build
+ * (see the `AZURE_IOT_STACK_USAGE` CMake option) to size task stacks.
+ *
+ * @note Profiling is meant for development builds: every instrumented call scans the stack of
+ * the calling task. It requires `INCLUDE_uxTaskGetStackHighWaterMark`, must only be used from
+ * tasks, and needs a port where tasks run on the stack FreeRTOS allocated for them. As used stack
+ * is painted again, uxTaskGetStackHighWaterMark() of a profiled task can under-report.
+ *
+ * @note You MUST NOT use any symbols (macros, functions, structures, enums, etc.)
+ * prefixed with an underscore ('_') directly in your application code. These symbols
+ * are part of Azure SDK's internal implementation; we do not document these symbols
+ * and they are subject to change in future versions of the SDK which would break your code.
+ *
+ */
+
+#ifndef AZURE_IOT_STACK_PROFILE_H
+#define AZURE_IOT_STACK_PROFILE_H
+
+#include <stdint.h>
+
+#include "azure_iot.h"
+
+/* Azure SDK for Embedded C includes */
+#include "azure/core/_az_cfg_prefix.h"
+
+/**
+ * @brief Instrumented entry points and callbacks.
+ */
+typedef enum AzureIoTStackProfileEntry
+{
+    eAzureIoTStackProfileHubConnect = 0,              /**< AzureIoTHubClient_Connect(). */
+    eAzureIoTStackProfileHubProcessLoop,              /**< AzureIoTHubClient_ProcessLoop(). */
+    eAzureIoTStackProfileHubSendTelemetry,            /**< AzureIoTHubClient_SendTelemetry(). */
+    eAzureIoTStackProfileHubSendTelemetryStream,      /**< AzureIoTHubClient_SendTelemetryStream(). */
+    eAzureIoTStackProfileHubSendCommandResponse,      /**< AzureIoTHubClient_SendCommandResponse(). */
+    eAzureIoTStackProfileHubSendPropertiesReported,   /**< AzureIoTHubClient_SendPropertiesReported(). */
+    eAzureIoTStackProfileHubCloudToDeviceCallback,    /**< The cloud to device message callback. */
+    eAzureIoTStackProfileHubCommandCallback,          /**< The command callback. */
+    eAzureIoTStackProfileHubPropertiesCallback,       /**< The properties callback. */
+    eAzureIoTStackProfileProvisioningRegister,        /**< AzureIoTProvisioningClient_Register(). */
+    eAzureIoTStackProfileEntryCount                   /**< Number of instrumented entries. */
+} AzureIoTStackProfileEntry_t;
+
+/**
+ * @brief Frame of an instrumented call.
+ *
+ * @warning Used internally.
+ */
+typedef struct AzureIoTStackProfileFrame
+{
+    struct
+    {
+        uint8_t * pucEntry;
+        uint8_t * pucDeepest;
+        uint8_t * pucPaintedTop;
+        uint8_t * pucPaintedEnd;
+        struct AzureIoTStackProfileFrame * pxOuter;
+    } _internal; /**< @brief Internal to the SDK */
+} AzureIoTStackProfileFrame_t;
+
+#if azureiotconfigSTACK_PROFILING
+
+/**
+ * @brief Get the peak stack usage of an entry, in bytes.
+ *
+ * @param[in] xEntry The #AzureIoTStackProfileEntry_t to look up.
+ * @return The peak stack usage recorded since boot or the last AzureIoTStackProfile_Reset(),
+ * 0 if \p xEntry was not called, or could not be measured for lack of free stack.
+ */
+uint32_t AzureIoTStackProfile_GetPeak( AzureIoTStackProfileEntry_t xEntry );
+
+/**
+ * @brief Clear the recorded peaks.
+ */
+void AzureIoTStackProfile_Reset( void );
+
+/**
+ * @brief Start measuring an instrumented call.
+ *
+ * @warning Used internally.
+ */
+void AzureIoTStackProfile_Begin( AzureIoTStackProfileFrame_t * pxFrame );
+
+/**
+ * @brief Finish measuring an instrumented call and record its peak.
+ *
+ * @warning Used internally.
+ */
+void AzureIoTStackProfile_End( AzureIoTStackProfileFrame_t * pxFrame,
+                               AzureIoTStackProfileEntry_t xEntry );
+
+#endif /* azureiotconfigSTACK_PROFILING */
+
+#include "azure/core/_az_cfg_suffix.h"
+
+#endif /* AZURE_IOT_STACK_PROFILE_H */
@@ -316,6 +316,38 @@ AzureIoTMQTTResult_t AzureIoTMQTT_Publish( AzureIoTMQTTHandle_t xContext,
                                            const AzureIoTMQTTPublishInfo_t * pxPublishInfo,
                                            uint16_t usPacketId );
 
+/**
+ * @brief Starts a PUBLISH whose payload is sent afterwards with #AzureIoTMQTT_PublishStreamSend.
+ *
+ * The fixed header, topic name and packet ID are sent for a payload of exactly
+ * pxPublishInfo->xPayloadLength bytes; pxPublishInfo->pvPayload is not used. Until that many
+ * payload bytes were sent, no other packet can be sent on the connection.
+ *
+ * @note On #eAzureIoTMQTTSendFailed, part of the header may have been sent already.
+ *
+ * @param[in] xContext Initialized AzureIoTMQTT context.
+ * @param[in] pxPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] usPacketId packet ID ( generated by #AzureIoTMQTT_GetPacketId ).
+ *
+ * @return An #AzureIoTMQTTResult_t with the result of the operation.
+ */
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamBegin( AzureIoTMQTTHandle_t xContext,
+                                                      const AzureIoTMQTTPublishInfo_t * pxPublishInfo,
+                                                      uint16_t usPacketId );
+
+/**
+ * @brief Sends part of the payload of a PUBLISH started with #AzureIoTMQTT_PublishStreamBegin.
+ *
+ * @param[in] xContext Initialized AzureIoTMQTT context.
+ * @param[in] pucData The payload bytes to send.
+ * @param[in] xDataLength The length of \p pucData.
+ *
+ * @return An #AzureIoTMQTTResult_t with the result of the operation.
+ */
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamSend( AzureIoTMQTTHandle_t xContext,
+                                                     const uint8_t * pucData,
+                                                     size_t xDataLength );
+
 /**
  * @brief Sends a MQTT PINGREQ to broker.
  *
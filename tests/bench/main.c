@@ -0,0 +1,725 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Middleware microbenchmarks.
+ *
+ * Runs every hot path of the middleware in its own FreeRTOS task and reports,
+ * per operation, the wall clock time, CPU cycles, heap allocations and the
+ * stack high-water mark of the task, as one JSON document on stdout.
+ * Message traffic goes through the in-process emulator.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+    #include <x86intrin.h>
+    #define benchHAS_CYCLE_COUNTER    1
+#else
+    #define benchHAS_CYCLE_COUNTER    0
+#endif
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+
+/* Azure IoT library includes */
+#include "azure_iot.h"
+#include "azure_iot_private.h"
+#include "azure_iot_hub_client.h"
+#include "azure_iot_hub_client_properties.h"
+#include "azure_iot_json_reader.h"
+#include "azure_iot_json_writer.h"
+
+/* Emulator includes */
+#include "azure_iot_emulator.h"
+/*-----------------------------------------------------------*/
+
+#define benchSTACK_DEPTH           ( 4 * 1024 )
+#define benchPRIORITY              ( tskIDLE_PRIORITY + 1 )
+#define benchBUFFER_SIZE           ( 5 * 1024 )
+#define benchPAYLOAD_SIZE          ( 64 )
+#define benchWARMUP_MAX            ( 100U )
+#define benchTIMEOUT_MS            ( 1000U )
+#define benchPROCESS_LOOPS_MAX     ( 1000U )
+#define benchHOSTNAME              "emulator.azure-devices.net"
+#define benchDEVICE_ID             "emulator-device"
+#define benchCOMMAND_NAME          "thermostat1*getMaxMinReport"
+#define benchCOMMAND_PAYLOAD       "{\"since\":\"2021-01-01T00:00:00Z\"}"
+#define benchSYMMETRIC_KEY         "MDEyMzQ1Njc4OWFiY2RlZjAxMjM0NTY3ODlhYmNkZWY="
+#define benchSAS_STRING_TO_SIGN    benchHOSTNAME "%2Fdevices%2F" benchDEVICE_ID "\n1700000000"
+
+/*
+ * Property request reply of a device with two thermostat components, as
+ * served by the emulator and scanned by the properties benchmarks.
+ */
+#define benchTWIN_DOCUMENT                                                                                       \
+    "{\"desired\":{\"thermostat1\":{\"__t\":\"c\",\"targetTemperature\":22.5},"                                  \
+    "\"thermostat2\":{\"__t\":\"c\",\"targetTemperature\":19.0},\"telemetryInterval\":10,\"$version\":7},"       \
+    "\"reported\":{\"thermostat1\":{\"__t\":\"c\",\"maxTempSinceLastReboot\":30.1,"                              \
+    "\"targetTemperature\":{\"ac\":200,\"av\":7,\"ad\":\"success\",\"value\":22.5}},"                            \
+    "\"thermostat2\":{\"__t\":\"c\",\"maxTempSinceLastReboot\":24.3},\"serialNumber\":\"SN-0001\",\"$version\":12}}"
+
+/* Writable property update for the same device. */
+#define benchWRITABLE_DOCUMENT                                                    \
+    "{\"thermostat1\":{\"__t\":\"c\",\"targetTemperature\":22.5},"                \
+    "\"thermostat2\":{\"__t\":\"c\",\"targetTemperature\":19.0},\"telemetryInterval\":10,\"$version\":8}"
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Untimed preparation of one operation, such as injecting the message it consumes.
+ */
+typedef int32_t ( * BenchSetup_t )( void );
+
+/**
+ * @brief One timed operation, returning 0 on success.
+ */
+typedef int32_t ( * BenchRun_t )( void );
+
+typedef struct BenchCase
+{
+    const char * pcName;
+    BenchSetup_t xSetup;
+    BenchRun_t xRun;
+} BenchCase_t;
+
+typedef struct BenchResult
+{
+    uint64_t ullNanoseconds;
+    uint64_t ullCycles;
+    uint64_t ullAllocations;
+    uint32_t ulStackBytes;
+    uint32_t ulFailures;
+} BenchResult_t;
+/*-----------------------------------------------------------*/
+
+static AzureIoTEmulator_t xEmulator;
+static NetworkContext_t xNetworkContext;
+static AzureIoTTransportInterface_t xTransport;
+static AzureIoTHubClient_t xAzureIoTHubClient;
+static AzureIoTMessageProperties_t xMessageProperties;
+static uint8_t ucSharedBuffer[ benchBUFFER_SIZE ];
+azureiothubASSERT_BUFFER_SIZE( sizeof( ucSharedBuffer ) );
+static uint8_t ucPropertiesBuffer[ 128 ];
+static uint8_t ucPayload[ benchPAYLOAD_SIZE ];
+static uint8_t ucScratch[ 512 ];
+
+static uint32_t ulIterations = 10000;
+static uint32_t ulVerbose = 0;
+static TaskHandle_t xCoordinatorTask;
+static const BenchCase_t * pxCurrentCase;
+static BenchResult_t xCurrentResult;
+
+static volatile uint32_t ulCloudMessages;
+static volatile uint32_t ulCommands;
+static volatile uint32_t ulPropertyMessages;
+static volatile uint64_t ullAllocations;
+
+static AzureIoTHubClientComponent_t xComponents[] =
+{
+    azureiothubCREATE_COMPONENT( "thermostat1" ), azureiothubCREATE_COMPONENT( "thermostat2" )
+};
+/*-----------------------------------------------------------*/
+
+/* Allocation counters, see the --wrap link options. */
+void * __real_malloc( size_t xSize );
+void * __real_calloc( size_t xCount,
+                      size_t xSize );
+void * __real_realloc( void * pvPtr,
+                       size_t xSize );
+
+void * __wrap_malloc( size_t xSize )
+{
+    ullAllocations++;
+    return __real_malloc( xSize );
+}
+
+void * __wrap_calloc( size_t xCount,
+                      size_t xSize )
+{
+    ullAllocations++;
+    return __real_calloc( xCount, xSize );
+}
+
+void * __wrap_realloc( void * pvPtr,
+                       size_t xSize )
+{
+    ullAllocations++;
+    return __real_realloc( pvPtr, xSize );
+}
+/*-----------------------------------------------------------*/
+
+/* Logs go to stderr, stdout carries the JSON report. */
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list arg;
+
+    if( ulVerbose )
+    {
+        va_start( arg, pcFormat );
+        vfprintf( stderr, pcFormat, arg );
+        va_end( arg );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t ulGetUnixTime( void )
+{
+    return ( uint64_t ) time( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetNanoseconds( void )
+{
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000000U ) + ( uint64_t ) xNow.tv_nsec;
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetCycles( void )
+{
+    #if benchHAS_CYCLE_COUNTER
+        return ( uint64_t ) __rdtsc();
+    #else
+        return 0;
+    #endif
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Stand in for the platform HMAC, so that only the middleware's share of the
+ * SAS computation is measured.
+ **/
+static uint32_t prvHMACFunction( const uint8_t * pucKey,
+                                 uint32_t ulKeyLength,
+                                 const uint8_t * pucData,
+                                 uint32_t ulDataLength,
+                                 uint8_t * pucOutput,
+                                 uint32_t ulOutputLength,
+                                 uint32_t * pulBytesCopied )
+{
+    uint32_t ulIndex;
+
+    if( ulOutputLength < 32 )
+    {
+        return 1;
+    }
+
+    for( ulIndex = 0; ulIndex < 32; ulIndex++ )
+    {
+        pucOutput[ ulIndex ] = pucKey[ ulIndex % ulKeyLength ] ^ pucData[ ulIndex % ulDataLength ];
+    }
+
+    *pulBytesCopied = 32;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleCloudMessage( AzureIoTHubClientCloudToDeviceMessageRequest_t * pxMessage,
+                                   void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+    ulCloudMessages++;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
+                              void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+    ulCommands++;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandlePropertiesMessage( AzureIoTHubClientPropertiesResponse_t * pxMessage,
+                                        void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+    ulPropertyMessages++;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Process incoming publishes until the completion counter moves.
+ **/
+static int32_t prvProcessUntil( volatile uint32_t * pulCompletions )
+{
+    uint32_t ulBefore = *pulCompletions;
+    uint32_t ulLoops;
+
+    /* A zero timeout runs a single receive iteration. */
+    for( ulLoops = 0; ( *pulCompletions == ulBefore ) && ( ulLoops < benchPROCESS_LOOPS_MAX ); ulLoops++ )
+    {
+        if( AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient, 0 ) != eAzureIoTSuccess )
+        {
+            return -1;
+        }
+    }
+
+    return ( *pulCompletions != ulBefore ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvSendTelemetry( void )
+{
+    return ( AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient, ucPayload, sizeof( ucPayload ),
+                                              NULL, eAzureIoTHubMessageQoS0, NULL ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvSendTelemetryWithProperties( void )
+{
+    return ( AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient, ucPayload, sizeof( ucPayload ),
+                                              &xMessageProperties, eAzureIoTHubMessageQoS0,
+                                              NULL ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvInjectCloudMessage( void )
+{
+    return AzureIoTEmulator_SendCloudMessage( &xNetworkContext, ucPayload, sizeof( ucPayload ) );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvProcessCloudMessage( void )
+{
+    return prvProcessUntil( &ulCloudMessages );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvInjectCommand( void )
+{
+    return AzureIoTEmulator_InvokeCommand( &xNetworkContext, benchCOMMAND_NAME,
+                                           ( const uint8_t * ) benchCOMMAND_PAYLOAD,
+                                           sizeof( benchCOMMAND_PAYLOAD ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvProcessCommand( void )
+{
+    return prvProcessUntil( &ulCommands );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvInjectWritableProperties( void )
+{
+    return AzureIoTEmulator_UpdateDesiredProperties( &xNetworkContext,
+                                                     ( const uint8_t * ) benchWRITABLE_DOCUMENT,
+                                                     sizeof( benchWRITABLE_DOCUMENT ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+/* The emulator queues the reply while the request is sent. */
+static int32_t prvRequestProperties( void )
+{
+    return ( AzureIoTHubClient_RequestPropertiesAsync( &xAzureIoTHubClient ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvProcessPropertiesMessage( void )
+{
+    return prvProcessUntil( &ulPropertyMessages );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvBase64HMACCalculate( void )
+{
+    uint8_t ucSignature[ 64 ];
+    uint32_t ulSignatureLength;
+
+    if( AzureIoT_Base64HMACCalculate( prvHMACFunction,
+                                      ( const uint8_t * ) benchSYMMETRIC_KEY, sizeof( benchSYMMETRIC_KEY ) - 1,
+                                      ( const uint8_t * ) benchSAS_STRING_TO_SIGN, sizeof( benchSAS_STRING_TO_SIGN ) - 1,
+                                      ucScratch, sizeof( ucScratch ),
+                                      ucSignature, sizeof( ucSignature ), &ulSignatureLength ) != eAzureIoTSuccess )
+    {
+        return -1;
+    }
+
+    return ( ulSignatureLength == 44 ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * {"temperature":21.5,"humidity":40,"status":"heating","enabled":true,"samples":[21.1,21.3,21.5]}
+ */
+static int32_t prvWriteTelemetry( void )
+{
+    AzureIoTJSONWriter_t xWriter;
+
+    if( ( AzureIoTJSONWriter_Init( &xWriter, ucScratch, sizeof( ucScratch ) ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendBeginObject( &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendPropertyWithDoubleValue( &xWriter, ( const uint8_t * ) "temperature",
+                                                            sizeof( "temperature" ) - 1, 21.5, 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendPropertyWithInt32Value( &xWriter, ( const uint8_t * ) "humidity",
+                                                           sizeof( "humidity" ) - 1, 40 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendPropertyWithStringValue( &xWriter, ( const uint8_t * ) "status",
+                                                            sizeof( "status" ) - 1,
+                                                            ( const uint8_t * ) "heating",
+                                                            sizeof( "heating" ) - 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendPropertyWithBoolValue( &xWriter, ( const uint8_t * ) "enabled",
+                                                          sizeof( "enabled" ) - 1, true ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendPropertyName( &xWriter, ( const uint8_t * ) "samples",
+                                                 sizeof( "samples" ) - 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendBeginArray( &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendDouble( &xWriter, 21.1, 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendDouble( &xWriter, 21.3, 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendDouble( &xWriter, 21.5, 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendEndArray( &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendEndObject( &xWriter ) != eAzureIoTSuccess ) )
+    {
+        return -1;
+    }
+
+    return ( AzureIoTJSONWriter_GetBytesUsed( &xWriter ) > 0 ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * {"thermostat1":{"__t":"c","targetTemperature":{"ac":200,"av":7,"ad":"success","value":22.5}}}
+ */
+static int32_t prvWritePropertyResponse( void )
+{
+    AzureIoTJSONWriter_t xWriter;
+
+    if( ( AzureIoTJSONWriter_Init( &xWriter, ucScratch, sizeof( ucScratch ) ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendBeginObject( &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTHubClientProperties_BuilderBeginComponent( &xAzureIoTHubClient, &xWriter,
+                                                             ( const uint8_t * ) "thermostat1",
+                                                             sizeof( "thermostat1" ) - 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTHubClientProperties_BuilderBeginResponseStatus( &xAzureIoTHubClient, &xWriter,
+                                                                  ( const uint8_t * ) "targetTemperature",
+                                                                  sizeof( "targetTemperature" ) - 1,
+                                                                  200, 7, ( const uint8_t * ) "success",
+                                                                  sizeof( "success" ) - 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendDouble( &xWriter, 22.5, 1 ) != eAzureIoTSuccess ) ||
+        ( AzureIoTHubClientProperties_BuilderEndResponseStatus( &xAzureIoTHubClient, &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTHubClientProperties_BuilderEndComponent( &xAzureIoTHubClient, &xWriter ) != eAzureIoTSuccess ) ||
+        ( AzureIoTJSONWriter_AppendEndObject( &xWriter ) != eAzureIoTSuccess ) )
+    {
+        return -1;
+    }
+
+    return ( AzureIoTJSONWriter_GetBytesUsed( &xWriter ) > 0 ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Scan every property of one type in a document, skipping values.
+ **/
+static int32_t prvScanProperties( const char * pcDocument,
+                                  uint32_t ulDocumentLength,
+                                  AzureIoTHubMessageType_t xResponseType,
+                                  AzureIoTHubClientPropertyType_t xPropertyType )
+{
+    AzureIoTJSONReader_t xReader;
+    AzureIoTResult_t xResult;
+    const uint8_t * pucComponentName;
+    uint32_t ulComponentNameLength;
+    uint32_t ulProperties = 0;
+
+    if( AzureIoTJSONReader_Init( &xReader, ( const uint8_t * ) pcDocument, ulDocumentLength ) != eAzureIoTSuccess )
+    {
+        return -1;
+    }
+
+    while( ( xResult = AzureIoTHubClientProperties_GetNextComponentProperty( &xAzureIoTHubClient, &xReader,
+                                                                             xResponseType, xPropertyType,
+                                                                             &pucComponentName,
+                                                                             &ulComponentNameLength ) ) == eAzureIoTSuccess )
+    {
+        if( ( AzureIoTJSONReader_NextToken( &xReader ) != eAzureIoTSuccess ) ||
+            ( AzureIoTJSONReader_SkipChildren( &xReader ) != eAzureIoTSuccess ) ||
+            ( AzureIoTJSONReader_NextToken( &xReader ) != eAzureIoTSuccess ) )
+        {
+            return -1;
+        }
+
+        ulProperties++;
+    }
+
+    return ( ( xResult == eAzureIoTErrorEndOfProperties ) && ( ulProperties > 0 ) ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvScanWritableUpdate( void )
+{
+    return prvScanProperties( benchWRITABLE_DOCUMENT, sizeof( benchWRITABLE_DOCUMENT ) - 1,
+                              eAzureIoTHubPropertiesWritablePropertyMessage, eAzureIoTHubClientPropertyWritable );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvScanRequestedWritable( void )
+{
+    return prvScanProperties( benchTWIN_DOCUMENT, sizeof( benchTWIN_DOCUMENT ) - 1,
+                              eAzureIoTHubPropertiesRequestedMessage, eAzureIoTHubClientPropertyWritable );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvScanRequestedReported( void )
+{
+    return prvScanProperties( benchTWIN_DOCUMENT, sizeof( benchTWIN_DOCUMENT ) - 1,
+                              eAzureIoTHubPropertiesRequestedMessage, eAzureIoTHubClientReportedFromDevice );
+}
+/*-----------------------------------------------------------*/
+
+static const BenchCase_t xBenchCases[] =
+{
+    { "hub_send_telemetry_qos0",               NULL,                        prvSendTelemetry               },
+    { "hub_send_telemetry_qos0_properties",    NULL,                        prvSendTelemetryWithProperties },
+    { "hub_process_cloud_message",             prvInjectCloudMessage,       prvProcessCloudMessage         },
+    { "hub_process_command",                   prvInjectCommand,            prvProcessCommand              },
+    { "hub_process_properties_writable",       prvInjectWritableProperties, prvProcessPropertiesMessage    },
+    { "hub_process_properties_response",       prvRequestProperties,        prvProcessPropertiesMessage    },
+    { "base64_hmac_calculate",                 NULL,                        prvBase64HMACCalculate         },
+    { "json_writer_telemetry",                 NULL,                        prvWriteTelemetry              },
+    { "json_writer_property_response",         NULL,                        prvWritePropertyResponse       },
+    { "properties_next_writable_update",       NULL,                        prvScanWritableUpdate          },
+    { "properties_next_requested_writable",    NULL,                        prvScanRequestedWritable       },
+    { "properties_next_requested_reported",    NULL,                        prvScanRequestedReported       },
+};
+/*-----------------------------------------------------------*/
+
+/**
+ * Run one case in a fresh task, so that its stack high-water mark is its own.
+ *
+ * Operations without setup are timed as one batch; the others are timed one
+ * by one around the run step only.
+ **/
+static void prvBenchTask( void * pvParameters )
+{
+    const BenchCase_t * pxCase = pxCurrentCase;
+    BenchResult_t * pxResult = &xCurrentResult;
+    uint32_t ulWarmup = ( ulIterations / 10 < benchWARMUP_MAX ) ? ( ulIterations / 10 ) : benchWARMUP_MAX;
+    uint32_t ulIndex;
+    uint64_t ullNanoseconds;
+    uint64_t ullCycles;
+    uint64_t ullAllocationsBefore;
+
+    ( void ) pvParameters;
+
+    memset( pxResult, 0, sizeof( *pxResult ) );
+
+    for( ulIndex = 0; ulIndex < ulWarmup; ulIndex++ )
+    {
+        if( ( ( pxCase->xSetup != NULL ) && ( pxCase->xSetup() != 0 ) ) || ( pxCase->xRun() != 0 ) )
+        {
+            pxResult->ulFailures++;
+        }
+    }
+
+    if( pxCase->xSetup == NULL )
+    {
+        ullAllocationsBefore = ullAllocations;
+        ullNanoseconds = prvGetNanoseconds();
+        ullCycles = prvGetCycles();
+
+        for( ulIndex = 0; ulIndex < ulIterations; ulIndex++ )
+        {
+            if( pxCase->xRun() != 0 )
+            {
+                pxResult->ulFailures++;
+            }
+        }
+
+        pxResult->ullCycles = prvGetCycles() - ullCycles;
+        pxResult->ullNanoseconds = prvGetNanoseconds() - ullNanoseconds;
+        pxResult->ullAllocations = ullAllocations - ullAllocationsBefore;
+    }
+    else
+    {
+        for( ulIndex = 0; ulIndex < ulIterations; ulIndex++ )
+        {
+            if( pxCase->xSetup() != 0 )
+            {
+                pxResult->ulFailures++;
+                continue;
+            }
+
+            ullAllocationsBefore = ullAllocations;
+            ullNanoseconds = prvGetNanoseconds();
+            ullCycles = prvGetCycles();
+
+            if( pxCase->xRun() != 0 )
+            {
+                pxResult->ulFailures++;
+            }
+
+            pxResult->ullCycles += prvGetCycles() - ullCycles;
+            pxResult->ullNanoseconds += prvGetNanoseconds() - ullNanoseconds;
+            pxResult->ullAllocations += ullAllocations - ullAllocationsBefore;
+        }
+    }
+
+    pxResult->ulStackBytes = ( uint32_t ) ( ( benchSTACK_DEPTH - uxTaskGetStackHighWaterMark( NULL ) ) *
+                                            sizeof( StackType_t ) );
+
+    xTaskNotifyGive( xCoordinatorTask );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void prvPrintResult( const BenchCase_t * pxCase,
+                            const BenchResult_t * pxResult,
+                            uint32_t ulLast )
+{
+    printf( "    {\"name\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,",
+            pxCase->pcName, ( unsigned ) ulIterations,
+            ( double ) pxResult->ullNanoseconds / ( double ) ulIterations );
+
+    #if benchHAS_CYCLE_COUNTER
+        printf( "\"cycles_per_op\":%.1f,", ( double ) pxResult->ullCycles / ( double ) ulIterations );
+    #else
+        printf( "\"cycles_per_op\":null," );
+    #endif
+
+    printf( "\"allocations_per_op\":%.3f,\"stack_bytes\":%u,\"failures\":%u}%s\n",
+            ( double ) pxResult->ullAllocations / ( double ) ulIterations,
+            ( unsigned ) pxResult->ulStackBytes, ( unsigned ) pxResult->ulFailures,
+            ulLast ? "" : "," );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCoordinatorTask( void * pvParameters )
+{
+    AzureIoTHubClientOptions_t xHubOptions = { 0 };
+    AzureIoTEmulatorOptions_t xEmulatorOptions = { NULL, 0, 0, benchTWIN_DOCUMENT };
+    bool xSessionPresent;
+    uint32_t ulCase;
+    uint32_t ulFailures = 0;
+    const uint32_t ulCaseCount = sizeof( xBenchCases ) / sizeof( xBenchCases[ 0 ] );
+
+    ( void ) pvParameters;
+
+    memset( ucPayload, 'x', sizeof( ucPayload ) );
+
+    configASSERT( AzureIoT_Init() == eAzureIoTSuccess );
+    AzureIoTEmulator_Init( &xEmulator, &xEmulatorOptions );
+    AzureIoTEmulator_SessionInit( &xEmulator, &xNetworkContext, &xTransport );
+
+    configASSERT( AzureIoTHubClient_OptionsInit( &xHubOptions ) == eAzureIoTSuccess );
+    xHubOptions.pxComponentList = xComponents;
+    xHubOptions.ulComponentListLength = sizeof( xComponents ) / sizeof( xComponents[ 0 ] );
+
+    configASSERT( AzureIoTHubClient_Init( &xAzureIoTHubClient,
+                                          ( const uint8_t * ) benchHOSTNAME, sizeof( benchHOSTNAME ) - 1,
+                                          ( const uint8_t * ) benchDEVICE_ID, sizeof( benchDEVICE_ID ) - 1,
+                                          &xHubOptions, ucSharedBuffer, sizeof( ucSharedBuffer ),
+                                          ulGetUnixTime, &xTransport ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_Connect( &xAzureIoTHubClient, false, &xSessionPresent,
+                                             benchTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeCloudToDeviceMessage( &xAzureIoTHubClient, prvHandleCloudMessage,
+                                                                   NULL, benchTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeCommand( &xAzureIoTHubClient, prvHandleCommand,
+                                                      NULL, benchTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeProperties( &xAzureIoTHubClient, prvHandlePropertiesMessage,
+                                                         NULL, benchTIMEOUT_MS ) == eAzureIoTSuccess );
+
+    configASSERT( AzureIoTMessage_PropertiesInit( &xMessageProperties, ucPropertiesBuffer, 0,
+                                                  sizeof( ucPropertiesBuffer ) ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTMessage_PropertiesAppend( &xMessageProperties,
+                                                    ( const uint8_t * ) "$.sub", sizeof( "$.sub" ) - 1,
+                                                    ( const uint8_t * ) "thermostat1", sizeof( "thermostat1" ) - 1 ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTMessage_PropertiesAppend( &xMessageProperties,
+                                                    ( const uint8_t * ) "alert", sizeof( "alert" ) - 1,
+                                                    ( const uint8_t * ) "high", sizeof( "high" ) - 1 ) == eAzureIoTSuccess );
+
+    printf( "{\n  \"cycle_counter\":%s,\n  \"benchmarks\":[\n", benchHAS_CYCLE_COUNTER ? "\"tsc\"" : "null" );
+
+    for( ulCase = 0; ulCase < ulCaseCount; ulCase++ )
+    {
+        pxCurrentCase = &xBenchCases[ ulCase ];
+
+        configASSERT( xTaskCreate( prvBenchTask, "Bench", benchSTACK_DEPTH,
+                                   NULL, benchPRIORITY, NULL ) == pdPASS );
+        ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        prvPrintResult( pxCurrentCase, &xCurrentResult, ulCase == ( ulCaseCount - 1 ) );
+        ulFailures += xCurrentResult.ulFailures;
+    }
+
+    printf( "  ],\n" );
+
+    #if azureiotconfigSTACK_PROFILING
+        printf( "  \"stack_profile\":{\"hub_connect\":%u,\"hub_process_loop\":%u,\"hub_send_telemetry\":%u,"
+                "\"hub_send_command_response\":%u,\"hub_send_properties_reported\":%u,\"hub_c2d_callback\":%u,"
+                "\"hub_command_callback\":%u,\"hub_properties_callback\":%u},\n",
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubConnect ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubProcessLoop ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubSendTelemetry ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubSendCommandResponse ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubSendPropertiesReported ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubCloudToDeviceCallback ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubCommandCallback ),
+                ( unsigned ) AzureIoTStackProfile_GetPeak( eAzureIoTStackProfileHubPropertiesCallback ) );
+    #endif /* azureiotconfigSTACK_PROFILING */
+
+    printf( "  \"protocol_errors\":%u\n}\n", ( unsigned ) xEmulator.ulProtocolErrors );
+    fflush( stdout );
+
+    AzureIoTHubClient_Disconnect( &xAzureIoTHubClient );
+    AzureIoTHubClient_Deinit( &xAzureIoTHubClient );
+
+    exit( ( ( ulFailures == 0 ) && ( xEmulator.ulProtocolErrors == 0 ) ) ? 0 : 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUsage( const char * pcName )
+{
+    fprintf( stderr, "Usage: %s [-n iterations] [-v]\r\n", pcName );
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int lOption;
+
+    while( ( lOption = getopt( argc, argv, "n:vh" ) ) != -1 )
+    {
+        switch( lOption )
+        {
+            case 'n':
+                ulIterations = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'v':
+                ulVerbose = 1;
+                break;
+
+            default:
+                prvUsage( argv[ 0 ] );
+                return 1;
+        }
+    }
+
+    if( ulIterations == 0 )
+    {
+        prvUsage( argv[ 0 ] );
+        return 1;
+    }
+
+    xTaskCreate( prvCoordinatorTask, "BenchCoordinator", benchSTACK_DEPTH,
+                 NULL, benchPRIORITY, &xCoordinatorTask );
+
+    /* Start the RTOS scheduler. */
+    vTaskStartScheduler();
+
+    for( ; ; )
+    {
+    }
+}
+/*-----------------------------------------------------------*/
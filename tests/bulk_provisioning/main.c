@@ -0,0 +1,373 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * Bulk provisioning harness.
+ *
+ * Registers many devices through concurrent AzureIoTProvisioningClient_t
+ * instances, each on its own transport session of the in-process emulator,
+ * and reports registrations per second and latency percentiles.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+#include "semphr.h"
+
+/* Azure IoT library includes */
+#include "azure_iot.h"
+#include "azure_iot_provisioning_client.h"
+
+/* Emulator includes */
+#include "azure_iot_emulator.h"
+/*-----------------------------------------------------------*/
+
+#define bulkprovSTACK_SIZE                  ( 8 * 1024 )
+#define bulkprovPRIORITY                    ( tskIDLE_PRIORITY + 1 )
+#define bulkprovCLIENTS_MAX                 ( 256 )
+#define bulkprovBUFFER_SIZE                 ( 4 * 1024 )
+#define bulkprovREGISTRATION_ID_MAX         ( 64 )
+#define bulkprovREGISTRATION_TIMEOUT_MS     ( 1000U )
+#define bulkprovREGISTRATION_ATTEMPTS_MAX   ( 120U )
+#define bulkprovENDPOINT                    "global.azure-devices-provisioning.net"
+#define bulkprovID_SCOPE                    "0ne00000000"
+#define bulkprovASSIGNED_HUB                "bulk.azure-devices.net"
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief State of one concurrent provisioning client.
+ */
+typedef struct BulkProvisioningWorker
+{
+    AzureIoTProvisioningClient_t xClient;
+    NetworkContext_t xNetworkContext;
+    AzureIoTTransportInterface_t xTransport;
+    uint8_t ucBuffer[ bulkprovBUFFER_SIZE ];
+    char cRegistrationID[ bulkprovREGISTRATION_ID_MAX ];
+    uint32_t ulFirstDevice;
+    uint32_t ulDeviceCount;
+} BulkProvisioningWorker_t;
+
+azureiotprovisioningASSERT_BUFFER_SIZE( bulkprovBUFFER_SIZE );
+/*-----------------------------------------------------------*/
+
+static AzureIoTEmulator_t xEmulator;
+static SemaphoreHandle_t xDoneSemaphore;
+
+static uint32_t ulDeviceCount = 1000;
+static uint32_t ulClientCount = 16;
+static uint32_t ulVerbose = 0;
+static AzureIoTEmulatorOptions_t xEmulatorOptions = { bulkprovASSIGNED_HUB, 0, 0, NULL };
+
+/* Latency of each device in microseconds, indexed by device number. */
+static uint32_t * pulLatencies;
+static volatile uint32_t ulFailures;
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list arg;
+
+    if( ulVerbose )
+    {
+        va_start( arg, pcFormat );
+        vprintf( pcFormat, arg );
+        va_end( arg );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t ulGetUnixTime( void )
+{
+    return ( uint64_t ) time( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetMicroseconds( void )
+{
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+static void prvCountFailure( const char * pcRegistrationID,
+                             const char * pcStep,
+                             AzureIoTResult_t xResult )
+{
+    taskENTER_CRITICAL();
+    ulFailures++;
+    taskEXIT_CRITICAL();
+
+    printf( "%s: %s failed: 0x%08x\r\n", pcRegistrationID, pcStep, xResult );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Register one device and check the assignment, returning its latency in microseconds.
+ **/
+static AzureIoTResult_t prvRegisterDevice( BulkProvisioningWorker_t * pxWorker,
+                                           uint32_t ulDevice,
+                                           uint32_t * pulLatency )
+{
+    AzureIoTResult_t xResult;
+    uint8_t ucHostname[ 128 ];
+    uint8_t ucDeviceID[ bulkprovREGISTRATION_ID_MAX ];
+    uint32_t ulHostnameLength = sizeof( ucHostname );
+    uint32_t ulDeviceIDLength = sizeof( ucDeviceID );
+    uint32_t ulRegistrationIDLength;
+    uint32_t ulAttempts = 0;
+    uint8_t * pucBuffer;
+    uint32_t ulBufferLength;
+    uint64_t ullStart;
+
+    ulRegistrationIDLength = ( uint32_t ) snprintf( pxWorker->cRegistrationID, sizeof( pxWorker->cRegistrationID ),
+                                                    "bulk-device-%06u", ( unsigned ) ulDevice );
+
+    ullStart = prvGetMicroseconds();
+    AzureIoTEmulator_SessionInit( &xEmulator, &pxWorker->xNetworkContext, &pxWorker->xTransport );
+
+    if( ( xResult = AzureIoTProvisioningClient_Init( &pxWorker->xClient,
+                                                     ( const uint8_t * ) bulkprovENDPOINT,
+                                                     sizeof( bulkprovENDPOINT ) - 1,
+                                                     ( const uint8_t * ) bulkprovID_SCOPE,
+                                                     sizeof( bulkprovID_SCOPE ) - 1,
+                                                     ( const uint8_t * ) pxWorker->cRegistrationID,
+                                                     ulRegistrationIDLength,
+                                                     NULL, pxWorker->ucBuffer, sizeof( pxWorker->ucBuffer ),
+                                                     ulGetUnixTime, &pxWorker->xTransport ) ) != eAzureIoTSuccess )
+    {
+        prvCountFailure( pxWorker->cRegistrationID, "Init", xResult );
+        return xResult;
+    }
+
+    do
+    {
+        xResult = AzureIoTProvisioningClient_Register( &pxWorker->xClient,
+                                                       bulkprovREGISTRATION_TIMEOUT_MS );
+    } while( ( xResult == eAzureIoTErrorPending ) &&
+             ( ++ulAttempts < bulkprovREGISTRATION_ATTEMPTS_MAX ) );
+
+    *pulLatency = ( uint32_t ) ( prvGetMicroseconds() - ullStart );
+
+    if( xResult != eAzureIoTSuccess )
+    {
+        prvCountFailure( pxWorker->cRegistrationID, "Register", xResult );
+    }
+    else if( ( xResult = AzureIoTProvisioningClient_GetDeviceAndHub( &pxWorker->xClient,
+                                                                     ucHostname, &ulHostnameLength,
+                                                                     ucDeviceID, &ulDeviceIDLength ) ) != eAzureIoTSuccess )
+    {
+        prvCountFailure( pxWorker->cRegistrationID, "GetDeviceAndHub", xResult );
+    }
+    else if( ( ulDeviceIDLength != ulRegistrationIDLength ) ||
+             ( memcmp( ucDeviceID, pxWorker->cRegistrationID, ulDeviceIDLength ) != 0 ) ||
+             ( ulHostnameLength != strlen( xEmulatorOptions.pcAssignedHub ) ) ||
+             ( memcmp( ucHostname, xEmulatorOptions.pcAssignedHub, ulHostnameLength ) != 0 ) )
+    {
+        /* A client reported another device's assignment. */
+        xResult = eAzureIoTErrorInvalidResponse;
+        prvCountFailure( pxWorker->cRegistrationID, "Assignment check", xResult );
+    }
+
+    ( void ) AzureIoTProvisioningClient_ReleaseBuffer( &pxWorker->xClient, &pucBuffer, &ulBufferLength );
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWorkerTask( void * pvParameters )
+{
+    BulkProvisioningWorker_t * pxWorker = ( BulkProvisioningWorker_t * ) pvParameters;
+    uint32_t ulIndex;
+    uint32_t ulDevice;
+
+    for( ulIndex = 0; ulIndex < pxWorker->ulDeviceCount; ulIndex++ )
+    {
+        ulDevice = pxWorker->ulFirstDevice + ulIndex;
+
+        if( prvRegisterDevice( pxWorker, ulDevice, &pulLatencies[ ulDevice ] ) != eAzureIoTSuccess )
+        {
+            pulLatencies[ ulDevice ] = UINT32_MAX;
+        }
+    }
+
+    xSemaphoreGive( xDoneSemaphore );
+    vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static int prvCompareLatency( const void * pvA,
+                              const void * pvB )
+{
+    uint32_t ulA = *( const uint32_t * ) pvA;
+    uint32_t ulB = *( const uint32_t * ) pvB;
+
+    return ( ulA > ulB ) - ( ulA < ulB );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Nearest-rank percentile of the sorted latencies, in milliseconds.
+ **/
+static double prvPercentile( const uint32_t * pulSorted,
+                             uint32_t ulCount,
+                             uint32_t ulPercent )
+{
+    uint32_t ulRank = ( ( ulCount * ulPercent ) + 99 ) / 100;
+
+    if( ulRank == 0 )
+    {
+        ulRank = 1;
+    }
+
+    return ( double ) pulSorted[ ulRank - 1 ] / 1000.0;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReport( uint64_t ullElapsed )
+{
+    uint32_t ulSucceeded = ulDeviceCount - ulFailures;
+
+    /* Failed devices sort last as UINT32_MAX and are left out of the percentiles. */
+    qsort( pulLatencies, ulDeviceCount, sizeof( uint32_t ), prvCompareLatency );
+
+    printf( "devices: %u\r\n", ( unsigned ) ulDeviceCount );
+    printf( "clients: %u\r\n", ( unsigned ) ulClientCount );
+    printf( "assigning_polls: %u\r\n", ( unsigned ) xEmulatorOptions.ulAssigningPollCount );
+    printf( "failures: %u\r\n", ( unsigned ) ulFailures );
+    printf( "protocol_errors: %u\r\n", ( unsigned ) xEmulator.ulProtocolErrors );
+    printf( "elapsed_ms: %.3f\r\n", ( double ) ullElapsed / 1000.0 );
+    printf( "registrations_per_second: %.1f\r\n",
+            ( ullElapsed > 0 ) ? ( ( double ) ulSucceeded * 1000000.0 / ( double ) ullElapsed ) : 0.0 );
+
+    if( ulSucceeded > 0 )
+    {
+        printf( "latency_ms_p50: %.3f\r\n", prvPercentile( pulLatencies, ulSucceeded, 50 ) );
+        printf( "latency_ms_p90: %.3f\r\n", prvPercentile( pulLatencies, ulSucceeded, 90 ) );
+        printf( "latency_ms_p99: %.3f\r\n", prvPercentile( pulLatencies, ulSucceeded, 99 ) );
+        printf( "latency_ms_max: %.3f\r\n", ( double ) pulLatencies[ ulSucceeded - 1 ] / 1000.0 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvCoordinatorTask( void * pvParameters )
+{
+    BulkProvisioningWorker_t * pxWorkers;
+    uint32_t ulIndex;
+    uint32_t ulFirstDevice = 0;
+    uint64_t ullStart;
+    uint64_t ullElapsed;
+
+    ( void ) pvParameters;
+
+    pxWorkers = ( BulkProvisioningWorker_t * ) pvPortMalloc( sizeof( BulkProvisioningWorker_t ) * ulClientCount );
+    pulLatencies = ( uint32_t * ) pvPortMalloc( sizeof( uint32_t ) * ulDeviceCount );
+    xDoneSemaphore = xSemaphoreCreateCounting( ulClientCount, 0 );
+    configASSERT( ( pxWorkers != NULL ) && ( pulLatencies != NULL ) && ( xDoneSemaphore != NULL ) );
+
+    configASSERT( AzureIoT_Init() == eAzureIoTSuccess );
+    AzureIoTEmulator_Init( &xEmulator, &xEmulatorOptions );
+
+    ullStart = prvGetMicroseconds();
+
+    /* Split the devices as evenly as possible across the clients. */
+    for( ulIndex = 0; ulIndex < ulClientCount; ulIndex++ )
+    {
+        pxWorkers[ ulIndex ].ulFirstDevice = ulFirstDevice;
+        pxWorkers[ ulIndex ].ulDeviceCount = ( ulDeviceCount / ulClientCount ) +
+                                             ( ( ulIndex < ( ulDeviceCount % ulClientCount ) ) ? 1 : 0 );
+        ulFirstDevice += pxWorkers[ ulIndex ].ulDeviceCount;
+
+        configASSERT( xTaskCreate( prvWorkerTask, "BulkProv", bulkprovSTACK_SIZE,
+                                   &pxWorkers[ ulIndex ], bulkprovPRIORITY, NULL ) == pdPASS );
+    }
+
+    for( ulIndex = 0; ulIndex < ulClientCount; ulIndex++ )
+    {
+        xSemaphoreTake( xDoneSemaphore, portMAX_DELAY );
+    }
+
+    ullElapsed = prvGetMicroseconds() - ullStart;
+
+    prvReport( ullElapsed );
+    fflush( stdout );
+
+    exit( ( ( ulFailures == 0 ) && ( xEmulator.ulProtocolErrors == 0 ) ) ? 0 : 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUsage( const char * pcName )
+{
+    printf( "Usage: %s [-d devices] [-c clients] [-p assigning polls] [-r retry-after seconds] [-v]\r\n", pcName );
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int lOption;
+
+    while( ( lOption = getopt( argc, argv, "d:c:p:r:vh" ) ) != -1 )
+    {
+        switch( lOption )
+        {
+            case 'd':
+                ulDeviceCount = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'c':
+                ulClientCount = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'p':
+                xEmulatorOptions.ulAssigningPollCount = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'r':
+                xEmulatorOptions.ulRetryAfterSeconds = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'v':
+                ulVerbose = 1;
+                break;
+
+            default:
+                prvUsage( argv[ 0 ] );
+                return 1;
+        }
+    }
+
+    if( ( ulDeviceCount == 0 ) || ( ulClientCount == 0 ) || ( ulClientCount > bulkprovCLIENTS_MAX ) )
+    {
+        prvUsage( argv[ 0 ] );
+        return 1;
+    }
+
+    if( ulClientCount > ulDeviceCount )
+    {
+        ulClientCount = ulDeviceCount;
+    }
+
+    xTaskCreate( prvCoordinatorTask, "BulkCoord", bulkprovSTACK_SIZE,
+                 NULL, bulkprovPRIORITY + 1, NULL );
+
+    /* Start the RTOS scheduler. */
+    vTaskStartScheduler();
+
+    for( ; ; )
+    {
+    }
+}
+/*-----------------------------------------------------------*/
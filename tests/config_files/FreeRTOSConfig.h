@@ -35,7 +35,7 @@
 #define configUSE_APPLICATION_TASK_TAG             0
 #define configUSE_COUNTING_SEMAPHORES              1
 #define configUSE_ALTERNATIVE_API                  0
-#define configNUM_THREAD_LOCAL_STORAGE_POINTERS    0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS    1 /* At least azureiotconfigSTACK_PROFILING_TLS_INDEX + 1. */
 #define configENABLE_BACKWARD_COMPATIBILITY        1
 #define configSUPPORT_STATIC_ALLOCATION            1
 
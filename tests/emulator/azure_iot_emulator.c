@@ -0,0 +1,864 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include "azure_iot_emulator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+/*-----------------------------------------------------------*/
+
+/* MQTT control packet types (high nibble of the fixed header). */
+#define azureiotemulatorPACKET_CONNECT        ( 1U )
+#define azureiotemulatorPACKET_PUBLISH        ( 3U )
+#define azureiotemulatorPACKET_PUBACK         ( 4U )
+#define azureiotemulatorPACKET_SUBSCRIBE      ( 8U )
+#define azureiotemulatorPACKET_UNSUBSCRIBE    ( 10U )
+#define azureiotemulatorPACKET_PINGREQ        ( 12U )
+#define azureiotemulatorPACKET_DISCONNECT     ( 14U )
+
+/* Topic filters the emulator serves, one bit each in the session subscriptions. */
+#define azureiotemulatorSUBSCRIPTION_DPS             ( 0x1U )
+#define azureiotemulatorSUBSCRIPTION_C2D             ( 0x2U )
+#define azureiotemulatorSUBSCRIPTION_COMMANDS        ( 0x4U )
+#define azureiotemulatorSUBSCRIPTION_TWIN_RESPONSE   ( 0x8U )
+#define azureiotemulatorSUBSCRIPTION_TWIN_DESIRED    ( 0x10U )
+
+#define azureiotemulatorTOPIC_MAX             ( 256 )
+#define azureiotemulatorPAYLOAD_MAX           ( 1024 )
+#define azureiotemulatorRID_MAX               ( 16 )
+
+#define azureiotemulatorDEFAULT_HUB           "emulator.azure-devices.net"
+#define azureiotemulatorDEFAULT_TWIN          "{\"desired\":{\"$version\":1},\"reported\":{\"$version\":1}}"
+
+static const char cDPSResponseFilter[] = "$dps/registrations/res/#";
+static const char cDPSRegisterTopic[] = "$dps/registrations/PUT/iotdps-register/?";
+static const char cDPSQueryTopic[] = "$dps/registrations/GET/iotdps-get-operationstatus/?";
+
+static const char cC2DFilter[] = "devices/+/messages/devicebound/#";
+static const char cCommandsFilter[] = "$iothub/methods/POST/#";
+static const char cTwinResponseFilter[] = "$iothub/twin/res/#";
+static const char cTwinDesiredFilter[] = "$iothub/twin/PATCH/properties/desired/#";
+
+static const char cTelemetryTopicPrefix[] = "devices/";
+static const char cTelemetryTopicSegment[] = "/messages/events/";
+static const char cCommandResponseTopic[] = "$iothub/methods/res/";
+static const char cTwinGetTopic[] = "$iothub/twin/GET/?";
+static const char cTwinReportedTopic[] = "$iothub/twin/PATCH/properties/reported/?";
+/*-----------------------------------------------------------*/
+
+static void prvIncrement( uint32_t * pulCounter )
+{
+    taskENTER_CRITICAL();
+    ( *pulCounter )++;
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Drop the session; the client sees a transport error on its next call.
+ *
+ * */
+static void prvProtocolError( NetworkContext_t * pxNetworkContext )
+{
+    if( !pxNetworkContext->ulClosed )
+    {
+        pxNetworkContext->ulClosed = 1;
+        prvIncrement( &pxNetworkContext->pxEmulator->ulProtocolErrors );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvReadUint16( const uint8_t * pucBuffer )
+{
+    return ( ( uint32_t ) pucBuffer[ 0 ] << 8 ) | pucBuffer[ 1 ];
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Read a length prefixed string at *pxOffset, advancing the offset past it.
+ *
+ * */
+static const uint8_t * prvReadString( const uint8_t * pucPacket,
+                                      size_t xPacketLength,
+                                      size_t * pxOffset,
+                                      size_t * pxStringLength )
+{
+    const uint8_t * pucString = NULL;
+
+    if( ( *pxOffset + 2 ) <= xPacketLength )
+    {
+        *pxStringLength = prvReadUint16( pucPacket + *pxOffset );
+
+        if( ( *pxOffset + 2 + *pxStringLength ) <= xPacketLength )
+        {
+            pucString = pucPacket + *pxOffset + 2;
+            *pxOffset += 2 + *pxStringLength;
+        }
+    }
+
+    return pucString;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Append a packet to the outbound queue of the session.
+ *
+ * */
+static void prvQueue( NetworkContext_t * pxNetworkContext,
+                      const uint8_t * pucData,
+                      size_t xDataLength )
+{
+    if( pxNetworkContext->xOutboundHead == pxNetworkContext->xOutboundLength )
+    {
+        pxNetworkContext->xOutboundHead = 0;
+        pxNetworkContext->xOutboundLength = 0;
+    }
+
+    if( xDataLength > ( sizeof( pxNetworkContext->ucOutbound ) - pxNetworkContext->xOutboundLength ) )
+    {
+        prvProtocolError( pxNetworkContext );
+        return;
+    }
+
+    memcpy( pxNetworkContext->ucOutbound + pxNetworkContext->xOutboundLength, pucData, xDataLength );
+    pxNetworkContext->xOutboundLength += xDataLength;
+}
+/*-----------------------------------------------------------*/
+
+static void prvQueueAck( NetworkContext_t * pxNetworkContext,
+                         uint8_t ucHeader,
+                         uint32_t ulPacketID )
+{
+    uint8_t ucAck[ 4 ];
+
+    ucAck[ 0 ] = ucHeader;
+    ucAck[ 1 ] = 2;
+    ucAck[ 2 ] = ( uint8_t ) ( ulPacketID >> 8 );
+    ucAck[ 3 ] = ( uint8_t ) ulPacketID;
+
+    prvQueue( pxNetworkContext, ucAck, sizeof( ucAck ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Deliver a QoS 0 publish to the client, returning -1 if it does not fit the session.
+ *
+ * */
+static int32_t prvQueuePublish( NetworkContext_t * pxNetworkContext,
+                                const char * pcTopic,
+                                size_t xTopicLength,
+                                const uint8_t * pucPayload,
+                                size_t xPayloadLength )
+{
+    uint8_t ucHeader[ 7 ];
+    size_t xHeaderLength = 1;
+    size_t xRemaining = 2 + xTopicLength + xPayloadLength;
+    size_t xPending = pxNetworkContext->xOutboundLength - pxNetworkContext->xOutboundHead;
+
+    ucHeader[ 0 ] = ( uint8_t ) ( azureiotemulatorPACKET_PUBLISH << 4 );
+
+    do
+    {
+        ucHeader[ xHeaderLength ] = ( uint8_t ) ( xRemaining & 0x7F );
+        xRemaining >>= 7;
+
+        if( xRemaining > 0 )
+        {
+            ucHeader[ xHeaderLength ] |= 0x80;
+        }
+
+        xHeaderLength++;
+    } while( xRemaining > 0 );
+
+    ucHeader[ xHeaderLength++ ] = ( uint8_t ) ( xTopicLength >> 8 );
+    ucHeader[ xHeaderLength++ ] = ( uint8_t ) xTopicLength;
+
+    if( ( pxNetworkContext->ulClosed ) ||
+        ( ( xHeaderLength + xTopicLength + xPayloadLength ) >
+          ( sizeof( pxNetworkContext->ucOutbound ) - ( ( xPending == 0 ) ? 0 : pxNetworkContext->xOutboundLength ) ) ) )
+    {
+        return -1;
+    }
+
+    prvQueue( pxNetworkContext, ucHeader, xHeaderLength );
+    prvQueue( pxNetworkContext, ( const uint8_t * ) pcTopic, xTopicLength );
+    prvQueue( pxNetworkContext, pucPayload, xPayloadLength );
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Deliver a reply generated by the emulator; a reply that can not be delivered drops the session.
+ *
+ * */
+static void prvQueueReply( NetworkContext_t * pxNetworkContext,
+                           const char * pcTopic,
+                           int lTopicLength,
+                           const char * pcPayload,
+                           int lPayloadLength,
+                           size_t xTopicSize,
+                           size_t xPayloadSize )
+{
+    if( ( lTopicLength < 0 ) || ( ( size_t ) lTopicLength >= xTopicSize ) ||
+        ( lPayloadLength < 0 ) || ( ( size_t ) lPayloadLength >= xPayloadSize ) ||
+        ( prvQueuePublish( pxNetworkContext, pcTopic, ( size_t ) lTopicLength,
+                           ( const uint8_t * ) pcPayload, ( size_t ) lPayloadLength ) != 0 ) )
+    {
+        prvProtocolError( pxNetworkContext );
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Copy the value of a "$rid" request ID out of a topic's property bag.
+ *
+ * */
+static void prvGetRequestID( const uint8_t * pucTopic,
+                             size_t xTopicLength,
+                             char * pcRequestID,
+                             size_t xRequestIDSize )
+{
+    size_t xIndex;
+    size_t xLength = 0;
+
+    for( xIndex = 0; ( xIndex + 5 ) <= xTopicLength; xIndex++ )
+    {
+        if( memcmp( pucTopic + xIndex, "$rid=", 5 ) == 0 )
+        {
+            xIndex += 5;
+
+            while( ( xIndex < xTopicLength ) && ( pucTopic[ xIndex ] != '&' ) &&
+                   ( xLength < ( xRequestIDSize - 1 ) ) )
+            {
+                pcRequestID[ xLength++ ] = ( char ) pucTopic[ xIndex++ ];
+            }
+
+            break;
+        }
+    }
+
+    pcRequestID[ xLength ] = '\0';
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Answer a registration request or status query with the operation status.
+ *
+ * */
+static void prvDPSReply( NetworkContext_t * pxNetworkContext,
+                         const char * pcRequestID )
+{
+    AzureIoTEmulator_t * pxEmulator = pxNetworkContext->pxEmulator;
+    char cTopic[ azureiotemulatorTOPIC_MAX ];
+    char cPayload[ azureiotemulatorPAYLOAD_MAX ];
+    int lTopicLength;
+    int lPayloadLength;
+    int lClientIDLength = ( int ) pxNetworkContext->xClientIDLength;
+    const char * pcClientID = pxNetworkContext->cClientID;
+
+    if( !( pxNetworkContext->ulSubscriptions & azureiotemulatorSUBSCRIPTION_DPS ) )
+    {
+        /* Like a broker, drop responses nobody listens to. */
+        return;
+    }
+
+    if( pxNetworkContext->ulPendingPolls > 0 )
+    {
+        pxNetworkContext->ulPendingPolls--;
+
+        if( pxEmulator->xOptions.ulRetryAfterSeconds > 0 )
+        {
+            lTopicLength = snprintf( cTopic, sizeof( cTopic ),
+                                     "$dps/registrations/res/202/?$rid=%s&retry-after=%u",
+                                     pcRequestID, ( unsigned ) pxEmulator->xOptions.ulRetryAfterSeconds );
+        }
+        else
+        {
+            lTopicLength = snprintf( cTopic, sizeof( cTopic ),
+                                     "$dps/registrations/res/202/?$rid=%s", pcRequestID );
+        }
+
+        lPayloadLength = snprintf( cPayload, sizeof( cPayload ),
+                                   "{\"operationId\":\"4.emulator.%.*s\",\"status\":\"assigning\"}",
+                                   lClientIDLength, pcClientID );
+    }
+    else
+    {
+        lTopicLength = snprintf( cTopic, sizeof( cTopic ),
+                                 "$dps/registrations/res/200/?$rid=%s", pcRequestID );
+        lPayloadLength = snprintf( cPayload, sizeof( cPayload ),
+                                   "{\"operationId\":\"4.emulator.%.*s\",\"status\":\"assigned\",\"registrationState\":"
+                                   "{\"registrationId\":\"%.*s\",\"createdDateTimeUtc\":\"2021-01-01T00:00:00.0000000Z\","
+                                   "\"assignedHub\":\"%s\",\"deviceId\":\"%.*s\",\"status\":\"assigned\","
+                                   "\"substatus\":\"initialAssignment\",\"lastUpdatedDateTimeUtc\":\"2021-01-01T00:00:00.0000000Z\","
+                                   "\"etag\":\"IjAwMDAwMDAwLTAwMDAtMDAwMC0wMDAwLTAwMDAwMDAwMDAwMCI=\"}}",
+                                   lClientIDLength, pcClientID, lClientIDLength, pcClientID,
+                                   pxEmulator->xOptions.pcAssignedHub, lClientIDLength, pcClientID );
+        prvIncrement( &pxEmulator->ulAssignments );
+    }
+
+    prvQueueReply( pxNetworkContext, cTopic, lTopicLength, cPayload, lPayloadLength,
+                   sizeof( cTopic ), sizeof( cPayload ) );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Answer a property document request or a reported property update.
+ *
+ * */
+static void prvTwinReply( NetworkContext_t * pxNetworkContext,
+                          const uint8_t * pucTopic,
+                          size_t xTopicLength,
+                          uint32_t ulReported )
+{
+    AzureIoTEmulator_t * pxEmulator = pxNetworkContext->pxEmulator;
+    char cRequestID[ azureiotemulatorRID_MAX ];
+    char cTopic[ azureiotemulatorTOPIC_MAX ];
+    const char * pcPayload = "";
+    int lTopicLength;
+    int lPayloadLength = 0;
+
+    prvGetRequestID( pucTopic, xTopicLength, cRequestID, sizeof( cRequestID ) );
+
+    if( ulReported )
+    {
+        prvIncrement( &pxEmulator->ulReportedProperties );
+        pxNetworkContext->ulReportedVersion++;
+        lTopicLength = snprintf( cTopic, sizeof( cTopic ), "$iothub/twin/res/204/?$rid=%s&$version=%u",
+                                 cRequestID, ( unsigned ) pxNetworkContext->ulReportedVersion );
+    }
+    else
+    {
+        prvIncrement( &pxEmulator->ulPropertyRequests );
+        lTopicLength = snprintf( cTopic, sizeof( cTopic ), "$iothub/twin/res/200/?$rid=%s", cRequestID );
+        pcPayload = pxEmulator->xOptions.pcTwinDocument;
+        lPayloadLength = ( int ) strlen( pcPayload );
+    }
+
+    if( pxNetworkContext->ulSubscriptions & azureiotemulatorSUBSCRIPTION_TWIN_RESPONSE )
+    {
+        prvQueueReply( pxNetworkContext, cTopic, lTopicLength, pcPayload, lPayloadLength,
+                       sizeof( cTopic ), ( size_t ) lPayloadLength + 1 );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvIsTelemetryTopic( const uint8_t * pucTopic,
+                                     size_t xTopicLength )
+{
+    size_t xIndex;
+
+    if( ( xTopicLength < ( sizeof( cTelemetryTopicPrefix ) - 1 ) ) ||
+        ( memcmp( pucTopic, cTelemetryTopicPrefix, sizeof( cTelemetryTopicPrefix ) - 1 ) != 0 ) )
+    {
+        return 0;
+    }
+
+    /* devices/<device>[/modules/<module>]/messages/events/... */
+    for( xIndex = sizeof( cTelemetryTopicPrefix ) - 1;
+         ( xIndex + sizeof( cTelemetryTopicSegment ) - 1 ) <= xTopicLength; xIndex++ )
+    {
+        if( memcmp( pucTopic + xIndex, cTelemetryTopicSegment, sizeof( cTelemetryTopicSegment ) - 1 ) == 0 )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvTopicStartsWith( const uint8_t * pucTopic,
+                                    size_t xTopicLength,
+                                    const char * pcPrefix,
+                                    size_t xPrefixLength )
+{
+    return ( xTopicLength >= xPrefixLength ) && ( memcmp( pucTopic, pcPrefix, xPrefixLength ) == 0 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandlePublishTopic( NetworkContext_t * pxNetworkContext,
+                                   const uint8_t * pucTopic,
+                                   size_t xTopicLength,
+                                   size_t xPayloadLength )
+{
+    AzureIoTEmulator_t * pxEmulator = pxNetworkContext->pxEmulator;
+    char cRequestID[ azureiotemulatorRID_MAX ];
+
+    if( prvIsTelemetryTopic( pucTopic, xTopicLength ) )
+    {
+        taskENTER_CRITICAL();
+        pxEmulator->ulTelemetryMessages++;
+        pxEmulator->ulTelemetryBytes += ( uint32_t ) xPayloadLength;
+        taskEXIT_CRITICAL();
+    }
+    else if( prvTopicStartsWith( pucTopic, xTopicLength, cCommandResponseTopic, sizeof( cCommandResponseTopic ) - 1 ) )
+    {
+        prvIncrement( &pxEmulator->ulCommandResponses );
+    }
+    else if( prvTopicStartsWith( pucTopic, xTopicLength, cTwinGetTopic, sizeof( cTwinGetTopic ) - 1 ) )
+    {
+        prvTwinReply( pxNetworkContext, pucTopic, xTopicLength, 0 );
+    }
+    else if( prvTopicStartsWith( pucTopic, xTopicLength, cTwinReportedTopic, sizeof( cTwinReportedTopic ) - 1 ) )
+    {
+        prvTwinReply( pxNetworkContext, pucTopic, xTopicLength, 1 );
+    }
+    else if( prvTopicStartsWith( pucTopic, xTopicLength, cDPSRegisterTopic, sizeof( cDPSRegisterTopic ) - 1 ) )
+    {
+        prvIncrement( &pxEmulator->ulRegistrations );
+        pxNetworkContext->ulPendingPolls = pxEmulator->xOptions.ulAssigningPollCount;
+        prvGetRequestID( pucTopic, xTopicLength, cRequestID, sizeof( cRequestID ) );
+        prvDPSReply( pxNetworkContext, cRequestID );
+    }
+    else if( prvTopicStartsWith( pucTopic, xTopicLength, cDPSQueryTopic, sizeof( cDPSQueryTopic ) - 1 ) )
+    {
+        prvIncrement( &pxEmulator->ulQueries );
+        prvGetRequestID( pucTopic, xTopicLength, cRequestID, sizeof( cRequestID ) );
+        prvDPSReply( pxNetworkContext, cRequestID );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleConnect( NetworkContext_t * pxNetworkContext,
+                              const uint8_t * pucPacket,
+                              size_t xPacketLength )
+{
+    static const uint8_t ucConnack[] = { 0x20, 0x02, 0x00, 0x00 };
+    const uint8_t * pucClientID;
+    size_t xOffset = 10; /* Protocol name, level, flags and keep alive. */
+    size_t xClientIDLength;
+
+    if( ( xPacketLength < xOffset ) ||
+        ( pxNetworkContext->ulConnected ) ||
+        ( ( pucClientID = prvReadString( pucPacket, xPacketLength,
+                                         &xOffset, &xClientIDLength ) ) == NULL ) ||
+        ( xClientIDLength >= sizeof( pxNetworkContext->cClientID ) ) )
+    {
+        prvProtocolError( pxNetworkContext );
+        return;
+    }
+
+    memcpy( pxNetworkContext->cClientID, pucClientID, xClientIDLength );
+    pxNetworkContext->cClientID[ xClientIDLength ] = '\0';
+    pxNetworkContext->xClientIDLength = xClientIDLength;
+    pxNetworkContext->ulConnected = 1;
+    prvIncrement( &pxNetworkContext->pxEmulator->ulConnections );
+
+    prvQueue( pxNetworkContext, ucConnack, sizeof( ucConnack ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandlePublish( NetworkContext_t * pxNetworkContext,
+                              uint8_t ucFlags,
+                              const uint8_t * pucPacket,
+                              size_t xPacketLength )
+{
+    const uint8_t * pucTopic;
+    size_t xTopicLength;
+    size_t xOffset = 0;
+    uint32_t ulQoS = ( ucFlags >> 1 ) & 0x3;
+
+    if( ( ulQoS > 1 ) ||
+        ( ( pucTopic = prvReadString( pucPacket, xPacketLength, &xOffset, &xTopicLength ) ) == NULL ) ||
+        ( ( ulQoS == 1 ) && ( ( xOffset + 2 ) > xPacketLength ) ) )
+    {
+        prvProtocolError( pxNetworkContext );
+        return;
+    }
+
+    if( ulQoS == 1 )
+    {
+        prvQueueAck( pxNetworkContext, ( uint8_t ) ( azureiotemulatorPACKET_PUBACK << 4 ),
+                     prvReadUint16( pucPacket + xOffset ) );
+    }
+
+    prvHandlePublishTopic( pxNetworkContext, pucTopic, xTopicLength,
+                           xPacketLength - xOffset - ( ( ulQoS == 1 ) ? 2 : 0 ) );
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvGetSubscription( const uint8_t * pucFilter,
+                                    size_t xFilterLength )
+{
+    uint32_t ulSubscription = 0;
+
+    static const struct
+    {
+        const char * pcFilter;
+        size_t xFilterLength;
+        uint32_t ulSubscription;
+    } xFilters[] =
+    {
+        { cDPSResponseFilter,  sizeof( cDPSResponseFilter ) - 1,  azureiotemulatorSUBSCRIPTION_DPS           },
+        { cC2DFilter,          sizeof( cC2DFilter ) - 1,          azureiotemulatorSUBSCRIPTION_C2D           },
+        { cCommandsFilter,     sizeof( cCommandsFilter ) - 1,     azureiotemulatorSUBSCRIPTION_COMMANDS      },
+        { cTwinResponseFilter, sizeof( cTwinResponseFilter ) - 1, azureiotemulatorSUBSCRIPTION_TWIN_RESPONSE },
+        { cTwinDesiredFilter,  sizeof( cTwinDesiredFilter ) - 1,  azureiotemulatorSUBSCRIPTION_TWIN_DESIRED  },
+    };
+    size_t xIndex;
+
+    for( xIndex = 0; xIndex < ( sizeof( xFilters ) / sizeof( xFilters[ 0 ] ) ); xIndex++ )
+    {
+        if( ( xFilterLength == xFilters[ xIndex ].xFilterLength ) &&
+            ( memcmp( pucFilter, xFilters[ xIndex ].pcFilter, xFilterLength ) == 0 ) )
+        {
+            ulSubscription = xFilters[ xIndex ].ulSubscription;
+            break;
+        }
+    }
+
+    return ulSubscription;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleSubscribe( NetworkContext_t * pxNetworkContext,
+                                uint32_t ulUnsubscribe,
+                                const uint8_t * pucPacket,
+                                size_t xPacketLength )
+{
+    uint8_t ucSuback[ 4 + 8 ];
+    size_t xSubackLength = 4;
+    const uint8_t * pucFilter;
+    size_t xFilterLength;
+    size_t xOffset = 2;
+    uint32_t ulSubscription;
+
+    if( xPacketLength < xOffset )
+    {
+        prvProtocolError( pxNetworkContext );
+        return;
+    }
+
+    while( xOffset < xPacketLength )
+    {
+        if( ( ( pucFilter = prvReadString( pucPacket, xPacketLength, &xOffset, &xFilterLength ) ) == NULL ) ||
+            ( ( !ulUnsubscribe ) && ( xOffset >= xPacketLength ) ) ||
+            ( xSubackLength == sizeof( ucSuback ) ) )
+        {
+            prvProtocolError( pxNetworkContext );
+            return;
+        }
+
+        ulSubscription = prvGetSubscription( pucFilter, xFilterLength );
+
+        if( ulUnsubscribe )
+        {
+            pxNetworkContext->ulSubscriptions &= ~ulSubscription;
+        }
+        else
+        {
+            pxNetworkContext->ulSubscriptions |= ulSubscription;
+            /* Grant at most QoS 1, and refuse filters the emulator does not serve. */
+            ucSuback[ xSubackLength++ ] = ( ulSubscription == 0 ) ? 0x80 :
+                                          ( ( pucPacket[ xOffset ] & 0x3 ) ? 1 : 0 );
+            xOffset++;
+        }
+    }
+
+    if( ulUnsubscribe )
+    {
+        prvQueueAck( pxNetworkContext, 0xB0, prvReadUint16( pucPacket ) );
+    }
+    else
+    {
+        ucSuback[ 0 ] = 0x90;
+        ucSuback[ 1 ] = ( uint8_t ) ( xSubackLength - 2 );
+        ucSuback[ 2 ] = pucPacket[ 0 ];
+        ucSuback[ 3 ] = pucPacket[ 1 ];
+        prvQueue( pxNetworkContext, ucSuback, xSubackLength );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandlePacket( NetworkContext_t * pxNetworkContext,
+                             uint8_t ucHeader,
+                             const uint8_t * pucPacket,
+                             size_t xPacketLength )
+{
+    static const uint8_t ucPingResp[] = { 0xD0, 0x00 };
+    uint32_t ulType = ucHeader >> 4;
+
+    if( ( ulType != azureiotemulatorPACKET_CONNECT ) && !pxNetworkContext->ulConnected )
+    {
+        prvProtocolError( pxNetworkContext );
+        return;
+    }
+
+    switch( ulType )
+    {
+        case azureiotemulatorPACKET_CONNECT:
+            prvHandleConnect( pxNetworkContext, pucPacket, xPacketLength );
+            break;
+
+        case azureiotemulatorPACKET_PUBLISH:
+            prvHandlePublish( pxNetworkContext, ucHeader & 0x0F, pucPacket, xPacketLength );
+            break;
+
+        case azureiotemulatorPACKET_PUBACK:
+            /* Replies are delivered at QoS 0, nothing to track. */
+            break;
+
+        case azureiotemulatorPACKET_SUBSCRIBE:
+            prvHandleSubscribe( pxNetworkContext, 0, pucPacket, xPacketLength );
+            break;
+
+        case azureiotemulatorPACKET_UNSUBSCRIBE:
+            prvHandleSubscribe( pxNetworkContext, 1, pucPacket, xPacketLength );
+            break;
+
+        case azureiotemulatorPACKET_PINGREQ:
+            prvQueue( pxNetworkContext, ucPingResp, sizeof( ucPingResp ) );
+            break;
+
+        case azureiotemulatorPACKET_DISCONNECT:
+            pxNetworkContext->ulConnected = 0;
+            pxNetworkContext->ulClosed = 1;
+            break;
+
+        default:
+            prvProtocolError( pxNetworkContext );
+            break;
+    }
+}
+/*-----------------------------------------------------------*/
+
+/**
+ *
+ * Handle every complete packet in the inbound buffer, keeping a trailing partial one.
+ *
+ * */
+static void prvProcessInbound( NetworkContext_t * pxNetworkContext )
+{
+    size_t xOffset = 0;
+    size_t xRemaining;
+    size_t xIndex;
+    uint32_t ulShift;
+    uint32_t ulComplete;
+
+    while( !pxNetworkContext->ulClosed && ( ( pxNetworkContext->xInboundLength - xOffset ) >= 2 ) )
+    {
+        xRemaining = 0;
+        ulShift = 0;
+        ulComplete = 0;
+
+        for( xIndex = xOffset + 1; ( xIndex < pxNetworkContext->xInboundLength ) && ( xIndex <= ( xOffset + 4 ) ); xIndex++ )
+        {
+            xRemaining |= ( size_t ) ( pxNetworkContext->ucInbound[ xIndex ] & 0x7F ) << ulShift;
+            ulShift += 7;
+
+            if( !( pxNetworkContext->ucInbound[ xIndex ] & 0x80 ) )
+            {
+                ulComplete = 1;
+                break;
+            }
+        }
+
+        if( !ulComplete )
+        {
+            if( xIndex > ( xOffset + 4 ) )
+            {
+                prvProtocolError( pxNetworkContext );
+            }
+
+            break;
+        }
+
+        if( ( pxNetworkContext->xInboundLength - ( xIndex + 1 ) ) < xRemaining )
+        {
+            break;
+        }
+
+        prvHandlePacket( pxNetworkContext, pxNetworkContext->ucInbound[ xOffset ],
+                         pxNetworkContext->ucInbound + xIndex + 1, xRemaining );
+        xOffset = xIndex + 1 + xRemaining;
+    }
+
+    memmove( pxNetworkContext->ucInbound, pxNetworkContext->ucInbound + xOffset,
+             pxNetworkContext->xInboundLength - xOffset );
+    pxNetworkContext->xInboundLength -= xOffset;
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTEmulator_Init( AzureIoTEmulator_t * pxEmulator,
+                            const AzureIoTEmulatorOptions_t * pxOptions )
+{
+    memset( pxEmulator, 0, sizeof( AzureIoTEmulator_t ) );
+
+    if( pxOptions != NULL )
+    {
+        pxEmulator->xOptions = *pxOptions;
+    }
+
+    if( pxEmulator->xOptions.pcAssignedHub == NULL )
+    {
+        pxEmulator->xOptions.pcAssignedHub = azureiotemulatorDEFAULT_HUB;
+    }
+
+    if( pxEmulator->xOptions.pcTwinDocument == NULL )
+    {
+        pxEmulator->xOptions.pcTwinDocument = azureiotemulatorDEFAULT_TWIN;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void AzureIoTEmulator_SessionInit( AzureIoTEmulator_t * pxEmulator,
+                                   NetworkContext_t * pxNetworkContext,
+                                   AzureIoTTransportInterface_t * pxTransport )
+{
+    memset( pxNetworkContext, 0, sizeof( NetworkContext_t ) );
+    pxNetworkContext->pxEmulator = pxEmulator;
+    pxNetworkContext->ulDesiredVersion = 1;
+    pxNetworkContext->ulReportedVersion = 1;
+
+    pxTransport->pxNetworkContext = pxNetworkContext;
+    pxTransport->xSend = AzureIoTEmulator_Send;
+    pxTransport->xRecv = AzureIoTEmulator_Recv;
+}
+/*-----------------------------------------------------------*/
+
+int32_t AzureIoTEmulator_SendCloudMessage( NetworkContext_t * pxNetworkContext,
+                                           const uint8_t * pucPayload,
+                                           uint32_t ulPayloadLength )
+{
+    char cTopic[ azureiotemulatorTOPIC_MAX ];
+    int lTopicLength;
+
+    if( !( pxNetworkContext->ulSubscriptions & azureiotemulatorSUBSCRIPTION_C2D ) )
+    {
+        return -1;
+    }
+
+    lTopicLength = snprintf( cTopic, sizeof( cTopic ),
+                             "devices/%s/messages/devicebound/%%24.to=%%2Fdevices%%2F%s%%2Fmessages%%2FdeviceBound",
+                             pxNetworkContext->cClientID, pxNetworkContext->cClientID );
+
+    if( ( lTopicLength < 0 ) || ( lTopicLength >= ( int ) sizeof( cTopic ) ) )
+    {
+        return -1;
+    }
+
+    return prvQueuePublish( pxNetworkContext, cTopic, ( size_t ) lTopicLength,
+                            pucPayload, ulPayloadLength );
+}
+/*-----------------------------------------------------------*/
+
+int32_t AzureIoTEmulator_InvokeCommand( NetworkContext_t * pxNetworkContext,
+                                        const char * pcCommandName,
+                                        const uint8_t * pucPayload,
+                                        uint32_t ulPayloadLength )
+{
+    char cTopic[ azureiotemulatorTOPIC_MAX ];
+    int lTopicLength;
+
+    if( !( pxNetworkContext->ulSubscriptions & azureiotemulatorSUBSCRIPTION_COMMANDS ) )
+    {
+        return -1;
+    }
+
+    lTopicLength = snprintf( cTopic, sizeof( cTopic ), "$iothub/methods/POST/%s/?$rid=%x",
+                             pcCommandName, ( unsigned ) ++pxNetworkContext->ulCommandRequestID );
+
+    if( ( lTopicLength < 0 ) || ( lTopicLength >= ( int ) sizeof( cTopic ) ) )
+    {
+        return -1;
+    }
+
+    return prvQueuePublish( pxNetworkContext, cTopic, ( size_t ) lTopicLength,
+                            pucPayload, ulPayloadLength );
+}
+/*-----------------------------------------------------------*/
+
+int32_t AzureIoTEmulator_UpdateDesiredProperties( NetworkContext_t * pxNetworkContext,
+                                                  const uint8_t * pucPayload,
+                                                  uint32_t ulPayloadLength )
+{
+    char cTopic[ azureiotemulatorTOPIC_MAX ];
+    int lTopicLength;
+
+    if( !( pxNetworkContext->ulSubscriptions & azureiotemulatorSUBSCRIPTION_TWIN_DESIRED ) )
+    {
+        return -1;
+    }
+
+    lTopicLength = snprintf( cTopic, sizeof( cTopic ), "$iothub/twin/PATCH/properties/desired/?$version=%u",
+                             ( unsigned ) ( pxNetworkContext->ulDesiredVersion + 1 ) );
+
+    if( ( lTopicLength < 0 ) || ( lTopicLength >= ( int ) sizeof( cTopic ) ) ||
+        ( prvQueuePublish( pxNetworkContext, cTopic, ( size_t ) lTopicLength,
+                           pucPayload, ulPayloadLength ) != 0 ) )
+    {
+        return -1;
+    }
+
+    pxNetworkContext->ulDesiredVersion++;
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+int32_t AzureIoTEmulator_Send( NetworkContext_t * pxNetworkContext,
+                               const void * pvBuffer,
+                               size_t xBytesToSend )
+{
+    if( pxNetworkContext->ulClosed )
+    {
+        return -1;
+    }
+
+    if( xBytesToSend > ( sizeof( pxNetworkContext->ucInbound ) - pxNetworkContext->xInboundLength ) )
+    {
+        prvProtocolError( pxNetworkContext );
+        return -1;
+    }
+
+    memcpy( pxNetworkContext->ucInbound + pxNetworkContext->xInboundLength, pvBuffer, xBytesToSend );
+    pxNetworkContext->xInboundLength += xBytesToSend;
+    prvProcessInbound( pxNetworkContext );
+
+    return ( int32_t ) xBytesToSend;
+}
+/*-----------------------------------------------------------*/
+
+int32_t AzureIoTEmulator_Recv( NetworkContext_t * pxNetworkContext,
+                               void * pvBuffer,
+                               size_t xBytesToRecv )
+{
+    size_t xAvailable = pxNetworkContext->xOutboundLength - pxNetworkContext->xOutboundHead;
+
+    if( xAvailable == 0 )
+    {
+        if( pxNetworkContext->ulClosed )
+        {
+            return -1;
+        }
+
+        /* Nothing pending, let the other sessions run instead of spinning. */
+        taskYIELD();
+        return 0;
+    }
+
+    if( xBytesToRecv > xAvailable )
+    {
+        xBytesToRecv = xAvailable;
+    }
+
+    memcpy( pvBuffer, pxNetworkContext->ucOutbound + pxNetworkContext->xOutboundHead, xBytesToRecv );
+    pxNetworkContext->xOutboundHead += xBytesToRecv;
+
+    return ( int32_t ) xBytesToRecv;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,173 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/**
+ * @file azure_iot_emulator.h
+ *
+ * @brief In-process MQTT broker emulator standing in for Azure IoT Hub and
+ * the Device Provisioning Service.
+ *
+ * @note The emulator speaks just enough MQTT 3.1.1 and of the IoT Hub and DPS
+ * topic conventions to serve the middleware clients over an in-memory
+ * #AzureIoTTransportInterface_t. Every transport session is a #NetworkContext_t;
+ * replies are generated synchronously while the client sends, and handed back
+ * on the next receive. Service initiated traffic (cloud messages, commands and
+ * writable property updates) is injected with the AzureIoTEmulator_*
+ * functions taking a session. Nothing leaves the process, so results are
+ * deterministic and need no live service.
+ *
+ * A session is not locked: inject into it from the task driving its client,
+ * between calls into the client.
+ *
+ */
+
+#ifndef AZURE_IOT_EMULATOR_H
+#define AZURE_IOT_EMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "azure_iot_transport_interface.h"
+
+/* Size of the per session buffers holding partial client packets and pending replies. */
+#ifndef azureiotemulatorSESSION_BUFFER_SIZE
+    #define azureiotemulatorSESSION_BUFFER_SIZE    ( 4096 )
+#endif
+
+/* Longest client ID (registration or device ID) the emulator keeps per session. */
+#define azureiotemulatorCLIENT_ID_MAX              ( 128 )
+
+/**
+ * @brief Emulator behavior.
+ *
+ */
+typedef struct AzureIoTEmulatorOptions
+{
+    const char * pcAssignedHub;         /**< Hub hostname returned on assignment. */
+    uint32_t ulAssigningPollCount;      /**< Number of "assigning" replies before a device is assigned. */
+    uint32_t ulRetryAfterSeconds;       /**< retry-after hint sent with "assigning" replies, 0 to omit it. */
+    const char * pcTwinDocument;        /**< Document returned for property requests. */
+} AzureIoTEmulatorOptions_t;
+
+/**
+ * @brief Emulator instance shared by all sessions.
+ *
+ * @note Counters are updated from the sessions' tasks inside critical sections.
+ *
+ */
+typedef struct AzureIoTEmulator
+{
+    AzureIoTEmulatorOptions_t xOptions;
+    uint32_t ulConnections;             /**< CONNECT packets accepted. */
+    uint32_t ulRegistrations;           /**< Registration requests served. */
+    uint32_t ulQueries;                 /**< Operation status queries served. */
+    uint32_t ulAssignments;             /**< Devices assigned to a hub. */
+    uint32_t ulTelemetryMessages;       /**< Telemetry messages received. */
+    uint32_t ulTelemetryBytes;          /**< Telemetry payload bytes received. */
+    uint32_t ulCommandResponses;        /**< Command responses received. */
+    uint32_t ulPropertyRequests;        /**< Property document requests served. */
+    uint32_t ulReportedProperties;      /**< Reported property updates served. */
+    uint32_t ulProtocolErrors;          /**< Sessions dropped for malformed or unsupported packets. */
+} AzureIoTEmulator_t;
+
+/**
+ * @brief One client connection to the emulator.
+ *
+ * @note Defines the transport context type for the emulator transport; do not link
+ * the emulator with another transport implementation.
+ *
+ */
+struct NetworkContext
+{
+    AzureIoTEmulator_t * pxEmulator;
+    uint8_t ucInbound[ azureiotemulatorSESSION_BUFFER_SIZE ];
+    size_t xInboundLength;
+    uint8_t ucOutbound[ azureiotemulatorSESSION_BUFFER_SIZE ];
+    size_t xOutboundHead;
+    size_t xOutboundLength;
+    char cClientID[ azureiotemulatorCLIENT_ID_MAX ];
+    size_t xClientIDLength;
+    uint32_t ulConnected;
+    uint32_t ulClosed;
+    uint32_t ulSubscriptions;
+    uint32_t ulPendingPolls;
+    uint32_t ulCommandRequestID;
+    uint32_t ulDesiredVersion;
+    uint32_t ulReportedVersion;
+};
+
+typedef struct NetworkContext NetworkContext_t;
+
+/**
+ * @brief Initialize the emulator.
+ *
+ * @param[out] pxEmulator The #AzureIoTEmulator_t * to initialize.
+ * @param[in] pxOptions Behavior of the emulator, or `NULL` for the defaults.
+ */
+void AzureIoTEmulator_Init( AzureIoTEmulator_t * pxEmulator,
+                            const AzureIoTEmulatorOptions_t * pxOptions );
+
+/**
+ * @brief Open a new session and point a transport interface at it.
+ *
+ * @param[in] pxEmulator The #AzureIoTEmulator_t * serving the session.
+ * @param[out] pxNetworkContext The session to initialize.
+ * @param[out] pxTransport The transport interface to hand to a middleware client.
+ */
+void AzureIoTEmulator_SessionInit( AzureIoTEmulator_t * pxEmulator,
+                                   NetworkContext_t * pxNetworkContext,
+                                   AzureIoTTransportInterface_t * pxTransport );
+
+/**
+ * @brief Deliver a cloud to device message to the session.
+ *
+ * @param[in] pxNetworkContext The session to deliver to.
+ * @param[in] pucPayload The message payload.
+ * @param[in] ulPayloadLength Length of \p pucPayload.
+ * @return 0 if the message was queued, -1 if the client is not subscribed or the session is full.
+ */
+int32_t AzureIoTEmulator_SendCloudMessage( NetworkContext_t * pxNetworkContext,
+                                           const uint8_t * pucPayload,
+                                           uint32_t ulPayloadLength );
+
+/**
+ * @brief Invoke a command on the session.
+ *
+ * @param[in] pxNetworkContext The session to deliver to.
+ * @param[in] pcCommandName The command name, optionally prefixed by "<component>*".
+ * @param[in] pucPayload The command payload.
+ * @param[in] ulPayloadLength Length of \p pucPayload.
+ * @return 0 if the command was queued, -1 if the client is not subscribed or the session is full.
+ */
+int32_t AzureIoTEmulator_InvokeCommand( NetworkContext_t * pxNetworkContext,
+                                        const char * pcCommandName,
+                                        const uint8_t * pucPayload,
+                                        uint32_t ulPayloadLength );
+
+/**
+ * @brief Deliver a writable property update to the session.
+ *
+ * @param[in] pxNetworkContext The session to deliver to.
+ * @param[in] pucPayload The desired properties patch.
+ * @param[in] ulPayloadLength Length of \p pucPayload.
+ * @return 0 if the update was queued, -1 if the client is not subscribed or the session is full.
+ */
+int32_t AzureIoTEmulator_UpdateDesiredProperties( NetworkContext_t * pxNetworkContext,
+                                                  const uint8_t * pucPayload,
+                                                  uint32_t ulPayloadLength );
+
+/**
+ * @brief Transport send, see #AzureIoTTransportSend_t.
+ */
+int32_t AzureIoTEmulator_Send( NetworkContext_t * pxNetworkContext,
+                               const void * pvBuffer,
+                               size_t xBytesToSend );
+
+/**
+ * @brief Transport receive, see #AzureIoTTransportRecv_t.
+ */
+int32_t AzureIoTEmulator_Recv( NetworkContext_t * pxNetworkContext,
+                               void * pvBuffer,
+                               size_t xBytesToRecv );
+
+#endif /* AZURE_IOT_EMULATOR_H */
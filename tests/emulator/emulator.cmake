@@ -0,0 +1,51 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT License.
+
+# FreeRTOS kernel on the Linux POSIX port and the in-process IoT Hub / DPS
+# emulator, for hosts that drive the middleware without a network.
+# Include before adding the middleware source directory, so that it builds
+# against the same kernel headers.
+
+if("${FREERTOS_DIRECTORY}" STREQUAL "")
+  message(FATAL_ERROR "The emulator needs a FreeRTOS directory.")
+endif()
+
+include_directories(${FREERTOS_DIRECTORY}/FreeRTOS/Source/include)
+include_directories(${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/ThirdParty/GCC/Posix)
+
+# Create FreeRTOS Lib
+add_library(freertos
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/event_groups.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/list.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/queue.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/tasks.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/timers.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/MemMang/heap_3.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/ThirdParty/GCC/Posix/utils/wait_for_event.c
+  ${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/ThirdParty/GCC/Posix/port.c
+)
+
+target_include_directories(freertos
+  PUBLIC
+    ${FREERTOS_DIRECTORY}/FreeRTOS/Source/include
+    ${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/ThirdParty/GCC/Posix
+    ${FREERTOS_DIRECTORY}/FreeRTOS/Source/portable/ThirdParty/GCC/Posix/utils
+)
+
+# Create emulator Lib
+add_library(azure_iot_emulator
+  ${CMAKE_CURRENT_LIST_DIR}/azure_iot_emulator.c
+  ${CMAKE_CURRENT_LIST_DIR}/azure_iot_emulator_hooks.c
+)
+
+target_include_directories(azure_iot_emulator
+  PUBLIC
+    ${CMAKE_CURRENT_LIST_DIR}
+)
+
+target_link_libraries(azure_iot_emulator
+  PUBLIC
+    freertos
+    pthread
+    az::iot_middleware::freertos
+)
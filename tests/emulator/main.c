@@ -0,0 +1,369 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+/*
+ * IoT Hub throughput harness.
+ *
+ * Drives one AzureIoTHubClient_t against the in-process emulator through
+ * every IoT Hub message flow and reports operations per second and round
+ * trip latency percentiles for each.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+
+/* Azure IoT library includes */
+#include "azure_iot.h"
+#include "azure_iot_hub_client.h"
+
+/* Emulator includes */
+#include "azure_iot_emulator.h"
+/*-----------------------------------------------------------*/
+
+#define hubthroughputSTACK_SIZE             ( 16 * 1024 )
+#define hubthroughputPRIORITY               ( tskIDLE_PRIORITY + 1 )
+#define hubthroughputBUFFER_SIZE            ( 5 * 1024 )
+#define hubthroughputPAYLOAD_MAX            ( 2 * 1024 )
+#define hubthroughputTIMEOUT_MS             ( 1000U )
+#define hubthroughputPROCESS_LOOPS_MAX      ( 1000U )
+#define hubthroughputHOSTNAME               "emulator.azure-devices.net"
+#define hubthroughputDEVICE_ID              "emulator-device"
+#define hubthroughputCOMMAND_NAME           "reboot"
+#define hubthroughputREPORTED_PROPERTIES    "{\"targetTemperature\":{\"ac\":200,\"av\":1,\"value\":22.5}}"
+#define hubthroughputDESIRED_PROPERTIES     "{\"targetTemperature\":22.5}"
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Starts one operation, which completes when the completion counter moves.
+ */
+typedef int32_t ( * HubThroughputStart_t )( void );
+/*-----------------------------------------------------------*/
+
+static AzureIoTEmulator_t xEmulator;
+static NetworkContext_t xNetworkContext;
+static AzureIoTTransportInterface_t xTransport;
+static AzureIoTHubClient_t xAzureIoTHubClient;
+static uint8_t ucSharedBuffer[ hubthroughputBUFFER_SIZE ];
+azureiothubASSERT_BUFFER_SIZE( sizeof( ucSharedBuffer ) );
+static uint8_t ucPayload[ hubthroughputPAYLOAD_MAX ];
+
+static uint32_t ulIterations = 1000;
+static uint32_t ulPayloadLength = 64;
+static uint32_t ulVerbose = 0;
+static uint32_t * pulLatencies;
+static uint32_t ulFailures;
+
+static volatile uint32_t ulTelemetryAcks;
+static volatile uint32_t ulCloudMessages;
+static volatile uint32_t ulPropertyMessages;
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * pcFormat,
+                     ... )
+{
+    va_list arg;
+
+    if( ulVerbose )
+    {
+        va_start( arg, pcFormat );
+        vprintf( pcFormat, arg );
+        va_end( arg );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t ulGetUnixTime( void )
+{
+    return ( uint64_t ) time( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetMicroseconds( void )
+{
+    struct timespec xNow;
+
+    clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( ( uint64_t ) xNow.tv_sec * 1000000U ) + ( ( uint64_t ) xNow.tv_nsec / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+static void prvTelemetryPubackCallback( uint16_t usPacketID )
+{
+    ( void ) usPacketID;
+    ulTelemetryAcks++;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleCloudMessage( AzureIoTHubClientCloudToDeviceMessageRequest_t * pxMessage,
+                                   void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+    ulCloudMessages++;
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleCommand( AzureIoTHubClientCommandRequest_t * pxMessage,
+                              void * pvContext )
+{
+    static const uint8_t ucResponse[] = "{}";
+
+    /* The emulator counts the response as the completion. */
+    if( AzureIoTHubClient_SendCommandResponse( ( AzureIoTHubClient_t * ) pvContext, pxMessage, 200,
+                                               ucResponse, sizeof( ucResponse ) - 1 ) != eAzureIoTSuccess )
+    {
+        ulFailures++;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandlePropertiesMessage( AzureIoTHubClientPropertiesResponse_t * pxMessage,
+                                        void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+    ulPropertyMessages++;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvSendTelemetry( void )
+{
+    return ( AzureIoTHubClient_SendTelemetry( &xAzureIoTHubClient, ucPayload, ulPayloadLength,
+                                              NULL, eAzureIoTHubMessageQoS1, NULL ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvSendCloudMessage( void )
+{
+    return AzureIoTEmulator_SendCloudMessage( &xNetworkContext, ucPayload, ulPayloadLength );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvInvokeCommand( void )
+{
+    return AzureIoTEmulator_InvokeCommand( &xNetworkContext, hubthroughputCOMMAND_NAME,
+                                           ( const uint8_t * ) "{}", 2 );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvRequestProperties( void )
+{
+    return ( AzureIoTHubClient_RequestPropertiesAsync( &xAzureIoTHubClient ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvReportProperties( void )
+{
+    return ( AzureIoTHubClient_SendPropertiesReported( &xAzureIoTHubClient,
+                                                       ( const uint8_t * ) hubthroughputREPORTED_PROPERTIES,
+                                                       sizeof( hubthroughputREPORTED_PROPERTIES ) - 1,
+                                                       NULL ) == eAzureIoTSuccess ) ? 0 : -1;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvUpdateDesiredProperties( void )
+{
+    return AzureIoTEmulator_UpdateDesiredProperties( &xNetworkContext,
+                                                     ( const uint8_t * ) hubthroughputDESIRED_PROPERTIES,
+                                                     sizeof( hubthroughputDESIRED_PROPERTIES ) - 1 );
+}
+/*-----------------------------------------------------------*/
+
+static int prvCompareLatency( const void * pvA,
+                              const void * pvB )
+{
+    uint32_t ulA = *( const uint32_t * ) pvA;
+    uint32_t ulB = *( const uint32_t * ) pvB;
+
+    return ( ulA > ulB ) - ( ulA < ulB );
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Nearest-rank percentile of the sorted latencies, in microseconds.
+ **/
+static uint32_t prvPercentile( const uint32_t * pulSorted,
+                               uint32_t ulCount,
+                               uint32_t ulPercent )
+{
+    uint32_t ulRank = ( ( ulCount * ulPercent ) + 99 ) / 100;
+
+    return pulSorted[ ( ulRank == 0 ) ? 0 : ( ulRank - 1 ) ];
+}
+/*-----------------------------------------------------------*/
+
+/**
+ * Run one message flow ulIterations times, each to completion, and report it.
+ **/
+static void prvMeasure( const char * pcName,
+                        HubThroughputStart_t xStart,
+                        volatile uint32_t * pulCompletions )
+{
+    uint32_t ulIndex;
+    uint32_t ulLoops;
+    uint32_t ulCompleted = 0;
+    uint32_t ulBefore;
+    uint64_t ullStart;
+    uint64_t ullTotal = 0;
+
+    for( ulIndex = 0; ulIndex < ulIterations; ulIndex++ )
+    {
+        ulBefore = *pulCompletions;
+        ullStart = prvGetMicroseconds();
+
+        if( xStart() != 0 )
+        {
+            ulFailures++;
+            continue;
+        }
+
+        /* A zero timeout runs a single receive iteration. */
+        for( ulLoops = 0; ( *pulCompletions == ulBefore ) && ( ulLoops < hubthroughputPROCESS_LOOPS_MAX ); ulLoops++ )
+        {
+            if( AzureIoTHubClient_ProcessLoop( &xAzureIoTHubClient, 0 ) != eAzureIoTSuccess )
+            {
+                break;
+            }
+        }
+
+        if( *pulCompletions == ulBefore )
+        {
+            ulFailures++;
+            continue;
+        }
+
+        pulLatencies[ ulCompleted ] = ( uint32_t ) ( prvGetMicroseconds() - ullStart );
+        ullTotal += pulLatencies[ ulCompleted ];
+        ulCompleted++;
+    }
+
+    printf( "%s_completed: %u\r\n", pcName, ( unsigned ) ulCompleted );
+
+    if( ulCompleted > 0 )
+    {
+        qsort( pulLatencies, ulCompleted, sizeof( uint32_t ), prvCompareLatency );
+
+        printf( "%s_per_second: %.1f\r\n", pcName,
+                ( ullTotal > 0 ) ? ( ( double ) ulCompleted * 1000000.0 / ( double ) ullTotal ) : 0.0 );
+        printf( "%s_latency_us_p50: %u\r\n", pcName, ( unsigned ) prvPercentile( pulLatencies, ulCompleted, 50 ) );
+        printf( "%s_latency_us_p99: %u\r\n", pcName, ( unsigned ) prvPercentile( pulLatencies, ulCompleted, 99 ) );
+        printf( "%s_latency_us_max: %u\r\n", pcName, ( unsigned ) pulLatencies[ ulCompleted - 1 ] );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvHubThroughputTask( void * pvParameters )
+{
+    AzureIoTHubClientOptions_t xHubOptions = { 0 };
+    bool xSessionPresent;
+
+    ( void ) pvParameters;
+
+    pulLatencies = ( uint32_t * ) pvPortMalloc( sizeof( uint32_t ) * ulIterations );
+    configASSERT( pulLatencies != NULL );
+    memset( ucPayload, 'x', sizeof( ucPayload ) );
+
+    configASSERT( AzureIoT_Init() == eAzureIoTSuccess );
+    AzureIoTEmulator_Init( &xEmulator, NULL );
+    AzureIoTEmulator_SessionInit( &xEmulator, &xNetworkContext, &xTransport );
+
+    configASSERT( AzureIoTHubClient_OptionsInit( &xHubOptions ) == eAzureIoTSuccess );
+    xHubOptions.xTelemetryCallback = prvTelemetryPubackCallback;
+
+    configASSERT( AzureIoTHubClient_Init( &xAzureIoTHubClient,
+                                          ( const uint8_t * ) hubthroughputHOSTNAME, sizeof( hubthroughputHOSTNAME ) - 1,
+                                          ( const uint8_t * ) hubthroughputDEVICE_ID, sizeof( hubthroughputDEVICE_ID ) - 1,
+                                          &xHubOptions, ucSharedBuffer, sizeof( ucSharedBuffer ),
+                                          ulGetUnixTime, &xTransport ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_Connect( &xAzureIoTHubClient, false, &xSessionPresent,
+                                             hubthroughputTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeCloudToDeviceMessage( &xAzureIoTHubClient, prvHandleCloudMessage,
+                                                                   &xAzureIoTHubClient,
+                                                                   hubthroughputTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeCommand( &xAzureIoTHubClient, prvHandleCommand,
+                                                      &xAzureIoTHubClient,
+                                                      hubthroughputTIMEOUT_MS ) == eAzureIoTSuccess );
+    configASSERT( AzureIoTHubClient_SubscribeProperties( &xAzureIoTHubClient, prvHandlePropertiesMessage,
+                                                         &xAzureIoTHubClient,
+                                                         hubthroughputTIMEOUT_MS ) == eAzureIoTSuccess );
+
+    printf( "iterations: %u\r\n", ( unsigned ) ulIterations );
+    printf( "payload_bytes: %u\r\n", ( unsigned ) ulPayloadLength );
+
+    prvMeasure( "telemetry", prvSendTelemetry, &ulTelemetryAcks );
+    prvMeasure( "cloud_message", prvSendCloudMessage, &ulCloudMessages );
+    prvMeasure( "command", prvInvokeCommand, &xEmulator.ulCommandResponses );
+    prvMeasure( "properties_request", prvRequestProperties, &ulPropertyMessages );
+    prvMeasure( "properties_reported", prvReportProperties, &ulPropertyMessages );
+    prvMeasure( "properties_writable", prvUpdateDesiredProperties, &ulPropertyMessages );
+
+    AzureIoTHubClient_Disconnect( &xAzureIoTHubClient );
+    AzureIoTHubClient_Deinit( &xAzureIoTHubClient );
+
+    printf( "failures: %u\r\n", ( unsigned ) ulFailures );
+    printf( "protocol_errors: %u\r\n", ( unsigned ) xEmulator.ulProtocolErrors );
+    fflush( stdout );
+
+    exit( ( ( ulFailures == 0 ) && ( xEmulator.ulProtocolErrors == 0 ) ) ? 0 : 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void prvUsage( const char * pcName )
+{
+    printf( "Usage: %s [-n iterations] [-s payload bytes] [-v]\r\n", pcName );
+}
+/*-----------------------------------------------------------*/
+
+int main( int argc,
+          char ** argv )
+{
+    int lOption;
+
+    while( ( lOption = getopt( argc, argv, "n:s:vh" ) ) != -1 )
+    {
+        switch( lOption )
+        {
+            case 'n':
+                ulIterations = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 's':
+                ulPayloadLength = ( uint32_t ) strtoul( optarg, NULL, 10 );
+                break;
+
+            case 'v':
+                ulVerbose = 1;
+                break;
+
+            default:
+                prvUsage( argv[ 0 ] );
+                return 1;
+        }
+    }
+
+    if( ( ulIterations == 0 ) || ( ulPayloadLength > hubthroughputPAYLOAD_MAX ) )
+    {
+        prvUsage( argv[ 0 ] );
+        return 1;
+    }
+
+    xTaskCreate( prvHubThroughputTask, "HubThroughput", hubthroughputSTACK_SIZE,
+                 NULL, hubthroughputPRIORITY, NULL );
+
+    /* Start the RTOS scheduler. */
+    vTaskStartScheduler();
+
+    for( ; ; )
+    {
+    }
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,332 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <cmocka.h>
+
+#include "azure_iot_cbor_writer.h"
+/*-----------------------------------------------------------*/
+
+static uint8_t ucProperty[] = "property";
+static uint8_t ucValue[] = "value";
+
+/*
+ * { "property": 42 }
+ */
+static const uint8_t ucTestCBORInt32[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0x18, 0x2A, 0xFF
+};
+
+/*
+ * { "property": -500 }
+ */
+static const uint8_t ucTestCBORNegativeInt32[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0x39, 0x01, 0xF3, 0xFF
+};
+
+/*
+ * { "property": 1.5 } (single precision)
+ */
+static const uint8_t ucTestCBORFloat[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0xFA, 0x3F, 0xC0, 0x00, 0x00, 0xFF
+};
+
+/*
+ * { "property": 1.1 } (double precision)
+ */
+static const uint8_t ucTestCBORDouble[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A, 0xFF
+};
+
+/*
+ * { "property": true }
+ */
+static const uint8_t ucTestCBORBool[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0xF5, 0xFF
+};
+
+/*
+ * { "property": "value" }
+ */
+static const uint8_t ucTestCBORString[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0x65, 'v', 'a', 'l', 'u', 'e', 0xFF
+};
+
+/*
+ * { "property": [ null, false, 0, -1, h'0102' ] }
+ */
+static const uint8_t ucTestCBORArray[] =
+{
+    0xBF, 0x68, 'p', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0x9F, 0xF6, 0xF4, 0x00, 0x20, 0x42, 0x01, 0x02, 0xFF, 0xFF
+};
+
+static uint8_t ucCBORWriterBuffer[ 128 ];
+
+void prvInitCBORWriter( AzureIoTCBORWriter_t * pxWriter );
+uint32_t ulGetAllTests();
+
+void prvInitCBORWriter( AzureIoTCBORWriter_t * pxWriter )
+{
+    memset( ucCBORWriterBuffer, 0, sizeof( ucCBORWriterBuffer ) );
+    assert_int_equal( AzureIoTCBORWriter_Init( pxWriter, ucCBORWriterBuffer, sizeof( ucCBORWriterBuffer ) ), eAzureIoTSuccess );
+}
+
+static void testAzureIoTCBORWriter_Init_Failure( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+    uint8_t ucBuffer[ 32 ];
+
+    /* Fail init if CBOR writer is NULL */
+    assert_int_equal( AzureIoTCBORWriter_Init( NULL,
+                                               ucBuffer,
+                                               sizeof( ucBuffer ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail init if buffer is NULL */
+    assert_int_equal( AzureIoTCBORWriter_Init( &xWriter,
+                                               NULL,
+                                               sizeof( ucBuffer ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail init if buffer length is 0 */
+    assert_int_equal( AzureIoTCBORWriter_Init( &xWriter,
+                                               ucBuffer,
+                                               0 ), eAzureIoTErrorInvalidArgument );
+}
+
+static void testAzureIoTCBORWriter_AppendProperty_Failure( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithInt32Value( NULL, ucProperty, sizeof( ucProperty ) - 1, 42 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithInt32Value( &xWriter, NULL, sizeof( ucProperty ) - 1, 42 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithDoubleValue( &xWriter, ucProperty, 0, 1.5 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithBoolValue( NULL, ucProperty, sizeof( ucProperty ) - 1, true ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithStringValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, NULL, 5 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyName( &xWriter, NULL, 5 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendString( &xWriter, ucValue, 0 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendBytes( &xWriter, NULL, 2 ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendBool( NULL, true ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendInt32( NULL, 1 ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendDouble( NULL, 1.0 ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendNull( NULL ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( NULL ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( NULL ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginArray( NULL ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndArray( NULL ), eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( NULL ), -1 );
+
+    /* Nothing was written by the failed calls */
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), 0 );
+}
+
+static void testAzureIoTCBORWriter_AppendPropertyWithInt32_Success( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithInt32Value( &xWriter, ucProperty, sizeof( ucProperty ) - 1, 42 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORInt32 ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORInt32, sizeof( ucTestCBORInt32 ) );
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithInt32Value( &xWriter, ucProperty, sizeof( ucProperty ) - 1, -500 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORNegativeInt32 ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORNegativeInt32, sizeof( ucTestCBORNegativeInt32 ) );
+}
+
+static void testAzureIoTCBORWriter_AppendPropertyWithDouble_Success( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithDoubleValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, 1.5 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORFloat ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORFloat, sizeof( ucTestCBORFloat ) );
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithDoubleValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, 1.1 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORDouble ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORDouble, sizeof( ucTestCBORDouble ) );
+}
+
+static void testAzureIoTCBORWriter_AppendPropertyWithBool_Success( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithBoolValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, true ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORBool ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORBool, sizeof( ucTestCBORBool ) );
+}
+
+static void testAzureIoTCBORWriter_AppendPropertyWithString_Success( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithStringValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1,
+                                                                        ucValue, sizeof( ucValue ) - 1 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORString ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORString, sizeof( ucTestCBORString ) );
+}
+
+static void testAzureIoTCBORWriter_AppendArray_Success( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+    uint8_t ucBytes[] = { 0x01, 0x02 };
+
+    prvInitCBORWriter( &xWriter );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyName( &xWriter, ucProperty, sizeof( ucProperty ) - 1 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendNull( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendBool( &xWriter, false ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendInt32( &xWriter, 0 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendInt32( &xWriter, -1 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendBytes( &xWriter, ucBytes, sizeof( ucBytes ) ), eAzureIoTSuccess );
+
+    /* Mismatched end */
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTErrorJSONInvalidState );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendEndArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucTestCBORArray ) );
+    assert_memory_equal( ucCBORWriterBuffer, ucTestCBORArray, sizeof( ucTestCBORArray ) );
+
+    /* Nothing left open */
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTErrorJSONInvalidState );
+}
+
+static void testAzureIoTCBORWriter_Nesting_Failure( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+    uint32_t ulIndex;
+
+    prvInitCBORWriter( &xWriter );
+
+    for( ulIndex = 0; ulIndex < azureiotcborwriterMAX_DEPTH; ulIndex++ )
+    {
+        assert_int_equal( AzureIoTCBORWriter_AppendBeginArray( &xWriter ), eAzureIoTSuccess );
+    }
+
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginArray( &xWriter ), eAzureIoTErrorJSONNestingOverflow );
+}
+
+static void testAzureIoTCBORWriter_InvalidWrite_Failure( void ** ppvState )
+{
+    AzureIoTCBORWriter_t xWriter;
+    uint8_t ucBuffer[ 11 ];
+
+    assert_int_equal( AzureIoTCBORWriter_Init( &xWriter, ucBuffer, sizeof( ucBuffer ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+
+    /* Fail property value api's (not enough space in buffer) and do not leave partial items behind */
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithInt32Value( &xWriter, ucProperty, sizeof( ucProperty ) - 1, 1000 ),
+                      eAzureIoTErrorOutOfMemory );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithDoubleValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, 1.5 ),
+                      eAzureIoTErrorOutOfMemory );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithStringValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1,
+                                                                        ucValue, sizeof( ucValue ) - 1 ),
+                      eAzureIoTErrorOutOfMemory );
+    assert_int_equal( AzureIoTCBORWriter_AppendPropertyWithBoolValue( &xWriter, ucProperty, sizeof( ucProperty ) - 1, true ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_GetBytesUsed( &xWriter ), sizeof( ucBuffer ) );
+
+    assert_int_equal( AzureIoTCBORWriter_AppendNull( &xWriter ), eAzureIoTErrorOutOfMemory );
+    assert_int_equal( AzureIoTCBORWriter_AppendEndObject( &xWriter ), eAzureIoTErrorOutOfMemory );
+}
+
+static void testAzureIoTCBORWriter_SetMessageProperties_Success( void ** ppvState )
+{
+    AzureIoTMessageProperties_t xProperties;
+    uint8_t ucPropertiesBuffer[ 64 ];
+    const uint8_t * pucValue;
+    uint32_t ulValueLength;
+
+    assert_int_equal( AzureIoTCBORWriter_SetMessageProperties( NULL, NULL, 0 ), eAzureIoTErrorInvalidArgument );
+
+    assert_int_equal( AzureIoTMessage_PropertiesInit( &xProperties, ucPropertiesBuffer, 0, sizeof( ucPropertiesBuffer ) ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTCBORWriter_SetMessageProperties( &xProperties, ( const uint8_t * ) "utf-8", 5 ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTMessage_PropertiesFind( &xProperties,
+                                                      ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_TYPE,
+                                                      sizeof( azureiotmessagePROPERTY_CONTENT_TYPE ) - 1,
+                                                      &pucValue, &ulValueLength ), eAzureIoTSuccess );
+    assert_int_equal( ulValueLength, strlen( "application%2Fcbor" ) );
+    assert_memory_equal( pucValue, "application%2Fcbor", ulValueLength );
+
+    assert_int_equal( AzureIoTMessage_PropertiesFind( &xProperties,
+                                                      ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_ENCODING,
+                                                      sizeof( azureiotmessagePROPERTY_CONTENT_ENCODING ) - 1,
+                                                      &pucValue, &ulValueLength ), eAzureIoTSuccess );
+    assert_int_equal( ulValueLength, 5 );
+    assert_memory_equal( pucValue, "utf-8", ulValueLength );
+}
+
+uint32_t ulGetAllTests()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test( testAzureIoTCBORWriter_Init_Failure ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendProperty_Failure ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendPropertyWithInt32_Success ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendPropertyWithDouble_Success ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendPropertyWithBool_Success ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendPropertyWithString_Success ),
+        cmocka_unit_test( testAzureIoTCBORWriter_AppendArray_Success ),
+        cmocka_unit_test( testAzureIoTCBORWriter_Nesting_Failure ),
+        cmocka_unit_test( testAzureIoTCBORWriter_InvalidWrite_Failure ),
+        cmocka_unit_test( testAzureIoTCBORWriter_SetMessageProperties_Success )
+    };
+
+    return ( uint32_t ) cmocka_run_group_tests_name( "azure_iot_cbor_writer_ut", tests, NULL, NULL );
+}
@@ -12,6 +12,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 
 #include <cmocka.h>
@@ -27,6 +28,9 @@ uint16_t usTestPacketId = 1;
 const uint8_t * pucPublishPayload = NULL;
 uint16_t usSentQOS = 0xFF;
 uint32_t ulDelayReceivePacket = 0;
+uint8_t ucStreamedPayload[ 256 ];
+uint32_t ulStreamedPayloadLength = 0;
+uint32_t ulStreamedPayloadAnnounced = 0;
 /*-----------------------------------------------------------*/
 
 AzureIoTMQTTResult_t AzureIoTMQTT_Init( AzureIoTMQTTHandle_t xContext,
@@ -107,6 +111,34 @@ AzureIoTMQTTResult_t AzureIoTMQTT_Publish( AzureIoTMQTTHandle_t xContext,
 }
 /*-----------------------------------------------------------*/
 
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamBegin( AzureIoTMQTTHandle_t xContext,
+                                                      const AzureIoTMQTTPublishInfo_t * pxPublishInfo,
+                                                      uint16_t usPacketId )
+{
+    ( void ) xContext;
+    ( void ) usPacketId;
+
+    ulStreamedPayloadLength = 0;
+    ulStreamedPayloadAnnounced = ( uint32_t ) pxPublishInfo->xPayloadLength;
+
+    return ( AzureIoTMQTTResult_t ) mock();
+}
+/*-----------------------------------------------------------*/
+
+AzureIoTMQTTResult_t AzureIoTMQTT_PublishStreamSend( AzureIoTMQTTHandle_t xContext,
+                                                     const uint8_t * pucData,
+                                                     size_t xDataLength )
+{
+    ( void ) xContext;
+
+    assert_true( ulStreamedPayloadLength + xDataLength <= sizeof( ucStreamedPayload ) );
+    memcpy( ucStreamedPayload + ulStreamedPayloadLength, pucData, xDataLength );
+    ulStreamedPayloadLength += ( uint32_t ) xDataLength;
+
+    return eAzureIoTMQTTSuccess;
+}
+/*-----------------------------------------------------------*/
+
 AzureIoTMQTTResult_t AzureIoTMQTT_Unsubscribe( AzureIoTMQTTHandle_t xContext,
                                                const AzureIoTMQTTSubscribeInfo_t * pxSubscriptionList,
                                                size_t xSubscriptionCount,
@@ -0,0 +1,212 @@
+/* Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT License. */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <cmocka.h>
+
+#include "azure_iot_compression.h"
+/*-----------------------------------------------------------*/
+
+#define testWINDOW_BUFFER_LENGTH    ( 1024 )
+
+static const uint8_t ucTestRepetitivePayload[] =
+    "{\"temperature\":21.5,\"humidity\":40}{\"temperature\":21.5,\"humidity\":41}"
+    "{\"temperature\":21.5,\"humidity\":42}{\"temperature\":21.5,\"humidity\":43}";
+
+/* "aaaa" as a literal followed by a back-reference of distance one and length three. */
+static const uint8_t ucTestOverlappingStream[] = { 0x01, 'a', 0x00, 0x00 };
+
+static uint8_t ucWindowBuffer[ testWINDOW_BUFFER_LENGTH + sizeof( uint32_t ) ];
+static uint8_t ucCompressed[ azureiotcompressionMAX_ENCODED_SIZE( sizeof( ucTestRepetitivePayload ) ) ];
+static uint8_t ucDecompressed[ sizeof( ucTestRepetitivePayload ) ];
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_Compress_InvalidArgFailure( void ** ppvState )
+{
+    uint32_t ulLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Compress( NULL, 1,
+                                                    ucCompressed, sizeof( ucCompressed ), &ulLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    NULL, sizeof( ucCompressed ), &ulLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    ucCompressed, sizeof( ucCompressed ), NULL,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    ucCompressed, sizeof( ucCompressed ), &ulLength,
+                                                    NULL, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    ucCompressed, sizeof( ucCompressed ), &ulLength,
+                                                    ucWindowBuffer, azureiotcompressionWINDOW_BUFFER_MIN - 1 ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_Decompress_InvalidArgFailure( void ** ppvState )
+{
+    uint32_t ulLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Decompress( NULL, 1,
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Decompress( ucTestOverlappingStream, sizeof( ucTestOverlappingStream ),
+                                                      NULL, sizeof( ucDecompressed ), &ulLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTCompression_Decompress( ucTestOverlappingStream, sizeof( ucTestOverlappingStream ),
+                                                      ucDecompressed, sizeof( ucDecompressed ), NULL ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_RoundTrip_Success( void ** ppvState )
+{
+    uint32_t ulCompressedLength;
+    uint32_t ulDecompressedLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    ucCompressed, sizeof( ucCompressed ), &ulCompressedLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTSuccess );
+    assert_true( ulCompressedLength < sizeof( ucTestRepetitivePayload ) );
+
+    assert_int_equal( AzureIoTCompression_Decompress( ucCompressed, ulCompressedLength,
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulDecompressedLength ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulDecompressedLength, sizeof( ucTestRepetitivePayload ) );
+    assert_memory_equal( ucDecompressed, ucTestRepetitivePayload, ulDecompressedLength );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_RoundTripUnalignedWindow_Success( void ** ppvState )
+{
+    uint32_t ulCompressedLength;
+    uint32_t ulDecompressedLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Compress( ucTestRepetitivePayload, sizeof( ucTestRepetitivePayload ),
+                                                    ucCompressed, sizeof( ucCompressed ), &ulCompressedLength,
+                                                    ucWindowBuffer + 1, azureiotcompressionWINDOW_BUFFER_MIN ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTCompression_Decompress( ucCompressed, ulCompressedLength,
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulDecompressedLength ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulDecompressedLength, sizeof( ucTestRepetitivePayload ) );
+    assert_memory_equal( ucDecompressed, ucTestRepetitivePayload, ulDecompressedLength );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_CompressEmpty_Success( void ** ppvState )
+{
+    uint32_t ulCompressedLength = 1;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Compress( NULL, 0,
+                                                    ucCompressed, sizeof( ucCompressed ), &ulCompressedLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulCompressedLength, 0 );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_CompressOutOfSpace_Failure( void ** ppvState )
+{
+    uint8_t ucIncompressible[ 64 ];
+    uint32_t ulCompressedLength;
+    uint32_t ulIndex;
+
+    ( void ) ppvState;
+
+    for( ulIndex = 0; ulIndex < sizeof( ucIncompressible ); ulIndex++ )
+    {
+        ucIncompressible[ ulIndex ] = ( uint8_t ) ( ulIndex * 7 );
+    }
+
+    assert_int_equal( AzureIoTCompression_Compress( ucIncompressible, sizeof( ucIncompressible ),
+                                                    ucCompressed, sizeof( ucIncompressible ), &ulCompressedLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTErrorOutOfMemory );
+
+    assert_int_equal( AzureIoTCompression_Compress( ucIncompressible, sizeof( ucIncompressible ),
+                                                    ucCompressed, azureiotcompressionMAX_ENCODED_SIZE( sizeof( ucIncompressible ) ),
+                                                    &ulCompressedLength,
+                                                    ucWindowBuffer, testWINDOW_BUFFER_LENGTH ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulCompressedLength, azureiotcompressionMAX_ENCODED_SIZE( sizeof( ucIncompressible ) ) );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_DecompressOverlapping_Success( void ** ppvState )
+{
+    uint32_t ulDecompressedLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Decompress( ucTestOverlappingStream, sizeof( ucTestOverlappingStream ),
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulDecompressedLength ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulDecompressedLength, 4 );
+    assert_memory_equal( ucDecompressed, "aaaa", ulDecompressedLength );
+
+    assert_int_equal( AzureIoTCompression_Decompress( ucTestOverlappingStream, sizeof( ucTestOverlappingStream ),
+                                                      ucDecompressed, 3, &ulDecompressedLength ),
+                      eAzureIoTErrorOutOfMemory );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTCompression_DecompressMalformed_Failure( void ** ppvState )
+{
+    /* Back-reference before any output was produced. */
+    const uint8_t ucBadDistance[] = { 0x00, 0x00, 0x00 };
+    /* Back-reference missing its second byte. */
+    const uint8_t ucTruncated[] = { 0x01, 'a', 0x00 };
+    uint32_t ulDecompressedLength;
+
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTCompression_Decompress( ucBadDistance, sizeof( ucBadDistance ),
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulDecompressedLength ),
+                      eAzureIoTErrorInvalidResponse );
+    assert_int_equal( AzureIoTCompression_Decompress( ucTruncated, sizeof( ucTruncated ),
+                                                      ucDecompressed, sizeof( ucDecompressed ), &ulDecompressedLength ),
+                      eAzureIoTErrorInvalidResponse );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulGetAllTests()
+{
+    const struct CMUnitTest tests[] =
+    {
+        cmocka_unit_test( testAzureIoTCompression_Compress_InvalidArgFailure ),
+        cmocka_unit_test( testAzureIoTCompression_Decompress_InvalidArgFailure ),
+        cmocka_unit_test( testAzureIoTCompression_RoundTrip_Success ),
+        cmocka_unit_test( testAzureIoTCompression_RoundTripUnalignedWindow_Success ),
+        cmocka_unit_test( testAzureIoTCompression_CompressEmpty_Success ),
+        cmocka_unit_test( testAzureIoTCompression_CompressOutOfSpace_Failure ),
+        cmocka_unit_test( testAzureIoTCompression_DecompressOverlapping_Success ),
+        cmocka_unit_test( testAzureIoTCompression_DecompressMalformed_Failure )
+    };
+
+    return ( uint32_t ) cmocka_run_group_tests_name( "azure_iot_compression_ut", tests, NULL, NULL );
+}
@@ -93,6 +93,59 @@ static const uint8_t ucTestJSONGetPayload[] =
 static const uint8_t ucTestJSONWriteableUpdate[] =
     "{\"targetTemperature\":40,\"$version\":6}";
 
+/*
+ *
+ * {
+ *   "temperature": 23,
+ *   "mode": "eco"
+ * }
+ *
+ */
+static const uint8_t ucTestJSONReportedDelta[] =
+    "{\"temperature\":23,\"mode\":\"eco\"}";
+
+/*
+ *
+ * {
+ *   "mode": "boost"
+ * }
+ *
+ */
+static const uint8_t ucTestJSONReportedModeDelta[] =
+    "{\"mode\":\"boost\"}";
+
+/*
+ *
+ * {
+ *   "thermostat1": {
+ *     "__t": "c",
+ *     "targetTemperature": {
+ *       "ac": 200,
+ *       "av": 3,
+ *       "ad": "set \"40\"",
+ *       "value": 40
+ *     },
+ *     "maxTempSinceLastReboot": 38.5
+ *   },
+ *   "serialNumber": "SN-1",
+ *   "thermostat2": {
+ *     "__t": "c",
+ *     "maxTempSinceLastReboot": 30
+ *   }
+ * }
+ *
+ */
+static const uint8_t ucTestJSONBatch[] =
+    "{\"thermostat1\":{\"__t\":\"c\",\"targetTemperature\":{\"ac\":200,\"av\":3,\"ad\":\"set \\\"40\\\"\",\"value\":40}," \
+    "\"maxTempSinceLastReboot\":38.5},\"serialNumber\":\"SN-1\",\"thermostat2\":{\"__t\":\"c\",\"maxTempSinceLastReboot\":30}}";
+
+/* Data exported by cmocka port for MQTT */
+extern AzureIoTMQTTPacketInfo_t xPacketInfo;
+extern AzureIoTMQTTDeserializedInfo_t xDeserializedInfo;
+extern uint16_t usTestPacketId;
+extern const uint8_t * pucPublishPayload;
+extern uint32_t ulDelayReceivePacket;
+
 static const uint8_t ucHostname[] = "unittest.azure-devices.net";
 static const uint8_t ucDeviceId[] = "testiothub";
 
@@ -108,6 +161,7 @@ static uint8_t ucJSONWriterBuffer[ 128 ];
 
 void prvInitJSONWriter( AzureIoTJSONWriter_t * pxWriter );
 TickType_t xTaskGetTickCount( void );
+void vTaskDelay( const TickType_t xTicksToDelay );
 uint32_t ulGetAllTests();
 
 void prvInitJSONWriter( AzureIoTJSONWriter_t * pxWriter )
@@ -123,6 +177,12 @@ TickType_t xTaskGetTickCount( void )
 }
 /*-----------------------------------------------------------*/
 
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    ( void ) xTicksToDelay;
+}
+/*-----------------------------------------------------------*/
+
 static uint64_t prvGetUnixTime( void )
 {
     return 0xFFFFFFFFFFFFFFFF;
@@ -720,6 +780,373 @@ static void testAzureIoTHubClientProperties_GetNextComponentPropertyWriteableUpd
                                                                             &ulComponentNameLength ), eAzureIoTErrorEndOfProperties );
 }
 
+static void prvTestProperties( AzureIoTHubClientPropertiesResponse_t * pxMessage,
+                               void * pvContext )
+{
+    ( void ) pxMessage;
+    ( void ) pvContext;
+}
+
+static void prvSetupSubscribedIoTHubClient( AzureIoTHubClient_t * pxTestIoTHubClient )
+{
+    AzureIoTHubClientOptions_t xOptions;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    AzureIoTHubClient_OptionsInit( &xOptions );
+    assert_int_equal( AzureIoTHubClient_Init( pxTestIoTHubClient,
+                                              ucHostname,
+                                              strlen( ucHostname ),
+                                              ucDeviceId,
+                                              strlen( ucDeviceId ),
+                                              &xOptions,
+                                              ucBuffer, sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_SUBACK;
+    xDeserializedInfo.usPacketIdentifier = usTestPacketId;
+    ulDelayReceivePacket = 0;
+    assert_int_equal( AzureIoTHubClient_SubscribeProperties( pxTestIoTHubClient,
+                                                             prvTestProperties,
+                                                             NULL, ( uint32_t ) -1 ), eAzureIoTSuccess );
+}
+
+static void testAzureIoTHubClientProperties_CacheInit_Failure( void ** ppvState )
+{
+    AzureIoTHubClientPropertiesCache_t xCache;
+    AzureIoTHubClientPropertiesCacheEntry_t xEntries[ 2 ];
+
+    /* Fail cache init when cache is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( NULL,
+                                                             xEntries,
+                                                             2 ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache init when entries are NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             NULL,
+                                                             2 ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache init when entry count is zero */
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             xEntries,
+                                                             0 ), eAzureIoTErrorInvalidArgument );
+}
+
+static void testAzureIoTHubClientProperties_CacheSet_Failure( void ** ppvState )
+{
+    AzureIoTHubClientPropertiesCache_t xCache;
+    AzureIoTHubClientPropertiesCacheEntry_t xEntries[ 1 ];
+    uint8_t ucLongValue[ azureiotconfigPROPERTIES_CACHE_VALUE_MAX + 1 ];
+
+    memset( ucLongValue, '1', sizeof( ucLongValue ) );
+
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             xEntries,
+                                                             1 ), eAzureIoTSuccess );
+
+    /* Fail cache set when cache is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( NULL,
+                                                            "temperature", strlen( "temperature" ),
+                                                            "23", strlen( "23" ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache set when property name is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            NULL, strlen( "temperature" ),
+                                                            "23", strlen( "23" ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache set when value is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            NULL, strlen( "23" ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache set when value is too long */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            ucLongValue, sizeof( ucLongValue ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail cache set when all entries are used */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            "23", strlen( "23" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "mode", strlen( "mode" ),
+                                                            "\"eco\"", strlen( "\"eco\"" ) ), eAzureIoTErrorOutOfMemory );
+}
+
+static void testAzureIoTHubClientProperties_SendReportedDelta_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientPropertiesCache_t xCache;
+    AzureIoTHubClientPropertiesCacheEntry_t xEntries[ 2 ];
+
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             xEntries,
+                                                             2 ), eAzureIoTSuccess );
+
+    /* Fail send delta when client is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( NULL,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     NULL ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail send delta when cache is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     NULL,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     NULL ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail send delta when payload buffer is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     NULL, sizeof( ucJSONWriterBuffer ),
+                                                                     NULL ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail process response when response is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_CacheProcessResponse( &xCache,
+                                                                        NULL ), eAzureIoTErrorInvalidArgument );
+}
+
+static void testAzureIoTHubClientProperties_SendReportedDelta_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientPropertiesCache_t xCache;
+    AzureIoTHubClientPropertiesCacheEntry_t xEntries[ 2 ];
+    AzureIoTHubClientPropertiesResponse_t xResponse = { 0 };
+    uint32_t ulRequestId = 0;
+
+    prvSetupSubscribedIoTHubClient( &xTestIoTHubClient );
+
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             xEntries,
+                                                             2 ), eAzureIoTSuccess );
+
+    /* Updates made before sending are coalesced */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            "22", strlen( "22" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "mode", strlen( "mode" ),
+                                                            "\"eco\"", strlen( "\"eco\"" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            "23", strlen( "23" ) ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = ucTestJSONReportedDelta;
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+    assert_int_equal( ulRequestId, 1 );
+
+    /* Only one delta is in flight at a time */
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTErrorPending );
+
+    /* Responses to other requests are ignored */
+    xResponse.xMessageType = eAzureIoTHubPropertiesReportedResponseMessage;
+    xResponse.xMessageStatus = eAzureIoTStatusNoContent;
+    xResponse.ulRequestID = 3;
+    assert_int_equal( AzureIoTHubClientProperties_CacheProcessResponse( &xCache,
+                                                                        &xResponse ), eAzureIoTErrorItemNotFound );
+
+    xResponse.ulRequestID = 1;
+    assert_int_equal( AzureIoTHubClientProperties_CacheProcessResponse( &xCache,
+                                                                        &xResponse ), eAzureIoTSuccess );
+
+    /* Acknowledged values are not sent again */
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "temperature", strlen( "temperature" ),
+                                                            "23", strlen( "23" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+    assert_int_equal( ulRequestId, 0 );
+
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "mode", strlen( "mode" ),
+                                                            "\"boost\"", strlen( "\"boost\"" ) ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = ucTestJSONReportedModeDelta;
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+    assert_int_equal( ulRequestId, 3 );
+    pucPublishPayload = NULL;
+}
+
+static void testAzureIoTHubClientProperties_SendReportedDeltaRejected_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientPropertiesCache_t xCache;
+    AzureIoTHubClientPropertiesCacheEntry_t xEntries[ 2 ];
+    AzureIoTHubClientPropertiesResponse_t xResponse = { 0 };
+    uint32_t ulRequestId = 0;
+
+    prvSetupSubscribedIoTHubClient( &xTestIoTHubClient );
+
+    assert_int_equal( AzureIoTHubClientProperties_CacheInit( &xCache,
+                                                             xEntries,
+                                                             2 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_CacheSet( &xCache,
+                                                            "mode", strlen( "mode" ),
+                                                            "\"boost\"", strlen( "\"boost\"" ) ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = ucTestJSONReportedModeDelta;
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+
+    /* A rejected delta is sent again */
+    xResponse.xMessageType = eAzureIoTHubPropertiesReportedResponseMessage;
+    xResponse.xMessageStatus = eAzureIoTStatusThrottled;
+    xResponse.ulRequestID = ulRequestId;
+    assert_int_equal( AzureIoTHubClientProperties_CacheProcessResponse( &xCache,
+                                                                        &xResponse ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+
+    /* So is a delta whose response was lost */
+    assert_int_equal( AzureIoTHubClientProperties_CacheCancelInFlight( &xCache ), eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_SendReportedDelta( &xTestIoTHubClient,
+                                                                     &xCache,
+                                                                     ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                                     &ulRequestId ), eAzureIoTSuccess );
+    pucPublishPayload = NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClientProperties_Batch_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientPropertiesBatch_t xBatch;
+    AzureIoTHubClientPropertiesBatchEntry_t xEntries[ 1 ];
+    uint32_t ulPayloadLength;
+
+    /* Fail batch init when entries are NULL */
+    assert_int_equal( AzureIoTHubClientProperties_BatchInit( &xBatch,
+                                                             NULL,
+                                                             1 ), eAzureIoTErrorInvalidArgument );
+
+    assert_int_equal( AzureIoTHubClientProperties_BatchInit( &xBatch,
+                                                             xEntries,
+                                                             1 ), eAzureIoTSuccess );
+
+    /* Fail batch add when component name is NULL with a length */
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    NULL, strlen( "thermostat1" ),
+                                                                    "serialNumber", strlen( "serialNumber" ),
+                                                                    "\"SN-1\"", strlen( "\"SN-1\"" ) ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail batch add when value is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddResponseStatus( &xBatch,
+                                                                          NULL, 0,
+                                                                          "targetTemperature", strlen( "targetTemperature" ),
+                                                                          NULL, 0,
+                                                                          200, 3, NULL, 0 ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail batch add when all entries are used */
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    NULL, 0,
+                                                                    "serialNumber", strlen( "serialNumber" ),
+                                                                    "\"SN-1\"", strlen( "\"SN-1\"" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    NULL, 0,
+                                                                    "serialNumber", strlen( "serialNumber" ),
+                                                                    "\"SN-1\"", strlen( "\"SN-1\"" ) ), eAzureIoTErrorOutOfMemory );
+
+    /* Fail batch write when the buffer is one byte short, without writing */
+    memset( ucJSONWriterBuffer, 0, sizeof( ucJSONWriterBuffer ) );
+    assert_int_equal( AzureIoTHubClientProperties_BatchWrite( &xTestIoTHubClient,
+                                                              &xBatch,
+                                                              ucJSONWriterBuffer,
+                                                              AzureIoTHubClientProperties_BatchGetPayloadLengthMax( &xBatch ) - 1,
+                                                              &ulPayloadLength ), eAzureIoTErrorOutOfMemory );
+    assert_int_equal( ucJSONWriterBuffer[ 0 ], 0 );
+
+    /* Fail batch write when payload length is NULL */
+    assert_int_equal( AzureIoTHubClientProperties_BatchWrite( &xTestIoTHubClient,
+                                                              &xBatch,
+                                                              ucJSONWriterBuffer, sizeof( ucJSONWriterBuffer ),
+                                                              NULL ), eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClientProperties_Batch_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientPropertiesBatch_t xBatch;
+    AzureIoTHubClientPropertiesBatchEntry_t xEntries[ 4 ];
+    uint8_t ucPayload[ sizeof( ucTestJSONBatch ) - 1 ];
+    uint32_t ulPayloadLength = 0;
+
+    assert_int_equal( AzureIoTHubClientProperties_BatchInit( &xBatch,
+                                                             xEntries,
+                                                             4 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchGetPayloadLengthMax( &xBatch ), strlen( "{}" ) );
+
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddResponseStatus( &xBatch,
+                                                                          "thermostat1", strlen( "thermostat1" ),
+                                                                          "targetTemperature", strlen( "targetTemperature" ),
+                                                                          "40", strlen( "40" ),
+                                                                          200, 3,
+                                                                          "set \"40\"", strlen( "set \"40\"" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    NULL, 0,
+                                                                    "serialNumber", strlen( "serialNumber" ),
+                                                                    "\"SN-1\"", strlen( "\"SN-1\"" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    "thermostat2", strlen( "thermostat2" ),
+                                                                    "maxTempSinceLastReboot", strlen( "maxTempSinceLastReboot" ),
+                                                                    "30", strlen( "30" ) ), eAzureIoTSuccess );
+
+    /* Properties of a component added later are written with the component */
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    "thermostat1", strlen( "thermostat1" ),
+                                                                    "maxTempSinceLastReboot", strlen( "maxTempSinceLastReboot" ),
+                                                                    "38.5", strlen( "38.5" ) ), eAzureIoTSuccess );
+
+    /* Without whitespace in the values the bound is reached, so a buffer of that length is enough */
+    assert_int_equal( AzureIoTHubClientProperties_BatchGetPayloadLengthMax( &xBatch ), sizeof( ucPayload ) );
+    assert_int_equal( AzureIoTHubClientProperties_BatchWrite( &xTestIoTHubClient,
+                                                              &xBatch,
+                                                              ucPayload, sizeof( ucPayload ),
+                                                              &ulPayloadLength ), eAzureIoTSuccess );
+    assert_int_equal( ulPayloadLength, sizeof( ucPayload ) );
+    assert_memory_equal( ucPayload, ucTestJSONBatch, sizeof( ucPayload ) );
+
+    /* Whitespace in a value is not written, so the payload is shorter than the bound */
+    assert_int_equal( AzureIoTHubClientProperties_BatchInit( &xBatch,
+                                                             xEntries,
+                                                             4 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchAddProperty( &xBatch,
+                                                                    NULL, 0,
+                                                                    "thresholds", strlen( "thresholds" ),
+                                                                    "[ 1, 2 ]", strlen( "[ 1, 2 ]" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClientProperties_BatchWrite( &xTestIoTHubClient,
+                                                              &xBatch,
+                                                              ucPayload, sizeof( ucPayload ),
+                                                              &ulPayloadLength ), eAzureIoTSuccess );
+    assert_int_equal( ulPayloadLength, strlen( "{\"thresholds\":[1,2]}" ) );
+    assert_true( ulPayloadLength < AzureIoTHubClientProperties_BatchGetPayloadLengthMax( &xBatch ) );
+}
+/*-----------------------------------------------------------*/
+
 uint32_t ulGetAllTests()
 {
     const struct CMUnitTest tests[] =
@@ -739,6 +1166,13 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTHubClientProperties_GetNextComponentProperty_Success ),
         cmocka_unit_test( testAzureIoTHubClientProperties_GetNextComponentPropertyGetDocument_Success ),
         cmocka_unit_test( testAzureIoTHubClientProperties_GetNextComponentPropertyWriteableUpdate_Success ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_CacheInit_Failure ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_CacheSet_Failure ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_SendReportedDelta_Failure ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_SendReportedDelta_Success ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_SendReportedDeltaRejected_Success ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_Batch_Failure ),
+        cmocka_unit_test( testAzureIoTHubClientProperties_Batch_Success ),
     };
 
     return ( uint32_t ) cmocka_run_group_tests_name( "azure_iot_hub_client_properties_ut ", tests, NULL, NULL );
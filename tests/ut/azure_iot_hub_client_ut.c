@@ -26,6 +26,7 @@
 #define testPROPERTY_MESSAGE                  "{\"desired\":{\"telemetrySendFrequency\":\"5m\"},\"reported\":{\"telemetrySendFrequency\":\"5m\"}}"
 #define testPROPERTY_DESIRED_MESSAGE_TOPIC    "$iothub/twin/PATCH/properties/desired/?$version=1"
 #define testPROPERTY_DESIRED_MESSAGE          "{\"telemetrySendFrequency\":\"5m\"}"
+#define testPROPERTY_REPORTED_MESSAGE_TOPIC   "$iothub/twin/res/204/?$rid=1&$version=2"
 /*-----------------------------------------------------------*/
 
 typedef struct ReceiveTestData
@@ -45,6 +46,9 @@ extern uint16_t usTestPacketId;
 extern const uint8_t * pucPublishPayload;
 extern uint16_t usSentQOS;
 extern uint32_t ulDelayReceivePacket;
+extern uint8_t ucStreamedPayload[];
+extern uint32_t ulStreamedPayloadLength;
+extern uint32_t ulStreamedPayloadAnnounced;
 
 static const uint8_t ucHostname[] = "unittest.azure-devices.net";
 static const uint8_t ucDeviceId[] = "testiothub";
@@ -59,7 +63,14 @@ static AzureIoTTransportInterface_t xTransportInterface =
     .xSend            = ( AzureIoTTransportSend_t ) 0xA5A5A5A5,
     .xRecv            = ( AzureIoTTransportRecv_t ) 0xACACACAC
 };
+static uint8_t ucConnectBuffer[ azureiotconfigUSERNAME_MAX + azureiotconfigPASSWORD_MAX ];
+static uint32_t ulConnectBufferAcquired;
+static uint32_t ulConnectBufferReleased;
 static uint32_t ulReceivedCallbackFunctionId;
+static TickType_t xTestTickCount = 1;
+static uint64_t ullTestUnixTime;
+static AzureIoTHubClientPropertiesResponse_t xReceivedPropertiesRequestResponse;
+static uint32_t ulReceivedPropertiesRequestLatency;
 static const ReceiveTestData_t xTestReceiveData[] =
 {
     {
@@ -125,11 +136,26 @@ static const ReceiveTestData_t xTestRandomReceiveData[] =
 /*-----------------------------------------------------------*/
 
 TickType_t xTaskGetTickCount( void );
+void vTaskDelay( const TickType_t xTicksToDelay );
 uint32_t ulGetAllTests();
 
 TickType_t xTaskGetTickCount( void )
 {
-    return 1;
+    return xTestTickCount;
+}
+/*-----------------------------------------------------------*/
+
+void vTaskDelay( const TickType_t xTicksToDelay )
+{
+    xTestTickCount += xTicksToDelay;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvTransportReconnect( void * pvContext )
+{
+    ( void ) pvContext;
+
+    return ( AzureIoTResult_t ) mock();
 }
 /*-----------------------------------------------------------*/
 
@@ -225,6 +251,18 @@ static void prvTestProperties( AzureIoTHubClientPropertiesResponse_t * pxMessage
 }
 /*-----------------------------------------------------------*/
 
+static void prvTestPropertiesRequest( AzureIoTHubClientPropertiesResponse_t * pxMessage,
+                                      uint32_t ulLatencyMilliseconds,
+                                      void * pvContext )
+{
+    assert_true( pxMessage != NULL );
+    assert_true( pvContext == &xReceivedPropertiesRequestResponse );
+
+    xReceivedPropertiesRequestResponse = *pxMessage;
+    ulReceivedPropertiesRequestLatency = ulLatencyMilliseconds;
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTHubClient_Init_Failure( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
@@ -353,6 +391,246 @@ static void testAzureIoTHubClient_Init_NULLOptions_Success( void ** ppvState )
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTHubClient_Init_ExactWorkingBuffer_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+    bool xSessionPresent;
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xExactWorkingBuffer = true;
+    xHubClientOptions.ulSymmetricKeyLengthMax = sizeof( ucTestSymmetricKey ) - 1;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+    assert_true( xTestIoTHubClient._internal.ulWorkingBufferLength <= azureiothubWORKING_BUFFER_SIZE );
+    assert_true( xTestIoTHubClient._internal.ulWorkingBufferLength >= azureiotconfigTOPIC_MAX );
+
+    /* Fail if the key is longer than the working buffer was sized for. */
+    assert_int_equal( AzureIoTHubClient_SetSymmetricKey( &xTestIoTHubClient,
+                                                         ucTestSymmetricKey,
+                                                         sizeof( ucTestSymmetricKey ),
+                                                         prvHmacFunction ),
+                      eAzureIoTErrorOutOfMemory );
+
+    assert_int_equal( AzureIoTHubClient_SetSymmetricKey( &xTestIoTHubClient,
+                                                         ucTestSymmetricKey,
+                                                         sizeof( ucTestSymmetricKey ) - 1,
+                                                         prvHmacFunction ),
+                      eAzureIoTSuccess );
+
+    will_return( prvHmacFunction, 0 );
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient,
+                                                 false,
+                                                 &xSessionPresent,
+                                                 60 ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Init_ExactWorkingBuffer_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xExactWorkingBuffer = true;
+
+    /* Fail if the buffer cannot hold the username. */
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucHostname ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTErrorOutOfMemory );
+}
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvConnectBufferAcquire( void * pvContext,
+                                          uint32_t ulLength )
+{
+    ( void ) pvContext;
+
+    ulConnectBufferAcquired++;
+
+    return ( ulLength <= sizeof( ucConnectBuffer ) ) ? ucConnectBuffer : NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvConnectBufferRelease( void * pvContext,
+                                     uint8_t * pucBuffer )
+{
+    assert_true( pvContext == ucConnectBuffer );
+    assert_true( pucBuffer == ucConnectBuffer );
+
+    ulConnectBufferReleased++;
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Init_TransientConnectBuffer_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xTransientConnectBuffer = true;
+
+    /* Fail if the network buffer cannot also hold the username and password. */
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              azureiotconfigTOPIC_MAX + azureiotconfigUSERNAME_MAX,
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTErrorOutOfMemory );
+
+    /* Fail if there is a release callback but no acquire callback. */
+    xHubClientOptions.xConnectBufferRelease = prvConnectBufferRelease;
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Init_TransientConnectBuffer_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+    bool xSessionPresent;
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xTransientConnectBuffer = true;
+    xHubClientOptions.xConnectBufferAcquire = prvConnectBufferAcquire;
+    xHubClientOptions.xConnectBufferRelease = prvConnectBufferRelease;
+    xHubClientOptions.pvConnectBufferContext = ucConnectBuffer;
+    ulConnectBufferAcquired = 0;
+    ulConnectBufferReleased = 0;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+    assert_int_equal( xTestIoTHubClient._internal.ulWorkingBufferLength, azureiotconfigTOPIC_MAX );
+
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient,
+                                                 false,
+                                                 &xSessionPresent,
+                                                 60 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulConnectBufferAcquired, 1 );
+    assert_int_equal( ulConnectBufferReleased, 1 );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Connect_BorrowNetworkBuffer_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+    bool xSessionPresent;
+    uint32_t ulUserNameBufferLength;
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xExactWorkingBuffer = true;
+    xHubClientOptions.xTransientConnectBuffer = true;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+    ulUserNameBufferLength = xTestIoTHubClient._internal.ulUserNameBufferLength;
+
+    /* The network buffer holds the username but leaves no room in front of it for the CONNECT packet. */
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              azureiotconfigTOPIC_MAX + ulUserNameBufferLength + 16,
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+
+    /* Fail before sending CONNECT. */
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient,
+                                                 false,
+                                                 &xSessionPresent,
+                                                 60 ),
+                      eAzureIoTErrorOutOfMemory );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Connect_BorrowNetworkBuffer_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+    bool xSessionPresent;
+
+    ( void ) ppvState;
+
+    xHubClientOptions.xExactWorkingBuffer = true;
+    xHubClientOptions.xTransientConnectBuffer = true;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+    assert_int_equal( xTestIoTHubClient._internal.ulWorkingBufferLength, azureiotconfigTOPIC_MAX );
+
+    /* Username is borrowed from the end of the network buffer. */
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient,
+                                                 false,
+                                                 &xSessionPresent,
+                                                 60 ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTHubClient_Deinit_Success( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
@@ -548,16 +826,302 @@ static void testAzureIoTHubClient_SendTelemetry_SendFailure( void ** ppvState )
 }
 /*-----------------------------------------------------------*/
 
-static void testAzureIoTHubClient_SendTelemetryQOS0_Success( void ** ppvState )
+static void testAzureIoTHubClient_SendTelemetryQOS0_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    usSentQOS = eAzureIoTMQTTQoS0; /* Check to make sure the hub QOS translates correctly to MQTT layer */
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
+                                                       ucTestTelemetryPayload,
+                                                       sizeof( ucTestTelemetryPayload ) - 1,
+                                                       NULL,
+                                                       eAzureIoTHubMessageQoS0,
+                                                       NULL ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+
+static void testAzureIoTHubClient_SendTelemetryQOS1WithPacketID_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint16_t usPacketId = 0;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    usSentQOS = eAzureIoTMQTTQoS1; /* Check to make sure the hub QOS translates correctly to MQTT QOS */
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
+                                                       ucTestTelemetryPayload,
+                                                       sizeof( ucTestTelemetryPayload ) - 1,
+                                                       NULL,
+                                                       eAzureIoTHubMessageQoS1,
+                                                       &usPacketId ),
+                      eAzureIoTSuccess );
+    assert_int_equal( usPacketId, 1 );
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvTelemetryWriter( AzureIoTJSONWriter_t * pxJSONWriter,
+                                            void * pvContext )
+{
+    uint32_t * pulCalls = ( uint32_t * ) pvContext;
+    AzureIoTResult_t xResult;
+
+    ( *pulCalls )++;
+
+    if( ( ( xResult = AzureIoTJSONWriter_AppendBeginObject( pxJSONWriter ) ) == eAzureIoTSuccess ) &&
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithInt32Value( pxJSONWriter,
+                                                                       ( const uint8_t * ) "temperature",
+                                                                       sizeof( "temperature" ) - 1,
+                                                                       22 ) ) == eAzureIoTSuccess ) &&
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithStringValue( pxJSONWriter,
+                                                                        ( const uint8_t * ) "log",
+                                                                        sizeof( "log" ) - 1,
+                                                                        ( const uint8_t * ) "sensor warming up after a cold start",
+                                                                        sizeof( "sensor warming up after a cold start" ) - 1 ) ) == eAzureIoTSuccess ) &&
+        ( ( xResult = AzureIoTJSONWriter_AppendPropertyWithStringValue( pxJSONWriter,
+                                                                        ( const uint8_t * ) "location",
+                                                                        sizeof( "location" ) - 1,
+                                                                        ( const uint8_t * ) "north building, second floor",
+                                                                        sizeof( "north building, second floor" ) - 1 ) ) == eAzureIoTSuccess ) )
+    {
+        xResult = AzureIoTJSONWriter_AppendEndObject( pxJSONWriter );
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static AzureIoTResult_t prvGrowingTelemetryWriter( AzureIoTJSONWriter_t * pxJSONWriter,
+                                                   void * pvContext )
+{
+    uint32_t * pulCalls = ( uint32_t * ) pvContext;
+
+    /* Only the first pass, which measures the payload, is short. */
+    if( ( *pulCalls )++ == 0 )
+    {
+        return AzureIoTJSONWriter_AppendNull( pxJSONWriter );
+    }
+
+    return prvTelemetryWriter( pxJSONWriter, pvContext );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_SendTelemetryStream_Failure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint8_t ucChunk[ azureiotjsonwriterCHUNK_SIZE_MIN ];
+    uint32_t ulCalls = 0;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* Fail SendTelemetryStream when the writer is NULL */
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             NULL, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SendTelemetryStream when the chunk is NULL */
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             NULL, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SendTelemetryStream when the chunk is smaller than the core writer needs */
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ) - 1,
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SendTelemetryStream when the PUBLISH header cannot be serialized */
+    will_return( AzureIoTMQTT_PublishStreamBegin, eAzureIoTMQTTNoMemory );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+    assert_int_equal( ulStreamedPayloadLength, 0 );
+
+    /* Fail SendTelemetryStream before sending more than the length announced in the header */
+    ulCalls = 0;
+    will_return( AzureIoTMQTT_PublishStreamBegin, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvGrowingTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+    assert_int_equal( ulStreamedPayloadAnnounced, strlen( "null" ) );
+    assert_int_equal( ulStreamedPayloadLength, 0 );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_SendTelemetryStream_OutOfSyncFailure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint8_t ucChunk[ azureiotjsonwriterCHUNK_SIZE_MIN ];
+    uint32_t ulCalls = 0;
+    bool xSessionPresent;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* Part of the PUBLISH header may have been sent */
+    will_return( AzureIoTMQTT_PublishStreamBegin, eAzureIoTMQTTSendFailed );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+
+    /* Without a transport reconnect, nothing is sent until the application connects again */
+    assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
+                                                       ucTestTelemetryPayload,
+                                                       sizeof( ucTestTelemetryPayload ) - 1,
+                                                       NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+    assert_int_equal( AzureIoTHubClient_ProcessLoop( &xTestIoTHubClient, 60 ),
+                      eAzureIoTErrorFailed );
+
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient, false, &xSessionPresent, 60 ),
+                      eAzureIoTSuccess );
+
+    /* Stopping part way through the payload leaves the connection out of sync as well */
+    ulCalls = 0;
+    will_return( AzureIoTMQTT_PublishStreamBegin, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvGrowingTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPublishFailed );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_SendTelemetryStream_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    const char * pcExpected = "{\"temperature\":22,\"log\":\"sensor warming up after a cold start\","
+                              "\"location\":\"north building, second floor\"}";
+    uint8_t ucChunk[ azureiotjsonwriterCHUNK_SIZE_MIN ];
+    uint32_t ulCalls = 0;
+    uint16_t usPacketId = 0;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* The payload is longer than the chunk, so it is sent in several parts */
+    will_return( AzureIoTMQTT_PublishStreamBegin, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetryStream( &xTestIoTHubClient,
+                                                             prvTelemetryWriter, &ulCalls,
+                                                             ucChunk, sizeof( ucChunk ),
+                                                             NULL, eAzureIoTHubMessageQoS1, &usPacketId ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulCalls, 2 );
+    assert_int_equal( usPacketId, 1 );
+    assert_int_equal( ulStreamedPayloadAnnounced, strlen( pcExpected ) );
+    assert_int_equal( ulStreamedPayloadLength, strlen( pcExpected ) );
+    assert_memory_equal( ucStreamedPayload, pcExpected, strlen( pcExpected ) );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_SetTelemetryCompression_InvalidArgFailure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint8_t ucCompressionBuffer[ 64 ];
+    uint8_t ucWindowBuffer[ azureiotcompressionWINDOW_BUFFER_MIN ];
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* Fail SetTelemetryCompression when client is NULL */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( NULL,
+                                                                 ucCompressionBuffer, sizeof( ucCompressionBuffer ),
+                                                                 ucWindowBuffer, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SetTelemetryCompression when compression buffer length is zero */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient,
+                                                                 ucCompressionBuffer, 0,
+                                                                 ucWindowBuffer, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SetTelemetryCompression when window buffer is NULL */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient,
+                                                                 ucCompressionBuffer, sizeof( ucCompressionBuffer ),
+                                                                 NULL, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SetTelemetryCompression when window buffer is too small */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient,
+                                                                 ucCompressionBuffer, sizeof( ucCompressionBuffer ),
+                                                                 ucWindowBuffer, sizeof( ucWindowBuffer ) - 1 ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Disabling compression needs no buffers */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient, NULL, 0, NULL, 0 ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_SendTelemetryCompressed_Success( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
+    static const uint8_t ucTestCompressiblePayload[] = "{\"temperature\":21,\"temperature\":21,\"temperature\":21}";
+    uint8_t ucCompressionBuffer[ sizeof( ucTestCompressiblePayload ) ];
+    uint8_t ucExpectedPayload[ azureiotcompressionMAX_ENCODED_SIZE( sizeof( ucTestCompressiblePayload ) ) ];
+    uint8_t ucWindowBuffer[ 256 ];
+    uint32_t ulExpectedLength;
 
     ( void ) ppvState;
 
     prvSetupTestIoTHubClient( &xTestIoTHubClient );
 
-    usSentQOS = eAzureIoTMQTTQoS0; /* Check to make sure the hub QOS translates correctly to MQTT layer */
+    assert_int_equal( AzureIoTCompression_Compress( ucTestCompressiblePayload, sizeof( ucTestCompressiblePayload ) - 1,
+                                                    ucExpectedPayload, sizeof( ucExpectedPayload ), &ulExpectedLength,
+                                                    ucWindowBuffer, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTSuccess );
+    assert_true( ulExpectedLength < sizeof( ucTestCompressiblePayload ) - 1 );
+
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient,
+                                                                 ucCompressionBuffer, sizeof( ucCompressionBuffer ),
+                                                                 ucWindowBuffer, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTSuccess );
+
+    pucPublishPayload = ucExpectedPayload;
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
+                                                       ucTestCompressiblePayload,
+                                                       sizeof( ucTestCompressiblePayload ) - 1,
+                                                       NULL,
+                                                       eAzureIoTHubMessageQoS0,
+                                                       NULL ),
+                      eAzureIoTSuccess );
 
+    /* A payload which does not compress is sent as is */
+    pucPublishPayload = ucTestTelemetryPayload;
     will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
     assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
                                                        ucTestTelemetryPayload,
@@ -566,30 +1130,46 @@ static void testAzureIoTHubClient_SendTelemetryQOS0_Success( void ** ppvState )
                                                        eAzureIoTHubMessageQoS0,
                                                        NULL ),
                       eAzureIoTSuccess );
+    pucPublishPayload = NULL;
 }
 /*-----------------------------------------------------------*/
 
-
-static void testAzureIoTHubClient_SendTelemetryQOS1WithPacketID_Success( void ** ppvState )
+static void testAzureIoTHubClient_SendTelemetryCompressed_ContentEncodingSet( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
-    uint16_t usPacketId = 0;
+    AzureIoTMessageProperties_t xProperties;
+    static const uint8_t ucTestCompressiblePayload[] = "{\"temperature\":21,\"temperature\":21,\"temperature\":21}";
+    uint8_t ucCompressionBuffer[ sizeof( ucTestCompressiblePayload ) ];
+    uint8_t ucWindowBuffer[ 256 ];
+    uint8_t ucPropertiesBuffer[ 32 ];
 
     ( void ) ppvState;
 
     prvSetupTestIoTHubClient( &xTestIoTHubClient );
 
-    usSentQOS = eAzureIoTMQTTQoS1; /* Check to make sure the hub QOS translates correctly to MQTT QOS */
+    assert_int_equal( AzureIoTHubClient_SetTelemetryCompression( &xTestIoTHubClient,
+                                                                 ucCompressionBuffer, sizeof( ucCompressionBuffer ),
+                                                                 ucWindowBuffer, sizeof( ucWindowBuffer ) ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTMessage_PropertiesInit( &xProperties, ucPropertiesBuffer, 0, sizeof( ucPropertiesBuffer ) ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTMessage_PropertiesAppend( &xProperties,
+                                                        ( const uint8_t * ) azureiotmessagePROPERTY_CONTENT_ENCODING,
+                                                        sizeof( azureiotmessagePROPERTY_CONTENT_ENCODING ) - 1,
+                                                        ( const uint8_t * ) "gzip", sizeof( "gzip" ) - 1 ),
+                      eAzureIoTSuccess );
 
+    /* A payload whose content encoding is set by the caller is sent as is */
+    pucPublishPayload = ucTestCompressiblePayload;
     will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
     assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
-                                                       ucTestTelemetryPayload,
-                                                       sizeof( ucTestTelemetryPayload ) - 1,
-                                                       NULL,
-                                                       eAzureIoTHubMessageQoS1,
-                                                       &usPacketId ),
+                                                       ucTestCompressiblePayload,
+                                                       sizeof( ucTestCompressiblePayload ) - 1,
+                                                       &xProperties,
+                                                       eAzureIoTHubMessageQoS0,
+                                                       NULL ),
                       eAzureIoTSuccess );
-    assert_int_equal( usPacketId, 1 );
+    pucPublishPayload = NULL;
 }
 /*-----------------------------------------------------------*/
 
@@ -1429,6 +2009,187 @@ static void testAzureIoTHubClient_RequestPropertiesAsync_Success( void ** ppvSta
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTHubClient_PropertiesRequestWithCallback_InvalidArgFailure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* Fail SendPropertiesReportedWithCallback when client is NULL */
+    assert_int_equal( AzureIoTHubClient_SendPropertiesReportedWithCallback( NULL,
+                                                                            ucTestPropertyReportedPayload,
+                                                                            sizeof( ucTestPropertyReportedPayload ) - 1,
+                                                                            prvTestPropertiesRequest, NULL, 0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SendPropertiesReportedWithCallback when callback is NULL */
+    assert_int_equal( AzureIoTHubClient_SendPropertiesReportedWithCallback( &xTestIoTHubClient,
+                                                                            ucTestPropertyReportedPayload,
+                                                                            sizeof( ucTestPropertyReportedPayload ) - 1,
+                                                                            NULL, NULL, 0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail RequestPropertiesWithCallback when client is NULL */
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( NULL,
+                                                                       prvTestPropertiesRequest, NULL, 0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail RequestPropertiesWithCallback when callback is NULL */
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       NULL, NULL, 0, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail RequestPropertiesWithCallback when properties are not subscribed */
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       prvTestPropertiesRequest, NULL, 0, NULL ),
+                      eAzureIoTErrorTopicNotSubscribed );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_PropertiesRequestWithCallback_Success( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTMQTTPublishInfo_t publishInfo;
+    uint32_t ulReportedRequestId = 0;
+    uint32_t ulGetRequestId = 0;
+    uint32_t ulIndex;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_SUBACK;
+    xDeserializedInfo.usPacketIdentifier = usTestPacketId;
+    ulDelayReceivePacket = 0;
+    assert_int_equal( AzureIoTHubClient_SubscribeProperties( &xTestIoTHubClient,
+                                                             prvTestProperties,
+                                                             NULL, ( uint32_t ) -1 ),
+                      eAzureIoTSuccess );
+
+    /* Both requests are in flight at once */
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = ucTestPropertyReportedPayload;
+    assert_int_equal( AzureIoTHubClient_SendPropertiesReportedWithCallback( &xTestIoTHubClient,
+                                                                            ucTestPropertyReportedPayload,
+                                                                            sizeof( ucTestPropertyReportedPayload ) - 1,
+                                                                            prvTestPropertiesRequest,
+                                                                            &xReceivedPropertiesRequestResponse,
+                                                                            1000, &ulReportedRequestId ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulReportedRequestId, 1 );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = NULL;
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       prvTestPropertiesRequest,
+                                                                       &xReceivedPropertiesRequestResponse,
+                                                                       1000, &ulGetRequestId ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulGetRequestId, 2 );
+
+    /* Responses go to the request callback only, and may arrive in any order */
+    xTestTickCount += 20;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_PUBLISH;
+    xDeserializedInfo.usPacketIdentifier = 1;
+    publishInfo.pcTopicName = ( const uint8_t * ) testPROPERTY_GET_MESSAGE_TOPIC;
+    publishInfo.usTopicNameLength = sizeof( testPROPERTY_GET_MESSAGE_TOPIC ) - 1;
+    publishInfo.pvPayload = testPROPERTY_MESSAGE;
+    publishInfo.xPayloadLength = sizeof( testPROPERTY_MESSAGE ) - 1;
+    xDeserializedInfo.pxPublishInfo = &publishInfo;
+    ulReceivedCallbackFunctionId = 0;
+    memset( &xReceivedPropertiesRequestResponse, 0, sizeof( xReceivedPropertiesRequestResponse ) );
+    assert_int_equal( AzureIoTHubClient_ProcessLoop( &xTestIoTHubClient, 60 ), eAzureIoTSuccess );
+    assert_int_equal( ulReceivedCallbackFunctionId, 0 );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageType, eAzureIoTHubPropertiesRequestedMessage );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageStatus, eAzureIoTStatusOk );
+    assert_int_equal( xReceivedPropertiesRequestResponse.ulRequestID, ulGetRequestId );
+    assert_int_equal( ulReceivedPropertiesRequestLatency, 20 );
+
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    publishInfo.pcTopicName = ( const uint8_t * ) testPROPERTY_REPORTED_MESSAGE_TOPIC;
+    publishInfo.usTopicNameLength = sizeof( testPROPERTY_REPORTED_MESSAGE_TOPIC ) - 1;
+    publishInfo.pvPayload = NULL;
+    publishInfo.xPayloadLength = 0;
+    memset( &xReceivedPropertiesRequestResponse, 0, sizeof( xReceivedPropertiesRequestResponse ) );
+    assert_int_equal( AzureIoTHubClient_ProcessLoop( &xTestIoTHubClient, 60 ), eAzureIoTSuccess );
+    assert_int_equal( ulReceivedCallbackFunctionId, 0 );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageType, eAzureIoTHubPropertiesReportedResponseMessage );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageStatus, eAzureIoTStatusNoContent );
+    assert_int_equal( xReceivedPropertiesRequestResponse.ulRequestID, ulReportedRequestId );
+
+    /* Only a limited number of requests can wait for their response */
+    for( ulIndex = 0; ulIndex < azureiotconfigPROPERTIES_REQUESTS_MAX; ulIndex++ )
+    {
+        will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+        assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                           prvTestPropertiesRequest,
+                                                                           &xReceivedPropertiesRequestResponse,
+                                                                           0, NULL ),
+                          eAzureIoTSuccess );
+    }
+
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       prvTestPropertiesRequest,
+                                                                       &xReceivedPropertiesRequestResponse,
+                                                                       0, NULL ),
+                      eAzureIoTErrorOutOfMemory );
+    xTestTickCount = 1;
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_PropertiesRequestWithCallback_Timeout( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint32_t ulRequestId = 0;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_SUBACK;
+    xDeserializedInfo.usPacketIdentifier = usTestPacketId;
+    ulDelayReceivePacket = 0;
+    assert_int_equal( AzureIoTHubClient_SubscribeProperties( &xTestIoTHubClient,
+                                                             prvTestProperties,
+                                                             NULL, ( uint32_t ) -1 ),
+                      eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = NULL;
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       prvTestPropertiesRequest,
+                                                                       &xReceivedPropertiesRequestResponse,
+                                                                       100, &ulRequestId ),
+                      eAzureIoTSuccess );
+
+    /* No response received and not timed out yet */
+    xTestTickCount += 99;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    ulDelayReceivePacket = 1000;
+    memset( &xReceivedPropertiesRequestResponse, 0, sizeof( xReceivedPropertiesRequestResponse ) );
+    assert_int_equal( AzureIoTHubClient_ProcessLoop( &xTestIoTHubClient, 60 ), eAzureIoTSuccess );
+    assert_int_equal( xReceivedPropertiesRequestResponse.ulRequestID, 0 );
+
+    xTestTickCount += 1;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_ProcessLoop( &xTestIoTHubClient, 60 ), eAzureIoTSuccess );
+    assert_int_equal( xReceivedPropertiesRequestResponse.ulRequestID, ulRequestId );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageType, eAzureIoTHubPropertiesRequestedMessage );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageStatus, eAzureIoTStatusTimeout );
+    assert_int_equal( ulReceivedPropertiesRequestLatency, 100 );
+
+    ulDelayReceivePacket = 0;
+    xTestTickCount = 1;
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTHubClient_ReceiveMessages_Success( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
@@ -1534,6 +2295,231 @@ static void testAzureIoTHubClient_ReceiveRandomMessages_Success( void ** ppvStat
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTHubClient_Run_InvalidArgFailure( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    /* Fail if hub client is NULL. */
+    assert_int_equal( AzureIoTHubClient_Run( NULL, 60 ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail if no transport reconnect callback was set. */
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Fail SetReconnect when the callback is NULL. */
+    assert_int_equal( AzureIoTHubClient_SetReconnect( &xTestIoTHubClient, NULL, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Run_ReconnectSuccess( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint32_t ulBackoffMilliseconds = azureiotconfigRECONNECT_BACKOFF_BASE_MS +
+                                     azureiotconfigRECONNECT_BACKOFF_BASE_MS / 100U * azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_SUBACK;
+    xDeserializedInfo.usPacketIdentifier = usTestPacketId;
+    assert_int_equal( AzureIoTHubClient_SubscribeCloudToDeviceMessage( &xTestIoTHubClient,
+                                                                       prvTestCloudMessage,
+                                                                       NULL, ( uint32_t ) -1 ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTHubClient_SetReconnect( &xTestIoTHubClient, prvTransportReconnect, NULL ),
+                      eAzureIoTSuccess );
+
+    /* Connection lost. */
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTRecvFailed );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTErrorPending );
+
+    /* Wait out the backoff, then fail to bring the transport back. */
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, ulBackoffMilliseconds ),
+                      eAzureIoTErrorPending );
+    will_return( prvTransportReconnect, eAzureIoTErrorFailed );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 0 ),
+                      eAzureIoTErrorPending );
+
+    /* The second attempt waits twice as long, so it is not due just before twice the base backoff. */
+    xTestTickCount += pdMS_TO_TICKS( 2U * azureiotconfigRECONNECT_BACKOFF_BASE_MS - 1U );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 0 ),
+                      eAzureIoTErrorPending );
+
+    /* Move past twice the base backoff and its largest jitter. */
+    xTestTickCount += pdMS_TO_TICKS( 1U + 2U * ( ulBackoffMilliseconds - azureiotconfigRECONNECT_BACKOFF_BASE_MS ) );
+
+    /* The session is not present, so the cloud to device subscription is restored. */
+    will_return( prvTransportReconnect, eAzureIoTSuccess );
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 0 ),
+                      eAzureIoTSuccess );
+
+    xPacketInfo.ucType = 0;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Run_ReconnectCancelsPropertiesRequests( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    uint32_t ulRequestId = 0;
+    uint32_t ulBackoffMilliseconds = azureiotconfigRECONNECT_BACKOFF_BASE_MS +
+                                     azureiotconfigRECONNECT_BACKOFF_BASE_MS / 100U * azureiotconfigRECONNECT_BACKOFF_JITTER_PERCENT;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = azureiotmqttPACKET_TYPE_SUBACK;
+    xDeserializedInfo.usPacketIdentifier = usTestPacketId;
+    assert_int_equal( AzureIoTHubClient_SubscribeProperties( &xTestIoTHubClient,
+                                                             prvTestProperties,
+                                                             NULL, ( uint32_t ) -1 ),
+                      eAzureIoTSuccess );
+
+    /* A request without a timeout, whose response never comes. */
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    pucPublishPayload = NULL;
+    assert_int_equal( AzureIoTHubClient_RequestPropertiesWithCallback( &xTestIoTHubClient,
+                                                                       prvTestPropertiesRequest,
+                                                                       &xReceivedPropertiesRequestResponse,
+                                                                       0, &ulRequestId ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTHubClient_SetReconnect( &xTestIoTHubClient, prvTransportReconnect, NULL ),
+                      eAzureIoTSuccess );
+
+    /* Connection lost. */
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTRecvFailed );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTErrorPending );
+
+    /* Move past the backoff and its largest jitter, then reconnect and restore the subscription. */
+    xTestTickCount += pdMS_TO_TICKS( ulBackoffMilliseconds + 1U );
+    memset( &xReceivedPropertiesRequestResponse, 0, sizeof( xReceivedPropertiesRequestResponse ) );
+    will_return( prvTransportReconnect, eAzureIoTSuccess );
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_Subscribe, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 0 ),
+                      eAzureIoTSuccess );
+
+    /* The request sent on the lost connection is timed out and its slot is free again. */
+    assert_int_equal( xReceivedPropertiesRequestResponse.ulRequestID, ulRequestId );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageType, eAzureIoTHubPropertiesRequestedMessage );
+    assert_int_equal( xReceivedPropertiesRequestResponse.xMessageStatus, eAzureIoTStatusTimeout );
+    assert_int_equal( xTestIoTHubClient._internal.xPropertiesRequests[ 0 ]._internal.ulRequestID, 0 );
+
+    xPacketInfo.ucType = 0;
+    xTestTickCount = 1;
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetTestUnixTime( void )
+{
+    return ullTestUnixTime;
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Run_TokenRenewalSuccess( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+    AzureIoTHubClientOptions_t xHubClientOptions = { 0 };
+    bool xSessionPresent;
+
+    ( void ) ppvState;
+
+    ullTestUnixTime = 1000;
+
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Init( &xTestIoTHubClient,
+                                              ucHostname, sizeof( ucHostname ) - 1,
+                                              ucDeviceId, sizeof( ucDeviceId ) - 1,
+                                              &xHubClientOptions,
+                                              ucBuffer,
+                                              sizeof( ucBuffer ),
+                                              prvGetTestUnixTime,
+                                              &xTransportInterface ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClient_SetSymmetricKey( &xTestIoTHubClient,
+                                                         ucTestSymmetricKey,
+                                                         sizeof( ucTestSymmetricKey ) - 1,
+                                                         prvHmacFunction ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTHubClient_SetReconnect( &xTestIoTHubClient, prvTransportReconnect, NULL ),
+                      eAzureIoTSuccess );
+
+    will_return( prvHmacFunction, 0 );
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Connect( &xTestIoTHubClient,
+                                                 false,
+                                                 &xSessionPresent,
+                                                 60 ),
+                      eAzureIoTSuccess );
+
+    /* Token still valid for long. */
+    xPacketInfo.ucType = 0;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTSuccess );
+
+    /* Within the renewal margin: reconnect with a new token. */
+    ullTestUnixTime = 1000 + azureiotconfigDEFAULT_TOKEN_TIMEOUT_IN_SEC - azureiotconfigTOKEN_RENEWAL_MARGIN_S;
+    will_return( AzureIoTMQTT_Disconnect, eAzureIoTMQTTSuccess );
+    will_return( prvTransportReconnect, eAzureIoTSuccess );
+    will_return( prvHmacFunction, 0 );
+    will_return( AzureIoTMQTT_Connect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTSuccess );
+
+    /* The new token is not due for renewal. */
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 60 ),
+                      eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTHubClient_Run_SendTelemetryPending( void ** ppvState )
+{
+    AzureIoTHubClient_t xTestIoTHubClient;
+
+    ( void ) ppvState;
+
+    prvSetupTestIoTHubClient( &xTestIoTHubClient );
+
+    assert_int_equal( AzureIoTHubClient_SetReconnect( &xTestIoTHubClient, prvTransportReconnect, NULL ),
+                      eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTRecvFailed );
+    assert_int_equal( AzureIoTHubClient_Run( &xTestIoTHubClient, 0 ),
+                      eAzureIoTErrorPending );
+
+    /* Telemetry waits for the reconnect. */
+    assert_int_equal( AzureIoTHubClient_SendTelemetry( &xTestIoTHubClient,
+                                                       ucTestTelemetryPayload,
+                                                       sizeof( ucTestTelemetryPayload ) - 1,
+                                                       NULL, eAzureIoTHubMessageQoS0, NULL ),
+                      eAzureIoTErrorPending );
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTHubClient_SetSymmetricKey_InvalidArgFailure( void ** ppvState )
 {
     AzureIoTHubClient_t xTestIoTHubClient;
@@ -1587,6 +2573,12 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTHubClient_Init_Failure ),
         cmocka_unit_test( testAzureIoTHubClient_Init_Success ),
         cmocka_unit_test( testAzureIoTHubClient_Init_NULLOptions_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_Init_ExactWorkingBuffer_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_Init_ExactWorkingBuffer_Failure ),
+        cmocka_unit_test( testAzureIoTHubClient_Init_TransientConnectBuffer_Failure ),
+        cmocka_unit_test( testAzureIoTHubClient_Init_TransientConnectBuffer_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_Connect_BorrowNetworkBuffer_Failure ),
+        cmocka_unit_test( testAzureIoTHubClient_Connect_BorrowNetworkBuffer_Success ),
         cmocka_unit_test( testAzureIoTHubClient_Deinit_Success ),
         cmocka_unit_test( testAzureIoTHubClient_OptionsInit_Fail ),
         cmocka_unit_test( testAzureIoTHubClient_OptionsInit_Success ),
@@ -1601,6 +2593,12 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTHubClient_SendTelemetry_SendFailure ),
         cmocka_unit_test( testAzureIoTHubClient_SendTelemetryQOS0_Success ),
         cmocka_unit_test( testAzureIoTHubClient_SendTelemetryQOS1WithPacketID_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_SetTelemetryCompression_InvalidArgFailure ),
+        cmocka_unit_test( testAzureIoTHubClient_SendTelemetryCompressed_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_SendTelemetryCompressed_ContentEncodingSet ),
+        cmocka_unit_test( testAzureIoTHubClient_SendTelemetryStream_Failure ),
+        cmocka_unit_test( testAzureIoTHubClient_SendTelemetryStream_OutOfSyncFailure ),
+        cmocka_unit_test( testAzureIoTHubClient_SendTelemetryStream_Success ),
         cmocka_unit_test( testAzureIoTHubClient_ProcessLoop_InvalidArgFailure ),
         cmocka_unit_test( testAzureIoTHubClient_ProcessLoop_MQTTProcessFailure ),
         cmocka_unit_test( testAzureIoTHubClient_ProcessLoop_Success ),
@@ -1646,8 +2644,16 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTHubClient_RequestPropertiesAsync_NotSubscribeFailure ),
         cmocka_unit_test( testAzureIoTHubClient_RequestPropertiesAsync_SendFailure ),
         cmocka_unit_test( testAzureIoTHubClient_RequestPropertiesAsync_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_PropertiesRequestWithCallback_InvalidArgFailure ),
+        cmocka_unit_test( testAzureIoTHubClient_PropertiesRequestWithCallback_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_PropertiesRequestWithCallback_Timeout ),
         cmocka_unit_test( testAzureIoTHubClient_ReceiveMessages_Success ),
         cmocka_unit_test( testAzureIoTHubClient_ReceiveRandomMessages_Success ),
+        cmocka_unit_test( testAzureIoTHubClient_Run_InvalidArgFailure ),
+        cmocka_unit_test( testAzureIoTHubClient_Run_ReconnectSuccess ),
+        cmocka_unit_test( testAzureIoTHubClient_Run_ReconnectCancelsPropertiesRequests ),
+        cmocka_unit_test( testAzureIoTHubClient_Run_TokenRenewalSuccess ),
+        cmocka_unit_test( testAzureIoTHubClient_Run_SendTelemetryPending ),
         cmocka_unit_test( testAzureIoTHubClient_SetSymmetricKey_InvalidArgFailure ),
         cmocka_unit_test( testAzureIoTHubClient_SetSymmetricKey_Success )
     };
@@ -38,6 +38,12 @@ static uint8_t ucTestJSONInt32[] =
 static uint8_t ucTestJSONDouble[] =
     "{\"property\":42.42}";
 
+/*
+ * [42.42, -42.42, 1.05, 1.5, 7, 0, 3.14159265358979]
+ */
+static uint8_t ucTestJSONDoubleFormats[] =
+    "[42.42,-42.42,1.05,1.5,7,0,3.14159265358979]";
+
 /*
  * {
  * "property_one": true
@@ -524,6 +530,29 @@ static void testAzureIoTJSONWriter_AppendDouble_Success( void ** ppvState )
     assert_string_equal( ucJSONWriterBuffer, ucTestJSONDouble );
 }
 
+static void testAzureIoTJSONWriter_AppendDouble_Formats_Success( void ** ppvState )
+{
+    AzureIoTJSONWriter_t xWriter;
+
+    prvInitJSONWriter( &xWriter );
+
+    assert_int_equal( AzureIoTJSONWriter_AppendBeginArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, 42.42, 2 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, -42.42, 2 ), eAzureIoTSuccess );
+    /* Leading zeros of the fractional part are kept */
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, 1.05, 2 ), eAzureIoTSuccess );
+    /* Trailing zeros of the fractional part are dropped */
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, 1.5, 6 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, 7.9, 0 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, -0.001, 2 ), eAzureIoTSuccess );
+    /* Fractional digits are clamped to 15 */
+    assert_int_equal( AzureIoTJSONWriter_AppendDouble( &xWriter, 3.14159265358979, 20 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendEndArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_GetBytesUsed( &xWriter ), strlen( ucTestJSONDoubleFormats ) );
+
+    assert_string_equal( ucJSONWriterBuffer, ucTestJSONDoubleFormats );
+}
+
 static void testAzureIoTJSONWriter_AppendNull_Failure( void ** ppvState )
 {
     /* Fail append NULL if JSON writer is NULL */
@@ -592,6 +621,118 @@ static void testAzureIoTJSONWriter_AppendArray_Success( void ** ppvState )
     assert_string_equal( ucJSONWriterBuffer, ucTestJSONArray );
 }
 
+static void prvAppendCountedDocument( AzureIoTJSONWriter_t * pxWriter )
+{
+    uint32_t ulIndex;
+
+    /* Longer than the counting chunk, so that it is counted in several chunks */
+    assert_int_equal( AzureIoTJSONWriter_AppendBeginObject( pxWriter ), eAzureIoTSuccess );
+
+    for( ulIndex = 0; ulIndex < 10; ulIndex++ )
+    {
+        assert_int_equal( AzureIoTJSONWriter_AppendPropertyName( pxWriter,
+                                                                 ucPropertyName,
+                                                                 strlen( ucPropertyName ) ), eAzureIoTSuccess );
+        assert_int_equal( AzureIoTJSONWriter_AppendBeginArray( pxWriter ), eAzureIoTSuccess );
+        assert_int_equal( AzureIoTJSONWriter_AppendString( pxWriter, ucValueOne, strlen( ucValueOne ) ), eAzureIoTSuccess );
+        assert_int_equal( AzureIoTJSONWriter_AppendDouble( pxWriter, xDoubleValue, usFractionalDigits ), eAzureIoTSuccess );
+        assert_int_equal( AzureIoTJSONWriter_AppendInt32( pxWriter, lInt32Value ), eAzureIoTSuccess );
+        assert_int_equal( AzureIoTJSONWriter_AppendEndArray( pxWriter ), eAzureIoTSuccess );
+    }
+
+    assert_int_equal( AzureIoTJSONWriter_AppendEndObject( pxWriter ), eAzureIoTSuccess );
+}
+
+static void testAzureIoTJSONWriter_Counting_Success( void ** ppvState )
+{
+    AzureIoTJSONWriter_t xWriter;
+    uint8_t ucBuffer[ 512 ];
+    int32_t lCountedBytes;
+
+    assert_int_equal( AzureIoTJSONWriter_Init( &xWriter, NULL, 0 ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_GetBytesUsed( &xWriter ), 0 );
+    prvAppendCountedDocument( &xWriter );
+    lCountedBytes = AzureIoTJSONWriter_GetBytesUsed( &xWriter );
+    assert_true( lCountedBytes > azureiotjsonwriterCOUNTING_CHUNK_SIZE );
+
+    /* The count is the exact length of the same document written to a buffer */
+    assert_int_equal( AzureIoTJSONWriter_Init( &xWriter, ucBuffer, ( uint32_t ) lCountedBytes ), eAzureIoTSuccess );
+    prvAppendCountedDocument( &xWriter );
+    assert_int_equal( AzureIoTJSONWriter_GetBytesUsed( &xWriter ), lCountedBytes );
+}
+
+static AzureIoTResult_t prvCollectFlush( void * pvContext,
+                                         const uint8_t * pucData,
+                                         uint32_t ulDataLength )
+{
+    uint32_t * pulCollected = ( uint32_t * ) pvContext;
+
+    assert_true( *pulCollected + ulDataLength <= sizeof( ucJSONWriterBuffer ) );
+    memcpy( ucJSONWriterBuffer + *pulCollected, pucData, ulDataLength );
+    *pulCollected += ulDataLength;
+
+    return eAzureIoTSuccess;
+}
+
+static void testAzureIoTJSONWriter_Chunked_Failure( void ** ppvState )
+{
+    AzureIoTJSONWriter_t xWriter;
+    uint8_t ucChunk[ azureiotjsonwriterCHUNK_SIZE_MIN ];
+    uint32_t ulCollected = 0;
+
+    /* Fail chunked init if flush callback is NULL */
+    assert_int_equal( AzureIoTJSONWriter_InitChunked( &xWriter,
+                                                      ucChunk, sizeof( ucChunk ),
+                                                      NULL, &ulCollected ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail chunked init if chunk is smaller than the core writer needs */
+    assert_int_equal( AzureIoTJSONWriter_InitChunked( &xWriter,
+                                                      ucChunk, sizeof( ucChunk ) - 1,
+                                                      prvCollectFlush, &ulCollected ), eAzureIoTErrorInvalidArgument );
+
+    /* Fail flush if the writer is not chunked */
+    prvInitJSONWriter( &xWriter );
+    assert_int_equal( AzureIoTJSONWriter_Flush( &xWriter ), eAzureIoTErrorInvalidArgument );
+}
+
+static void testAzureIoTJSONWriter_Chunked_Success( void ** ppvState )
+{
+    AzureIoTJSONWriter_t xWriter;
+    const char * pcExpected = "{\"description\":[\"a value longer than ten bytes\",\"another value longer than ten bytes\"]}";
+    uint8_t ucChunk[ azureiotjsonwriterCHUNK_SIZE_MIN ];
+    uint32_t ulCollected = 0;
+
+    memset( ucJSONWriterBuffer, 0, sizeof( ucJSONWriterBuffer ) );
+    assert_int_equal( AzureIoTJSONWriter_InitChunked( &xWriter,
+                                                      ucChunk, sizeof( ucChunk ),
+                                                      prvCollectFlush, &ulCollected ), eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTJSONWriter_AppendBeginObject( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendPropertyName( &xWriter,
+                                                             "description",
+                                                             strlen( "description" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendBeginArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendString( &xWriter,
+                                                       "a value longer than ten bytes",
+                                                       strlen( "a value longer than ten bytes" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendString( &xWriter,
+                                                       "another value longer than ten bytes",
+                                                       strlen( "another value longer than ten bytes" ) ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendEndArray( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( AzureIoTJSONWriter_AppendEndObject( &xWriter ), eAzureIoTSuccess );
+
+    /* The text is longer than the chunk, part of it was flushed and the rest waits for the flush */
+    assert_true( strlen( pcExpected ) > sizeof( ucChunk ) );
+    assert_true( ulCollected > 0 );
+    assert_true( ulCollected < strlen( pcExpected ) );
+    assert_int_equal( AzureIoTJSONWriter_GetBytesUsed( &xWriter ), strlen( pcExpected ) );
+
+    assert_int_equal( AzureIoTJSONWriter_Flush( &xWriter ), eAzureIoTSuccess );
+    assert_int_equal( ulCollected, strlen( pcExpected ) );
+    assert_int_equal( AzureIoTJSONWriter_GetBytesUsed( &xWriter ), strlen( pcExpected ) );
+    assert_memory_equal( ucJSONWriterBuffer, pcExpected, strlen( pcExpected ) );
+}
+
 static void testAzureIoTJSONWriter_InvalidWrite_Failure( void ** ppvState )
 {
     AzureIoTJSONWriter_t xWriter;
@@ -673,6 +814,7 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTJSONWriter_AppendInt32_Success ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendDouble_Failure ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendDouble_Success ),
+        cmocka_unit_test( testAzureIoTJSONWriter_AppendDouble_Formats_Success ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendNull_Failure ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendNull_Success ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendBeginObject_Failure ),
@@ -680,6 +822,9 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTJSONWriter_AppendBeginArray_Failure ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendEndArray_Failure ),
         cmocka_unit_test( testAzureIoTJSONWriter_AppendArray_Success ),
+        cmocka_unit_test( testAzureIoTJSONWriter_Counting_Success ),
+        cmocka_unit_test( testAzureIoTJSONWriter_Chunked_Failure ),
+        cmocka_unit_test( testAzureIoTJSONWriter_Chunked_Success ),
         cmocka_unit_test( testAzureIoTJSONWriter_InvalidWrite_Failure )
     };
 
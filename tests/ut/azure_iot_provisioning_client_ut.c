@@ -28,7 +28,7 @@ static const uint8_t ucDeviceId[] = "UnitTest";
 static const uint8_t ucHubEndpoint[] = "unittest.azure-iothub.com";
 static const uint8_t ucSymmetricKey[] = "ABC12345";
 static const uint8_t ucTestProvisioningServiceResponse[] = "$dps/registrations/res/202/?";
-static uint8_t ucBuffer[ 1024 ];
+static uint8_t ucBuffer[ 2048 ];
 static uint32_t ulExpectedExtendedCode = 400207;
 static AzureIoTTransportInterface_t xTransportInterface =
 {
@@ -77,6 +77,7 @@ static const uint8_t ucCustomPayload[] = "{\"modelId\":\"UnitTest\"}";
 static uint8_t ucTopicBuffer[ 128 ];
 static uint32_t ulRequestId = 1;
 static uint64_t ullUnixTime = 0;
+static TickType_t xTestTickCount = 1;
 /*-----------------------------------------------------------*/
 
 TickType_t xTaskGetTickCount( void );
@@ -93,7 +94,7 @@ static uint32_t prvHmacFunction( const uint8_t * pucKey,
 
 TickType_t xTaskGetTickCount( void )
 {
-    return 1;
+    return xTestTickCount;
 }
 /*-----------------------------------------------------------*/
 
@@ -307,6 +308,7 @@ static void prvRegister( AzureIoTProvisioningClient_t * pxTestProvisioningClient
     /* Wait for timeout */
     will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
     ullUnixTime += 2;
+    xTestTickCount += pdMS_TO_TICKS( 2000 );
     assert_int_equal( AzureIoTProvisioningClient_Register( pxTestProvisioningClient,
                                                            azureiotprovisioningNO_WAIT ),
                       eAzureIoTErrorPending );
@@ -783,6 +785,117 @@ static void testAzureIoTProvisioningClient_Register_QueryInvalidResponseFailure(
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTProvisioningClient_Register_RetryBudgetFailure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTProvisioningClientOptions_t xProvisioningOptions = { 0 };
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+
+    ( void ) ppvState;
+
+    xProvisioningOptions.ulRetryBudget = 1;
+    will_return( AzureIoTMQTT_Init, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTProvisioningClient_Init( &xTestProvisioningClient,
+                                                       &ucEndpoint[ 0 ], sizeof( ucEndpoint ),
+                                                       &ucIdScope[ 0 ], sizeof( ucIdScope ),
+                                                       &ucRegistrationId[ 0 ], sizeof( ucRegistrationId ),
+                                                       &xProvisioningOptions, ucBuffer, sizeof( ucBuffer ),
+                                                       prvGetUnixTime,
+                                                       &xTransportInterface ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTProvisioningClient_SetSymmetricKey( &xTestProvisioningClient,
+                                                                  ucSymmetricKey, sizeof( ucSymmetricKey ) - 1,
+                                                                  prvHmacFunction ),
+                      eAzureIoTSuccess );
+
+    prvRegister( &xTestProvisioningClient );
+
+    /* Publish Registration Query */
+    will_return( AzureIoTMQTT_Publish, eAzureIoTMQTTSuccess );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    xPacketInfo.ucType = 0;
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    /* Still assigning */
+    prvGenerateGoodResponse( &xPublishInfo, 1 );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    /* Out of retries */
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorFailed );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_Register_QueryBackoffSuccess( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+    uint32_t ulExpectedMilliseconds = 1000;
+    uint32_t ulDelayMilliseconds;
+    uint32_t ulQuery;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegistrationConnectStep( &xTestProvisioningClient );
+    prvRegistrationSubscribeStep( &xTestProvisioningClient );
+    prvRegistrationAckSubscribeStep( &xTestProvisioningClient );
+    prvRegistrationPublishStep( &xTestProvisioningClient );
+
+    /* Enough queries for the delay to reach its cap and stay there. */
+    for( ulQuery = 0; ulQuery < 8; ulQuery++ )
+    {
+        /* Still assigning, retry after a second */
+        prvGenerateGoodResponse( &xPublishInfo, 1 );
+        assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                               azureiotprovisioningNO_WAIT ),
+                          eAzureIoTErrorPending );
+        will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+        assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                               azureiotprovisioningNO_WAIT ),
+                          eAzureIoTErrorPending );
+
+        /* The delay doubles with each query up to the cap, plus a bounded jitter. */
+        ulDelayMilliseconds = xTestProvisioningClient._internal.ulRetryTimeMilliseconds - ( uint32_t ) xTestTickCount;
+        assert_in_range( ulDelayMilliseconds, ulExpectedMilliseconds,
+                         ulExpectedMilliseconds + ulExpectedMilliseconds / 100 * azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT );
+
+        ulExpectedMilliseconds *= 2;
+
+        if( ulExpectedMilliseconds > azureiotconfigPROVISIONING_BACKOFF_MAX_S * 1000 )
+        {
+            ulExpectedMilliseconds = azureiotconfigPROVISIONING_BACKOFF_MAX_S * 1000;
+        }
+
+        /* Not due a millisecond early */
+        xTestTickCount += pdMS_TO_TICKS( ulDelayMilliseconds - 1 );
+        will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+        assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                               azureiotprovisioningNO_WAIT ),
+                          eAzureIoTErrorPending );
+        assert_int_equal( xTestProvisioningClient._internal.ulRetryCount, ulQuery + 1 );
+
+        /* Due, then publish the registration query */
+        xTestTickCount += pdMS_TO_TICKS( 1 );
+        will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+        assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                               azureiotprovisioningNO_WAIT ),
+                          eAzureIoTErrorPending );
+        prvRegistrationPublishStep( &xTestProvisioningClient );
+    }
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTProvisioningClient_Register_Success( void ** ppvState )
 {
     AzureIoTProvisioningClient_t xTestProvisioningClient;
@@ -798,6 +911,90 @@ static void testAzureIoTProvisioningClient_Register_Success( void ** ppvState )
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTProvisioningClient_Register_ResponseInPlaceSuccess( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+    uint8_t ucNetworkBuffer[ sizeof( ucAssignedHubResponse ) ];
+    uint8_t ucTestDevice[ 128 ];
+    uint32_t ulTestDeviceLength = sizeof( ucTestDevice );
+    uint8_t ucTestHostname[ 128 ];
+    uint32_t ulTestHostnameLength = sizeof( ucTestHostname );
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegister( &xTestProvisioningClient );
+    prvRegistrationPublishStep( &xTestProvisioningClient );
+
+    /* Response received in the network buffer */
+    memcpy( ucNetworkBuffer, ucAssignedHubResponse, sizeof( ucAssignedHubResponse ) );
+    prvGenerateResponse( &xPublishInfo, 0, ucNetworkBuffer, sizeof( ucNetworkBuffer ) - 1 );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    /* The network buffer is reused by the next packet before the response is processed */
+    memset( ucNetworkBuffer, 'X', sizeof( ucNetworkBuffer ) );
+    xPacketInfo.ucType = 0;
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( xTestProvisioningClient._internal.xRegisterResponse.operation_status,
+                      AZ_IOT_PROVISIONING_STATUS_ASSIGNED );
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHub( &xTestProvisioningClient,
+                                                                  ucTestHostname, &ulTestHostnameLength,
+                                                                  ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTSuccess );
+    assert_memory_equal( ucTestHostname, ucHubEndpoint, sizeof( ucHubEndpoint ) - 1 );
+    assert_int_equal( ulTestHostnameLength, sizeof( ucHubEndpoint ) - 1 );
+    assert_memory_equal( ucTestDevice, ucDeviceId, sizeof( ucDeviceId ) - 1 );
+    assert_int_equal( ulTestDeviceLength, sizeof( ucDeviceId ) - 1 );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_Register_ResponseTooLargeFailure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+    uint8_t ucLongDeviceId[ azureiotprovisioningRESPONSE_STATE_MAX ];
+    uint8_t ucResponse[ sizeof( ucLongDeviceId ) + 256 ];
+    int lResponseLength;
+
+    ( void ) ppvState;
+
+    /* Operation ID, hub hostname and device ID together do not fit the response state */
+    memset( ucLongDeviceId, 'd', sizeof( ucLongDeviceId ) );
+    lResponseLength = snprintf( ( char * ) ucResponse, sizeof( ucResponse ),
+                                "{\"operationId\":\"4.002305f54fc89692.b1f11200-8776-4b5d-867b-dc21c4b59c12\",\"status\":\"assigned\","
+                                "\"registrationState\":{\"registrationId\":\"reg_id\",\"assignedHub\":\"%s\","
+                                "\"deviceId\":\"%.*s\",\"status\":\"assigned\"}}",
+                                ucHubEndpoint, ( int ) sizeof( ucLongDeviceId ), ucLongDeviceId );
+    assert_in_range( lResponseLength, sizeof( ucLongDeviceId ), sizeof( ucResponse ) - 1 );
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegister( &xTestProvisioningClient );
+    prvRegistrationPublishStep( &xTestProvisioningClient );
+
+    prvGenerateResponse( &xPublishInfo, 0, ucResponse, ( uint32_t ) lResponseLength );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    xPacketInfo.ucType = 0;
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorOutOfMemory );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTProvisioningClient_GetDeviceAndHub_Failure( void ** ppvState )
 {
     AzureIoTProvisioningClient_t xTestProvisioningClient;
@@ -932,6 +1129,377 @@ static void testAzureIoTProvisioningClient_WithCustomPayload_Success( void ** pp
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTProvisioningClient_SaveResult_Failure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint8_t ucSavedResult[ azureiotprovisioningSAVED_RESULT_MAX ];
+    uint32_t ulSavedResultLength;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( NULL, ucSavedResult,
+                                                             sizeof( ucSavedResult ), &ulSavedResultLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, NULL,
+                                                             sizeof( ucSavedResult ), &ulSavedResultLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, ucSavedResult,
+                                                             sizeof( ucSavedResult ), NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Nothing to save before registration */
+    assert_int_not_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, ucSavedResult,
+                                                                 sizeof( ucSavedResult ), &ulSavedResultLength ),
+                          eAzureIoTSuccess );
+
+    prvRegister( &xTestProvisioningClient );
+    prvQuery( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, ucSavedResult,
+                                                             18 + sizeof( ucHubEndpoint ) + sizeof( ucDeviceId ) - 3,
+                                                             &ulSavedResultLength ),
+                      eAzureIoTErrorOutOfMemory );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_SaveResult_Success( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint8_t ucSavedResult[ azureiotprovisioningSAVED_RESULT_MAX ];
+    uint32_t ulSavedResultLength;
+    uint8_t ucTestDevice[ 128 ];
+    uint32_t ulTestDeviceLength = sizeof( ucTestDevice );
+    uint8_t ucTestHostname[ 128 ];
+    uint32_t ulTestHostnameLength = sizeof( ucTestHostname );
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegister( &xTestProvisioningClient );
+    prvQuery( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, ucSavedResult,
+                                                             sizeof( ucSavedResult ), &ulSavedResultLength ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulSavedResultLength, 18 + sizeof( ucHubEndpoint ) + sizeof( ucDeviceId ) - 2 );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+
+    /* Next boot, no registration */
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 ucSavedResult, ulSavedResultLength,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( ulTestDeviceLength, sizeof( ucDeviceId ) - 1 );
+    assert_memory_equal( ucTestDevice, ucDeviceId, ulTestDeviceLength );
+    assert_int_equal( ulTestHostnameLength, sizeof( ucHubEndpoint ) - 1 );
+    assert_memory_equal( ucTestHostname, ucHubEndpoint, ulTestHostnameLength );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult_Failure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint8_t ucSavedResult[ azureiotprovisioningSAVED_RESULT_MAX ];
+    uint32_t ulSavedResultLength;
+    uint8_t ucTestDevice[ 128 ];
+    uint32_t ulTestDeviceLength = sizeof( ucTestDevice );
+    uint8_t ucTestHostname[ 128 ];
+    uint32_t ulTestHostnameLength = sizeof( ucTestHostname );
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegister( &xTestProvisioningClient );
+    prvQuery( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_SaveResult( &xTestProvisioningClient, ucSavedResult,
+                                                             sizeof( ucSavedResult ), &ulSavedResultLength ),
+                      eAzureIoTSuccess );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 NULL, ulSavedResultLength,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Truncated */
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 ucSavedResult, ulSavedResultLength - 1,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTErrorItemNotFound );
+
+    /* Output buffers too small */
+    ulTestHostnameLength = 1;
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 ucSavedResult, ulSavedResultLength,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTErrorFailed );
+    ulTestHostnameLength = sizeof( ucTestHostname );
+
+    /* Corrupted */
+    ucSavedResult[ 20 ] ^= 0x01;
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 ucSavedResult, ulSavedResultLength,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTErrorItemNotFound );
+    ucSavedResult[ 20 ] ^= 0x01;
+
+    /* Saved without the registration payload now in use */
+    assert_int_equal( AzureIoTProvisioningClient_SetRegistrationPayload( &xTestProvisioningClient,
+                                                                         ucCustomPayload, sizeof( ucCustomPayload ) - 1 ),
+                      eAzureIoTSuccess );
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult( &xTestProvisioningClient,
+                                                                                 ucSavedResult, ulSavedResultLength,
+                                                                                 ucTestHostname, &ulTestHostnameLength,
+                                                                                 ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTErrorItemNotFound );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_GetSleepTime_Failure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint32_t ulSleepMilliseconds;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( NULL, &ulSleepMilliseconds ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( &xTestProvisioningClient, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_GetSleepTime_Success( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+    uint32_t ulSleepMilliseconds;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    /* Connect is due right away */
+    prvRegistrationConnectStep( &xTestProvisioningClient );
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( &xTestProvisioningClient, &ulSleepMilliseconds ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulSleepMilliseconds, 0 );
+
+    /* Waiting for the subscribe ack */
+    prvRegistrationSubscribeStep( &xTestProvisioningClient );
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( &xTestProvisioningClient, &ulSleepMilliseconds ),
+                      eAzureIoTSuccess );
+    assert_int_not_equal( ulSleepMilliseconds, 0 );
+
+    prvRegistrationAckSubscribeStep( &xTestProvisioningClient );
+    prvRegistrationPublishStep( &xTestProvisioningClient );
+
+    /* Registration response asking to retry after a second */
+    prvGenerateGoodResponse( &xPublishInfo, 1 );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    /* Query is due once the retry time, plus jitter, has passed */
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( &xTestProvisioningClient, &ulSleepMilliseconds ),
+                      eAzureIoTSuccess );
+    assert_in_range( ulSleepMilliseconds, 1000, 1000 + 10 * azureiotconfigPROVISIONING_BACKOFF_JITTER_PERCENT );
+
+    xTestTickCount += pdMS_TO_TICKS( ulSleepMilliseconds );
+    assert_int_equal( AzureIoTProvisioningClient_GetSleepTime( &xTestProvisioningClient, &ulSleepMilliseconds ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulSleepMilliseconds, 0 );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_ReleaseBuffer_Failure( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint8_t * pucReleasedBuffer;
+    uint32_t ulReleasedBufferLength;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_ReleaseBuffer( NULL, &pucReleasedBuffer, &ulReleasedBufferLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTProvisioningClient_ReleaseBuffer( &xTestProvisioningClient, NULL, &ulReleasedBufferLength ),
+                      eAzureIoTErrorInvalidArgument );
+    assert_int_equal( AzureIoTProvisioningClient_ReleaseBuffer( &xTestProvisioningClient, &pucReleasedBuffer, NULL ),
+                      eAzureIoTErrorInvalidArgument );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_ReleaseBuffer_Success( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    uint8_t * pucReleasedBuffer;
+    uint32_t ulReleasedBufferLength;
+    uint8_t ucTestDevice[ 128 ];
+    uint32_t ulTestDeviceLength = sizeof( ucTestDevice );
+    uint8_t ucTestHostname[ 128 ];
+    uint32_t ulTestHostnameLength = sizeof( ucTestHostname );
+
+    ( void ) ppvState;
+
+    /* Not connected yet, nothing to disconnect */
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+    assert_int_equal( AzureIoTProvisioningClient_ReleaseBuffer( &xTestProvisioningClient,
+                                                                &pucReleasedBuffer, &ulReleasedBufferLength ),
+                      eAzureIoTSuccess );
+    assert_true( pucReleasedBuffer == ucBuffer );
+    assert_int_equal( ulReleasedBufferLength, sizeof( ucBuffer ) );
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+    prvRegister( &xTestProvisioningClient );
+    prvQuery( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHub( &xTestProvisioningClient,
+                                                                  ucTestHostname, &ulTestHostnameLength,
+                                                                  ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTSuccess );
+
+    will_return( AzureIoTMQTT_Disconnect, eAzureIoTMQTTSuccess );
+    assert_int_equal( AzureIoTProvisioningClient_ReleaseBuffer( &xTestProvisioningClient,
+                                                                &pucReleasedBuffer, &ulReleasedBufferLength ),
+                      eAzureIoTSuccess );
+    assert_true( pucReleasedBuffer == ucBuffer );
+    assert_int_equal( ulReleasedBufferLength, sizeof( ucBuffer ) );
+
+    /* The hub info is gone with the buffer */
+    assert_int_not_equal( AzureIoTProvisioningClient_GetDeviceAndHub( &xTestProvisioningClient,
+                                                                      ucTestHostname, &ulTestHostnameLength,
+                                                                      ucTestDevice, &ulTestDeviceLength ),
+                          eAzureIoTSuccess );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_ResetRegistration_Failure( void ** ppvState )
+{
+    ( void ) ppvState;
+
+    assert_int_equal( AzureIoTProvisioningClient_ResetRegistration( NULL ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_ResetRegistration_Success( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+    AzureIoTMQTTPublishInfo_t xPublishInfo;
+    uint8_t ucTestDevice[ 128 ];
+    uint32_t ulTestDeviceLength = sizeof( ucTestDevice );
+    uint8_t ucTestHostname[ 128 ];
+    uint32_t ulTestHostnameLength = sizeof( ucTestHostname );
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    prvRegister( &xTestProvisioningClient );
+    prvQuery( &xTestProvisioningClient );
+
+    assert_int_equal( AzureIoTProvisioningClient_ResetRegistration( &xTestProvisioningClient ),
+                      eAzureIoTSuccess );
+
+    /* No hub info until registered again */
+    assert_int_not_equal( AzureIoTProvisioningClient_GetDeviceAndHub( &xTestProvisioningClient,
+                                                                      ucTestHostname, &ulTestHostnameLength,
+                                                                      ucTestDevice, &ulTestDeviceLength ),
+                          eAzureIoTSuccess );
+
+    /* Registration request goes out on the current connection, without connect or subscribe */
+    prvRegistrationPublishStep( &xTestProvisioningClient );
+
+    /* Registration response */
+    prvGenerateGoodResponse( &xPublishInfo, 0 );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorPending );
+
+    /* Process response */
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTProvisioningClient_GetDeviceAndHub( &xTestProvisioningClient,
+                                                                  ucTestHostname, &ulTestHostnameLength,
+                                                                  ucTestDevice, &ulTestDeviceLength ),
+                      eAzureIoTSuccess );
+    assert_int_equal( ulTestHostnameLength, sizeof( ucHubEndpoint ) - 1 );
+    assert_memory_equal( ucTestHostname, ucHubEndpoint, ulTestHostnameLength );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTProvisioningClient_ResetRegistrationDisconnected_Success( void ** ppvState )
+{
+    AzureIoTProvisioningClient_t xTestProvisioningClient;
+
+    ( void ) ppvState;
+
+    prvSetupTestProvisioningClient( &xTestProvisioningClient );
+
+    /* Connect */
+    prvRegistrationConnectStep( &xTestProvisioningClient );
+
+    /* Subscribe */
+    prvRegistrationSubscribeStep( &xTestProvisioningClient );
+
+    /* Connection lost */
+    xPacketInfo.ucType = 0;
+    will_return( AzureIoTMQTT_ProcessLoop, eAzureIoTMQTTRecvFailed );
+    assert_int_equal( AzureIoTProvisioningClient_Register( &xTestProvisioningClient,
+                                                           azureiotprovisioningNO_WAIT ),
+                      eAzureIoTErrorFailed );
+
+    assert_int_equal( AzureIoTProvisioningClient_ResetRegistration( &xTestProvisioningClient ),
+                      eAzureIoTSuccess );
+
+    /* Starts over with connect */
+    prvRegistrationConnectStep( &xTestProvisioningClient );
+
+    AzureIoTProvisioningClient_Deinit( &xTestProvisioningClient );
+}
+/*-----------------------------------------------------------*/
+
 uint32_t ulGetAllTests()
 {
     const struct CMUnitTest tests[] =
@@ -951,11 +1519,25 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTProvisioningClient_Register_QueryFailure ),
         cmocka_unit_test( testAzureIoTProvisioningClient_Register_QueryDeviceDisabledResponseFailure ),
         cmocka_unit_test( testAzureIoTProvisioningClient_Register_QueryInvalidResponseFailure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_Register_RetryBudgetFailure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_Register_QueryBackoffSuccess ),
         cmocka_unit_test( testAzureIoTProvisioningClient_Register_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_Register_ResponseInPlaceSuccess ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_Register_ResponseTooLargeFailure ),
         cmocka_unit_test( testAzureIoTProvisioningClient_GetDeviceAndHub_Failure ),
         cmocka_unit_test( testAzureIoTProvisioningClient_GetDeviceAndHub_Success ),
         cmocka_unit_test( testAzureIoTProvisioningClient_WithCustomPayload_Failure ),
-        cmocka_unit_test( testAzureIoTProvisioningClient_WithCustomPayload_Success )
+        cmocka_unit_test( testAzureIoTProvisioningClient_WithCustomPayload_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_SaveResult_Failure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_SaveResult_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_GetDeviceAndHubFromSavedResult_Failure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_GetSleepTime_Failure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_GetSleepTime_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_ReleaseBuffer_Failure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_ReleaseBuffer_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_ResetRegistration_Failure ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_ResetRegistration_Success ),
+        cmocka_unit_test( testAzureIoTProvisioningClient_ResetRegistrationDisconnected_Success )
     };
 
     return ( uint32_t ) cmocka_run_group_tests_name( "azure_iot_provisioning_client_ut", tests, NULL, NULL );
@@ -202,6 +202,110 @@ static void testAzureIoTMessagePropertiesFind_Success( void ** ppvState )
 }
 /*-----------------------------------------------------------*/
 
+static void testAzureIoTMessagePropertiesIndex_Failure( void ** ppvState )
+{
+    AzureIoTMessageProperties_t xTestMessageProperties;
+    AzureIoTMessagePropertiesIndex_t xIndex;
+    AzureIoTMessagePropertiesIndexEntry_t xEntries[ 2 ];
+    const uint8_t * pucOutValue;
+    uint32_t ulOutValueLength;
+
+    ( void ) ppvState;
+
+    /* Setup property bag with three properties */
+    assert_int_equal( AzureIoTMessage_PropertiesInit( &xTestMessageProperties,
+                                                      ucBuffer, 0, sizeof( ucBuffer ) ),
+                      eAzureIoTSuccess );
+
+    for( uint32_t ulIndex = 0; ulIndex < 3; ulIndex++ )
+    {
+        assert_int_equal( AzureIoTMessage_PropertiesAppend( &xTestMessageProperties,
+                                                            &( ucTestKey[ ulIndex ] ), ( uint32_t ) ( sizeof( ucTestKey ) - 1 - ulIndex ),
+                                                            ucTestValue, sizeof( ucTestValue ) - 1 ),
+                          eAzureIoTSuccess );
+    }
+
+    /* Failed for NULL entries */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexBuild( &xTestMessageProperties, &xIndex, NULL, 2 ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Failed for zero entries */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexBuild( &xTestMessageProperties, &xIndex, xEntries, 0 ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Failed for more properties than entries */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexBuild( &xTestMessageProperties, &xIndex, xEntries, 2 ),
+                      eAzureIoTErrorOutOfMemory );
+
+    /* Failed lookup in the index left by a failed build, rather than missing properties */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexFind( &xIndex, ucTestKey, sizeof( ucTestKey ) - 1,
+                                                           &pucOutValue, &ulOutValueLength ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Failed for NULL key */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexFind( &xIndex, NULL, 0, &pucOutValue, &ulOutValueLength ),
+                      eAzureIoTErrorInvalidArgument );
+
+    /* Failed for NULL outvalue */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexFind( &xIndex, ucTestKey, sizeof( ucTestKey ) - 1,
+                                                           NULL, 0 ),
+                      eAzureIoTErrorInvalidArgument );
+}
+/*-----------------------------------------------------------*/
+
+static void testAzureIoTMessagePropertiesIndex_Success( void ** ppvState )
+{
+    AzureIoTMessageProperties_t xTestMessageProperties;
+    AzureIoTMessagePropertiesIndex_t xIndex;
+    AzureIoTMessagePropertiesIndexEntry_t xEntries[ 2 * ( sizeof( ucTestKey ) - 1 ) ];
+    const uint8_t * pucOutValue;
+    uint32_t ulOutValueLength;
+
+    ( void ) ppvState;
+
+    /* Setup property bag and add key-value to it */
+    assert_int_equal( AzureIoTMessage_PropertiesInit( &xTestMessageProperties,
+                                                      ucBuffer, 0, sizeof( ucBuffer ) ),
+                      eAzureIoTSuccess );
+
+    for( uint32_t ulIndex = 0; ulIndex < sizeof( ucTestKey ) - 1; ulIndex++ )
+    {
+        assert_int_equal( AzureIoTMessage_PropertiesAppend( &xTestMessageProperties,
+                                                            &( ucTestKey[ ulIndex ] ), ( uint32_t ) ( sizeof( ucTestKey ) - 1 - ulIndex ),
+                                                            &( ucTestValue[ ulIndex ] ), ( uint32_t ) ( sizeof( ucTestValue ) - 1 - ulIndex ) ),
+                          eAzureIoTSuccess );
+    }
+
+    /* A repeated name keeps the first value, as PropertiesFind does */
+    assert_int_equal( AzureIoTMessage_PropertiesAppend( &xTestMessageProperties,
+                                                        ucTestKey, sizeof( ucTestKey ) - 1,
+                                                        ucTestUnknownKey, sizeof( ucTestUnknownKey ) - 1 ),
+                      eAzureIoTSuccess );
+
+    assert_int_equal( AzureIoTMessage_PropertiesIndexBuild( &xTestMessageProperties, &xIndex,
+                                                            xEntries, sizeof( xEntries ) / sizeof( xEntries[ 0 ] ) ),
+                      eAzureIoTSuccess );
+
+    /* Find all keys in reverse order, and check they agree with PropertiesFind */
+    for( uint32_t ulPos = sizeof( ucTestKey ) - 1; ulPos > 0; ulPos-- )
+    {
+        assert_int_equal( AzureIoTMessage_PropertiesIndexFind( &xIndex,
+                                                               &( ucTestKey[ ulPos - 1 ] ), ( uint32_t ) ( sizeof( ucTestKey ) - ulPos ),
+                                                               &pucOutValue, &ulOutValueLength ),
+                          eAzureIoTSuccess );
+
+        assert_int_equal( ulOutValueLength, sizeof( ucTestValue ) - ulPos );
+        assert_memory_equal( pucOutValue, &( ucTestValue[ ulPos - 1 ] ), ulOutValueLength );
+    }
+
+    /* Not found key */
+    assert_int_equal( AzureIoTMessage_PropertiesIndexFind( &xIndex,
+                                                           ucTestUnknownKey, sizeof( ucTestUnknownKey ) - 1,
+                                                           &pucOutValue, &ulOutValueLength ),
+                      eAzureIoTErrorItemNotFound );
+}
+/*-----------------------------------------------------------*/
+
 static void testAzureIoTInit_Success( void ** ppvState )
 {
     ( void ) ppvState;
@@ -288,6 +392,8 @@ uint32_t ulGetAllTests()
         cmocka_unit_test( testAzureIoTMessagePropertiesAppend_Success ),
         cmocka_unit_test( testAzureIoTMessagePropertiesFind_Failure ),
         cmocka_unit_test( testAzureIoTMessagePropertiesFind_Success ),
+        cmocka_unit_test( testAzureIoTMessagePropertiesIndex_Failure ),
+        cmocka_unit_test( testAzureIoTMessagePropertiesIndex_Success ),
         cmocka_unit_test( testAzureIoTInit_Success ),
         cmocka_unit_test( testAzureIoTInit_LogSuccess ),
         cmocka_unit_test( testAzureIoT_Base64HMACCalculateSuccess ),